@@ -116,6 +116,9 @@ Args::Ctor()
   out_db_config     = "";
   db_makeMetricDB   = true;
   db_addStructId    = false;
+  db_metricDBFmt    = MetricDBFmt_Dense;
+  db_singleMetricDB = false;
+  db_makeExperimentDB = false;
 
   out_txt           = Analysis_OUT_TXT;
   txt_summary       = TxtSum_NULL;
@@ -187,6 +187,7 @@ public:
 
 #define Analysis_OUT_DB_EXPERIMENT "experiment.xml"
 #define Analysis_OUT_DB_CSV        "experiment.csv"
+#define Analysis_OUT_DB_EXPERIMENT_BIN "experiment.db"
 
 #define Analysis_DB_DIR_pfx        "hpctoolkit"
 #define Analysis_DB_DIR_nm         "database"
@@ -204,6 +205,21 @@ public:
   bool db_makeMetricDB;
   bool db_addStructId;
 
+  // layout of the thread-level metric value database
+  enum MetricDBFmt {
+    MetricDBFmt_Dense        = 0, // one row per CCT node (version 00.10)
+    MetricDBFmt_SparseNode   = 1, // nonzeros grouped by node (02.00)
+    MetricDBFmt_SparseMetric = 2  // nonzeros grouped by metric (02.00)
+  };
+
+  int/*MetricDBFmt*/ db_metricDBFmt;
+
+  // write all thread-level metric-dbs into one file (hpcprof-mpi)
+  bool db_singleMetricDB;
+
+  // also write the binary experiment database (experiment.db)
+  bool db_makeExperimentDB;
+
   // -------------------------------------------------------
   // Output arguments: textual output
   // -------------------------------------------------------
@@ -155,6 +155,23 @@ Options: Output:\n\
   --metric-db <yes|no>\n\
                        Control whether to generate a thread-level metric\n\
                        value database for hpcviewer scatter plots. {yes}\n\
+  --metric-db-format <dense|node|metric>\n\
+                       Layout of the thread-level metric value database:\n\
+                         dense:  one value per (node, metric) pair\n\
+                         node:   nonzero values grouped by CCT node\n\
+                         metric: nonzero values grouped by metric\n\
+                       The sparse layouts need a viewer that reads\n\
+                       metric-db version 02.00. hpcprof-mpi only.\n\
+                       {dense}\n\
+  --single-metric-db <yes|no>\n\
+                       Write the thread-level metric values of all\n\
+                       profiles into one file, experiment.metric-dbs,\n\
+                       instead of one file per profile. Requires a\n\
+                       sparse --metric-db-format. hpcprof-mpi only. {no}\n\
+  --experiment-db <yes|no>\n\
+                       Also write experiment.db, a binary form of the\n\
+                       CCT, its dictionaries and its summary metric\n\
+                       values that can be mapped without parsing. {no}\n\
   --remove-redundancy \n\
                        Eliminate procedure name redundancy in experiment.xml\n\
   --struct-id          Add 'str=nnn' field to profile data with the hpcstruct\n\
@@ -204,6 +221,12 @@ CmdLineParser::OptArgDesc Analysis::ArgsHPCProf::optArgs[] = {
      NULL },
   {  0 , "metric-db",       CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "metric-db-format", CLP::ARG_REQ, CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "single-metric-db", CLP::ARG_REQ, CLP::DUPOPT_CLOB, NULL,
+     NULL },
+  {  0 , "experiment-db",   CLP::ARG_REQ,  CLP::DUPOPT_CLOB, NULL,
+     NULL },
   {  0 , "struct-id",       CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
 
@@ -238,6 +261,7 @@ ArgsHPCProf::ArgsHPCProf()
   prof_metrics = Analysis::Args::MetricFlg_StatsSum;
 
   db_makeMetricDB = true;
+  db_metricDBFmt = Analysis::Args::MetricDBFmt_Dense;
   remove_redundancy = false;
 }
 
@@ -409,6 +433,24 @@ ArgsHPCProf::parse(int argc, const char* const argv[])
       const string& arg = parser.getOptArg("metric-db");
       db_makeMetricDB = CmdLineParser::parseArg_bool(arg, "--metric-db option");
     }
+    if (parser.isOpt("metric-db-format")) {
+      const string& arg = parser.getOptArg("metric-db-format");
+      db_metricDBFmt = parseArg_metricDBFmt(arg, "--metric-db-format option");
+    }
+    if (parser.isOpt("single-metric-db")) {
+      const string& arg = parser.getOptArg("single-metric-db");
+      db_singleMetricDB =
+	CmdLineParser::parseArg_bool(arg, "--single-metric-db option");
+      if (db_singleMetricDB
+	  && db_metricDBFmt == Analysis::Args::MetricDBFmt_Dense) {
+	ARG_ERROR("--single-metric-db requires a sparse --metric-db-format");
+      }
+    }
+    if (parser.isOpt("experiment-db")) {
+      const string& arg = parser.getOptArg("experiment-db");
+      db_makeExperimentDB =
+	CmdLineParser::parseArg_bool(arg, "--experiment-db option");
+    }
     if (parser.isOpt("struct-id")) {
       db_addStructId = true;
     }
@@ -468,6 +510,25 @@ ArgsHPCProf::parseArg_norm(const string& value, const char* errTag)
 }
 
 
+int
+ArgsHPCProf::parseArg_metricDBFmt(const std::string& value,
+				  const char* errTag)
+{
+  if (value == "dense") {
+    return Analysis::Args::MetricDBFmt_Dense;
+  }
+  else if (value == "node") {
+    return Analysis::Args::MetricDBFmt_SparseNode;
+  }
+  else if (value == "metric") {
+    return Analysis::Args::MetricDBFmt_SparseMetric;
+  }
+  else {
+    ARG_ERROR(errTag << ": Unexpected value received: '" << value << "'");
+  }
+}
+
+
 // Cf. hpcproftt/Args::parseArg_metric()
 void
 ArgsHPCProf::parseArg_metric(const std::string& value, const char* errTag)
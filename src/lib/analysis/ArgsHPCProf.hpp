@@ -121,6 +121,9 @@ protected:
   void
   parseArg_metric(const std::string& value, const char* errTag);
 
+  int
+  parseArg_metricDBFmt(const std::string& value, const char* errTag);
+
   
   static std::string
   makeDBDirName(const std::string& profileArg);
@@ -72,8 +72,12 @@ using std::string;
 #include <cstring>
 
 #include <typeinfo>
+#include <map>
+#include <vector>
 
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 //*************************** User Include Files ****************************
 
@@ -92,6 +96,7 @@ using std::string;
 #include <lib/profxml/PGMReader.hpp>
 
 #include <lib/prof-lean/hpcrun-metric.h>
+#include <lib/prof-lean/hpcexpdb-fmt.h>
 
 #include <lib/binutils/LM.hpp>
 #include <lib/binutils/VMAInterval.hpp>
@@ -1077,6 +1082,10 @@ static void
 write(Prof::CallPath::Profile& prof, std::ostream& os,
       const Analysis::Args& args);
 
+static void
+writeExperimentDB(const Prof::CallPath::Profile& prof, const string& fnm,
+		  const Analysis::Args& args);
+
 
 // makeDatabase: assumes Analysis::Args::makeDatabaseDir() has been called
 void
@@ -1108,16 +1117,19 @@ makeDatabase(Prof::CallPath::Profile& prof, const Analysis::Args& args)
   IOUtil::CloseStream(os);
 
   delete[] outBuf;
+
+  // 5. Create 'experiment.db' file (N.B.: after 'experiment.xml',
+  //    which builds the dictionaries it shares)
+  if (args.db_makeExperimentDB) {
+    string expdb_fnm = db_dir + "/" + Analysis_OUT_DB_EXPERIMENT_BIN;
+    writeExperimentDB(prof, expdb_fnm, args);
+  }
 }
 
 
-static void
-write(Prof::CallPath::Profile& prof, std::ostream& os,
-      const Analysis::Args& args)
+static int
+makeOFlags(const Analysis::Args& args)
 {
-  static const char* experimentDTD =
-#include <lib/xml/hpc-experiment.dtd.h>
-
   using namespace Prof;
 
   int oFlags = 0; // CCT::Tree::OFlg_LeafMetricsOnly;
@@ -1131,16 +1143,38 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   if (args.db_addStructId) {
     oFlags |= CCT::Tree::OFlg_StructId;
   }
+  return oFlags;
+}
+
+
+// findVisibleMetrics: the range of metrics written to the database
+static void
+findVisibleMetrics(const Prof::CallPath::Profile& prof,
+		   uint& metricBegId, uint& metricEndId)
+{
+  using namespace Prof;
+
+  const Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
+  const Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
+  metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
+  metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
+}
+
+
+static void
+write(Prof::CallPath::Profile& prof, std::ostream& os,
+      const Analysis::Args& args)
+{
+  static const char* experimentDTD =
+#include <lib/xml/hpc-experiment.dtd.h>
+
+  using namespace Prof;
+
+  int oFlags = makeOFlags(args);
 
   uint metricBegId = 0;
   uint metricEndId = prof.metricMgr()->size();
-
- {
-    Metric::ADesc* mBeg = prof.metricMgr()->findFirstVisible();
-    Metric::ADesc* mEnd = prof.metricMgr()->findLastVisible();
-    metricBegId = (mBeg) ? mBeg->id()     : Metric::Mgr::npos;
-    metricEndId = (mEnd) ? mEnd->id() + 1 : Metric::Mgr::npos;
-  }
+  findVisibleMetrics(prof, metricBegId, metricEndId);
 
   string name = (args.title.empty()) ? prof.name() : args.title;
 
@@ -1175,6 +1209,146 @@ write(Prof::CallPath::Profile& prof, std::ostream& os,
   os.flush();
 }
 
+//****************************************************************************
+// experiment.db
+//****************************************************************************
+
+typedef std::map<string, uint32_t> StringToOffsetMap;
+
+// addString: returns the offset of 'x' in the string table 'strTbl',
+// appending it if new
+static uint32_t
+addString(string& strTbl, StringToOffsetMap& strOff, const string& x)
+{
+  if (x.empty()) {
+    return 0;
+  }
+  StringToOffsetMap::iterator it = strOff.find(x);
+  if (it != strOff.end()) {
+    return it->second;
+  }
+  uint32_t off = strTbl.size();
+  strTbl.append(x.c_str(), x.size() + 1);
+  strOff.insert(std::make_pair(x, off));
+  return off;
+}
+
+
+static void
+addDictTable(std::vector<hpcexpdb_fmt_dict_t>& dicts, string& strTbl,
+	     StringToOffsetMap& strOff,
+	     const Prof::CallPath::Profile::DictTable& table, uint8_t kind)
+{
+  for (uint i = 0; i < table.size(); ++i) {
+    hpcexpdb_fmt_dict_t x;
+    memset(&x, 0, sizeof(x));
+    x.id    = table[i].id;
+    x.name  = addString(strTbl, strOff, table[i].name);
+    x.kind  = kind;
+    x.flags = (table[i].isFake) ? HPCEXPDB_FMT_DictFake : 0;
+    dicts.push_back(x);
+  }
+}
+
+
+// writeExperimentDB: writes the dictionaries, the CCT and the summary
+// metric values of experiment.xml as flat arrays (see
+// prof-lean/hpcexpdb-fmt.h).  Each section is a single large write.
+static void
+writeExperimentDB(const Prof::CallPath::Profile& prof, const string& fnm,
+		  const Analysis::Args& args)
+{
+  using namespace Prof;
+
+  int oFlags = makeOFlags(args);
+
+  uint metricBegId, metricEndId;
+  findVisibleMetrics(prof, metricBegId, metricEndId);
+
+  string strTbl(1, '\0');
+  StringToOffsetMap strOff;
+
+  // -------------------------------------------------------
+  // metric and dictionary tables
+  // -------------------------------------------------------
+  std::vector<hpcexpdb_fmt_metric_t> metrics;
+  for (uint i = metricBegId; i < metricEndId; ++i) {
+    const Metric::ADesc* m = prof.metricMgr()->metric(i);
+
+    hpcexpdb_fmt_metric_t x;
+    x.id      = i;
+    x.name    = addString(strTbl, strOff, m->name());
+    x.partner = (m->partner()) ? m->partner()->id() : HPCEXPDB_FMT_NoMetric;
+    x.type    = m->type();
+    x.flags   = 0;
+    if (m->isVisible()) {
+      x.flags |= HPCEXPDB_FMT_MetricShow;
+    }
+    if (m->doDispPercent()) {
+      x.flags |= HPCEXPDB_FMT_MetricShowPercent;
+    }
+    metrics.push_back(x);
+  }
+
+  typedef Prof::CallPath::Profile Profile;
+
+  std::vector<hpcexpdb_fmt_dict_t> dicts;
+  addDictTable(dicts, strTbl, strOff, prof.dictTable(Profile::DictTy_LM),
+	       HPCEXPDB_FMT_DictLM);
+  addDictTable(dicts, strTbl, strOff, prof.dictTable(Profile::DictTy_File),
+	       HPCEXPDB_FMT_DictFile);
+  if ( !(oFlags & CCT::Tree::OFlg_Debug) ) {
+    addDictTable(dicts, strTbl, strOff, prof.dictTable(Profile::DictTy_Proc),
+		 HPCEXPDB_FMT_DictProc);
+  }
+
+  // -------------------------------------------------------
+  // CCT and summary metrics
+  // -------------------------------------------------------
+  CCT::Tree::Columns cols;
+  prof.cct()->makeColumns(cols, metricBegId, metricEndId);
+
+  hpcexpdb_fmt_data_t data;
+  memset(&data, 0, sizeof(data));
+  data.str        = strTbl.data();
+  data.strSz      = strTbl.size();
+  data.metrics    = (metrics.empty()) ? NULL : &metrics[0];
+  data.numMetrics = metrics.size();
+  data.dicts      = (dicts.empty()) ? NULL : &dicts[0];
+  data.numDicts   = dicts.size();
+  data.numNodes   = cols.kind.size();
+  if (data.numNodes > 0) {
+    for (int c = 0; c < HPCEXPDB_FMT_NumCols; ++c) {
+      data.col[c] = &cols.col[c][0];
+    }
+    data.kind  = &cols.kind[0];
+    data.flags = &cols.flags[0];
+  }
+  data.metricPtr = &cols.metricPtr[0];
+  if (!cols.values.empty()) {
+    data.values = &cols.values[0];
+    data.rows   = &cols.rows[0];
+  }
+
+  // -------------------------------------------------------
+  // write
+  // -------------------------------------------------------
+  DIAG_Msg(1, "Writing binary Experiment database: " << fnm);
+
+  int fd = open(fnm.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    DIAG_Throw("error opening binary experiment database '" << fnm << "'");
+  }
+  int ret = hpcexpdb_fmt_write(fd, &data);
+  if (close(fd) != 0) {
+    ret = HPCFMT_ERR;
+  }
+  if (ret == HPCFMT_ERR) {
+    DIAG_Throw("error writing binary experiment database '" << fnm << "'");
+  }
+}
+
+
 } // namespace CallPath
 
 } // namespace Analysis
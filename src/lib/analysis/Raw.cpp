@@ -61,6 +61,7 @@
 
 #include <iostream>
 #include <string>
+#include <vector>
 using std::string;
 
 #define __STDC_FORMAT_MACROS
@@ -96,6 +97,9 @@ Analysis::Raw::writeAsText(/*destination,*/ const char* filenm)
   else if (ty == ProfType_CallpathMetricDB) {
     writeAsText_callpathMetricDB(filenm);
   }
+  else if (ty == ProfType_CallpathMetricDBSet) {
+    writeAsText_callpathMetricDBSet(filenm);
+  }
   else if (ty == ProfType_CallpathTrace) {
     writeAsText_callpathTrace(filenm);
   }
@@ -125,6 +129,32 @@ Analysis::Raw::writeAsText_callpath(const char* filenm)
 }
 
 
+// Prints a sparse (version 02.00) metric-db one node at a time,
+// omitting nodes without nonzero values.
+static void
+writeAsText_callpathMetricDBSparse(const hpcmetricDB_sparse_t& db)
+{
+  const char* layout = (db.footer.layout == HPCMETRICDB_LAYOUT_Node)
+    ? "node" : "metric";
+  fprintf(stdout, "[sparse: (layout: %s) (nonzeros: %" PRIu64 ")]\n",
+	  layout, db.footer.nnz);
+
+  std::vector<double> row(db.hdr.numMetrics);
+  for (uint nodeId = 1; nodeId < db.hdr.numNodes + 1; ++nodeId) {
+    if (row.empty()
+	|| hpcmetricDB_sparse_query(&db, nodeId, nodeId + 1,
+				    0, db.hdr.numMetrics, &row[0]) == 0) {
+      continue;
+    }
+    fprintf(stdout, "(%6u: ", nodeId);
+    for (uint mId = 0; mId < db.hdr.numMetrics; ++mId) {
+      fprintf(stdout, "%12g ", row[mId]);
+    }
+    fprintf(stdout, ")\n");
+  }
+}
+
+
 void
 Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 {
@@ -144,11 +174,22 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 
     hpcmetricDB_fmt_hdr_fprint(&hdr, stdout);
 
+    if (hdr.version >= 2.0) {
+      hpcmetricDB_sparse_t db;
+      if (hpcmetricDB_sparse_open(&db, fs) != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+      writeAsText_callpathMetricDBSparse(db);
+      hpcmetricDB_sparse_close(&db);
+      hpcio_fclose(fs);
+      return;
+    }
+
     for (uint nodeId = 1; nodeId < hdr.numNodes + 1; ++nodeId) {
       fprintf(stdout, "(%6u: ", nodeId);
       for (uint mId = 0; mId < hdr.numMetrics; ++mId) {
 	double mval = 0;
-	ret = hpcfmt_real8_fread(&mval, fs);
+	ret = hpcfmt_real8_fread_endian(&mval, hdr.endian, fs);
 	if (ret != HPCFMT_OK) {
 	  DIAG_Throw("error reading trace file '" << filenm << "'");
 	}
@@ -166,6 +207,52 @@ Analysis::Raw::writeAsText_callpathMetricDB(const char* filenm)
 }
 
 
+void
+Analysis::Raw::writeAsText_callpathMetricDBSet(const char* filenm)
+{
+  if (!filenm) { return; }
+
+  try {
+    FILE* fs = hpcio_fopen_r(filenm);
+    if (!fs) {
+      DIAG_Throw("error opening metric-db file '" << filenm << "'");
+    }
+
+    hpcmetricDB_set_t set;
+    if (hpcmetricDB_set_open(&set, fs) != HPCFMT_OK) {
+      DIAG_Throw("error reading metric-db file '" << filenm << "'");
+    }
+
+    fprintf(stdout, "[metric-db set: (endian: %c) (entries: %" PRIu64 ")]\n",
+	    set.endian, set.footer.numEntries);
+
+    for (uint64_t i = 0; i < set.footer.numEntries; ++i) {
+      hpcmetricDB_set_entry_t entry;
+      const char* name;
+      hpcmetricDB_sparse_t db;
+      if (hpcmetricDB_set_entry(&set, i, &entry, &name) != HPCFMT_OK
+	  || hpcmetricDB_sparse_open_set(&db, &set, i) != HPCFMT_OK) {
+	DIAG_Throw("error reading metric-db file '" << filenm << "'");
+      }
+
+      fprintf(stdout, "\n[%u.%.*s: (offset: %" PRIu64 ") (length: %" PRIu64
+	      ")]\n", entry.groupId, (int)entry.nameLen, name,
+	      entry.off, entry.len);
+      hpcmetricDB_fmt_hdr_fprint(&db.hdr, stdout);
+      writeAsText_callpathMetricDBSparse(db);
+      hpcmetricDB_sparse_close(&db);
+    }
+
+    hpcmetricDB_set_close(&set);
+    hpcio_fclose(fs);
+  }
+  catch (...) {
+    DIAG_EMsg("While reading '" << filenm << "'...");
+    throw;
+  }
+}
+
+
 void
 Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
 {
@@ -189,7 +276,7 @@ Analysis::Raw::writeAsText_callpathTrace(const char* filenm)
     // Read trace records and exit on EOF
     while ( !feof(fs) ) {
       hpctrace_fmt_datum_t datum;
-      ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, fs);
+      ret = hpctrace_fmt_datum_fread(&datum, &hdr, fs);
       if (ret == HPCFMT_EOF) {
 	break;
       }
@@ -89,6 +89,9 @@ writeAsText_callpath(/*destination,*/ const char* filenm);
 void
 writeAsText_callpathMetricDB(/*destination,*/ const char* filenm);
 
+void
+writeAsText_callpathMetricDBSet(/*destination,*/ const char* filenm);
+
 void
 writeAsText_callpathTrace(/*destination,*/ const char* filenm);
 
@@ -64,6 +64,8 @@
 #include <string>
 using std::string;
 
+#include <vector>
+
 #include <algorithm>
 #include <typeinfo>
 
@@ -81,6 +83,7 @@ using std::string;
 #include <lib/banal/StructSimple.hpp>
 
 #include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-z.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcrunflat-fmt.h>
@@ -143,9 +146,16 @@ getProfileType(const std::string& filenm)
   static const int bufSZ = 32;
   char buf[bufSZ] = { '\0' };
 
-  std::istream* is = IOUtil::OpenIStream(filenm.c_str());
-  is->read(buf, bufSZ);
-  IOUtil::CloseStream(is);
+  // hpcio_fopen_r() sees through compressed hpcrun output files
+  FILE* fs = hpcio_fopen_r(filenm.c_str());
+  if (!fs) {
+    DIAG_Throw("could not open " << filenm);
+  }
+  size_t nr = fread(buf, 1, bufSZ, fs);
+  hpcio_fclose(fs);
+  if (nr < (size_t)bufSZ) {
+    buf[nr] = '\0';
+  }
   
   ProfType_t ty = ProfType_NULL;
   if (strncmp(buf, HPCRUN_FMT_Magic, HPCRUN_FMT_MagicLen) == 0) {
@@ -154,6 +164,10 @@ getProfileType(const std::string& filenm)
   else if (strncmp(buf, HPCMETRICDB_FMT_Magic, HPCMETRICDB_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathMetricDB;
   }
+  else if (strncmp(buf, HPCMETRICDB_SET_FMT_Magic,
+		   sizeof(HPCMETRICDB_SET_FMT_Magic) - 1) == 0) {
+    ty = ProfType_CallpathMetricDBSet;
+  }
   else if (strncmp(buf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen) == 0) {
     ty = ProfType_CallpathTrace;
   }
@@ -581,6 +595,52 @@ copySourceFile(const string& filenm, const string& dstDir,
 namespace Analysis {
 namespace Util {
 
+// copyTraceFile: Copies trace 'srcFnm' to 'dstFnm', decompressing a
+// trace that hpcrun compressed (the database holds uncompressed traces
+// that hpcserver can map).
+static void
+copyTraceFile(const std::string& dstFnm, const std::string& srcFnm)
+{
+  FILE* fs = fopen(srcFnm.c_str(), "r");
+  bool isCompressed = (fs && hpcio_z_is_compressed(fs));
+  if (fs) {
+    fclose(fs);
+  }
+
+  if (!isCompressed) {
+    FileUtil::copy(dstFnm, srcFnm);
+    return;
+  }
+
+  FILE* infs = hpcio_fopen_r(srcFnm.c_str());
+  if (!infs) {
+    DIAG_Throw("could not open " << srcFnm);
+  }
+  FILE* outfs = hpcio_fopen_w(dstFnm.c_str(), 1/*overwrite*/);
+  if (!outfs) {
+    hpcio_fclose(infs);
+    DIAG_Throw("could not open " << dstFnm);
+  }
+
+  std::vector<char> buf(HPCIO_RWBufferSz);
+  size_t nr;
+  bool isOk = true;
+  while ((nr = fread(&buf[0], 1, buf.size(), infs)) > 0) {
+    if (fwrite(&buf[0], 1, nr, outfs) != nr) {
+      isOk = false;
+      break;
+    }
+  }
+  isOk = isOk && !ferror(infs);
+
+  hpcio_fclose(infs);
+  isOk = (hpcio_fclose(outfs) == 0) && isOk;
+  if (!isOk) {
+    DIAG_Throw("error decompressing " << srcFnm);
+  }
+}
+
+
 // copyTraceFiles:
 void
 copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
@@ -631,7 +691,7 @@ copyTraceFiles(const std::string& dstDir, const std::set<string>& srcFiles)
       // no trace.tmp file: always copy (keep original)
       try {
 	DIAG_Msg(2, "trace (cp): '" << srcFnm2 << "' -> '" << dstFnm << "'");
-	FileUtil::copy(dstFnm, srcFnm2);
+	copyTraceFile(dstFnm, srcFnm2);
       }
       catch (const Diagnostics::Exception& ex) {
 	DIAG_EMsg("While copying trace files ['"
@@ -93,6 +93,7 @@ enum ProfType_t {
   ProfType_NULL,
   ProfType_Callpath,
   ProfType_CallpathMetricDB,
+  ProfType_CallpathMetricDBSet,
   ProfType_CallpathTrace,
   ProfType_Flat
 };
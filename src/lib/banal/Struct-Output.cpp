@@ -67,13 +67,16 @@
 //***************************************************************************
 
 #include <limits.h>
+#include <string.h>
 
 #include <list>
 #include <map>
 #include <ostream>
 #include <string>
+#include <vector>
 
 #include <lib/binutils/VMAInterval.hpp>
+#include <lib/prof-lean/hpcstruct-fmt.h>
 #include <lib/support/FileUtil.hpp>
 #include <lib/support/StringTable.hpp>
 #include <lib/support/dictionary.h>
@@ -115,14 +118,102 @@ static const char * hpcstruct_xml_head =
 #define VRANGE(vma, len)  \
   " v=\"{[0x" << hex << vma << "-0x" << vma + len << dec << ")}\""
 
+//----------------------------------------------------------------------
+
+// Binary output (hpcstruct --binary, see lib/prof-lean/hpcstruct-fmt.h).
+// Nodes are written as they are visited, in the same pre-order and
+// with the same ids as the XML elements.  The vma ranges and string
+// table are appended at the end.
+
+static bool binary_out = false;
+static vector <uint32_t> bin_stack;  // indices of the open nodes
+static uint32_t bin_num_nodes;
+static vector <uint64_t> bin_vmas;   // beg, end pairs
+static string bin_strs;
+static map <string, uint32_t> bin_str_map;
+
+static uint32_t
+binString(const string & str)
+{
+  if (str.empty()) {
+    return 0;
+  }
+
+  auto it = bin_str_map.find(str);
+  if (it != bin_str_map.end()) {
+    return it->second;
+  }
+
+  uint32_t off = bin_strs.size();
+  bin_strs.append(str);
+  bin_strs.push_back('\0');
+  bin_str_map[str] = off;
+  return off;
+}
+
+// Write one node as a child of the innermost open node and make it
+// the innermost open node.  Uses the next XML index as its id.
+static void
+binBegin(ostream * os, int kind, const string & name, const string & file,
+	 const string & linkName, long line,
+	 const VMAIntervalSet * vset = NULL)
+{
+  hpcstruct_fmt_node_t node;
+
+  memset(&node, 0, sizeof(node));
+  node.kind = kind;
+  node.parent = bin_stack.empty() ? HPCSTRUCT_FMT_NoParent : bin_stack.back();
+  node.id = next_index++;
+  node.name = binString(name);
+  node.file = binString(file);
+  node.linkName = binString(linkName);
+  node.line = line;
+  node.vmaIdx = bin_vmas.size() / 2;
+
+  if (vset != NULL) {
+    for (auto it = vset->begin(); it != vset->end(); ++it) {
+      bin_vmas.push_back(it->beg());
+      bin_vmas.push_back(it->end());
+    }
+  }
+  node.numVMA = bin_vmas.size() / 2 - node.vmaIdx;
+
+  os->write((const char *) &node, sizeof(node));
+  bin_stack.push_back(bin_num_nodes++);
+}
+
+static void
+binEnd()
+{
+  bin_stack.pop_back();
+}
+
+//----------------------------------------------------------------------
+
 static void
 doIndent(ostream * os, int depth)
 {
+  if (binary_out) {
+    return;
+  }
   for (int n = 1; n <= depth; n++) {
     *os << INDENT;
   }
 }
 
+// Close the innermost element: write the end tag, or for binary
+// output, pop the open node.
+static void
+doEndTag(ostream * os, int depth, const char * tag)
+{
+  if (binary_out) {
+    binEnd();
+    return;
+  }
+  doIndent(os, depth);
+  *os << tag;
+}
+
 //----------------------------------------------------------------------
 
 namespace BAnal {
@@ -162,19 +253,35 @@ locateTree(TreeNode *, ScopeInfo &, HPC::StringTable &, bool = false);
 
 //----------------------------------------------------------------------
 
-// DOCTYPE header and <HPCToolkitStructure> tag.
+// DOCTYPE header and <HPCToolkitStructure> tag, or the binary header.
 void
-printStructFileBegin(ostream * os, ostream * gaps, string filenm)
+printStructFileBegin(ostream * os, ostream * gaps, string filenm, bool binary)
 {
   if (os == NULL) {
     return;
   }
 
-  *os << "<?xml version=\"1.0\"?>\n"
-      << "<!DOCTYPE HPCToolkitStructure [\n"
-      << hpcstruct_xml_head
-      << "]>\n"
-      << "<HPCToolkitStructure i=\"0\" version=\"4.7\" n=\"\">\n";
+  binary_out = binary;
+
+  if (binary_out) {
+    char hdr[HPCSTRUCT_FMT_HeaderLen];
+
+    bin_stack.clear();
+    bin_num_nodes = 0;
+    bin_vmas.clear();
+    bin_strs.assign(1, '\0');
+    bin_str_map.clear();
+
+    hpcstruct_fmt_hdr_init(hdr);
+    os->write(hdr, sizeof(hdr));
+  }
+  else {
+    *os << "<?xml version=\"1.0\"?>\n"
+	<< "<!DOCTYPE HPCToolkitStructure [\n"
+	<< hpcstruct_xml_head
+	<< "]>\n"
+	<< "<HPCToolkitStructure i=\"0\" version=\"4.7\" n=\"\">\n";
+  }
 
   if (gaps != NULL) {
     *gaps << "This file describes the unclaimed vma ranges (gaps) in the control\n"
@@ -185,7 +292,7 @@ printStructFileBegin(ostream * os, ostream * gaps, string filenm)
   }
 }
 
-// Closing tag.
+// Closing tag, or the binary vma ranges, string table and footer.
 void
 printStructFileEnd(ostream * os, ostream * gaps)
 {
@@ -193,7 +300,29 @@ printStructFileEnd(ostream * os, ostream * gaps)
     return;
   }
 
-  *os << "</HPCToolkitStructure>\n";
+  if (binary_out) {
+    hpcstruct_fmt_footer_t footer;
+
+    footer.numNodes = bin_num_nodes;
+    footer.vmaOff = HPCSTRUCT_FMT_HeaderLen
+      + (uint64_t) bin_num_nodes * sizeof(hpcstruct_fmt_node_t);
+    footer.numVMAs = bin_vmas.size() / 2;
+    footer.strOff = footer.vmaOff + bin_vmas.size() * sizeof(uint64_t);
+    footer.strSz = bin_strs.size();
+    memcpy(footer.magic, HPCSTRUCT_FMT_FooterMagic, sizeof(footer.magic));
+
+    os->write((const char *) bin_vmas.data(),
+	      bin_vmas.size() * sizeof(uint64_t));
+    os->write(bin_strs.data(), bin_strs.size());
+    os->write((const char *) &footer, sizeof(footer));
+
+    bin_vmas.clear();
+    bin_strs.clear();
+    bin_str_map.clear();
+  }
+  else {
+    *os << "</HPCToolkitStructure>\n";
+  }
   os->flush();
 
   if (gaps != NULL) {
@@ -213,6 +342,11 @@ printLoadModuleBegin(ostream * os, string lmName)
 
   next_index = INIT_LM_INDEX;
 
+  if (binary_out) {
+    binBegin(os, HPCSTRUCT_FMT_LM, lmName, "", "", 0);
+    return;
+  }
+
   *os << "<LM"
       << INDEX
       << STRING("n", lmName)
@@ -227,7 +361,7 @@ printLoadModuleEnd(ostream * os)
     return;
   }
 
-  *os << "</LM>\n";
+  doEndTag(os, 0, "</LM>\n");
 }
 
 //----------------------------------------------------------------------
@@ -240,6 +374,11 @@ printFileBegin(ostream * os, FileInfo * finfo)
     return;
   }
 
+  if (binary_out) {
+    binBegin(os, HPCSTRUCT_FMT_File, finfo->fileName, "", "", 0);
+    return;
+  }
+
   doIndent(os, 1);
   *os << "<F"
       << INDEX
@@ -255,8 +394,7 @@ printFileEnd(ostream * os, FileInfo * finfo)
     return;
   }
 
-  doIndent(os, 1);
-  *os << "</F>\n";
+  doEndTag(os, 1, "</F>\n");
 }
 
 //----------------------------------------------------------------------
@@ -277,20 +415,31 @@ printProc(ostream * os, ostream * gaps, string gaps_file,
   long base_index = strTab.str2index(FileUtil::basename(finfo->fileName.c_str()));
   ScopeInfo scope(file_index, base_index, pinfo->line_num);
 
-  doIndent(os, 2);
-  *os << "<P"
-      << INDEX
-      << STRING("n", pinfo->prettyName);
+  if (binary_out) {
+    string linkName =
+      (pinfo->linkName != pinfo->prettyName) ? pinfo->linkName : "";
+    VMAIntervalSet vset;
+    vset.insert(pinfo->entry_vma, pinfo->entry_vma + 1);
 
-  if (pinfo->linkName != pinfo->prettyName) {
-    *os << STRING("ln", pinfo->linkName);
+    binBegin(os, HPCSTRUCT_FMT_Proc, pinfo->prettyName, "", linkName,
+	     pinfo->line_num, &vset);
   }
-  if (pinfo->symbol_index != 0) {
-    *os << NUMBER("s", pinfo->symbol_index);
+  else {
+    doIndent(os, 2);
+    *os << "<P"
+	<< INDEX
+	<< STRING("n", pinfo->prettyName);
+
+    if (pinfo->linkName != pinfo->prettyName) {
+      *os << STRING("ln", pinfo->linkName);
+    }
+    if (pinfo->symbol_index != 0) {
+      *os << NUMBER("s", pinfo->symbol_index);
+    }
+    *os << NUMBER("l", pinfo->line_num)
+	<< VRANGE(pinfo->entry_vma, 1)
+	<< ">\n";
   }
-  *os << NUMBER("l", pinfo->line_num)
-      << VRANGE(pinfo->entry_vma, 1)
-      << ">\n";
 
   // write the gaps to the first proc (low vma) of the group.  this
   // only applies to full gaps.
@@ -300,8 +449,7 @@ printProc(ostream * os, ostream * gaps, string gaps_file,
 
   doTreeNode(os, 3, root, scope, strTab);
 
-  doIndent(os, 2);
-  *os << "</P>\n";
+  doEndTag(os, 2, "</P>\n");
 }
 
 //----------------------------------------------------------------------
@@ -328,23 +476,32 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 	<< "0x" << hex << ginfo->start << "--0x" << ginfo->end << dec << "\n\n";
   gaps_line += 6;
 
-  doIndent(os, 3);
-  *os << "<A"
-      << INDEX
-      << NUMBER("l", pinfo->line_num)
-      << STRING("f", finfo->fileName)
-      << STRING("n", "")
-      << " v=\"{}\""
-      << ">\n";
+  if (binary_out) {
+    binBegin(os, HPCSTRUCT_FMT_Alien, "", finfo->fileName, "",
+	     pinfo->line_num);
+    binBegin(os, HPCSTRUCT_FMT_Alien,
+	     "unclaimed region in: " + pinfo->prettyName, gaps_file, "",
+	     gaps_line - 4);
+  }
+  else {
+    doIndent(os, 3);
+    *os << "<A"
+	<< INDEX
+	<< NUMBER("l", pinfo->line_num)
+	<< STRING("f", finfo->fileName)
+	<< STRING("n", "")
+	<< " v=\"{}\""
+	<< ">\n";
 
-  doIndent(os, 4);
-  *os << "<A"
-      << INDEX
-      << NUMBER("l", gaps_line - 4)
-      << STRING("f", gaps_file)
-      << STRING("n", "unclaimed region in: " + pinfo->prettyName)
-      << " v=\"{}\""
-      << ">\n";
+    doIndent(os, 4);
+    *os << "<A"
+	<< INDEX
+	<< NUMBER("l", gaps_line - 4)
+	<< STRING("f", gaps_file)
+	<< STRING("n", "unclaimed region in: " + pinfo->prettyName)
+	<< " v=\"{}\""
+	<< ">\n";
+  }
 
   for (auto git = ginfo->gapSet.begin(); git != ginfo->gapSet.end(); ++git) {
     long start = git->beg();
@@ -355,19 +512,26 @@ doGaps(ostream * os, ostream * gaps, string gaps_file,
 	  << dec << "  (" << len << ")\n";
     gaps_line++;
 
-    doIndent(os, 5);
-    *os << "<S"
-	<< INDEX
-	<< NUMBER("l", gaps_line)
-	<< VRANGE(start, len)
-	<< "/>\n";
+    if (binary_out) {
+      VMAIntervalSet vset;
+      vset.insert(start, end);
+
+      binBegin(os, HPCSTRUCT_FMT_Stmt, "", "", "", gaps_line, &vset);
+      binEnd();
+    }
+    else {
+      doIndent(os, 5);
+      *os << "<S"
+	  << INDEX
+	  << NUMBER("l", gaps_line)
+	  << VRANGE(start, len)
+	  << "/>\n";
+    }
   }
 
-  doIndent(os, 4);
-  *os << "</A>\n";
+  doEndTag(os, 4, "</A>\n");
 
-  doIndent(os, 3);
-  *os << "</A>\n";
+  doEndTag(os, 3, "</A>\n");
 }
 
 //----------------------------------------------------------------------
@@ -468,20 +632,25 @@ doTreeNode(ostream * os, int depth, TreeNode * root, ScopeInfo scope,
     locateTree(node, alien_scope, strTab, true);
 
     // guard alien
-    doIndent(os, depth);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", alien_scope.line_num)
-	<< STRING("f", strTab.index2str(file_index))
-	<< STRING("n", GUARD_NAME)
-	<< " v=\"{}\""
-	<< ">\n";
+    if (binary_out) {
+      binBegin(os, HPCSTRUCT_FMT_Alien, GUARD_NAME,
+	       strTab.index2str(file_index), "", alien_scope.line_num);
+    }
+    else {
+      doIndent(os, depth);
+      *os << "<A"
+	  << INDEX
+	  << NUMBER("l", alien_scope.line_num)
+	  << STRING("f", strTab.index2str(file_index))
+	  << STRING("n", GUARD_NAME)
+	  << " v=\"{}\""
+	  << ">\n";
+    }
 
     doStmtList(os, depth + 1, node);
     doLoopList(os, depth + 1, node, strTab);
 
-    doIndent(os, depth);
-    *os << "</A>\n";
+    doEndTag(os, depth, "</A>\n");
 
     node->clear();
     delete node;
@@ -503,33 +672,40 @@ doTreeNode(ostream * os, int depth, TreeNode * root, ScopeInfo scope,
 
     // outer, caller alien.  use file and line from flp call site, but
     // empty proc name.
-    doIndent(os, depth);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", flp.line_num)
-	<< STRING("f", strTab.index2str(flp.file_index))
-	<< STRING("n", "")
-	<< " v=\"{}\""
-	<< ">\n";
-
+    //
     // inner, callee alien.  use proc name from flp call site, but
     // file and line from subtree.
-    doIndent(os, depth + 1);
-    *os << "<A"
-	<< INDEX
-	<< NUMBER("l", subscope.line_num)
-	<< STRING("f", strTab.index2str(subscope.file_index))
-	<< STRING("n", callname)
-	<< " v=\"{}\""
-	<< ">\n";
+    if (binary_out) {
+      binBegin(os, HPCSTRUCT_FMT_Alien, "", strTab.index2str(flp.file_index),
+	       "", flp.line_num);
+      binBegin(os, HPCSTRUCT_FMT_Alien, callname,
+	       strTab.index2str(subscope.file_index), "", subscope.line_num);
+    }
+    else {
+      doIndent(os, depth);
+      *os << "<A"
+	  << INDEX
+	  << NUMBER("l", flp.line_num)
+	  << STRING("f", strTab.index2str(flp.file_index))
+	  << STRING("n", "")
+	  << " v=\"{}\""
+	  << ">\n";
+
+      doIndent(os, depth + 1);
+      *os << "<A"
+	  << INDEX
+	  << NUMBER("l", subscope.line_num)
+	  << STRING("f", strTab.index2str(subscope.file_index))
+	  << STRING("n", callname)
+	  << " v=\"{}\""
+	  << ">\n";
+    }
 
     doTreeNode(os, depth + 2, subtree, subscope, strTab);
 
-    doIndent(os, depth + 1);
-    *os << "</A>\n";
+    doEndTag(os, depth + 1, "</A>\n");
 
-    doIndent(os, depth);
-    *os << "</A>\n";
+    doEndTag(os, depth, "</A>\n");
   }
 }
 
@@ -565,12 +741,18 @@ doStmtList(ostream * os, int depth, TreeNode * node)
     long line = mit->first;
     VMAIntervalSet * vset = mit->second;
 
-    doIndent(os, depth);
-    *os << "<S"
-	<< INDEX
-	<< NUMBER("l", line)
-	<< " v=\"" << vset->toString() << "\""
-	<< "/>\n";
+    if (binary_out) {
+      binBegin(os, HPCSTRUCT_FMT_Stmt, "", "", "", line, vset);
+      binEnd();
+    }
+    else {
+      doIndent(os, depth);
+      *os << "<S"
+	  << INDEX
+	  << NUMBER("l", line)
+	  << " v=\"" << vset->toString() << "\""
+	  << "/>\n";
+    }
 
     delete vset;
   }
@@ -587,18 +769,26 @@ doLoopList(ostream * os, int depth, TreeNode * node, HPC::StringTable & strTab)
     LoopInfo * linfo = *lit;
     ScopeInfo scope(linfo->file_index, linfo->base_index);
 
-    doIndent(os, depth);
-    *os << "<L"
-	<< INDEX
-	<< NUMBER("l", linfo->line_num)
-	<< STRING("f", strTab.index2str(linfo->file_index))
-	<< VRANGE(linfo->entry_vma, 1)
-	<< ">\n";
+    if (binary_out) {
+      VMAIntervalSet vset;
+      vset.insert(linfo->entry_vma, linfo->entry_vma + 1);
+
+      binBegin(os, HPCSTRUCT_FMT_Loop, "", strTab.index2str(linfo->file_index),
+	       "", linfo->line_num, &vset);
+    }
+    else {
+      doIndent(os, depth);
+      *os << "<L"
+	  << INDEX
+	  << NUMBER("l", linfo->line_num)
+	  << STRING("f", strTab.index2str(linfo->file_index))
+	  << VRANGE(linfo->entry_vma, 1)
+	  << ">\n";
+    }
 
     doTreeNode(os, depth + 1, linfo->node, scope, strTab);
 
-    doIndent(os, depth);
-    *os << "</L>\n";
+    doEndTag(os, depth, "</L>\n");
   }
 }
 
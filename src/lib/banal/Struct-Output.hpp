@@ -66,7 +66,7 @@ namespace Output {
 using namespace Struct;
 using namespace std;
 
-void printStructFileBegin(ostream *, ostream *, string);
+void printStructFileBegin(ostream *, ostream *, string, bool = false);
 void printStructFileEnd(ostream *, ostream *);
 
 void printLoadModuleBegin(ostream *, string);
@@ -559,7 +559,7 @@ makeStructure(string filename,
     return;
   }
 
-  Output::printStructFileBegin(outFile, gapsFile, sfilename);
+  Output::printStructFileBegin(outFile, gapsFile, sfilename, opts.binary);
 
   for (uint i = 0; i < elfFileVector->size(); i++) {
     ElfFile *elfFile = (*elfFileVector)[i];
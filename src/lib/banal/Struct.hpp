@@ -66,6 +66,7 @@ public:
   int  jobs_symtab;
   bool show_time;
   bool ourDemangle;
+  bool binary;
 
   Options()
   {
@@ -74,6 +75,7 @@ public:
     jobs_symtab = 1;
     show_time = false;
     ourDemangle = false;
+    binary = false;
   }
 };
 
@@ -0,0 +1,336 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Low-level types and functions for the binary experiment database
+//   (experiment.db), a memory-mappable companion of experiment.xml.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <stdio.h>
+#include <string.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcfmt.h"
+#include "hpcexpdb-fmt.h"
+
+//***************************************************************************
+
+#define FOOTER_SIZE  48
+
+static inline uint16_t
+ld2_endian(const uint8_t* p, char endian)
+{
+  return (endian == 'b') ? (uint16_t)((p[0] << 8) | p[1])
+                         : (uint16_t)((p[1] << 8) | p[0]);
+}
+
+//***************************************************************************
+// writer
+//***************************************************************************
+
+int
+hpcexpdb_fmt_write(int fd, const hpcexpdb_fmt_data_t* data)
+{
+  hpcexpdb_fmt_footer_t ftr;
+  memset(&ftr, 0, sizeof(ftr));
+  ftr.strSz      = data->strSz;
+  ftr.numMetrics = data->numMetrics;
+  ftr.numDicts   = data->numDicts;
+  ftr.numNodes   = data->numNodes;
+  ftr.nnz        = data->metricPtr[data->numMetrics];
+  memcpy(ftr.magic, HPCEXPDB_FMT_FooterMagic, sizeof(ftr.magic));
+
+  hpcexpdb_fmt_layout_t lay;
+  hpcexpdb_fmt_layout(&lay, &ftr);
+
+  uint64_t n = ftr.numNodes;
+
+  char hdr[HPCEXPDB_FMT_HeaderLen];
+  memset(hdr, 0, sizeof(hdr));
+  memcpy(hdr, HPCEXPDB_FMT_Magic, HPCEXPDB_FMT_MagicLen);
+  memcpy(hdr + HPCEXPDB_FMT_MagicLen, HPCEXPDB_FMT_Version,
+	 HPCEXPDB_FMT_VersionLen);
+  hdr[HPCEXPDB_FMT_MagicLen + HPCEXPDB_FMT_VersionLen] = HPCIO_HostEndian;
+
+  // N.B.: alignment gaps between sections are not written; they read
+  // as zeros once the footer extends the file past them.
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, hdr, sizeof(hdr), 0));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->str, ftr.strSz, lay.strOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->metrics,
+				    ftr.numMetrics * sizeof(*data->metrics),
+				    lay.metricOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->dicts,
+				    ftr.numDicts * sizeof(*data->dicts),
+				    lay.dictOff));
+  for (int c = 0; c < HPCEXPDB_FMT_NumCols; ++c) {
+    HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->col[c], n * sizeof(uint32_t),
+				      lay.colOff + c * lay.colSz));
+  }
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->kind, n, lay.kindOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->flags, n, lay.flagsOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->metricPtr,
+				    (ftr.numMetrics + 1) * sizeof(uint64_t),
+				    lay.metricPtrOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->values,
+				    ftr.nnz * sizeof(double), lay.valuesOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, data->rows,
+				    ftr.nnz * sizeof(uint32_t), lay.rowsOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, &ftr, FOOTER_SIZE, lay.footerOff));
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// reader
+//***************************************************************************
+
+int
+hpcexpdb_fmt_open(hpcexpdb_fmt_t* db, FILE* fs)
+{
+  memset(db, 0, sizeof(*db));
+
+  if (hpcio_map_fs(&db->map, fs) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  const uint8_t* beg = db->map.beg;
+  uint64_t len = db->map.end - db->map.beg;
+
+  // -------------------------------------------------------
+  // header, footer and layout
+  // -------------------------------------------------------
+  if (len < HPCEXPDB_FMT_HeaderLen + FOOTER_SIZE
+      || memcmp(beg, HPCEXPDB_FMT_Magic, HPCEXPDB_FMT_MagicLen) != 0
+      || memcmp(beg + HPCEXPDB_FMT_MagicLen, HPCEXPDB_FMT_Version,
+		HPCEXPDB_FMT_VersionLen) != 0) {
+    goto error;
+  }
+
+  char e = beg[HPCEXPDB_FMT_MagicLen + HPCEXPDB_FMT_VersionLen];
+  if (e != 'l' && e != 'b') {
+    goto error;
+  }
+  db->endian = e;
+
+  const uint8_t* p = db->map.end - FOOTER_SIZE;
+  hpcexpdb_fmt_footer_t* ftr = &db->footer;
+  ftr->strSz      = hpcio_ld8_endian(p, e);
+  ftr->numMetrics = hpcio_ld8_endian(p + 8, e);
+  ftr->numDicts   = hpcio_ld8_endian(p + 16, e);
+  ftr->numNodes   = hpcio_ld8_endian(p + 24, e);
+  ftr->nnz        = hpcio_ld8_endian(p + 32, e);
+  memcpy(ftr->magic, p + 40, sizeof(ftr->magic));
+
+  // bounding each count by the file length keeps the layout
+  // arithmetic from overflowing
+  if (memcmp(ftr->magic, HPCEXPDB_FMT_FooterMagic, sizeof(ftr->magic)) != 0
+      || ftr->strSz == 0 || ftr->strSz > len
+      || ftr->numMetrics > len || ftr->numDicts > len
+      || ftr->numNodes > len || ftr->numNodes > UINT32_MAX
+      || ftr->nnz > len) {
+    goto error;
+  }
+
+  hpcexpdb_fmt_layout_t* lay = &db->layout;
+  hpcexpdb_fmt_layout(lay, ftr);
+  if (lay->footerOff != len - FOOTER_SIZE
+      || beg[lay->strOff] != '\0'
+      || beg[lay->strOff + ftr->strSz - 1] != '\0') {
+    goto error;
+  }
+
+  // -------------------------------------------------------
+  // tables
+  // -------------------------------------------------------
+  for (uint64_t i = 0; i < ftr->numMetrics; ++i) {
+    hpcexpdb_fmt_metric_t x;
+    hpcexpdb_fmt_metric(db, i, &x);
+    if (x.name >= ftr->strSz) {
+      goto error;
+    }
+  }
+
+  for (uint64_t i = 0; i < ftr->numDicts; ++i) {
+    hpcexpdb_fmt_dict_t x;
+    hpcexpdb_fmt_dict(db, i, &x);
+    if (x.name >= ftr->strSz
+	|| x.kind < HPCEXPDB_FMT_DictLM || x.kind > HPCEXPDB_FMT_DictProc) {
+      goto error;
+    }
+  }
+
+  // -------------------------------------------------------
+  // nodes and metric columns
+  // -------------------------------------------------------
+  const uint8_t* kind = hpcexpdb_fmt_kind(db);
+  for (uint64_t i = 0; i < ftr->numNodes; ++i) {
+    uint32_t parent = hpcexpdb_fmt_col_at(db, HPCEXPDB_FMT_ColParent, i);
+    if ((parent != HPCEXPDB_FMT_NoParent && parent >= i)
+	|| kind[i] < HPCEXPDB_FMT_ProcFrm || kind[i] > HPCEXPDB_FMT_Stmt) {
+      goto error;
+    }
+  }
+
+  uint64_t prev = 0;
+  for (uint64_t j = 0; j <= ftr->numMetrics; ++j) {
+    uint64_t ptr = hpcexpdb_fmt_metricPtr(db, j);
+    if (ptr < prev || ptr > ftr->nnz || (j == 0 && ptr != 0)) {
+      goto error;
+    }
+    prev = ptr;
+  }
+  if (prev != ftr->nnz) {
+    goto error;
+  }
+
+  for (uint64_t k = 0; k < ftr->nnz; ++k) {
+    uint32_t row;
+    hpcexpdb_fmt_value(db, k, &row);
+    if (row >= ftr->numNodes) {
+      goto error;
+    }
+  }
+
+  return HPCFMT_OK;
+
+ error:
+  hpcexpdb_fmt_close(db);
+  return HPCFMT_ERR;
+}
+
+
+void
+hpcexpdb_fmt_close(hpcexpdb_fmt_t* db)
+{
+  hpcio_unmap(&db->map);
+}
+
+
+void
+hpcexpdb_fmt_metric(const hpcexpdb_fmt_t* db, uint64_t i,
+		    hpcexpdb_fmt_metric_t* metric)
+{
+  const uint8_t* p = db->map.beg + db->layout.metricOff + i * 16;
+  char e = db->endian;
+
+  metric->id      = hpcio_ld4_endian(p, e);
+  metric->name    = hpcio_ld4_endian(p + 4, e);
+  metric->partner = hpcio_ld4_endian(p + 8, e);
+  metric->type    = ld2_endian(p + 12, e);
+  metric->flags   = ld2_endian(p + 14, e);
+}
+
+
+void
+hpcexpdb_fmt_dict(const hpcexpdb_fmt_t* db, uint64_t i,
+		  hpcexpdb_fmt_dict_t* dict)
+{
+  const uint8_t* p = db->map.beg + db->layout.dictOff + i * 16;
+  char e = db->endian;
+
+  memset(dict, 0, sizeof(*dict));
+  dict->id    = hpcio_ld4_endian(p, e);
+  dict->name  = hpcio_ld4_endian(p + 4, e);
+  dict->kind  = p[8];
+  dict->flags = p[9];
+}
+
+
+const uint32_t*
+hpcexpdb_fmt_col(const hpcexpdb_fmt_t* db, int col)
+{
+  if (db->endian != HPCIO_HostEndian) {
+    return NULL;
+  }
+  const uint8_t* p = db->map.beg + db->layout.colOff + col * db->layout.colSz;
+  return (const uint32_t*) p;
+}
+
+
+uint32_t
+hpcexpdb_fmt_col_at(const hpcexpdb_fmt_t* db, int col, uint64_t i)
+{
+  const uint8_t* p = (db->map.beg + db->layout.colOff
+		      + col * db->layout.colSz + i * sizeof(uint32_t));
+  return hpcio_ld4_endian(p, db->endian);
+}
+
+
+uint64_t
+hpcexpdb_fmt_metricPtr(const hpcexpdb_fmt_t* db, uint64_t j)
+{
+  const uint8_t* p = db->map.beg + db->layout.metricPtrOff + j * 8;
+  return hpcio_ld8_endian(p, db->endian);
+}
+
+
+double
+hpcexpdb_fmt_value(const hpcexpdb_fmt_t* db, uint64_t k, uint32_t* row)
+{
+  const uint8_t* p = db->map.beg + db->layout.valuesOff + k * 8;
+  const uint8_t* r = db->map.beg + db->layout.rowsOff + k * 4;
+
+  uint64_t bits = hpcio_ld8_endian(p, db->endian);
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+
+  *row = hpcio_ld4_endian(r, db->endian);
+  return x;
+}
@@ -0,0 +1,362 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Low-level types and functions for the binary experiment database
+//   (experiment.db), a memory-mappable companion of experiment.xml.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcexpdb_fmt_h
+#define prof_lean_hpcexpdb_fmt_h
+
+//************************* System Include Files ****************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcfmt.h"
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+// experiment.db holds the dictionaries, the CCT and the summary metric
+// values of experiment.xml as flat arrays:
+//
+//   hdr:      magic, version, endian (padded to 24 bytes)
+//   strings:  strSz bytes of NUL-terminated strings; offset 0 is ""
+//   metrics:  numMetrics x hpcexpdb_fmt_metric_t
+//   dicts:    numDicts x hpcexpdb_fmt_dict_t (LM, file and proc tables)
+//   nodes:    HPCEXPDB_FMT_NumCols uint32_t columns of numNodes values,
+//             then the uint8_t columns 'kind' and 'flags'
+//   values:   summary metrics in compressed sparse column form:
+//             metricPtr[numMetrics + 1] (uint64_t), values[nnz]
+//             (double), rows[nnz] (uint32_t node index)
+//   footer:   hpcexpdb_fmt_footer_t
+//
+// Every section begins on an 8-byte boundary, so a mapped file in host
+// order can be used in place.  Section offsets follow from the counts
+// in the footer (hpcexpdb_fmt_layout()).  Nodes are in the pre-order
+// of experiment.xml; a node's parent always precedes it and top-level
+// nodes have no parent.  The values of metric column j (the metric
+// metrics[j]) are values[metricPtr[j] .. metricPtr[j+1]), in node
+// order.  Writers use host order; all integers are in the byte order
+// of the endian byte.
+
+static const char HPCEXPDB_FMT_Magic[]   = "HPCPROF-expdb_____"; // 18 bytes
+static const char HPCEXPDB_FMT_Version[] = "01.00";              // 5 bytes
+
+#define HPCEXPDB_FMT_MagicLen   (sizeof(HPCEXPDB_FMT_Magic) - 1)
+#define HPCEXPDB_FMT_VersionLen (sizeof(HPCEXPDB_FMT_Version) - 1)
+#define HPCEXPDB_FMT_HeaderLen  24
+
+static const char HPCEXPDB_FMT_FooterMagic[] = "HPCEXPDB"; // 8 bytes
+
+#define HPCEXPDB_FMT_NoParent  UINT32_MAX
+#define HPCEXPDB_FMT_NoMetric  UINT32_MAX
+
+// node kinds (the values of Prof::CCT::ANode::ANodeTy)
+enum {
+  HPCEXPDB_FMT_ProcFrm = 1, // <PF>
+  HPCEXPDB_FMT_Proc    = 2, // <Pr>
+  HPCEXPDB_FMT_Loop    = 3, // <L>
+  HPCEXPDB_FMT_Call    = 4, // <C>
+  HPCEXPDB_FMT_Stmt    = 5  // <S>
+};
+
+// uint32_t node columns and the XML attributes they hold.  'lm',
+// 'file' and 'proc' are 0 where the XML omits the attribute; so is
+// 'cpId' ('it').
+enum {
+  HPCEXPDB_FMT_ColId     = 0, // i
+  HPCEXPDB_FMT_ColParent = 1, // index of the enclosing node
+  HPCEXPDB_FMT_ColStruct = 2, // s
+  HPCEXPDB_FMT_ColLine   = 3, // l
+  HPCEXPDB_FMT_ColLM     = 4, // lm
+  HPCEXPDB_FMT_ColFile   = 5, // f
+  HPCEXPDB_FMT_ColProc   = 6, // n
+  HPCEXPDB_FMT_ColCpId   = 7, // it
+
+  HPCEXPDB_FMT_NumCols   = 8
+};
+
+// node flags
+#define HPCEXPDB_FMT_NodeAlien  0x1 // a="1"
+
+// dictionary kinds and flags
+enum {
+  HPCEXPDB_FMT_DictLM   = 1, // <LoadModule>
+  HPCEXPDB_FMT_DictFile = 2, // <File>
+  HPCEXPDB_FMT_DictProc = 3  // <Procedure>
+};
+
+#define HPCEXPDB_FMT_DictFake  0x1 // f="1"
+
+// metric flags
+#define HPCEXPDB_FMT_MetricShow        0x1 // show="1"
+#define HPCEXPDB_FMT_MetricShowPercent 0x2 // show-percent="1"
+
+
+// One <Metric> of the MetricTable.  'name' is a string offset;
+// 'type' is a Prof::Metric::ADesc::ADescTy.  Formulas and sample
+// periods remain in experiment.xml.
+typedef struct hpcexpdb_fmt_metric_t {
+
+  uint32_t id;
+  uint32_t name;
+  uint32_t partner; // or HPCEXPDB_FMT_NoMetric
+  uint16_t type;
+  uint16_t flags;
+
+} hpcexpdb_fmt_metric_t; // 16 bytes
+
+
+// One entry of a dictionary table.  'name' is a string offset.
+typedef struct hpcexpdb_fmt_dict_t {
+
+  uint32_t id;
+  uint32_t name;
+  uint8_t  kind;
+  uint8_t  flags;
+  uint8_t  pad[6];
+
+} hpcexpdb_fmt_dict_t; // 16 bytes
+
+
+typedef struct hpcexpdb_fmt_footer_t {
+
+  uint64_t strSz;
+  uint64_t numMetrics;
+  uint64_t numDicts;
+  uint64_t numNodes;
+  uint64_t nnz;
+  char magic[sizeof(HPCEXPDB_FMT_FooterMagic) - 1];
+
+} hpcexpdb_fmt_footer_t; // 48 bytes
+
+
+// Section offsets implied by a footer's counts.
+typedef struct hpcexpdb_fmt_layout_t {
+
+  uint64_t strOff;
+  uint64_t metricOff;
+  uint64_t dictOff;
+  uint64_t colOff;       // first uint32_t column
+  uint64_t colSz;        // distance between uint32_t columns
+  uint64_t kindOff;
+  uint64_t flagsOff;
+  uint64_t metricPtrOff;
+  uint64_t valuesOff;
+  uint64_t rowsOff;
+  uint64_t footerOff;
+
+} hpcexpdb_fmt_layout_t;
+
+
+static inline uint64_t
+hpcexpdb_fmt_align(uint64_t x)
+{
+  return (x + 7) & ~(uint64_t)7;
+}
+
+
+static inline void
+hpcexpdb_fmt_layout(hpcexpdb_fmt_layout_t* lay,
+		    const hpcexpdb_fmt_footer_t* ftr)
+{
+  uint64_t n = ftr->numNodes;
+
+  lay->strOff       = HPCEXPDB_FMT_HeaderLen;
+  lay->metricOff    = hpcexpdb_fmt_align(lay->strOff + ftr->strSz);
+  lay->dictOff      = lay->metricOff + ftr->numMetrics * 16;
+  lay->colOff       = lay->dictOff + ftr->numDicts * 16;
+  lay->colSz        = hpcexpdb_fmt_align(n * sizeof(uint32_t));
+  lay->kindOff      = lay->colOff + HPCEXPDB_FMT_NumCols * lay->colSz;
+  lay->flagsOff     = lay->kindOff + hpcexpdb_fmt_align(n);
+  lay->metricPtrOff = lay->flagsOff + hpcexpdb_fmt_align(n);
+  lay->valuesOff    = lay->metricPtrOff
+                      + (ftr->numMetrics + 1) * sizeof(uint64_t);
+  lay->rowsOff      = lay->valuesOff + ftr->nnz * sizeof(double);
+  lay->footerOff    = hpcexpdb_fmt_align(lay->rowsOff
+					 + ftr->nnz * sizeof(uint32_t));
+}
+
+
+//***************************************************************************
+// writer
+//***************************************************************************
+
+// The contents of an experiment.db, in host order.  'metricPtr' has
+// numMetrics + 1 entries; metricPtr[numMetrics] is the number of
+// nonzero values.
+typedef struct hpcexpdb_fmt_data_t {
+
+  const char* str;
+  uint64_t strSz;
+
+  const hpcexpdb_fmt_metric_t* metrics;
+  uint32_t numMetrics;
+
+  const hpcexpdb_fmt_dict_t* dicts;
+  uint32_t numDicts;
+
+  uint32_t numNodes;
+  const uint32_t* col[HPCEXPDB_FMT_NumCols];
+  const uint8_t* kind;
+  const uint8_t* flags;
+
+  const uint64_t* metricPtr;
+  const double* values;
+  const uint32_t* rows;
+
+} hpcexpdb_fmt_data_t;
+
+
+// Writes 'data' to 'fd' (from offset 0) with one pwrite() per section
+// and column.  Since every offset is known in advance, callers may
+// equally write sections from several threads.  Returns HPCFMT_OK or
+// HPCFMT_ERR.
+int
+hpcexpdb_fmt_write(int fd, const hpcexpdb_fmt_data_t* data);
+
+
+//***************************************************************************
+// reader
+//***************************************************************************
+
+// An experiment.db opened for reading.  The file is mapped and
+// validated once by hpcexpdb_fmt_open(), so the accessors below need
+// no further checks.
+typedef struct hpcexpdb_fmt_t {
+
+  char endian;
+  hpcexpdb_fmt_footer_t footer;
+  hpcexpdb_fmt_layout_t layout;
+  hpcio_map_t map;
+
+} hpcexpdb_fmt_t;
+
+
+// Maps 'fs' and validates the header, the footer, the parent links
+// and the metric columns.  Returns HPCFMT_OK or HPCFMT_ERR.
+int
+hpcexpdb_fmt_open(hpcexpdb_fmt_t* db, FILE* fs);
+
+void
+hpcexpdb_fmt_close(hpcexpdb_fmt_t* db);
+
+
+static inline const char*
+hpcexpdb_fmt_str(const hpcexpdb_fmt_t* db, uint32_t off)
+{
+  return (const char*)(db->map.beg + db->layout.strOff + off);
+}
+
+void
+hpcexpdb_fmt_metric(const hpcexpdb_fmt_t* db, uint64_t i,
+		    hpcexpdb_fmt_metric_t* metric);
+
+void
+hpcexpdb_fmt_dict(const hpcexpdb_fmt_t* db, uint64_t i,
+		  hpcexpdb_fmt_dict_t* dict);
+
+
+// Returns column 'col' for use in place, or NULL if the file is not
+// in host order (use hpcexpdb_fmt_col_at()).
+const uint32_t*
+hpcexpdb_fmt_col(const hpcexpdb_fmt_t* db, int col);
+
+uint32_t
+hpcexpdb_fmt_col_at(const hpcexpdb_fmt_t* db, int col, uint64_t i);
+
+static inline const uint8_t*
+hpcexpdb_fmt_kind(const hpcexpdb_fmt_t* db)
+{
+  return db->map.beg + db->layout.kindOff;
+}
+
+static inline const uint8_t*
+hpcexpdb_fmt_flags(const hpcexpdb_fmt_t* db)
+{
+  return db->map.beg + db->layout.flagsOff;
+}
+
+
+// Returns the beginning of metric column 'j' in the values; column j
+// ends where column j+1 begins.
+uint64_t
+hpcexpdb_fmt_metricPtr(const hpcexpdb_fmt_t* db, uint64_t j);
+
+// Returns the 'k'th nonzero value and its node index.
+double
+hpcexpdb_fmt_value(const hpcexpdb_fmt_t* db, uint64_t k, uint32_t* row);
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* prof_lean_hpcexpdb_fmt_h */
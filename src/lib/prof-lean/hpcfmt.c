@@ -66,6 +66,8 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 
 
 //*************************** User Include Files ****************************
@@ -161,6 +163,24 @@ hpcfmt_fwrite(void *data, size_t size, FILE *outfs)
 }
 
 
+int
+hpcfmt_pwrite(int fd, const void *data, size_t size, uint64_t off)
+{
+  const char* p = (const char*) data;
+  while (size > 0) {
+    ssize_t nw = pwrite(fd, p, size, off);
+    if (nw < 0) {
+      if (errno == EINTR) continue;
+      return HPCFMT_ERR;
+    }
+    p += nw;
+    size -= nw;
+    off += nw;
+  }
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 //
 //***************************************************************************
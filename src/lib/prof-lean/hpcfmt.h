@@ -145,6 +145,10 @@ int hpcfmt_fread(void *data, size_t size, FILE *infs);
 
 int hpcfmt_fwrite(void *data, size_t size, FILE *outfs);
 
+// Writes 'size' bytes at offset 'off' of 'fd' without moving the file
+// position, restarting after short or interrupted writes.
+int hpcfmt_pwrite(int fd, const void *data, size_t size, uint64_t off);
+
 
 static inline int
 hpcfmt_int2_fread(uint16_t* val, FILE* infs)
@@ -201,6 +205,80 @@ hpcfmt_real8_fread(double* val, FILE* infs)
 }
 
 
+// hpcfmt_intX_fread_endian: Like the above, but for data in the byte
+// order named by 'endian' ('l' or 'b').  Data in host order is read
+// directly.
+
+static inline int
+hpcfmt_int4_fread_endian(uint32_t* val, char endian, FILE* infs)
+{
+  size_t sz;
+  if (endian == HPCIO_HostEndian) {
+    sz = fread(val, 1, sizeof(uint32_t), infs);
+  }
+  else {
+    sz = (endian == 'l') ?
+      hpcio_le4_fread(val, infs) : hpcio_be4_fread(val, infs);
+  }
+  if ( sz != sizeof(uint32_t) ) {
+    return (sz == 0 && feof(infs)) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int8_fread_endian(uint64_t* val, char endian, FILE* infs)
+{
+  size_t sz;
+  if (endian == HPCIO_HostEndian) {
+    sz = fread(val, 1, sizeof(uint64_t), infs);
+  }
+  else {
+    sz = (endian == 'l') ?
+      hpcio_le8_fread(val, infs) : hpcio_be8_fread(val, infs);
+  }
+  if ( sz != sizeof(uint64_t) ) {
+    return (sz == 0 && feof(infs)) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_real8_fread_endian(double* val, char endian, FILE* infs)
+{
+  return hpcfmt_int8_fread_endian((uint64_t*)val, endian, infs);
+}
+
+
+// hpcfmt_intX_mread: Like the above, but decode in place from a
+// memory-mapped file (see hpcio_map_t) and advance the mapping.
+
+static inline int
+hpcfmt_int4_mread(uint32_t* val, hpcio_map_t* map)
+{
+  if ( hpcio_map_avail(map) < sizeof(uint32_t) ) {
+    return (hpcio_map_avail(map) == 0) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  *val = hpcio_be4_load(map->cur);
+  map->cur += sizeof(uint32_t);
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int8_mread(uint64_t* val, hpcio_map_t* map)
+{
+  if ( hpcio_map_avail(map) < sizeof(uint64_t) ) {
+    return (hpcio_map_avail(map) == 0) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+  *val = hpcio_be8_load(map->cur);
+  map->cur += sizeof(uint64_t);
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 
 static inline int
@@ -257,6 +335,53 @@ hpcfmt_real8_fwrite(double val, FILE* outfs)
 }
 
 
+// hpcfmt_int8_fwrite_n, hpcfmt_real8_fwrite_n: Write the 'n' values
+// at 'val' (e.g., a node's hpcrun_metricVal_t[]) with one bulk
+// byte-swap and write, cf. hpcio_be8_fwrite_n().
+
+static inline int
+hpcfmt_int8_fwrite_n(const uint64_t* val, size_t n, FILE* outfs)
+{
+  if ( n * sizeof(uint64_t) != hpcio_be8_fwrite_n(val, n, outfs) ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_real8_fwrite_n(const double* val, size_t n, FILE* outfs)
+{
+  if ( n * sizeof(double) != hpcio_be8_fwrite_n(val, n, outfs) ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+// hpcfmt_intX_fwrite_host: Write 'val' in host byte order (cf.
+// HPCIO_HostEndian).
+
+static inline int
+hpcfmt_int4_fwrite_host(uint32_t val, FILE* outfs)
+{
+  if ( fwrite(&val, sizeof(uint32_t), 1, outfs) != 1 ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static inline int
+hpcfmt_int8_fwrite_host(uint64_t val, FILE* outfs)
+{
+  if ( fwrite(&val, sizeof(uint64_t), 1, outfs) != 1 ) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 // hpcfmt_str_t
 //***************************************************************************
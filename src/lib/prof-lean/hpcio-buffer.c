@@ -69,6 +69,11 @@
 // control at the end of the process, so there is no way to auto close
 // the buffers.
 //
+// Note: with hpcio_outbuf_compress(), the buffer is written through
+// the chunked compressor in hpcio-z.c, one chunk of at most
+// HPCIO_Z_ChunkSz bytes at a time.  The compressor uses only memory
+// supplied by the client.
+//
 // Deserves further study: the best way to handle errors from write().
 //
 //***************************************************************************
@@ -87,6 +92,7 @@
 
 #include "hpcfmt.h"
 #include "hpcio-buffer.h"
+#include "hpcio-z.h"
 #include "spinlock.h"
 #include <include/min-max.h>
 
@@ -105,6 +111,18 @@ outbuf_flush_buffer(hpcio_outbuf_t *outbuf)
 {
   ssize_t amt_done, ret;
 
+  if (outbuf->zenc != NULL) {
+    size_t done = 0;
+    int zret = hpcio_z_enc_write(outbuf->zenc, outbuf->fd, outbuf->buf_start,
+				 outbuf->in_use, &done);
+    if (done > 0) {
+      memmove(outbuf->buf_start, outbuf->buf_start + done,
+	      outbuf->in_use - done);
+      outbuf->in_use -= done;
+    }
+    return zret;
+  }
+
   amt_done = 0;
   while (amt_done < outbuf->in_use) {
     errno = 0;
@@ -161,12 +179,35 @@ hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
   outbuf->fd = fd;
   outbuf->flags = flags;
   outbuf->use_lock = (flags & HPCIO_OUTBUF_LOCKED);
+  outbuf->zenc = NULL;
   spinlock_unlock(&outbuf->lock);
 
   return HPCFMT_OK;
 }
 
 
+// Compress everything written to the outbuf at 'level' (see
+// hpcio-z.h).  Must be called after attach and before the first
+// write.  The client supplies the compressor's working memory, of
+// size hpcio_z_enc_worksz(level).
+//
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+//
+int
+hpcio_outbuf_compress(hpcio_outbuf_t *outbuf, void *work, size_t worksz,
+		      int level)
+{
+  if (outbuf == NULL || outbuf->magic != HPCIO_OUTBUF_MAGIC
+      || outbuf->in_use != 0) {
+    return HPCFMT_ERR;
+  }
+
+  outbuf->zenc = hpcio_z_enc_init(work, worksz, level);
+
+  return (outbuf->zenc != NULL) ? HPCFMT_OK : HPCFMT_ERR;
+}
+
+
 // Copy data to the outbuf and flush if necessary.
 //
 // Returns: number of bytes copied, or else -1 on bad buffer.
@@ -52,6 +52,8 @@
 #include <stdio.h>
 #include "spinlock.h"
 
+struct hpcio_z_enc_s;
+
 
 // Clients should treat the outbuf struct as opaque.
 
@@ -64,6 +66,7 @@ typedef struct hpcio_outbuf_s {
   int  flags;
   char use_lock;
   spinlock_t lock;
+  struct hpcio_z_enc_s *zenc;
 } hpcio_outbuf_t;
 
 
@@ -82,6 +85,10 @@ int
 hpcio_outbuf_attach(hpcio_outbuf_t *outbuf /* out */, int fd,
 		    void *buf_start, size_t buf_size, int flags);
 
+int
+hpcio_outbuf_compress(hpcio_outbuf_t *outbuf, void *work, size_t worksz,
+		      int level);
+
 ssize_t
 hpcio_outbuf_write(hpcio_outbuf_t *outbuf, const void *data, size_t size);
 
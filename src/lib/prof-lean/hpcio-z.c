@@ -0,0 +1,585 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Chunked, compressed streams for hpcrun output files (see hpcio-z.h).
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#define _GNU_SOURCE  // fopencookie()
+
+#include <sys/types.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <lzma.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcfmt.h"
+#include "hpcio.h"
+#include "hpcio-z.h"
+
+//***************************************************************************
+
+#define HPCIO_Z_Version  "01"
+#define HPCIO_Z_CodecLZMA2 'x'
+
+// log2 of the LZMA dictionary size.  Chunks are independent, so a
+// dictionary larger than a chunk is wasted; 64K keeps the encoder
+// under 2MB per stream.
+#define HPCIO_Z_DictLog2 16
+
+// allocator slack beyond lzma_raw_encoder_memusage()
+#define HPCIO_Z_ArenaSlack (64 * 1024)
+
+#define HPCIO_Z_Align(x) (((x) + 15) & ~((size_t) 15))
+
+
+static void
+z_set_filters(lzma_filter* filters, lzma_options_lzma* opts, int level,
+	      int dictLog2)
+{
+  lzma_lzma_preset(opts, (uint32_t) level);
+  opts->dict_size = (uint32_t)1 << dictLog2;
+
+  filters[0].id = LZMA_FILTER_LZMA2;
+  filters[0].options = opts;
+  filters[1].id = LZMA_VLI_UNKNOWN;
+  filters[1].options = NULL;
+}
+
+
+static inline void
+z_store_be4(uint8_t* p, uint32_t x)
+{
+  p[0] = x >> 24;  p[1] = x >> 16;  p[2] = x >> 8;  p[3] = x;
+}
+
+
+static inline void
+z_store_be8(uint8_t* p, uint64_t x)
+{
+  z_store_be4(p, (uint32_t)(x >> 32));
+  z_store_be4(p + 4, (uint32_t) x);
+}
+
+
+//***************************************************************************
+// encoder
+//***************************************************************************
+
+// The encoder's working memory: this struct, the output buffer for
+// one chunk, and an arena from which liblzma allocates.  Every chunk
+// is encoded by a fresh liblzma coder that frees everything when it
+// ends, so the arena is simply reset before each chunk.
+struct hpcio_z_enc_s {
+  lzma_options_lzma opts;
+  lzma_filter filters[2];
+  lzma_allocator allocator;
+
+  uint8_t* out;
+  uint8_t* arena;
+  size_t arenaSz;
+  size_t arenaUsed;
+
+  uint64_t rawOff;
+  int isHdrDone;
+};
+
+
+static void*
+z_arena_alloc(void* opaque, size_t nmemb, size_t size)
+{
+  hpcio_z_enc_t* z = (hpcio_z_enc_t*) opaque;
+  size_t sz = HPCIO_Z_Align(nmemb * size);
+  if (sz > z->arenaSz - z->arenaUsed) {
+    return NULL;
+  }
+  void* p = z->arena + z->arenaUsed;
+  z->arenaUsed += sz;
+  return p;
+}
+
+
+static void
+z_arena_free(void* opaque, void* ptr)
+{
+  // reclaimed all at once by resetting the arena
+}
+
+
+static size_t
+z_arena_size(int level)
+{
+  lzma_options_lzma opts;
+  lzma_filter filters[2];
+  z_set_filters(filters, &opts, level, HPCIO_Z_DictLog2);
+
+  uint64_t sz = lzma_raw_encoder_memusage(filters);
+  if (sz == UINT64_MAX) {
+    return 0;
+  }
+  return HPCIO_Z_Align((size_t) sz + HPCIO_Z_ArenaSlack);
+}
+
+
+// write() all of 'buf', retrying on EINTR and short writes
+static int
+z_write_all(int fd, const void* buf, size_t size)
+{
+  const uint8_t* p = (const uint8_t*) buf;
+  while (size > 0) {
+    ssize_t ret = write(fd, p, size);
+    if (ret < 0) {
+      if (errno == EINTR) continue;
+      return HPCFMT_ERR;
+    }
+    p += ret;
+    size -= ret;
+  }
+  return HPCFMT_OK;
+}
+
+
+size_t
+hpcio_z_enc_worksz(int level)
+{
+  if (level < 0 || level > 9) {
+    return 0;
+  }
+  size_t arenaSz = z_arena_size(level);
+  if (arenaSz == 0) {
+    return 0;
+  }
+  return HPCIO_Z_Align(sizeof(hpcio_z_enc_t)) + HPCIO_Z_ChunkSz + arenaSz;
+}
+
+
+hpcio_z_enc_t*
+hpcio_z_enc_init(void* work, size_t worksz, int level)
+{
+  size_t needSz = hpcio_z_enc_worksz(level);
+  if (work == NULL || needSz == 0 || worksz < needSz) {
+    return NULL;
+  }
+
+  hpcio_z_enc_t* z = (hpcio_z_enc_t*) work;
+  memset(z, 0, sizeof(*z));
+  z_set_filters(z->filters, &z->opts, level, HPCIO_Z_DictLog2);
+
+  z->allocator.alloc = z_arena_alloc;
+  z->allocator.free = z_arena_free;
+  z->allocator.opaque = z;
+
+  z->out = (uint8_t*) work + HPCIO_Z_Align(sizeof(hpcio_z_enc_t));
+  z->arena = z->out + HPCIO_Z_ChunkSz;
+  z->arenaSz = worksz - HPCIO_Z_Align(sizeof(hpcio_z_enc_t)) - HPCIO_Z_ChunkSz;
+
+  return z;
+}
+
+
+// Compresses and writes one chunk.  A chunk that does not shrink (or
+// that the encoder fails on) is stored.
+static int
+z_enc_chunk(hpcio_z_enc_t* z, int fd, const uint8_t* data, size_t size)
+{
+  size_t zLen = 0;
+
+  z->arenaUsed = 0;
+  lzma_ret ret = lzma_raw_buffer_encode(z->filters, &z->allocator,
+					data, size, z->out, &zLen,
+					HPCIO_Z_ChunkSz);
+  if (ret != LZMA_OK || zLen >= size) {
+    zLen = 0;
+  }
+
+  uint8_t hdr[HPCIO_Z_ChunkHdrLen];
+  z_store_be8(hdr, z->rawOff);
+  z_store_be4(hdr + 8, (uint32_t) size);
+  z_store_be4(hdr + 12, (uint32_t) zLen);
+
+  HPCFMT_ThrowIfError(z_write_all(fd, hdr, sizeof(hdr)));
+  if (zLen > 0) {
+    HPCFMT_ThrowIfError(z_write_all(fd, z->out, zLen));
+  }
+  else {
+    HPCFMT_ThrowIfError(z_write_all(fd, data, size));
+  }
+
+  z->rawOff += size;
+  return HPCFMT_OK;
+}
+
+
+int
+hpcio_z_enc_write(hpcio_z_enc_t* z, int fd, const void* data, size_t size,
+		  size_t* done)
+{
+  *done = 0;
+
+  if (!z->isHdrDone) {
+    uint8_t hdr[HPCIO_Z_HdrLen];
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, HPCIO_Z_Magic, sizeof(HPCIO_Z_Magic) - 1);
+    memcpy(hdr + 8, HPCIO_Z_Version, 2);
+    hdr[10] = HPCIO_Z_CodecLZMA2;
+    hdr[11] = HPCIO_Z_DictLog2;
+
+    HPCFMT_ThrowIfError(z_write_all(fd, hdr, sizeof(hdr)));
+    z->isHdrDone = 1;
+  }
+
+  const uint8_t* p = (const uint8_t*) data;
+  while (*done < size) {
+    size_t len = size - *done;
+    if (len > HPCIO_Z_ChunkSz) {
+      len = HPCIO_Z_ChunkSz;
+    }
+    HPCFMT_ThrowIfError(z_enc_chunk(z, fd, p + *done, len));
+    *done += len;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+//***************************************************************************
+// decoder
+//***************************************************************************
+
+typedef struct z_chunk_s {
+  uint64_t rawOff;
+  uint64_t fileOff; // of the chunk's data
+  uint32_t rawLen;
+  uint32_t zLen;
+} z_chunk_t;
+
+
+typedef struct z_reader_s {
+  FILE* fs;
+
+  lzma_options_lzma opts;
+  lzma_filter filters[2];
+
+  z_chunk_t* chunks;
+  size_t numChunks;
+  uint64_t rawSize;
+
+  uint64_t pos;     // in the uncompressed stream
+  size_t cur;       // index of the chunk in 'buf', or numChunks if none
+  uint8_t* buf;     // uncompressed chunk
+  uint8_t* zbuf;    // compressed chunk
+  uint32_t bufSz;
+  uint32_t zbufSz;
+} z_reader_t;
+
+
+int
+hpcio_z_is_compressed(FILE* fs)
+{
+  char magic[sizeof(HPCIO_Z_Magic) - 1];
+
+  off_t pos = ftello(fs);
+  size_t nr = fread(magic, 1, sizeof(magic), fs);
+  fseeko(fs, pos, SEEK_SET);
+
+  return (nr == sizeof(magic)
+	  && memcmp(magic, HPCIO_Z_Magic, sizeof(magic)) == 0);
+}
+
+
+static void
+z_reader_free(z_reader_t* z)
+{
+  free(z->chunks);
+  free(z->buf);
+  free(z->zbuf);
+  free(z);
+}
+
+
+// Reads the stream header and the header of every chunk.
+static int
+z_reader_scan(z_reader_t* z)
+{
+  uint8_t hdr[HPCIO_Z_HdrLen];
+  if (fread(hdr, 1, sizeof(hdr), z->fs) != sizeof(hdr)
+      || memcmp(hdr, HPCIO_Z_Magic, sizeof(HPCIO_Z_Magic) - 1) != 0
+      || hdr[10] != HPCIO_Z_CodecLZMA2
+      || hdr[11] < 12 || hdr[11] > 30) {
+    return HPCFMT_ERR;
+  }
+  z_set_filters(z->filters, &z->opts, 0, hdr[11]);
+
+  size_t capacity = 0;
+  uint64_t fileOff = sizeof(hdr);
+
+  for (;;) {
+    uint8_t chdr[HPCIO_Z_ChunkHdrLen];
+    size_t nr = fread(chdr, 1, sizeof(chdr), z->fs);
+    if (nr == 0 && feof(z->fs)) {
+      break;
+    }
+    if (nr != sizeof(chdr)) {
+      return HPCFMT_ERR; // truncated
+    }
+    fileOff += sizeof(chdr);
+
+    if (z->numChunks == capacity) {
+      capacity = (capacity == 0) ? 64 : 2 * capacity;
+      z_chunk_t* x = (z_chunk_t*) realloc(z->chunks, capacity * sizeof(*x));
+      if (!x) {
+	return HPCFMT_ERR;
+      }
+      z->chunks = x;
+    }
+
+    z_chunk_t* c = &z->chunks[z->numChunks];
+    c->rawOff  = hpcio_be8_load(chdr);
+    c->rawLen  = hpcio_be4_load(chdr + 8);
+    c->zLen    = hpcio_be4_load(chdr + 12);
+    c->fileOff = fileOff;
+    if (c->rawOff != z->rawSize) {
+      return HPCFMT_ERR;
+    }
+
+    uint32_t len = (c->zLen > 0) ? c->zLen : c->rawLen;
+    if (fseeko(z->fs, len, SEEK_CUR) != 0) {
+      return HPCFMT_ERR;
+    }
+    fileOff += len;
+
+    if (c->rawLen > z->bufSz) {
+      z->bufSz = c->rawLen;
+    }
+    if (c->zLen > z->zbufSz) {
+      z->zbufSz = c->zLen;
+    }
+    z->rawSize += c->rawLen;
+    z->numChunks++;
+  }
+
+  // fseeko() may move past the end of a truncated file
+  if (fileOff != (uint64_t) ftello(z->fs)) {
+    return HPCFMT_ERR;
+  }
+
+  z->buf = (uint8_t*) malloc(z->bufSz + 1);
+  z->zbuf = (uint8_t*) malloc(z->zbufSz + 1);
+  if (!z->buf || !z->zbuf) {
+    return HPCFMT_ERR;
+  }
+
+  z->cur = z->numChunks;
+  return HPCFMT_OK;
+}
+
+
+// Makes the chunk holding z->pos current.  Returns 0 at end of stream,
+// -1 on error, 1 otherwise.
+static int
+z_reader_load(z_reader_t* z)
+{
+  if (z->pos >= z->rawSize) {
+    return 0;
+  }
+
+  if (z->cur < z->numChunks) {
+    z_chunk_t* c = &z->chunks[z->cur];
+    if (c->rawOff <= z->pos && z->pos < c->rawOff + c->rawLen) {
+      return 1;
+    }
+  }
+
+  // binary search for the last chunk starting at or before 'pos'
+  size_t lo = 0, hi = z->numChunks;
+  while (hi - lo > 1) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (z->chunks[mid].rawOff <= z->pos) {
+      lo = mid;
+    }
+    else {
+      hi = mid;
+    }
+  }
+
+  z_chunk_t* c = &z->chunks[lo];
+  z->cur = z->numChunks;
+
+  if (fseeko(z->fs, c->fileOff, SEEK_SET) != 0) {
+    return -1;
+  }
+  if (c->zLen == 0) {
+    if (fread(z->buf, 1, c->rawLen, z->fs) != c->rawLen) {
+      return -1;
+    }
+  }
+  else {
+    if (fread(z->zbuf, 1, c->zLen, z->fs) != c->zLen) {
+      return -1;
+    }
+    size_t inPos = 0, outPos = 0;
+    lzma_ret ret = lzma_raw_buffer_decode(z->filters, NULL,
+					  z->zbuf, &inPos, c->zLen,
+					  z->buf, &outPos, c->rawLen);
+    if (ret != LZMA_OK || outPos != c->rawLen) {
+      return -1;
+    }
+  }
+
+  z->cur = lo;
+  return 1;
+}
+
+
+static ssize_t
+z_cookie_read(void* cookie, char* buf, size_t size)
+{
+  z_reader_t* z = (z_reader_t*) cookie;
+  size_t done = 0;
+
+  while (done < size) {
+    int ret = z_reader_load(z);
+    if (ret < 0) {
+      errno = EIO;
+      return (done > 0) ? (ssize_t) done : -1;
+    }
+    if (ret == 0) {
+      break;
+    }
+
+    z_chunk_t* c = &z->chunks[z->cur];
+    size_t off = z->pos - c->rawOff;
+    size_t len = c->rawLen - off;
+    if (len > size - done) {
+      len = size - done;
+    }
+    memcpy(buf + done, z->buf + off, len);
+    done += len;
+    z->pos += len;
+  }
+
+  return done;
+}
+
+
+static int
+z_cookie_seek(void* cookie, off64_t* offset, int whence)
+{
+  z_reader_t* z = (z_reader_t*) cookie;
+
+  int64_t base = 0;
+  if (whence == SEEK_CUR) {
+    base = z->pos;
+  }
+  else if (whence == SEEK_END) {
+    base = z->rawSize;
+  }
+  else if (whence != SEEK_SET) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  int64_t pos = base + *offset;
+  if (pos < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+
+  z->pos = pos;
+  *offset = pos;
+  return 0;
+}
+
+
+static int
+z_cookie_close(void* cookie)
+{
+  z_reader_t* z = (z_reader_t*) cookie;
+  int ret = fclose(z->fs);
+  z_reader_free(z);
+  return ret;
+}
+
+
+FILE*
+hpcio_z_fopen(FILE* fs)
+{
+  z_reader_t* z = (z_reader_t*) calloc(1, sizeof(z_reader_t));
+  if (!z) {
+    return NULL;
+  }
+  z->fs = fs;
+
+  if (fseeko(fs, 0, SEEK_SET) != 0 || z_reader_scan(z) != HPCFMT_OK) {
+    z_reader_free(z);
+    return NULL;
+  }
+
+  cookie_io_functions_t fns;
+  fns.read  = z_cookie_read;
+  fns.write = NULL;
+  fns.seek  = z_cookie_seek;
+  fns.close = z_cookie_close;
+
+  FILE* zfs = fopencookie(z, "r", fns);
+  if (!zfs) {
+    z_reader_free(z);
+    return NULL;
+  }
+  return zfs;
+}
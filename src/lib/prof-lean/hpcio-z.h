@@ -0,0 +1,155 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Chunked, compressed streams for hpcrun output files.
+//
+// Description:
+//   A compressed stream ("hpcio-z") is a header followed by chunks,
+//   each compressed independently (raw LZMA2):
+//
+//     hdr:   magic (8 bytes), version (2), codec (1), log2 of the
+//            dictionary size (1), reserved (4)
+//     chunk: rawOff (8 bytes), rawLen (4), zLen (4), and then zLen
+//            bytes of compressed data or, if zLen is 0, rawLen bytes
+//            of uncompressed data
+//
+//   'rawOff' is the offset of the chunk's data in the uncompressed
+//   stream.  Header and chunk fields are big-endian.  Because chunks
+//   are independent, a reader can seek to any offset of the
+//   uncompressed stream by decoding a single chunk.
+//
+//   The encoder is for hpcrun: it does not call malloc and is safe
+//   inside signal handlers.  The client supplies its working memory.
+//   The decoder is for the analysis tools and uses stdio.
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcio_z_h
+#define prof_lean_hpcio_z_h
+
+//************************* System Include Files ****************************
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+static const char HPCIO_Z_Magic[] = "HPCIO-z_"; // 8 bytes
+
+#define HPCIO_Z_HdrLen      16
+#define HPCIO_Z_ChunkHdrLen 16
+
+// Uncompressed size of a chunk.  Larger chunks compress slightly
+// better; smaller ones make seeking cheaper.
+#define HPCIO_Z_ChunkSz (256 * 1024)
+
+// Compression levels are LZMA presets, 0 (fastest) to 9.
+#define HPCIO_Z_LevelDefault 1
+
+
+typedef struct hpcio_z_enc_s hpcio_z_enc_t;
+
+
+//***************************************************************************
+// encoder
+//***************************************************************************
+
+// Returns the size of the working memory hpcio_z_enc_init() needs for
+// 'level'.
+size_t
+hpcio_z_enc_worksz(int level);
+
+// Sets up an encoder in 'work' (of size 'worksz' as returned by
+// hpcio_z_enc_worksz()).  Returns NULL on error.
+hpcio_z_enc_t*
+hpcio_z_enc_init(void* work, size_t worksz, int level);
+
+// Compresses 'data' into chunks of at most HPCIO_Z_ChunkSz bytes and
+// writes them to 'fd', preceded by the stream header on the first
+// call.  Sets '*done' to the number of bytes of 'data' that were
+// written.  Returns HPCFMT_OK or HPCFMT_ERR.
+int
+hpcio_z_enc_write(hpcio_z_enc_t* z, int fd, const void* data, size_t size,
+		  size_t* done);
+
+
+//***************************************************************************
+// decoder
+//***************************************************************************
+
+// Returns 1 if 'fs' is positioned at the start of a compressed stream
+// (the position is restored), 0 otherwise.
+int
+hpcio_z_is_compressed(FILE* fs);
+
+// Returns a read-only stream of the uncompressed contents of the
+// compressed stream 'fs', which supports fseek() and ftell().  On
+// success, the new stream owns 'fs' and closes it when closed.
+// Returns NULL on error.
+FILE*
+hpcio_z_fopen(FILE* fs);
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif // prof_lean_hpcio_z_h
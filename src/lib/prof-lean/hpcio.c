@@ -79,11 +79,19 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#elif defined(__SSSE3__)
+#  include <tmmintrin.h>
+#endif
 
 
 //*************************** User Include Files ****************************
 
 #include "hpcio.h"
+#include "hpcio-z.h"
 
 
 
@@ -134,6 +142,15 @@ FILE*
 hpcio_fopen_r(const char* fnm)
 {
   FILE* fs = fopen(fnm, "r");
+
+  // a compressed hpcrun output file is read through a decompressor
+  if (fs && hpcio_z_is_compressed(fs)) {
+    FILE* zfs = hpcio_z_fopen(fs);
+    if (!zfs) {
+      fclose(fs);
+    }
+    fs = zfs;
+  }
   return fs;
 }
 
@@ -160,6 +177,67 @@ hpcio_fclose(FILE* fs)
 }
 
 
+//***************************************************************************
+// Memory-mapped input.  See header for interface information.
+//***************************************************************************
+
+int
+hpcio_map_fs(hpcio_map_t* map, FILE* fs)
+{
+  struct stat st;
+  int fd = fileno(fs);
+
+  memset(map, 0, sizeof(*map));
+
+  if (fd < 0 || fstat(fd, &st) != 0 || ! S_ISREG(st.st_mode)
+      || st.st_size <= 0) {
+    return 1;
+  }
+
+  void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (addr == MAP_FAILED) {
+    return 1;
+  }
+  madvise(addr, st.st_size, MADV_SEQUENTIAL);
+
+  map->beg = (const uint8_t*) addr;
+  map->cur = map->beg;
+  map->end = map->beg + st.st_size;
+  return 0;
+}
+
+
+int
+hpcio_unmap(hpcio_map_t* map)
+{
+  int ret = 0;
+  if (map->beg) {
+    ret = munmap((void*) map->beg, map->end - map->beg);
+  }
+  memset(map, 0, sizeof(*map));
+  return (ret != 0);
+}
+
+
+int
+hpcio_map_seek_fs(hpcio_map_t* map, FILE* fs)
+{
+  long off = ftell(fs);
+  if (off < 0 || off > map->end - map->beg) {
+    return 1;
+  }
+  map->cur = map->beg + off;
+  return 0;
+}
+
+
+int
+hpcio_fs_seek_map(FILE* fs, const hpcio_map_t* map)
+{
+  return (fseek(fs, (long)(map->cur - map->beg), SEEK_SET) != 0);
+}
+
+
 //***************************************************************************
 // Read and write x bytes in little/big endian format.  See header for
 // interface information.
@@ -347,45 +425,27 @@ hpcio_beX_fread(uint8_t* val, size_t size, FILE* fs)
 size_t
 hpcio_be2_fwrite(uint16_t* val, FILE* fs)
 {
-  uint16_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 8; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t buf[sizeof(*val)];
+  hpcio_be2_store(buf, *val);
+  return fwrite(buf, 1, sizeof(buf), fs);
 }
 
 
 size_t
 hpcio_be4_fwrite(uint32_t* val, FILE* fs)
 {
-  uint32_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 24; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t buf[sizeof(*val)];
+  hpcio_be4_store(buf, *val);
+  return fwrite(buf, 1, sizeof(buf), fs);
 }
 
 
 size_t
 hpcio_be8_fwrite(uint64_t* val, FILE* fs)
 {
-  uint64_t v = *val; // local copy of val
-  int shift = 0, num_write = 0, c;
-  
-  for (shift = 56; shift >= 0; shift -= 8) {
-    c = fputc( ((v >> shift) & 0xff) , fs);
-    if (c == EOF) { break; }
-    num_write++;
-  }
-  return num_write;
+  uint8_t buf[sizeof(*val)];
+  hpcio_be8_store(buf, *val);
+  return fwrite(buf, 1, sizeof(buf), fs);
 }
 
 
@@ -406,6 +466,61 @@ hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs)
 }
 
 
+// be8_swap_n: hpcio_be8_store_n(), using 'pshufb' where the compiler
+// targets SSSE3 or AVX2.
+static void
+be8_swap_n(uint8_t* p, const uint8_t* val, size_t n)
+{
+  size_t i = 0;
+
+#if defined(HPCIO_BE8_TO_HOST) && defined(__AVX2__)
+  const __m256i mask =
+    _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+		     7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  for ( ; i + 4 <= n; i += 4) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)(val + 8 * i));
+    _mm256_storeu_si256((__m256i*)(p + 8 * i), _mm256_shuffle_epi8(x, mask));
+  }
+#elif defined(HPCIO_BE8_TO_HOST) && defined(__SSSE3__)
+  const __m128i mask =
+    _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+  for ( ; i + 2 <= n; i += 2) {
+    __m128i x = _mm_loadu_si128((const __m128i*)(val + 8 * i));
+    _mm_storeu_si128((__m128i*)(p + 8 * i), _mm_shuffle_epi8(x, mask));
+  }
+#endif
+
+  hpcio_be8_store_n(p + 8 * i, val + 8 * i, n - i);
+}
+
+
+size_t
+hpcio_be8_fwrite_n(const void* val, size_t n, FILE* fs)
+{
+  // kept modest since hpcrun writes profiles on application stacks
+  uint8_t buf[2048];
+  const size_t bufN = sizeof(buf) / 8;
+
+  const uint8_t* q = (const uint8_t*) val;
+  size_t num_write = 0;
+
+  while (n > 0) {
+    size_t k = (n < bufN) ? n : bufN;
+    be8_swap_n(buf, q, k);
+
+    size_t nw = fwrite(buf, 1, 8 * k, fs);
+    num_write += nw;
+    if (nw != 8 * k) {
+      break;
+    }
+    q += 8 * k;
+    n -= k;
+  }
+
+  return num_write;
+}
+
+
 //***************************************************************************
 //
 //***************************************************************************
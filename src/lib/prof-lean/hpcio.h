@@ -67,6 +67,7 @@
 //************************* System Include Files ****************************
 
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 
 //*************************** User Include Files ****************************
@@ -96,7 +97,9 @@ extern "C" {
 // 'overwrite' is 1 any existing file will be overwritten.  For
 // reading, it is an error if the file does not exist.  For any of
 // these errors, or other open errors, NULL is returned; otherwise a
-// non-null FILE pointer is returned.
+// non-null FILE pointer is returned.  hpcio_fopen_r transparently
+// decompresses files written by a compressing hpcio_outbuf (see
+// hpcio-z.h); such streams have no file descriptor.
 //
 // hpcio_close: Close the file stream.  Returns 0 upon success; 
 // non-zero on error.
@@ -171,6 +174,226 @@ size_t
 hpcio_beX_fwrite(uint8_t* val, size_t size, FILE* fs);
 
 
+// hpcio_be8_fwrite_n: Write the 'n' 8 byte values at 'val' (e.g., a
+// uint64_t[], double[] or hpcrun_metricVal_t[]) to the big-endian
+// file stream 'fs'.  The values are byte-swapped in bulk into a
+// staging buffer that is written with one fwrite() per chunk.
+// Returns the number of bytes written.
+size_t
+hpcio_be8_fwrite_n(const void* val, size_t n, FILE* fs);
+
+
+//***************************************************************************
+
+// hpcio_map_t: A read-only memory mapping of the regular file
+// underlying a file stream, for decoding bulk records in place
+// without going through stdio.  'cur' is the decoding position.
+typedef struct hpcio_map_t {
+  const uint8_t* beg;
+  const uint8_t* cur;
+  const uint8_t* end;
+} hpcio_map_t;
+
+// hpcio_map_fs: Maps the entire file underlying 'fs'.  Returns 0 on
+// success; non-zero if 'fs' is not backed by a regular file (e.g., a
+// pipe or memstream) or the mapping fails, in which case 'map' is
+// zeroed and callers should fall back to the hpcio_*_fread routines.
+//
+// hpcio_unmap: Releases the mapping.  Returns 0 upon success;
+// non-zero on error.
+int
+hpcio_map_fs(hpcio_map_t* map, FILE* fs);
+
+int
+hpcio_unmap(hpcio_map_t* map);
+
+
+// hpcio_map_seek_fs: Moves 'map' to the current position of 'fs'.
+// hpcio_fs_seek_map: Moves 'fs' to the current position of 'map'.
+// Both return 0 upon success; non-zero on error.  Together they let
+// a reader switch between stdio (headers) and the mapping (bulk
+// records) on the same file.
+int
+hpcio_map_seek_fs(hpcio_map_t* map, FILE* fs);
+
+int
+hpcio_fs_seek_map(FILE* fs, const hpcio_map_t* map);
+
+
+static inline size_t
+hpcio_map_avail(const hpcio_map_t* map)
+{
+  return (size_t)(map->end - map->cur);
+}
+
+
+// hpcio_beX_load: Loads 'X' big-endian bytes from (possibly
+// unaligned) 'p' and returns them in the order of the current
+// architecture.  hpcio_be8_load_n loads 'n' consecutive 8 byte
+// values into 'val'; the loop is simple enough to be vectorized.
+
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) \
+  && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#  define HPCIO_BE2_TO_HOST(v) __builtin_bswap16(v)
+#  define HPCIO_BE4_TO_HOST(v) __builtin_bswap32(v)
+#  define HPCIO_BE8_TO_HOST(v) __builtin_bswap64(v)
+#elif defined(__GNUC__) && defined(__BYTE_ORDER__) \
+  && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#  define HPCIO_BE2_TO_HOST(v) (v)
+#  define HPCIO_BE4_TO_HOST(v) (v)
+#  define HPCIO_BE8_TO_HOST(v) (v)
+#endif
+
+
+// HPCIO_HostEndian: The byte order of the current architecture as
+// named by the endian byte of the file formats: 'l' (little) or 'b'
+// (big).
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#  define HPCIO_HostEndian 'l'
+#else
+#  define HPCIO_HostEndian 'b'
+#endif
+
+static inline uint16_t
+hpcio_be2_load(const uint8_t* p)
+{
+#ifdef HPCIO_BE2_TO_HOST
+  uint16_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE2_TO_HOST(v);
+#else
+  return (uint16_t)((p[0] << 8) | p[1]);
+#endif
+}
+
+
+static inline uint32_t
+hpcio_be4_load(const uint8_t* p)
+{
+#ifdef HPCIO_BE4_TO_HOST
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE4_TO_HOST(v);
+#else
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16)
+    | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+#endif
+}
+
+
+static inline uint64_t
+hpcio_be8_load(const uint8_t* p)
+{
+#ifdef HPCIO_BE8_TO_HOST
+  uint64_t v;
+  memcpy(&v, p, sizeof(v));
+  return HPCIO_BE8_TO_HOST(v);
+#else
+  return ((uint64_t)hpcio_be4_load(p) << 32) | hpcio_be4_load(p + 4);
+#endif
+}
+
+
+static inline void
+hpcio_be8_load_n(uint64_t* val, const uint8_t* p, size_t n)
+{
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    val[i] = hpcio_be8_load(p + 8 * i);
+  }
+}
+
+
+// hpcio_beX_store: Stores 'v' as 'X' big-endian bytes at (possibly
+// unaligned) 'p'.  hpcio_be8_store_n stores the 'n' consecutive 8
+// byte values at 'val'; like hpcio_be8_load_n, it can be vectorized.
+
+static inline void
+hpcio_be2_store(uint8_t* p, uint16_t v)
+{
+#ifdef HPCIO_BE2_TO_HOST
+  v = HPCIO_BE2_TO_HOST(v);
+  memcpy(p, &v, sizeof(v));
+#else
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+#endif
+}
+
+
+static inline void
+hpcio_be4_store(uint8_t* p, uint32_t v)
+{
+#ifdef HPCIO_BE4_TO_HOST
+  v = HPCIO_BE4_TO_HOST(v);
+  memcpy(p, &v, sizeof(v));
+#else
+  p[0] = (uint8_t)(v >> 24);
+  p[1] = (uint8_t)(v >> 16);
+  p[2] = (uint8_t)(v >> 8);
+  p[3] = (uint8_t)v;
+#endif
+}
+
+
+static inline void
+hpcio_be8_store(uint8_t* p, uint64_t v)
+{
+#ifdef HPCIO_BE8_TO_HOST
+  v = HPCIO_BE8_TO_HOST(v);
+  memcpy(p, &v, sizeof(v));
+#else
+  hpcio_be4_store(p, (uint32_t)(v >> 32));
+  hpcio_be4_store(p + 4, (uint32_t)v);
+#endif
+}
+
+
+static inline void
+hpcio_be8_store_n(uint8_t* p, const void* val, size_t n)
+{
+  const uint8_t* q = (const uint8_t*) val;
+  size_t i;
+  for (i = 0; i < n; ++i) {
+    uint64_t v;
+    memcpy(&v, q + 8 * i, sizeof(v));
+    hpcio_be8_store(p + 8 * i, v);
+  }
+}
+
+
+// hpcio_ld4_endian, hpcio_ld8_endian: Loads a 4 or 8 byte value in
+// the byte order named by 'endian' ('l' or 'b'; cf. HPCIO_HostEndian)
+// from (possibly unaligned) 'p'.
+
+static inline uint32_t
+hpcio_ld4_endian(const uint8_t* p, char endian)
+{
+  if (endian == HPCIO_HostEndian) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  return (endian == 'b') ? hpcio_be4_load(p)
+    : ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16)
+    | ((uint32_t)p[1] << 8) | (uint32_t)p[0];
+}
+
+
+static inline uint64_t
+hpcio_ld8_endian(const uint8_t* p, char endian)
+{
+  if (endian == HPCIO_HostEndian) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+  }
+  uint64_t w0 = hpcio_ld4_endian(p, endian);
+  uint64_t w1 = hpcio_ld4_endian(p + 4, endian);
+  return (endian == 'b') ? ((w0 << 32) | w1) : ((w1 << 32) | w0);
+}
+
+
 //***************************************************************************
 
 #if defined(__cplusplus)
@@ -181,6 +181,20 @@ hpcrun_fmt_epochHdr_fread(hpcrun_fmt_epochHdr_t* ehdr, FILE* fs,
     return (nr == 0 && feof(fs)) ? HPCFMT_EOF : HPCFMT_ERR;
   }
 
+  // version 02.01: skip the previous epoch's cct-idx; the toc ends
+  // the epochs
+  if (strcmp(tag, HPCRUN_FMT_CCTIdxTag) == 0) {
+    uint64_t n = 0;
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&n, fs));
+    if (fseeko(fs, n * sizeof(uint64_t), SEEK_CUR) != 0) {
+      return HPCFMT_ERR;
+    }
+    return hpcrun_fmt_epochHdr_fread(ehdr, fs, alloc);
+  }
+  if (strcmp(tag, HPCRUN_FMT_TocTag) == 0) {
+    return HPCFMT_EOF;
+  }
+
   if (strcmp(tag, HPCRUN_FMT_EpochTag) != 0) {
     return HPCFMT_ERR;
   }
@@ -358,10 +372,9 @@ hpcrun_fmt_metricTbl_free(metric_tbl_t* metric_tbl, hpcfmt_free_fn dealloc)
 
 //***************************************************************************
 
-int
-hpcrun_fmt_metricDesc_fread(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs,
-			    double GCC_ATTR_UNUSED fmtVersion,
-			    hpcfmt_alloc_fn alloc)
+// the descriptor proper, without the measured aux info
+static int
+metricDesc_fread(metric_desc_t* x, FILE* fs, hpcfmt_alloc_fn alloc)
 {
   HPCFMT_ThrowIfError(hpcfmt_str_fread(&(x->name), fs, alloc));
   HPCFMT_ThrowIfError(hpcfmt_str_fread(&(x->description), fs, alloc));
@@ -394,11 +407,6 @@ hpcrun_fmt_metricDesc_fread(metric_desc_t* x, metric_aux_info_t *aux_info, FILE*
   HPCFMT_ThrowIfError(hpcfmt_str_fread(&(x->format), fs, alloc));
 
   HPCFMT_ThrowIfError(hpcfmt_int2_fread ((uint16_t*)&(x->is_frequency_metric),    fs));
-  HPCFMT_ThrowIfError(hpcfmt_int2_fread ((uint16_t*)&(aux_info->is_multiplexed),  fs));
-  HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(aux_info->threshold_mean),  fs));
-  // disabled temporarily
-  //HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(x->info_data.threshold_stdev), fs));
-  HPCFMT_ThrowIfError(hpcfmt_int8_fread ((&aux_info->num_samples),     fs));
 
   // These two aren't written into the hpcrun file; hence manually set them.
   x->properties.time = 0;
@@ -408,8 +416,20 @@ hpcrun_fmt_metricDesc_fread(metric_desc_t* x, metric_aux_info_t *aux_info, FILE*
 }
 
 
-int
-hpcrun_fmt_metricDesc_fwrite(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs)
+static int
+metricAux_fread(metric_aux_info_t *aux_info, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int2_fread ((uint16_t*)&(aux_info->is_multiplexed),  fs));
+  HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(aux_info->threshold_mean),  fs));
+  // disabled temporarily
+  //HPCFMT_ThrowIfError(hpcfmt_real8_fread(&(x->info_data.threshold_stdev), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread ((&aux_info->num_samples),     fs));
+  return HPCFMT_OK;
+}
+
+
+static int
+metricDesc_fwrite(metric_desc_t* x, FILE* fs)
 {
   HPCFMT_ThrowIfError(hpcfmt_str_fwrite(x->name, fs));
   HPCFMT_ThrowIfError(hpcfmt_str_fwrite(x->description, fs));
@@ -419,17 +439,42 @@ hpcrun_fmt_metricDesc_fwrite(metric_desc_t* x, metric_aux_info_t *aux_info, FILE
   HPCFMT_ThrowIfError(hpcfmt_str_fwrite(x->format, fs));
 
   HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(x->is_frequency_metric, fs));
+  return HPCFMT_OK;
+}
+
 
+static int
+metricAux_fwrite(metric_aux_info_t *aux_info, FILE* fs)
+{
   HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(aux_info->is_multiplexed, fs));
   HPCFMT_ThrowIfError(hpcfmt_real8_fwrite(aux_info->threshold_mean, fs));
   HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(aux_info->num_samples, fs));
+  return HPCFMT_OK;
+}
 
+
+int
+hpcrun_fmt_metricDesc_fread(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs,
+			    double GCC_ATTR_UNUSED fmtVersion,
+			    hpcfmt_alloc_fn alloc)
+{
+  HPCFMT_ThrowIfError(metricDesc_fread(x, fs, alloc));
+  HPCFMT_ThrowIfError(metricAux_fread(aux_info, fs));
   return HPCFMT_OK;
 }
 
 
 int
-hpcrun_fmt_metricDesc_fprint(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs, const char* pre)
+hpcrun_fmt_metricDesc_fwrite(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs)
+{
+  HPCFMT_ThrowIfError(metricDesc_fwrite(x, fs));
+  HPCFMT_ThrowIfError(metricAux_fwrite(aux_info, fs));
+  return HPCFMT_OK;
+}
+
+
+static void
+metricDesc_fprint(metric_desc_t* x, FILE* fs, const char* pre)
 {
   fprintf(fs, "%s[(nm: %s) (desc: %s) "
 	  "((ty: %d) (val-ty: %d) (val-fmt: %d) (partner: %u) (show: %d) (showPercent: %d)) "
@@ -440,6 +485,13 @@ hpcrun_fmt_metricDesc_fprint(metric_desc_t* x, metric_aux_info_t *aux_info, FILE
 	  (uint)x->flags.fields.partner, x->flags.fields.show, x->flags.fields.showPercent,
 	  x->period,
 	  hpcfmt_str_ensure(x->formula), hpcfmt_str_ensure(x->format));
+}
+
+
+int
+hpcrun_fmt_metricDesc_fprint(metric_desc_t* x, metric_aux_info_t *aux_info, FILE* fs, const char* pre)
+{
+  metricDesc_fprint(x, fs, pre);
   fprintf(fs, "    (frequency: %d) (multiplexed: %d) (period-mean: %f) (num-samples: %d)]\n",
           (int)x->is_frequency_metric, (int)aux_info->is_multiplexed,
 		  aux_info->threshold_mean,  (int) aux_info->num_samples);
@@ -639,27 +691,81 @@ hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 }
 
 
+int
+hpcrun_fmt_cct_node_mread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, hpcio_map_t* map)
+{
+  bool isLogicalUnwind = flags.fields.isLogicalUnwind;
+
+  // check the size of the whole record once, then decode without
+  // further bounds checks
+  size_t sz = hpcrun_fmt_cct_node_size(flags, x->num_metrics);
+  if (hpcio_map_avail(map) < sz) {
+    return (hpcio_map_avail(map) == 0) ? HPCFMT_EOF : HPCFMT_ERR;
+  }
+
+  const uint8_t* p = map->cur;
+
+  x->id = hpcio_be4_load(p);          p += sizeof(uint32_t);
+  x->id_parent = hpcio_be4_load(p);   p += sizeof(uint32_t);
+
+  x->as_info = lush_assoc_info_NULL;
+  if (isLogicalUnwind) {
+    x->as_info.bits = hpcio_be4_load(p);  p += sizeof(uint32_t);
+  }
+
+  x->lm_id = hpcio_be2_load(p);       p += sizeof(uint16_t);
+  x->lm_ip = hpcio_be8_load(p);       p += sizeof(uint64_t);
+
+  lush_lip_init(&x->lip);
+  if (isLogicalUnwind) {
+    hpcio_be8_load_n(x->lip.data8, p, LUSH_LIP_DATA8_SZ);
+    p += LUSH_LIP_DATA8_SZ * sizeof(uint64_t);
+  }
+
+  // hpcrun_metricVal_t is a union of 8 byte values
+  hpcio_be8_load_n((uint64_t*) x->metrics, p, x->num_metrics);
+  p += x->num_metrics * sizeof(uint64_t);
+
+  map->cur = p;
+  return HPCFMT_OK;
+}
+
+
 int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs)
 {
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->id_parent, fs));
+  // stage the fixed fields (cf. hpcrun_fmt_cct_node_mread) so that a
+  // node takes two writes: its fields and its metrics
+  uint8_t buf[4 + 4 + 4 + 2 + 8 + sizeof(x->lip.data8)];
+  uint8_t* p = buf;
+
+  hpcio_be4_store(p, x->id);
+  hpcio_be4_store(p + 4, x->id_parent);
+  p += 8;
 
   if (flags.fields.isLogicalUnwind) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->as_info.bits, fs));
+    hpcio_be4_store(p, x->as_info.bits);
+    p += 4;
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int2_fwrite(x->lm_id, fs));
-  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->lm_ip, fs));
+  hpcio_be2_store(p, x->lm_id);
+  hpcio_be8_store(p + 2, x->lm_ip);
+  p += 10;
 
   if (flags.fields.isLogicalUnwind) {
-    HPCFMT_ThrowIfError(hpcrun_fmt_lip_fwrite(&x->lip, fs));
+    hpcio_be8_store_n(p, x->lip.data8, LUSH_LIP_DATA8_SZ);
+    p += sizeof(x->lip.data8);
   }
 
-  for (int i = 0; i < x->num_metrics; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metrics[i].bits, fs));
+  if (fwrite(buf, 1, p - buf, fs) != (size_t)(p - buf)) {
+    return HPCFMT_ERR;
   }
+
+  // hpcrun_metricVal_t is a union of 8 byte values
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite_n((uint64_t*) x->metrics,
+					   x->num_metrics, fs));
   
   return HPCFMT_OK;
 }
@@ -736,11 +842,7 @@ hpcrun_fmt_lip_fread(lush_lip_t* x, FILE* fs)
 int
 hpcrun_fmt_lip_fwrite(lush_lip_t* x, FILE* fs)
 {
-  for (int i = 0; i < LUSH_LIP_DATA8_SZ; ++i) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->data8[i], fs));
-  }
-  
-  return HPCFMT_OK;
+  return hpcfmt_int8_fwrite_n(x->data8, LUSH_LIP_DATA8_SZ, fs);
 }
 
 
@@ -756,6 +858,500 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre)
 }
 
 
+//***************************************************************************
+
+uint32_t
+hpcrun_fmt_cct_node_size(epoch_flags_t flags, uint32_t numMetrics)
+{
+  uint32_t sz = (sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint16_t)
+		 + sizeof(uint64_t) + (numMetrics * sizeof(uint64_t)));
+  if (flags.fields.isLogicalUnwind) {
+    sz += sizeof(uint32_t) + (LUSH_LIP_DATA8_SZ * sizeof(uint64_t));
+  }
+  return sz;
+}
+
+
+//***************************************************************************
+// cct-idx and toc
+//***************************************************************************
+
+int
+hpcrun_fmt_cctIdx_fwrite(const uint64_t* idx, uint64_t n, FILE* fs)
+{
+  size_t tagLen = sizeof(HPCRUN_FMT_CCTIdxTag) - 1;
+  if (fwrite(HPCRUN_FMT_CCTIdxTag, 1, tagLen, fs) != tagLen) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(n, fs));
+  return hpcfmt_int8_fwrite_n(idx, n, fs);
+}
+
+
+int
+hpcrun_fmt_tocHdr_fwrite(uint32_t numEpochs, FILE* fs)
+{
+  size_t tagLen = sizeof(HPCRUN_FMT_TocTag) - 1;
+  if (fwrite(HPCRUN_FMT_TocTag, 1, tagLen, fs) != tagLen) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(numEpochs, fs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_tocEntry_fwrite(const hpcrun_fmt_tocEntry_t* x, FILE* fs)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->epochOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->metricTblOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->loadmapOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->cctOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->cctIdxOff, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->numNodes, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->numMetrics, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->nodeSz, fs));
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_tocFtr_fwrite(uint64_t tocOff, FILE* fs)
+{
+  size_t magicLen = sizeof(HPCRUN_FMT_TocMagic) - 1;
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(tocOff, fs));
+  if (fwrite(HPCRUN_FMT_TocMagic, 1, magicLen, fs) != magicLen) {
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+static int
+toc_fread(hpcrun_fmt_toc_t* toc, FILE* fs, hpcfmt_alloc_fn alloc)
+{
+  char buf[sizeof(HPCRUN_FMT_TocMagic)];
+  size_t magicLen = sizeof(HPCRUN_FMT_TocMagic) - 1;
+  uint64_t tocOff = 0;
+
+  // footer
+  if (fseeko(fs, -HPCRUN_FMT_TocFtrLen, SEEK_END) != 0) {
+    return HPCFMT_ERR;
+  }
+  off_t ftrOff = ftello(fs);
+  HPCFMT_ThrowIfError(hpcfmt_int8_fread(&tocOff, fs));
+  if (fread(buf, 1, magicLen, fs) != magicLen
+      || memcmp(buf, HPCRUN_FMT_TocMagic, magicLen) != 0
+      || tocOff >= (uint64_t) ftrOff) {
+    return HPCFMT_ERR;
+  }
+
+  // hdr
+  size_t tagLen = sizeof(HPCRUN_FMT_TocTag) - 1;
+  if (fseeko(fs, tocOff, SEEK_SET) != 0
+      || fread(buf, 1, tagLen, fs) != tagLen
+      || memcmp(buf, HPCRUN_FMT_TocTag, tagLen) != 0) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&toc->len, fs));
+
+  // entries
+  toc->lst = alloc(toc->len * sizeof(hpcrun_fmt_tocEntry_t));
+  if (toc->len > 0 && !toc->lst) {
+    return HPCFMT_ERR;
+  }
+  for (uint32_t i = 0; i < toc->len; i++) {
+    hpcrun_fmt_tocEntry_t* x = &toc->lst[i];
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->epochOff, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->metricTblOff, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->loadmapOff, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->cctOff, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->cctIdxOff, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&x->numNodes, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->numMetrics, fs));
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&x->nodeSz, fs));
+  }
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_toc_fread(hpcrun_fmt_toc_t* toc, FILE* fs, hpcfmt_alloc_fn alloc)
+{
+  toc->len = 0;
+  toc->lst = NULL;
+
+  off_t pos = ftello(fs);
+  if (pos < 0) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = toc_fread(toc, fs, alloc);
+  if (ret != HPCFMT_OK) {
+    toc->len = 0; // toc->lst (if any) belongs to the caller
+  }
+
+  if (fseeko(fs, pos, SEEK_SET) != 0) {
+    return HPCFMT_ERR;
+  }
+  return ret;
+}
+
+
+int
+hpcrun_fmt_toc_fprint(hpcrun_fmt_toc_t* toc, FILE* fs)
+{
+  fprintf(fs, "[toc: (num-epochs: %u)\n", toc->len);
+  for (uint32_t i = 0; i < toc->len; i++) {
+    hpcrun_fmt_tocEntry_t* x = &toc->lst[i];
+    fprintf(fs, "  [epoch: (offset: %"PRIu64") (metric-tbl: %"PRIu64") "
+	    "(loadmap: %"PRIu64") (cct: %"PRIu64") (cct-idx: %"PRIu64")\n"
+	    "    (num-nodes: %"PRIu64") (num-metrics: %u) (node-size: %u)]\n",
+	    x->epochOff, x->metricTblOff, x->loadmapOff, x->cctOff,
+	    x->cctIdxOff, x->numNodes, x->numMetrics, x->nodeSz);
+  }
+  fprintf(fs, "]\n");
+  return HPCFMT_OK;
+}
+
+
+void
+hpcrun_fmt_toc_free(hpcrun_fmt_toc_t* toc, hpcfmt_free_fn dealloc)
+{
+  dealloc(toc->lst);
+  toc->lst = NULL;
+  toc->len = 0;
+}
+
+
+int
+hpcrun_fmt_cct_node_fseek(const hpcrun_fmt_tocEntry_t* x, uint32_t id,
+			  FILE* fs)
+{
+  // binary search over the entries of the cct-idx
+  uint64_t base = x->cctIdxOff + (sizeof(HPCRUN_FMT_CCTIdxTag) - 1)
+    + sizeof(uint64_t);
+  uint64_t lo = 0, hi = x->numNodes;
+
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    uint64_t e = 0;
+    if (fseeko(fs, base + mid * sizeof(uint64_t), SEEK_SET) != 0) {
+      return HPCFMT_ERR;
+    }
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&e, fs));
+
+    uint32_t e_id = (uint32_t)(e >> 32);
+    if (e_id == id) {
+      uint64_t pos = (uint32_t) e;
+      uint64_t off = x->cctOff + sizeof(uint64_t) + pos * x->nodeSz;
+      return (fseeko(fs, off, SEEK_SET) == 0) ? HPCFMT_OK : HPCFMT_ERR;
+    }
+    else if (e_id < id) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return HPCFMT_ERR;
+}
+
+
+int
+hpcrun_fmt_cct_metric_fread(const hpcrun_fmt_tocEntry_t* x,
+			    uint32_t metricId, hpcrun_metricVal_t* vals,
+			    FILE* fs)
+{
+  if (metricId >= x->numMetrics || x->nodeSz == 0) {
+    return HPCFMT_ERR;
+  }
+
+  // metrics are the last field of a node
+  uint32_t metricOff = x->nodeSz - (x->numMetrics - metricId) * sizeof(uint64_t);
+
+  // read whole blocks of nodes and pick out the metric
+  const uint64_t blkNodes = 4096;
+  uint8_t* blk = malloc(blkNodes * x->nodeSz);
+  if (!blk) {
+    return HPCFMT_ERR;
+  }
+
+  int ret = HPCFMT_OK;
+  if (fseeko(fs, x->cctOff + sizeof(uint64_t), SEEK_SET) != 0) {
+    ret = HPCFMT_ERR;
+  }
+  for (uint64_t i = 0; i < x->numNodes && ret == HPCFMT_OK; ) {
+    uint64_t n = x->numNodes - i;
+    if (n > blkNodes) {
+      n = blkNodes;
+    }
+    if (fread(blk, x->nodeSz, n, fs) != n) {
+      ret = HPCFMT_ERR;
+      break;
+    }
+    for (uint64_t k = 0; k < n; k++) {
+      vals[i + k].bits = hpcio_be8_load(blk + k * x->nodeSz + metricOff);
+    }
+    i += n;
+  }
+
+  free(blk);
+  return ret;
+}
+
+
+//***************************************************************************
+// dictionary
+//***************************************************************************
+
+int
+hpcrun_fmt_dictHdr_fwrite(FILE* fs, ...)
+{
+  va_list args;
+  va_start(args, fs);
+
+  fwrite(HPCRUN_FMT_DictMagic,   1, HPCRUN_FMT_MagicLen, fs);
+  fwrite(HPCRUN_FMT_DictVersion, 1, HPCRUN_FMT_VersionLen, fs);
+  fwrite(HPCRUN_FMT_Endian,      1, HPCRUN_FMT_EndianLen, fs);
+
+  hpcfmt_nvpairs_vfwrite(fs, args);
+
+  va_end(args);
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_dictMetric_fwrite(uint32_t id, metric_desc_t* x, FILE* fs)
+{
+  if (fputc(HPCRUN_FMT_DictMetric, fs) == EOF) {
+    return HPCFMT_ERR;
+  }
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(id, fs));
+  return metricDesc_fwrite(x, fs);
+}
+
+
+int
+hpcrun_fmt_dictLM_fwrite(loadmap_entry_t* x, FILE* fs)
+{
+  if (fputc(HPCRUN_FMT_DictLM, fs) == EOF) {
+    return HPCFMT_ERR;
+  }
+  return hpcrun_fmt_loadmapEntry_fwrite(x, fs);
+}
+
+
+// Extends the (zero-filled) array '*lst' of '*len' elements of size
+// 'sz' to at least 'n' elements.
+static int
+dict_grow(void** lst, uint32_t* len, uint32_t n, size_t sz)
+{
+  if (n <= *len) {
+    return HPCFMT_OK;
+  }
+  char* x = realloc(*lst, n * sz);
+  if (x == NULL) {
+    return HPCFMT_ERR;
+  }
+  memset(x + *len * sz, 0, (n - *len) * sz);
+  *lst = x;
+  *len = n;
+  return HPCFMT_OK;
+}
+
+
+static int
+dict_fread(hpcrun_fmt_dict_t* dict, FILE* fs)
+{
+  char tag[HPCRUN_FMT_MagicLen + 1];
+
+  if (fread(tag, 1, HPCRUN_FMT_MagicLen, fs) != HPCRUN_FMT_MagicLen) {
+    return HPCFMT_ERR;
+  }
+  tag[HPCRUN_FMT_MagicLen] = '\0';
+  if (strcmp(tag, HPCRUN_FMT_DictMagic) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  if (fread(dict->versionStr, 1, HPCRUN_FMT_VersionLen, fs)
+      != HPCRUN_FMT_VersionLen) {
+    return HPCFMT_ERR;
+  }
+  dict->versionStr[HPCRUN_FMT_VersionLen] = '\0';
+  dict->version = atof(dict->versionStr);
+
+  if (fread(&dict->endian, 1, HPCRUN_FMT_EndianLen, fs)
+      != HPCRUN_FMT_EndianLen) {
+    return HPCFMT_ERR;
+  }
+
+  HPCFMT_ThrowIfError(hpcfmt_nvpairList_fread(&(dict->nvps), fs, malloc));
+
+  for (int kind = fgetc(fs); kind != EOF; kind = fgetc(fs)) {
+    if (kind == HPCRUN_FMT_DictMetric) {
+      uint32_t id = 0;
+      HPCFMT_ThrowIfError(hpcfmt_int4_fread(&id, fs));
+      if (id >= UINT16_MAX) { // far more than any process defines
+	return HPCFMT_ERR;
+      }
+      metric_tbl_t* tbl = &dict->metricTbl;
+      HPCFMT_ThrowIfError(dict_grow((void**) &tbl->lst, &tbl->len, id + 1,
+				    sizeof(metric_desc_t)));
+      hpcrun_fmt_metricDesc_free(&tbl->lst[id], free);
+      HPCFMT_ThrowIfError(metricDesc_fread(&tbl->lst[id], fs, malloc));
+    }
+    else if (kind == HPCRUN_FMT_DictLM) {
+      loadmap_entry_t e;
+      HPCFMT_ThrowIfError(hpcrun_fmt_loadmapEntry_fread(&e, fs, malloc));
+      loadmap_t* lm = &dict->loadmap;
+      if (dict_grow((void**) &lm->lst, &lm->len, e.id + 1u,
+		    sizeof(loadmap_entry_t)) != HPCFMT_OK) {
+	hpcrun_fmt_loadmapEntry_free(&e, free);
+	return HPCFMT_ERR;
+      }
+      hpcrun_fmt_loadmapEntry_free(&lm->lst[e.id], free);
+      lm->lst[e.id] = e;
+    }
+    else {
+      return HPCFMT_ERR;
+    }
+  }
+
+  return ferror(fs) ? HPCFMT_ERR : HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_dict_fread(hpcrun_fmt_dict_t* dict, FILE* fs)
+{
+  memset(dict, 0, sizeof(*dict));
+
+  int ret = dict_fread(dict, fs);
+  if (ret != HPCFMT_OK) {
+    hpcrun_fmt_dict_free(dict);
+  }
+  return ret;
+}
+
+
+int
+hpcrun_fmt_dict_fprint(hpcrun_fmt_dict_t* dict, FILE* fs)
+{
+  fprintf(fs, "[dictionary:\n");
+  fprintf(fs, "  (version: %s)\n", dict->versionStr);
+  fprintf(fs, "  (endian: %c)\n", dict->endian);
+  hpcfmt_nvpairList_fprint(&dict->nvps, fs, "  ");
+  for (uint32_t i = 0; i < dict->metricTbl.len; i++) {
+    metric_desc_t* x = &dict->metricTbl.lst[i];
+    if (x->name) {
+      metricDesc_fprint(x, fs, "  ");
+      fprintf(fs, "    (metric-id: %u)]\n", i);
+    }
+  }
+  for (uint32_t i = 0; i < dict->loadmap.len; i++) {
+    loadmap_entry_t* e = &dict->loadmap.lst[i];
+    if (e->name) {
+      hpcrun_fmt_loadmapEntry_fprint(e, fs, "  ");
+    }
+  }
+  fprintf(fs, "]\n");
+
+  return HPCFMT_OK;
+}
+
+
+void
+hpcrun_fmt_dict_free(hpcrun_fmt_dict_t* dict)
+{
+  if (dict->nvps.lst) {
+    hpcfmt_nvpairList_free(&(dict->nvps), free);
+  }
+  if (dict->metricTbl.lst) {
+    hpcrun_fmt_metricTbl_free(&dict->metricTbl, free);
+  }
+  if (dict->loadmap.lst) {
+    hpcrun_fmt_loadmap_free(&dict->loadmap, free);
+  }
+  memset(dict, 0, sizeof(*dict));
+}
+
+
+//***************************************************************************
+
+int
+hpcrun_fmt_metricTblRef_fread(metric_tbl_t* metric_tbl,
+			      metric_aux_info_t **aux_info,
+			      const hpcrun_fmt_dict_t* dict, FILE* fs)
+{
+  uint32_t len = 0;
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&len, fs));
+  if (len > dict->metricTbl.len) {
+    return HPCFMT_ERR;
+  }
+  metric_tbl->len = len;
+  metric_tbl->lst = dict->metricTbl.lst;
+
+  metric_aux_info_t *perf_info = calloc(len + 1, sizeof(metric_aux_info_t));
+  if (perf_info == NULL) {
+    return HPCFMT_ERR;
+  }
+  *aux_info = perf_info;
+
+  for (uint32_t i = 0; i < len; i++) {
+    if (metric_tbl->lst[i].name == NULL) {
+      return HPCFMT_ERR;
+    }
+    HPCFMT_ThrowIfError(metricAux_fread(&perf_info[i], fs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_metricTblRef_fwrite(uint32_t len, metric_aux_info_t *aux_info,
+			       FILE* fs)
+{
+  metric_aux_info_t zero;
+  memset(&zero, 0, sizeof(zero));
+
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(len, fs));
+  for (uint32_t i = 0; i < len; i++) {
+    // as in hpcrun_fmt_metricTbl_fwrite(), 'aux_info' may be NULL
+    HPCFMT_ThrowIfError(metricAux_fwrite(aux_info ? &aux_info[i] : &zero, fs));
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcrun_fmt_loadmapRef_fread(loadmap_t* loadmap, const hpcrun_fmt_dict_t* dict,
+			    FILE* fs, hpcfmt_alloc_fn alloc)
+{
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(loadmap->len), fs));
+  loadmap->lst = alloc(loadmap->len * sizeof(loadmap_entry_t));
+  if (loadmap->len > 0 && !loadmap->lst) {
+    return HPCFMT_ERR;
+  }
+
+  for (uint32_t i = 0; i < loadmap->len; i++) {
+    uint16_t id = 0;
+    HPCFMT_ThrowIfError(hpcfmt_int2_fread(&id, fs));
+    if (id >= dict->loadmap.len || dict->loadmap.lst[id].name == NULL) {
+      loadmap->len = i;
+      return HPCFMT_ERR;
+    }
+    loadmap->lst[i] = dict->loadmap.lst[id];
+  }
+
+  return HPCFMT_OK;
+}
+
+
 //***************************************************************************
 // hpctrace (located here for now)
 //***************************************************************************
@@ -798,7 +1394,8 @@ hpctrace_fmt_hdr_fread(hpctrace_fmt_hdr_t* hdr, FILE* infs)
 
   hdr->flags = hpctrace_hdr_flags_NULL;
   if (hdr->version > 1.0) {
-    HPCFMT_ThrowIfError(hpcfmt_int8_fread(&(hdr->flags.bits), infs));
+    HPCFMT_ThrowIfError(hpcfmt_int8_fread_endian(&(hdr->flags.bits),
+						 hdr->endian, infs));
   }
 
   return HPCFMT_OK;
@@ -813,19 +1410,12 @@ hpctrace_fmt_hdr_outbuf(hpctrace_hdr_flags_t flags, hpcio_outbuf_t* outbuf)
   ssize_t ret;
 
   const int bufSZ = sizeof(flags);
-  unsigned char buf[bufSZ];
-
   uint64_t flag_bits = flags.bits;
-  int k = 0;
-  for (int shift = 56; shift >= 0; shift -= 8) {
-    buf[k] = (flag_bits >> shift) & 0xff;
-    k++;
-  }
 
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Magic, HPCTRACE_FMT_MagicLen);
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Version, HPCTRACE_FMT_VersionLen);
   hpcio_outbuf_write(outbuf, HPCTRACE_FMT_Endian, HPCTRACE_FMT_EndianLen);
-  ret = hpcio_outbuf_write(outbuf, buf, bufSZ);
+  ret = hpcio_outbuf_write(outbuf, &flag_bits, bufSZ);
 
   if (ret != bufSZ) {
     return HPCFMT_ERR;
@@ -850,7 +1440,7 @@ hpctrace_fmt_hdr_fwrite(hpctrace_hdr_flags_t flags, FILE* fs)
   nw = fwrite(HPCTRACE_FMT_Endian,  1, HPCTRACE_FMT_EndianLen, fs);
   if (nw != HPCTRACE_FMT_EndianLen) return HPCFMT_ERR;
 
-  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(flags.bits, fs));
+  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite_host(flags.bits, fs));
 
   return HPCFMT_OK;
 }
@@ -876,20 +1466,21 @@ hpctrace_fmt_hdr_fprint(hpctrace_fmt_hdr_t* hdr, FILE* fs)
 //***************************************************************************
 
 int
-hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
-			 FILE* fs)
+hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x,
+			 const hpctrace_fmt_hdr_t* hdr, FILE* fs)
 {
   int ret = HPCFMT_OK;
+  char endian = hdr->endian;
   
-  ret = hpcfmt_int8_fread(&(x->time), fs);
+  ret = hpcfmt_int8_fread_endian(&(x->time), endian, fs);
   if (ret != HPCFMT_OK) {
     return ret; // can be HPCFMT_EOF
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->cpId), fs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread_endian(&(x->cpId), endian, fs));
 
-  if (flags.fields.isDataCentric) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(x->metricId), fs));
+  if (hdr->flags.fields.isDataCentric) {
+    HPCFMT_ThrowIfError(hpcfmt_int4_fread_endian(&(x->metricId), endian, fs));
   }
   else {
     x->metricId = HPCRUN_FMT_MetricId_NULL;
@@ -899,38 +1490,39 @@ hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 }
 
 
-// Append the trace record to the outbuf.
-// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
-int
-hpctrace_fmt_datum_outbuf(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
-			  hpcio_outbuf_t* outbuf)
+// Packs 'x' into 'buf' (at least sizeof(hpctrace_fmt_datum_t) bytes);
+// returns the record's length.
+static int
+hpctrace_fmt_datum_pack(unsigned char* buf, const hpctrace_fmt_datum_t* x,
+			hpctrace_hdr_flags_t flags)
 {
-  const int bufSZ = sizeof(hpctrace_fmt_datum_t);
-  unsigned char buf[bufSZ];
-  int shift, k;
-
-  k = 0;
+  int k = 0;
 
-  uint64_t time = x->time;
-  for (shift = 56; shift >= 0; shift -= 8) {
-    buf[k] = (time >> shift) & 0xff;
-    k++;
-  }
+  // host byte order, cf. HPCTRACE_FMT_Endian
+  memcpy(buf + k, &x->time, sizeof(x->time));
+  k += sizeof(x->time);
 
-  uint32_t cpId = x->cpId;
-  for (shift = 24; shift >= 0; shift -= 8) {
-    buf[k] = (cpId >> shift) & 0xff;
-    k++;
-  }
+  memcpy(buf + k, &x->cpId, sizeof(x->cpId));
+  k += sizeof(x->cpId);
 
   if (flags.fields.isDataCentric) {
-    uint32_t metricId = x->metricId;
-    for (shift = 24; shift >= 0; shift -= 8) {
-      buf[k] = (metricId >> shift) & 0xff;
-      k++;
-    }
+    memcpy(buf + k, &x->metricId, sizeof(x->metricId));
+    k += sizeof(x->metricId);
   }
 
+  return k;
+}
+
+
+// Append the trace record to the outbuf.
+// Returns: HPCFMT_OK on success, else HPCFMT_ERR.
+int
+hpctrace_fmt_datum_outbuf(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
+			  hpcio_outbuf_t* outbuf)
+{
+  unsigned char buf[sizeof(hpctrace_fmt_datum_t)];
+  int k = hpctrace_fmt_datum_pack(buf, x, flags);
+
   if (hpcio_outbuf_write(outbuf, buf, k) != k) {
     return HPCFMT_ERR;
   }
@@ -943,10 +1535,11 @@ int
 hpctrace_fmt_datum_fwrite(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 			  FILE* outfs)
 {
-  HPCFMT_ThrowIfError(hpcfmt_int8_fwrite(x->time, outfs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->cpId, outfs));
-  if (flags.fields.isDataCentric) {
-    HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(x->metricId, outfs));
+  unsigned char buf[sizeof(hpctrace_fmt_datum_t)];
+  size_t k = hpctrace_fmt_datum_pack(buf, x, flags);
+
+  if (fwrite(buf, 1, k, outfs) != k) {
+    return HPCFMT_ERR;
   }
 
   return HPCFMT_OK;
@@ -978,8 +1571,6 @@ int
 hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
 {
   char tag[HPCMETRICDB_FMT_MagicLen + 1];
-  char version[HPCMETRICDB_FMT_VersionLen + 1];
-  char endian[HPCMETRICDB_FMT_EndianLen + 1];
 
   int nr = fread(tag, 1, HPCMETRICDB_FMT_MagicLen, infs);
   tag[HPCMETRICDB_FMT_MagicLen] = '\0';
@@ -991,20 +1582,22 @@ hpcmetricDB_fmt_hdr_fread(hpcmetricDB_fmt_hdr_t* hdr, FILE* infs)
     return HPCFMT_ERR;
   }
 
-  nr = fread(&version, 1, HPCMETRICDB_FMT_VersionLen, infs);
-  version[HPCMETRICDB_FMT_VersionLen] = '\0';
+  nr = fread(hdr->versionStr, 1, HPCMETRICDB_FMT_VersionLen, infs);
+  hdr->versionStr[HPCMETRICDB_FMT_VersionLen] = '\0';
   if (nr != HPCMETRICDB_FMT_VersionLen) {
     return HPCFMT_ERR;
   }
   hdr->version = atof(hdr->versionStr);
 
-  nr = fread(&endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
+  nr = fread(&hdr->endian, 1, HPCMETRICDB_FMT_EndianLen, infs);
   if (nr != HPCMETRICDB_FMT_EndianLen) {
     return HPCFMT_ERR;
   }
 
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numNodes), infs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fread(&(hdr->numMetrics), infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread_endian(&(hdr->numNodes),
+					       hdr->endian, infs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fread_endian(&(hdr->numMetrics),
+					       hdr->endian, infs));
 
   return HPCFMT_OK;
 }
@@ -1024,8 +1617,8 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   nw = fwrite(HPCMETRICDB_FMT_Endian,  1, HPCMETRICDB_FMT_EndianLen, outfs);
   if (nw != HPCMETRICDB_FMT_EndianLen) return HPCFMT_ERR;
 
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numNodes, outfs));
-  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite(hdr->numMetrics, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite_host(hdr->numNodes, outfs));
+  HPCFMT_ThrowIfError(hpcfmt_int4_fwrite_host(hdr->numMetrics, outfs));
 
   return HPCFMT_OK;
 }
@@ -1037,9 +1630,422 @@ hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs)
   fprintf(outfs, "%s\n", HPCMETRICDB_FMT_Magic);
   fprintf(outfs, "[hdr:...]\n");
 
+  fprintf(outfs, "(endian: %c)\n", hdr->endian);
+
   fprintf(outfs, "(num-nodes:   %u)\n", hdr->numNodes);
   fprintf(outfs, "(num-metrics: %u)\n", hdr->numMetrics);
 
   return HPCFMT_OK;
 }
 
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+// hdr plus numNodes and numMetrics
+#define HPCMETRICDB_FMT_HeaderLenX \
+  (HPCMETRICDB_FMT_MagicLenX + HPCMETRICDB_FMT_VersionLenX \
+   + HPCMETRICDB_FMT_EndianLenX)
+
+#define HPCMETRICDB_SparseHdrLen \
+  (HPCMETRICDB_FMT_HeaderLenX + 2 * sizeof(uint32_t))
+
+
+// Computes the section offsets of a sparse metric-db; returns the
+// offset of the footer.
+static uint64_t
+sparse_layout(hpcmetricDB_fmt_footer_t* ftr, uint32_t numMajor, uint64_t nnz)
+{
+  ftr->majorPtrOff = HPCMETRICDB_SparseHdrLen;
+  ftr->valuesOff   = ftr->majorPtrOff + (numMajor + 1) * sizeof(uint64_t);
+  ftr->minorIdsOff = ftr->valuesOff + nnz * sizeof(double);
+  ftr->majorIdsOff = ftr->minorIdsOff + nnz * sizeof(uint32_t);
+  ftr->nnz         = nnz;
+  ftr->numMajor    = numMajor;
+
+  uint64_t end = ftr->majorIdsOff + numMajor * sizeof(uint32_t);
+  return (end + 7) & ~((uint64_t) 7);
+}
+
+
+uint64_t
+hpcmetricDB_fmt_sparse_size(uint32_t numMajor, uint64_t nnz)
+{
+  hpcmetricDB_fmt_footer_t ftr;
+  return sparse_layout(&ftr, numMajor, nnz) + sizeof(ftr);
+}
+
+
+int
+hpcmetricDB_fmt_sparse_write(int fd, uint64_t off,
+			     const hpcmetricDB_fmt_hdr_t* hdr,
+			     uint32_t layout, uint32_t numMajor,
+			     const uint32_t* majorIds, const uint64_t* majorPtr,
+			     const uint32_t* minorIds, const double* values)
+{
+  static const char pad[8] = { 0 };
+  uint64_t nnz = majorPtr[numMajor];
+
+  // ------------------------------------------------------------
+  // hdr
+  // ------------------------------------------------------------
+  char buf[HPCMETRICDB_SparseHdrLen];
+  char* p = buf;
+  memcpy(p, HPCMETRICDB_FMT_Magic, HPCMETRICDB_FMT_MagicLen);
+  p += HPCMETRICDB_FMT_MagicLen;
+  memcpy(p, HPCMETRICDB_FMT_VersionSparse, HPCMETRICDB_FMT_VersionLen);
+  p += HPCMETRICDB_FMT_VersionLen;
+  memcpy(p, HPCMETRICDB_FMT_Endian, HPCMETRICDB_FMT_EndianLen);
+  p += HPCMETRICDB_FMT_EndianLen;
+  memcpy(p, &hdr->numNodes, sizeof(uint32_t));
+  p += sizeof(uint32_t);
+  memcpy(p, &hdr->numMetrics, sizeof(uint32_t));
+
+  // ------------------------------------------------------------
+  // sections and footer
+  // ------------------------------------------------------------
+  hpcmetricDB_fmt_footer_t ftr;
+  memset(&ftr, 0, sizeof(ftr));
+  uint64_t ftrOff = sparse_layout(&ftr, numMajor, nnz);
+  ftr.layout = layout;
+  memcpy(ftr.magic, HPCMETRICDB_FMT_FooterMagic, sizeof(ftr.magic));
+
+  uint64_t end = ftr.majorIdsOff + numMajor * sizeof(uint32_t);
+
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, buf, sizeof(buf), off));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, majorPtr,
+				    (numMajor + 1) * sizeof(uint64_t),
+				    off + ftr.majorPtrOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, values, nnz * sizeof(double),
+				    off + ftr.valuesOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, minorIds, nnz * sizeof(uint32_t),
+				    off + ftr.minorIdsOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, majorIds,
+				    numMajor * sizeof(uint32_t),
+				    off + ftr.majorIdsOff));
+  if (ftrOff > end) {
+    HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, pad, ftrOff - end, off + end));
+  }
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, &ftr, sizeof(ftr), off + ftrOff));
+
+  return HPCFMT_OK;
+}
+
+
+static inline uint32_t
+sparse_ld4(const hpcmetricDB_sparse_t* db, uint64_t off)
+{
+  return hpcio_ld4_endian(db->map.beg + off, db->hdr.endian);
+}
+
+
+static inline uint64_t
+sparse_ld8(const hpcmetricDB_sparse_t* db, uint64_t off)
+{
+  return hpcio_ld8_endian(db->map.beg + off, db->hdr.endian);
+}
+
+
+// Validates the sparse metric-db spanned by db->map and reads its
+// header and footer.
+static int
+sparse_init(hpcmetricDB_sparse_t* db)
+{
+  size_t sz = hpcio_map_avail(&db->map);
+  const uint8_t* p = db->map.beg;
+  hpcmetricDB_fmt_footer_t* ftr = &db->footer;
+
+  if (sz < HPCMETRICDB_SparseHdrLen + sizeof(*ftr)
+      || memcmp(p, HPCMETRICDB_FMT_Magic, HPCMETRICDB_FMT_MagicLen) != 0) {
+    return HPCFMT_ERR;
+  }
+  p += HPCMETRICDB_FMT_MagicLen;
+  memcpy(db->hdr.versionStr, p, HPCMETRICDB_FMT_VersionLen);
+  db->hdr.versionStr[HPCMETRICDB_FMT_VersionLen] = '\0';
+  db->hdr.version = atof(db->hdr.versionStr);
+  if (db->hdr.version < 2.0) {
+    return HPCFMT_ERR;
+  }
+  p += HPCMETRICDB_FMT_VersionLen;
+  db->hdr.endian = *p;
+
+  db->hdr.numNodes = sparse_ld4(db, HPCMETRICDB_FMT_HeaderLenX);
+  db->hdr.numMetrics = sparse_ld4(db, HPCMETRICDB_FMT_HeaderLenX + 4);
+
+  uint64_t off = sz - sizeof(*ftr);
+  ftr->majorPtrOff = sparse_ld8(db, off);
+  ftr->valuesOff   = sparse_ld8(db, off + 8);
+  ftr->minorIdsOff = sparse_ld8(db, off + 16);
+  ftr->majorIdsOff = sparse_ld8(db, off + 24);
+  ftr->nnz         = sparse_ld8(db, off + 32);
+  ftr->numMajor    = sparse_ld4(db, off + 40);
+  ftr->layout      = sparse_ld4(db, off + 44);
+  memcpy(ftr->magic, db->map.beg + off + 48, sizeof(ftr->magic));
+
+  if (memcmp(ftr->magic, HPCMETRICDB_FMT_FooterMagic, sizeof(ftr->magic)) != 0
+      || (ftr->layout != HPCMETRICDB_LAYOUT_Node
+	  && ftr->layout != HPCMETRICDB_LAYOUT_Metric)
+      || ftr->majorPtrOff + (ftr->numMajor + 1) * sizeof(uint64_t) > off
+      || ftr->valuesOff + ftr->nnz * sizeof(double) > off
+      || ftr->minorIdsOff + ftr->nnz * sizeof(uint32_t) > off
+      || ftr->majorIdsOff + ftr->numMajor * sizeof(uint32_t) > off) {
+    return HPCFMT_ERR;
+  }
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_open(hpcmetricDB_sparse_t* db, FILE* fs)
+{
+  memset(db, 0, sizeof(*db));
+
+  if (hpcio_map_fs(&db->map, fs) != 0) {
+    return HPCFMT_ERR;
+  }
+  db->isMapOwner = true;
+
+  if (sparse_init(db) != HPCFMT_OK) {
+    hpcmetricDB_sparse_close(db);
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
+
+void
+hpcmetricDB_sparse_close(hpcmetricDB_sparse_t* db)
+{
+  if (db->isMapOwner) {
+    hpcio_unmap(&db->map);
+  }
+  memset(&db->map, 0, sizeof(db->map));
+}
+
+
+// first index in [lo, hi) of the uint32_t array at 'off' whose value
+// is >= key
+static uint64_t
+sparse_lower_bound(const hpcmetricDB_sparse_t* db, uint64_t off,
+		   uint64_t lo, uint64_t hi, uint32_t key)
+{
+  while (lo < hi) {
+    uint64_t mid = lo + (hi - lo) / 2;
+    if (sparse_ld4(db, off + mid * sizeof(uint32_t)) < key) {
+      lo = mid + 1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+
+uint64_t
+hpcmetricDB_sparse_query(const hpcmetricDB_sparse_t* db,
+			 uint32_t nodeBeg, uint32_t nodeEnd,
+			 uint32_t mBeg, uint32_t mEnd, double* vals)
+{
+  const hpcmetricDB_fmt_footer_t* ftr = &db->footer;
+  bool byNode = (ftr->layout == HPCMETRICDB_LAYOUT_Node);
+
+  uint32_t majBeg = (byNode) ? nodeBeg : mBeg;
+  uint32_t majEnd = (byNode) ? nodeEnd : mEnd;
+  uint32_t minBeg = (byNode) ? mBeg : nodeBeg;
+  uint32_t minEnd = (byNode) ? mEnd : nodeEnd;
+
+  uint32_t numCols = mEnd - mBeg;
+  uint64_t numFound = 0;
+
+  memset(vals, 0, (size_t)(nodeEnd - nodeBeg) * numCols * sizeof(double));
+
+  uint64_t i = sparse_lower_bound(db, ftr->majorIdsOff, 0, ftr->numMajor,
+				  majBeg);
+  for ( ; i < ftr->numMajor; ++i) {
+    uint32_t maj = sparse_ld4(db, ftr->majorIdsOff + i * sizeof(uint32_t));
+    if (maj >= majEnd) {
+      break;
+    }
+    uint64_t beg = sparse_ld8(db, ftr->majorPtrOff + i * sizeof(uint64_t));
+    uint64_t end = sparse_ld8(db, ftr->majorPtrOff + (i+1) * sizeof(uint64_t));
+    if (end > ftr->nnz) {
+      break; // corrupt
+    }
+
+    uint64_t k = sparse_lower_bound(db, ftr->minorIdsOff, beg, end, minBeg);
+    for ( ; k < end; ++k) {
+      uint32_t min = sparse_ld4(db, ftr->minorIdsOff + k * sizeof(uint32_t));
+      if (min >= minEnd) {
+	break;
+      }
+      uint32_t node   = (byNode) ? maj : min;
+      uint32_t metric = (byNode) ? min : maj;
+
+      hpcfmt_byte8_union_t v;
+      v.i8 = sparse_ld8(db, ftr->valuesOff + k * sizeof(double));
+      vals[(size_t)(node - nodeBeg) * numCols + (metric - mBeg)] = v.r8;
+      numFound++;
+    }
+  }
+
+  return numFound;
+}
+
+
+//***************************************************************************
+// [hpcprof-metricdb] set
+//***************************************************************************
+
+int
+hpcmetricDB_set_hdr_write(int fd)
+{
+  char buf[HPCMETRICDB_SET_FMT_HeaderLen];
+  memset(buf, 0, sizeof(buf));
+
+  char* p = buf;
+  memcpy(p, HPCMETRICDB_SET_FMT_Magic, sizeof(HPCMETRICDB_SET_FMT_Magic) - 1);
+  p += sizeof(HPCMETRICDB_SET_FMT_Magic) - 1;
+  memcpy(p, HPCMETRICDB_SET_FMT_Version,
+	 sizeof(HPCMETRICDB_SET_FMT_Version) - 1);
+  p += sizeof(HPCMETRICDB_SET_FMT_Version) - 1;
+  *p = HPCIO_HostEndian;
+
+  return hpcfmt_pwrite(fd, buf, sizeof(buf), 0);
+}
+
+
+int
+hpcmetricDB_set_index_write(int fd, uint64_t off,
+			    const hpcmetricDB_set_entry_t* entries,
+			    uint64_t numEntries,
+			    const char* names, uint64_t namesLen)
+{
+  static const char pad[8] = { 0 };
+
+  hpcmetricDB_set_footer_t ftr;
+  memset(&ftr, 0, sizeof(ftr));
+  ftr.indexOff   = off;
+  ftr.namesOff   = off + numEntries * sizeof(hpcmetricDB_set_entry_t);
+  ftr.numEntries = numEntries;
+  memcpy(ftr.magic, HPCMETRICDB_SET_FMT_FooterMagic, sizeof(ftr.magic));
+
+  uint64_t end = ftr.namesOff + namesLen;
+  uint64_t ftrOff = (end + 7) & ~((uint64_t) 7);
+
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, entries,
+				    numEntries * sizeof(*entries),
+				    ftr.indexOff));
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, names, namesLen, ftr.namesOff));
+  if (ftrOff > end) {
+    HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, pad, ftrOff - end, end));
+  }
+  HPCFMT_ThrowIfError(hpcfmt_pwrite(fd, &ftr, sizeof(ftr), ftrOff));
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_set_open(hpcmetricDB_set_t* set, FILE* fs)
+{
+  memset(set, 0, sizeof(*set));
+
+  if (hpcio_map_fs(&set->map, fs) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  size_t sz = hpcio_map_avail(&set->map);
+  const uint8_t* beg = set->map.beg;
+  hpcmetricDB_set_footer_t* ftr = &set->footer;
+
+  const size_t magicLen = sizeof(HPCMETRICDB_SET_FMT_Magic) - 1;
+  const size_t versionLen = sizeof(HPCMETRICDB_SET_FMT_Version) - 1;
+
+  if (sz < HPCMETRICDB_SET_FMT_HeaderLen + sizeof(*ftr)
+      || memcmp(beg, HPCMETRICDB_SET_FMT_Magic, magicLen) != 0) {
+    goto bad;
+  }
+  set->endian = beg[magicLen + versionLen];
+
+  uint64_t off = sz - sizeof(*ftr);
+  ftr->indexOff   = hpcio_ld8_endian(beg + off, set->endian);
+  ftr->namesOff   = hpcio_ld8_endian(beg + off + 8, set->endian);
+  ftr->numEntries = hpcio_ld8_endian(beg + off + 16, set->endian);
+  memcpy(ftr->magic, beg + off + 24, sizeof(ftr->magic));
+
+  if (memcmp(ftr->magic, HPCMETRICDB_SET_FMT_FooterMagic,
+	     sizeof(ftr->magic)) != 0
+      || ftr->namesOff > off
+      || ftr->indexOff + ftr->numEntries * sizeof(hpcmetricDB_set_entry_t)
+         > ftr->namesOff) {
+    goto bad;
+  }
+
+  return HPCFMT_OK;
+
+ bad:
+  hpcmetricDB_set_close(set);
+  return HPCFMT_ERR;
+}
+
+
+void
+hpcmetricDB_set_close(hpcmetricDB_set_t* set)
+{
+  hpcio_unmap(&set->map);
+}
+
+
+int
+hpcmetricDB_set_entry(const hpcmetricDB_set_t* set, uint64_t i,
+		      hpcmetricDB_set_entry_t* entry, const char** name)
+{
+  const hpcmetricDB_set_footer_t* ftr = &set->footer;
+  if (i >= ftr->numEntries) {
+    return HPCFMT_ERR;
+  }
+
+  const uint8_t* p =
+    set->map.beg + ftr->indexOff + i * sizeof(hpcmetricDB_set_entry_t);
+  entry->off     = hpcio_ld8_endian(p, set->endian);
+  entry->len     = hpcio_ld8_endian(p + 8, set->endian);
+  entry->nameOff = hpcio_ld8_endian(p + 16, set->endian);
+  entry->nameLen = hpcio_ld4_endian(p + 24, set->endian);
+  entry->groupId = hpcio_ld4_endian(p + 28, set->endian);
+
+  size_t sz = hpcio_map_avail(&set->map);
+  if (entry->off + entry->len > ftr->indexOff
+      || ftr->namesOff + entry->nameOff + entry->nameLen > sz) {
+    return HPCFMT_ERR;
+  }
+  *name = (const char*)(set->map.beg + ftr->namesOff + entry->nameOff);
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcmetricDB_sparse_open_set(hpcmetricDB_sparse_t* db,
+			    const hpcmetricDB_set_t* set, uint64_t i)
+{
+  hpcmetricDB_set_entry_t entry;
+  const char* name;
+
+  memset(db, 0, sizeof(*db));
+  HPCFMT_ThrowIfError(hpcmetricDB_set_entry(set, i, &entry, &name));
+
+  db->map.beg = set->map.beg + entry.off;
+  db->map.cur = db->map.beg;
+  db->map.end = db->map.beg + entry.len;
+  db->isMapOwner = false;
+
+  if (sparse_init(db) != HPCFMT_OK) {
+    memset(&db->map, 0, sizeof(db->map));
+    return HPCFMT_ERR;
+  }
+  return HPCFMT_OK;
+}
+
@@ -98,6 +98,9 @@ static const char HPCRUN_TraceFnmSfx[] = "hpctrace";
 // hpcrun log filename suffix
 static const char HPCRUN_LogFnmSfx[] = "log";
 
+// hpcrun dictionary filename suffix
+static const char HPCRUN_DictFnmSfx[] = "hpcdict";
+
 // hpcprof metric db filename suffix
 static const char HPCPROF_MetricDBSfx[] = "metric-db";
 
@@ -111,7 +114,7 @@ static const char HPCPROF_TmpFnmSfx[] = "tmp";
 // N.B.: The header string is 24 bytes of character data
 
 static const char HPCRUN_FMT_Magic[]   = "HPCRUN-profile____"; // 18 bytes
-static const char HPCRUN_FMT_Version[] = "02.00";              // 5 bytes
+static const char HPCRUN_FMT_Version[] = "02.02";              // 5 bytes
 static const char HPCRUN_FMT_Endian[]  = "b";                  // 1 byte
 
 static const int HPCRUN_FMT_MagicLen   = (sizeof(HPCRUN_FMT_Magic) - 1);
@@ -121,6 +124,8 @@ static const int HPCRUN_FMT_EndianLen  = (sizeof(HPCRUN_FMT_Endian) - 1);
 
 // currently supported versions
 static const double HPCRUN_FMT_Version_20 = 2.0;
+static const double HPCRUN_FMT_Version_201 = 2.01; // adds cct-idx and toc
+static const double HPCRUN_FMT_Version_202 = 2.02; // adds dictionary
 
 
 typedef struct hpcrun_fmt_hdr_t {
@@ -162,6 +167,18 @@ hpcrun_fmt_hdr_free(hpcrun_fmt_hdr_t* hdr, hpcfmt_free_fn dealloc);
 #define HPCRUN_FMT_NV_traceMinTime "trace-min-time"
 #define HPCRUN_FMT_NV_traceMaxTime "trace-max-time"
 
+// number of threads whose profiles were merged into this file
+#define HPCRUN_FMT_NV_numThreads "num-threads"
+
+// time window (microseconds since the epoch) covered by a rotated
+// profile written in continuous-profiling mode
+#define HPCRUN_FMT_NV_windowBegin "window-begin"
+#define HPCRUN_FMT_NV_windowEnd   "window-end"
+
+// name of the dictionary file (in the profile's directory) that holds
+// the metric descriptors, load modules and program nv-pairs
+#define HPCRUN_FMT_NV_dict "dictionary"
+
 
 //***************************************************************************
 // epoch-hdr
@@ -555,6 +572,13 @@ extern int
 hpcrun_fmt_cct_node_fread(hpcrun_fmt_cct_node_t* x,
 			  epoch_flags_t flags, FILE* fs);
 
+// hpcrun_fmt_cct_node_mread: Like hpcrun_fmt_cct_node_fread, but
+// decodes the whole record in place from a memory-mapped file.
+// N.B.: assumes space for metrics has been allocated
+extern int
+hpcrun_fmt_cct_node_mread(hpcrun_fmt_cct_node_t* x,
+			  epoch_flags_t flags, hpcio_map_t* map);
+
 extern int
 hpcrun_fmt_cct_node_fwrite(hpcrun_fmt_cct_node_t* x,
 			   epoch_flags_t flags, FILE* fs);
@@ -579,6 +603,190 @@ extern int
 hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 
 
+// --------------------------------------------------------------------------
+// 
+// --------------------------------------------------------------------------
+
+// hpcrun_fmt_cct_node_size: the size in bytes of a CCT node in an
+// epoch with 'flags' and 'numMetrics' metrics.  All nodes of an epoch
+// have the same size.
+extern uint32_t
+hpcrun_fmt_cct_node_size(epoch_flags_t flags, uint32_t numMetrics);
+
+
+//***************************************************************************
+// cct-idx and toc (version 02.01)
+//***************************************************************************
+
+// Version 02.01 adds two kinds of sections so that readers can reach
+// the parts of a file without parsing it front to back:
+//
+// - cct-idx: follows each epoch's CCT.  The tag, the number of
+//   entries (8 bytes) and one 8-byte entry per CCT node, sorted:
+//     (node-id << 32) | position of the node in the CCT
+//   where node-id is the absolute value of the node's id.
+//
+// - toc: follows the last epoch.  The tag, the number of epochs (4
+//   bytes) and one hpcrun_fmt_tocEntry_t per epoch.  The file ends
+//   with the toc footer: the offset of the toc (8 bytes) and
+//   HPCRUN_FMT_TocMagic.
+//
+// A sequential reader skips cct-idx sections and stops at the toc
+// (see hpcrun_fmt_epochHdr_fread).  Offsets are from the start of the
+// file; all values are big-endian.
+
+static const char HPCRUN_FMT_CCTIdxTag[] = "CCT-IDX_";
+static const char HPCRUN_FMT_TocTag[]    = "TOC_____";
+static const char HPCRUN_FMT_TocMagic[]  = "HPCRUNTC"; // 8 bytes
+
+#define HPCRUN_FMT_TocFtrLen 16
+
+typedef struct hpcrun_fmt_tocEntry_t {
+  uint64_t epochOff;
+  uint64_t metricTblOff;
+  uint64_t loadmapOff;
+  uint64_t cctOff;      // the CCT's node count
+  uint64_t cctIdxOff;
+  uint64_t numNodes;
+  uint32_t numMetrics;
+  uint32_t nodeSz;      // cf. hpcrun_fmt_cct_node_size()
+} hpcrun_fmt_tocEntry_t;
+
+HPCFMT_List_declare(hpcrun_fmt_tocEntry_t);
+typedef HPCFMT_List(hpcrun_fmt_tocEntry_t) hpcrun_fmt_toc_t;
+
+
+// hpcrun_fmt_cctIdx_fwrite: writes a cct-idx section; 'idx' holds
+// 'n' sorted entries.
+extern int
+hpcrun_fmt_cctIdx_fwrite(const uint64_t* idx, uint64_t n, FILE* fs);
+
+// Writes a toc: hdr, 'numEpochs' entries and then the footer, where
+// 'tocOff' is the offset of the toc hdr.
+extern int
+hpcrun_fmt_tocHdr_fwrite(uint32_t numEpochs, FILE* fs);
+
+extern int
+hpcrun_fmt_tocEntry_fwrite(const hpcrun_fmt_tocEntry_t* x, FILE* fs);
+
+extern int
+hpcrun_fmt_tocFtr_fwrite(uint64_t tocOff, FILE* fs);
+
+// hpcrun_fmt_toc_fread: reads the toc of the (seekable) file 'fs'
+// and restores the file position.  Returns HPCFMT_ERR if the file
+// has no toc.
+extern int
+hpcrun_fmt_toc_fread(hpcrun_fmt_toc_t* toc, FILE* fs, hpcfmt_alloc_fn alloc);
+
+extern int
+hpcrun_fmt_toc_fprint(hpcrun_fmt_toc_t* toc, FILE* fs);
+
+extern void
+hpcrun_fmt_toc_free(hpcrun_fmt_toc_t* toc, hpcfmt_free_fn dealloc);
+
+// hpcrun_fmt_cct_node_fseek: positions 'fs' at the CCT node with
+// (absolute) id 'id' of epoch 'x' so that hpcrun_fmt_cct_node_fread
+// reads it.  Returns HPCFMT_ERR if there is no such node.
+extern int
+hpcrun_fmt_cct_node_fseek(const hpcrun_fmt_tocEntry_t* x, uint32_t id,
+			  FILE* fs);
+
+// hpcrun_fmt_cct_metric_fread: reads metric 'metricId' of every CCT
+// node of epoch 'x', in CCT order, into 'vals' (of length
+// x->numNodes), without decoding the rest of the nodes.
+extern int
+hpcrun_fmt_cct_metric_fread(const hpcrun_fmt_tocEntry_t* x,
+			    uint32_t metricId, hpcrun_metricVal_t* vals,
+			    FILE* fs);
+
+
+//***************************************************************************
+// dictionary (version 02.02)
+//***************************************************************************
+
+// The metric descriptors, load module names and program nv-pairs are
+// the same in all profiles of a process.  hpcrun writes them once, to
+// the process's dictionary, and a profile whose file-hdr names a
+// dictionary (HPCRUN_FMT_NV_dict) refers to them by id:
+//
+// - metric-tbl: the number of metrics (4 bytes) and, per metric, only
+//   its aux info (is-multiplexed, period-mean, num-samples).  Metric
+//   i is the dictionary's metric i.
+//
+// - loadmap: the number of entries (4 bytes) and one load module id
+//   (2 bytes) per entry.
+//
+// - the file-hdr omits the nv-pairs in the dictionary's hdr.
+//
+// The dictionary is its hdr (as the file-hdr, with its own magic and
+// version) followed by records appended as profiles need them: a
+// 1-byte kind and
+//   HPCRUN_FMT_DictMetric: metric id (4 bytes) and metric descriptor
+//                          without aux info
+//   HPCRUN_FMT_DictLM:     loadmap entry
+// up to the end of the file.
+
+static const char HPCRUN_FMT_DictMagic[]   = "HPCRUN-dictionary_"; // 18 bytes
+static const char HPCRUN_FMT_DictVersion[] = "01.00";              // 5 bytes
+
+#define HPCRUN_FMT_DictMetric 'm'
+#define HPCRUN_FMT_DictLM     'l'
+
+typedef struct hpcrun_fmt_dict_t {
+
+  char versionStr[sizeof(HPCRUN_FMT_DictVersion)];
+  double version;
+
+  char endian;
+
+  HPCFMT_List(hpcfmt_nvpair_t) nvps;
+
+  // indexed by id; an entry with a NULL name is not (yet) defined
+  metric_tbl_t metricTbl;
+  loadmap_t loadmap;
+
+} hpcrun_fmt_dict_t;
+
+
+// Writes the dictionary's hdr: a NULL-terminated list of nv-pairs.
+extern int
+hpcrun_fmt_dictHdr_fwrite(FILE* fs, ...);
+
+extern int
+hpcrun_fmt_dictMetric_fwrite(uint32_t id, metric_desc_t* x, FILE* fs);
+
+extern int
+hpcrun_fmt_dictLM_fwrite(loadmap_entry_t* x, FILE* fs);
+
+// hpcrun_fmt_dict_fread: reads a whole dictionary (malloc'd; free
+// with hpcrun_fmt_dict_free).
+extern int
+hpcrun_fmt_dict_fread(hpcrun_fmt_dict_t* dict, FILE* fs);
+
+extern int
+hpcrun_fmt_dict_fprint(hpcrun_fmt_dict_t* dict, FILE* fs);
+
+extern void
+hpcrun_fmt_dict_free(hpcrun_fmt_dict_t* dict);
+
+
+// The metric-tbl and loadmap of a profile with a dictionary.  The
+// tables read borrow the descriptors and names of 'dict': free the
+// loadmap's 'lst' (only) with 'dealloc' and the metric-tbl not at all.
+extern int
+hpcrun_fmt_metricTblRef_fread(metric_tbl_t* metric_tbl,
+			      metric_aux_info_t **aux_info,
+			      const hpcrun_fmt_dict_t* dict, FILE* fs);
+
+extern int
+hpcrun_fmt_metricTblRef_fwrite(uint32_t len, metric_aux_info_t *aux_info,
+			       FILE* fs);
+
+extern int
+hpcrun_fmt_loadmapRef_fread(loadmap_t* loadmap, const hpcrun_fmt_dict_t* dict,
+			    FILE* fs, hpcfmt_alloc_fn alloc);
+
+
 //***************************************************************************
 // hpctrace (located here for now)
 //***************************************************************************
@@ -593,7 +801,11 @@ hpcrun_fmt_lip_fprint(lush_lip_t* x, FILE* fs, const char* pre);
 
 static const char HPCTRACE_FMT_Magic[]   = "HPCRUN-trace______"; // 18 bytes
 static const char HPCTRACE_FMT_Version[] = "01.01";              // 5 bytes
-static const char HPCTRACE_FMT_Endian[]  = "b";                  // 1 byte
+static const char HPCTRACE_FMT_Endian[]  = { HPCIO_HostEndian, '\0' }; // 1 byte
+
+// Writers emit header fields after the endian byte and all trace
+// records in host byte order and record that order in the endian
+// byte; readers handle either order.
 
 
 typedef struct hpctrace_hdr_flags_bitfield {
@@ -666,9 +878,10 @@ typedef struct hpctrace_fmt_datum_t {
 } hpctrace_fmt_datum_t;
 
 
+// N.B.: the byte order and flags of the records are those of 'hdr'
 int
-hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
-			 FILE* fs);
+hpctrace_fmt_datum_fread(hpctrace_fmt_datum_t* x,
+			 const hpctrace_fmt_hdr_t* hdr, FILE* fs);
 
 int
 hpctrace_fmt_datum_outbuf(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
@@ -694,7 +907,12 @@ hpctrace_fmt_datum_fprint(hpctrace_fmt_datum_t* x, hpctrace_hdr_flags_t flags,
 
 static const char HPCMETRICDB_FMT_Magic[]   = "HPCPROF-metricdb__"; // 18 bytes
 static const char HPCMETRICDB_FMT_Version[] = "00.10";              // 5 bytes
-static const char HPCMETRICDB_FMT_Endian[]  = "b";                  // 1 byte
+static const char HPCMETRICDB_FMT_Endian[]  = { HPCIO_HostEndian, '\0' }; // 1 byte
+
+// As with hpctrace, the header fields after the endian byte and the
+// metric values are in the byte order named by the endian byte.
+// Writers use host order, so readers on a matching host can use the
+// values as they are.
 
 #define HPCMETRICDB_FMT_MagicLenX   (sizeof(HPCMETRICDB_FMT_Magic) - 1)
 #define HPCMETRICDB_FMT_VersionLenX (sizeof(HPCMETRICDB_FMT_Version) - 1)
@@ -731,12 +949,200 @@ hpcmetricDB_fmt_hdr_fwrite(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 int
 hpcmetricDB_fmt_hdr_fprint(hpcmetricDB_fmt_hdr_t* hdr, FILE* outfs);
 
+
+//***************************************************************************
+// [hpcprof-metricdb] sparse format
+//***************************************************************************
+
+// Version 02.00 stores only the nonzero values of a thread in
+// compressed sparse form:
+//
+//   hdr:      as above plus numNodes and numMetrics (32 bytes)
+//   majorPtr: (numMajor + 1) x uint64_t; the entries of major i are
+//             [majorPtr[i], majorPtr[i+1])
+//   values:   nnz x double
+//   minorIds: nnz x uint32_t, ascending within each major
+//   majorIds: numMajor x uint32_t, ascending
+//   (padding to 8 bytes)
+//   footer:   hpcmetricDB_fmt_footer_t
+//
+// With HPCMETRICDB_LAYOUT_Node the majors are CCT node ids and the
+// minors are metric ids (CSR); with HPCMETRICDB_LAYOUT_Metric it is
+// the reverse (CSC).  Node ids are as in the dense format (first node
+// is 1) and metric ids are relative to the thread's first metric.
+// Only nodes (resp. metrics) with a nonzero value appear in majorIds.
+// The footer at the end of the file locates every section, so a
+// reader can find any (node, metric) range with two binary searches.
+// All integers are in the byte order of the endian byte.
+
+static const char HPCMETRICDB_FMT_VersionSparse[] = "02.00";     // 5 bytes
+
+static const char HPCMETRICDB_FMT_FooterMagic[] = "HPCSPMDB";    // 8 bytes
+
+enum {
+  HPCMETRICDB_LAYOUT_Node   = 1,
+  HPCMETRICDB_LAYOUT_Metric = 2
+};
+
+typedef struct hpcmetricDB_fmt_footer_t {
+
+  uint64_t majorPtrOff;
+  uint64_t valuesOff;
+  uint64_t minorIdsOff;
+  uint64_t majorIdsOff;
+  uint64_t nnz;
+  uint32_t numMajor;
+  uint32_t layout;
+  char magic[sizeof(HPCMETRICDB_FMT_FooterMagic) - 1];
+
+} hpcmetricDB_fmt_footer_t;
+
+
+// Returns the size in bytes (a multiple of 8) of a sparse metric-db
+// with 'numMajor' majors and 'nnz' nonzeros.
+uint64_t
+hpcmetricDB_fmt_sparse_size(uint32_t numMajor, uint64_t nnz);
+
+// Writes a sparse metric-db to 'fd' at offset 'off' (host byte order)
+// with one pwrite per section.  'hdr' supplies numNodes and
+// numMetrics; 'majorPtr' has numMajor + 1 entries and
+// majorPtr[numMajor] is the number of nonzeros.  Offsets within the
+// footer are relative to 'off'.
+int
+hpcmetricDB_fmt_sparse_write(int fd, uint64_t off,
+			     const hpcmetricDB_fmt_hdr_t* hdr,
+			     uint32_t layout, uint32_t numMajor,
+			     const uint32_t* majorIds, const uint64_t* majorPtr,
+			     const uint32_t* minorIds, const double* values);
+
+
+// A sparse metric-db opened for queries.  The file is mapped; in the
+// common case of a host byte order file, values are used in place.
+// 'map' spans exactly the metric-db, which may be one section of a
+// metric-db set (see below), in which case the set owns the mapping.
+typedef struct hpcmetricDB_sparse_t {
+
+  hpcmetricDB_fmt_hdr_t hdr;
+  hpcmetricDB_fmt_footer_t footer;
+  hpcio_map_t map;
+  bool isMapOwner;
+
+} hpcmetricDB_sparse_t;
+
+
+// Maps the metric-db underlying 'fs' and validates its header and
+// footer.  Returns HPCFMT_OK or HPCFMT_ERR (e.g., for a dense
+// metric-db).
+int
+hpcmetricDB_sparse_open(hpcmetricDB_sparse_t* db, FILE* fs);
+
+void
+hpcmetricDB_sparse_close(hpcmetricDB_sparse_t* db);
+
+// Stores the values of nodes [nodeBeg, nodeEnd) and metrics [mBeg,
+// mEnd) in 'vals' as a dense, node-major matrix with zeros for absent
+// entries.  Returns the number of nonzeros found.
+uint64_t
+hpcmetricDB_sparse_query(const hpcmetricDB_sparse_t* db,
+			 uint32_t nodeBeg, uint32_t nodeEnd,
+			 uint32_t mBeg, uint32_t mEnd, double* vals);
+
+
+//***************************************************************************
+// [hpcprof-metricdb] set: all thread-level metric-dbs in one file
+//***************************************************************************
+
+// Instead of one metric-db per profile, hpcprof-mpi may write a single
+// file holding the sparse metric-db of every profile:
+//
+//   hdr:      magic, version, endian (padded to 24 bytes)
+//   sections: one sparse metric-db per profile, each 8-byte aligned
+//   index:    numEntries x hpcmetricDB_set_entry_t
+//   names:    the concatenated entry names (no terminators)
+//   (padding to 8 bytes)
+//   footer:   hpcmetricDB_set_footer_t
+//
+// An entry's name is the basename of its profile without suffix, i.e.,
+// the name its per-profile metric-db would have had without the
+// "<group-id>." prefix and ".metric-db" suffix.  Entries are in the
+// canonical profile order.  All integers are in the byte order of the
+// endian byte.
+
+static const char HPCMETRICDB_SET_Fnm[] = "experiment.metric-dbs";
+
+static const char HPCMETRICDB_SET_FMT_Magic[]   = "HPCPROF-metricdbs_"; // 18
+static const char HPCMETRICDB_SET_FMT_Version[] = "01.00";              // 5
+static const char HPCMETRICDB_SET_FMT_FooterMagic[] = "HPCMDBIX";       // 8
+
+#define HPCMETRICDB_SET_FMT_HeaderLen 24
+
+typedef struct hpcmetricDB_set_entry_t {
+
+  uint64_t off;     // offset of the section
+  uint64_t len;     // length of the section
+  uint64_t nameOff; // offset of the name within 'names'
+  uint32_t nameLen;
+  uint32_t groupId;
+
+} hpcmetricDB_set_entry_t;
+
+typedef struct hpcmetricDB_set_footer_t {
+
+  uint64_t indexOff;
+  uint64_t namesOff;
+  uint64_t numEntries;
+  char magic[sizeof(HPCMETRICDB_SET_FMT_FooterMagic) - 1];
+
+} hpcmetricDB_set_footer_t;
+
+
+// Writes the header of a metric-db set to 'fd' (host byte order).
+int
+hpcmetricDB_set_hdr_write(int fd);
+
+// Writes index, names and footer at 'off' (host byte order).
+int
+hpcmetricDB_set_index_write(int fd, uint64_t off,
+			    const hpcmetricDB_set_entry_t* entries,
+			    uint64_t numEntries,
+			    const char* names, uint64_t namesLen);
+
+
+typedef struct hpcmetricDB_set_t {
+
+  char endian;
+  hpcmetricDB_set_footer_t footer;
+  hpcio_map_t map;
+
+} hpcmetricDB_set_t;
+
+
+// Maps the metric-db set underlying 'fs' and validates its header and
+// footer.  Returns HPCFMT_OK or HPCFMT_ERR.
+int
+hpcmetricDB_set_open(hpcmetricDB_set_t* set, FILE* fs);
+
+void
+hpcmetricDB_set_close(hpcmetricDB_set_t* set);
+
+// Reads entry 'i'; '*name' points into the mapped file and is not
+// terminated (use entry->nameLen).
+int
+hpcmetricDB_set_entry(const hpcmetricDB_set_t* set, uint64_t i,
+		      hpcmetricDB_set_entry_t* entry, const char** name);
+
+// Opens the section of entry 'i' for queries.  'db' remains valid
+// until 'set' is closed.
+int
+hpcmetricDB_sparse_open_set(hpcmetricDB_sparse_t* db,
+			    const hpcmetricDB_set_t* set, uint64_t i);
+
 // --------------------------------------------------------------------------
 // additional sampling info
 // --------------------------------------------------------------------------
 
 typedef struct sampling_info_s {
-  uint64_t  sample_clock;
+  uint64_t  sample_clock;  // trace time of the sample in usec (0: now)
   void     *sample_data;
 } sampling_info_t;
 
@@ -0,0 +1,214 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Low-level types and functions for the binary form of a program
+//   structure (hpcstruct) file.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************* System Include Files ****************************
+
+#include <stdio.h>
+#include <string.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcfmt.h"
+#include "hpcstruct-fmt.h"
+
+//***************************************************************************
+
+#define NODE_SIZE  48
+#define VMA_SIZE   16
+
+bool
+hpcstruct_fmt_isBinary(FILE* fs)
+{
+  char tag[HPCSTRUCT_FMT_MagicLen];
+
+  size_t nr = fread(tag, 1, HPCSTRUCT_FMT_MagicLen, fs);
+  rewind(fs);
+
+  return (nr == HPCSTRUCT_FMT_MagicLen
+	  && memcmp(tag, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) == 0);
+}
+
+
+int
+hpcstruct_fmt_open(hpcstruct_fmt_t* st, FILE* fs)
+{
+  const size_t ftrSz = 5 * sizeof(uint64_t) + sizeof(st->footer.magic);
+
+  memset(st, 0, sizeof(*st));
+
+  if (hpcio_map_fs(&st->map, fs) != 0) {
+    return HPCFMT_ERR;
+  }
+
+  const uint8_t* beg = st->map.beg;
+  uint64_t len = st->map.end - st->map.beg;
+
+  // -------------------------------------------------------
+  // header and footer
+  // -------------------------------------------------------
+  if (len < HPCSTRUCT_FMT_HeaderLen + ftrSz
+      || memcmp(beg, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen) != 0
+      || memcmp(beg + HPCSTRUCT_FMT_MagicLen, HPCSTRUCT_FMT_Version,
+		HPCSTRUCT_FMT_VersionLen) != 0) {
+    goto error;
+  }
+
+  st->endian = beg[HPCSTRUCT_FMT_MagicLen + HPCSTRUCT_FMT_VersionLen];
+  if (st->endian != 'l' && st->endian != 'b') {
+    goto error;
+  }
+
+  const uint8_t* p = st->map.end - ftrSz;
+  hpcstruct_fmt_footer_t* ftr = &st->footer;
+  ftr->numNodes = hpcio_ld8_endian(p, st->endian);
+  ftr->vmaOff   = hpcio_ld8_endian(p + 8, st->endian);
+  ftr->numVMAs  = hpcio_ld8_endian(p + 16, st->endian);
+  ftr->strOff   = hpcio_ld8_endian(p + 24, st->endian);
+  ftr->strSz    = hpcio_ld8_endian(p + 32, st->endian);
+  memcpy(ftr->magic, p + 40, sizeof(ftr->magic));
+
+  // sections must be in order and fit (guarding against overflow)
+  uint64_t dataEnd = len - ftrSz;
+  if (memcmp(ftr->magic, HPCSTRUCT_FMT_FooterMagic, sizeof(ftr->magic)) != 0
+      || ftr->numNodes > (dataEnd - HPCSTRUCT_FMT_HeaderLen) / NODE_SIZE
+      || ftr->vmaOff != HPCSTRUCT_FMT_HeaderLen + ftr->numNodes * NODE_SIZE
+      || ftr->numVMAs > (dataEnd - ftr->vmaOff) / VMA_SIZE
+      || ftr->strOff != ftr->vmaOff + ftr->numVMAs * VMA_SIZE
+      || ftr->strSz == 0 || ftr->strSz > dataEnd - ftr->strOff
+      || beg[ftr->strOff] != '\0'
+      || beg[ftr->strOff + ftr->strSz - 1] != '\0') {
+    goto error;
+  }
+
+  // -------------------------------------------------------
+  // nodes: kinds, parents, strings and VMA ranges
+  // -------------------------------------------------------
+  for (uint64_t i = 0; i < ftr->numNodes; ++i) {
+    hpcstruct_fmt_node_t x;
+    hpcstruct_fmt_node(st, i, &x); // 'i' is in range
+
+    bool isLM = (x.kind == HPCSTRUCT_FMT_LM);
+    if (x.kind < HPCSTRUCT_FMT_LM || x.kind > HPCSTRUCT_FMT_Stmt
+	|| (isLM != (x.parent == HPCSTRUCT_FMT_NoParent))
+	|| (!isLM && x.parent >= i)
+	|| x.name >= ftr->strSz || x.file >= ftr->strSz
+	|| x.linkName >= ftr->strSz
+	|| x.vmaIdx > ftr->numVMAs || x.numVMA > ftr->numVMAs - x.vmaIdx) {
+      goto error;
+    }
+  }
+
+  return HPCFMT_OK;
+
+ error:
+  hpcstruct_fmt_close(st);
+  return HPCFMT_ERR;
+}
+
+
+void
+hpcstruct_fmt_close(hpcstruct_fmt_t* st)
+{
+  hpcio_unmap(&st->map);
+}
+
+
+int
+hpcstruct_fmt_node(const hpcstruct_fmt_t* st, uint64_t i,
+		   hpcstruct_fmt_node_t* node)
+{
+  if (i >= st->footer.numNodes) {
+    return HPCFMT_ERR;
+  }
+
+  const uint8_t* p = st->map.beg + HPCSTRUCT_FMT_HeaderLen + i * NODE_SIZE;
+  char e = st->endian;
+
+  node->kind     = p[0];
+  node->parent   = hpcio_ld4_endian(p + 4, e);
+  node->id       = hpcio_ld4_endian(p + 8, e);
+  node->name     = hpcio_ld4_endian(p + 12, e);
+  node->file     = hpcio_ld4_endian(p + 16, e);
+  node->linkName = hpcio_ld4_endian(p + 20, e);
+  node->line     = hpcio_ld4_endian(p + 24, e);
+  node->numVMA   = hpcio_ld4_endian(p + 28, e);
+  node->procId   = hpcio_ld4_endian(p + 32, e);
+  node->vmaIdx   = hpcio_ld8_endian(p + 40, e);
+
+  return HPCFMT_OK;
+}
+
+
+int
+hpcstruct_fmt_vma(const hpcstruct_fmt_t* st, uint64_t i,
+		  uint64_t* beg, uint64_t* end)
+{
+  if (i >= st->footer.numVMAs) {
+    return HPCFMT_ERR;
+  }
+
+  const uint8_t* p = st->map.beg + st->footer.vmaOff + i * VMA_SIZE;
+
+  *beg = hpcio_ld8_endian(p, st->endian);
+  *end = hpcio_ld8_endian(p + 8, st->endian);
+
+  return HPCFMT_OK;
+}
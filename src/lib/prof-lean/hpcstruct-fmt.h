@@ -0,0 +1,223 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Low-level types and functions for the binary form of a program
+//   structure (hpcstruct) file.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+#ifndef prof_lean_hpcstruct_fmt_h
+#define prof_lean_hpcstruct_fmt_h
+
+//************************* System Include Files ****************************
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+//*************************** User Include Files ****************************
+
+#include "hpcio.h"
+#include "hpcfmt.h"
+
+//*************************** Forward Declarations **************************
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+//***************************************************************************
+
+// The binary form holds the same tree as the XML form (hpcstruct
+// --binary) but can be loaded without parsing:
+//
+//   hdr:     magic, version, endian (padded to 24 bytes)
+//   nodes:   numNodes x hpcstruct_fmt_node_t, in XML pre-order
+//   vmas:    numVMAs x { uint64_t beg, end }
+//   strings: strSz bytes of NUL-terminated strings; offset 0 is ""
+//   footer:  hpcstruct_fmt_footer_t
+//
+// A node's parent always precedes it; LMs have no parent.  Each node
+// owns 'numVMA' consecutive VMA intervals starting at 'vmaIdx'.
+// Writers use host order; all integers are in the byte order of the
+// endian byte.
+
+static const char HPCSTRUCT_FMT_Magic[]   = "HPCSTRUCT-binary"; // 16 bytes
+static const char HPCSTRUCT_FMT_Version[] = "01.01";            // 5 bytes
+
+#define HPCSTRUCT_FMT_MagicLen   (sizeof(HPCSTRUCT_FMT_Magic) - 1)
+#define HPCSTRUCT_FMT_VersionLen (sizeof(HPCSTRUCT_FMT_Version) - 1)
+#define HPCSTRUCT_FMT_HeaderLen  24
+
+static const char HPCSTRUCT_FMT_FooterMagic[] = "HPCSTRCT"; // 8 bytes
+
+#define HPCSTRUCT_FMT_NoParent  UINT32_MAX
+#define HPCSTRUCT_FMT_NoProc    0  // XML ids start at 1
+
+enum {
+  HPCSTRUCT_FMT_LM    = 1,
+  HPCSTRUCT_FMT_File  = 2,
+  HPCSTRUCT_FMT_Proc  = 3,
+  HPCSTRUCT_FMT_Alien = 4,
+  HPCSTRUCT_FMT_Loop  = 5,
+  HPCSTRUCT_FMT_Stmt  = 6
+};
+
+
+// One <LM>, <F>, <P>, <A>, <L> or <S> element.  'name', 'file' and
+// 'linkName' are offsets into the string table and correspond to the
+// XML attributes 'n', 'f' and (of a <P>) 'ln'; 'id' is the XML 'i'.
+// The 'ln' of an <A> is the id of a <P>, and is kept in 'procId'.
+typedef struct hpcstruct_fmt_node_t {
+
+  uint8_t  kind;
+  uint8_t  pad[3];
+  uint32_t parent;
+  uint32_t id;
+  uint32_t name;
+  uint32_t file;
+  uint32_t linkName;
+  uint32_t line;
+  uint32_t numVMA;
+  uint32_t procId;
+  uint32_t pad2;
+  uint64_t vmaIdx;
+
+} hpcstruct_fmt_node_t; // 48 bytes
+
+
+typedef struct hpcstruct_fmt_footer_t {
+
+  uint64_t numNodes;
+  uint64_t vmaOff;
+  uint64_t numVMAs;
+  uint64_t strOff;
+  uint64_t strSz;
+  char magic[sizeof(HPCSTRUCT_FMT_FooterMagic) - 1];
+
+} hpcstruct_fmt_footer_t; // 48 bytes
+
+
+// Fills 'hdr' with the header of a host order file.
+static inline void
+hpcstruct_fmt_hdr_init(char hdr[HPCSTRUCT_FMT_HeaderLen])
+{
+  memset(hdr, 0, HPCSTRUCT_FMT_HeaderLen);
+  memcpy(hdr, HPCSTRUCT_FMT_Magic, HPCSTRUCT_FMT_MagicLen);
+  memcpy(hdr + HPCSTRUCT_FMT_MagicLen, HPCSTRUCT_FMT_Version,
+	 HPCSTRUCT_FMT_VersionLen);
+  hdr[HPCSTRUCT_FMT_MagicLen + HPCSTRUCT_FMT_VersionLen] = HPCIO_HostEndian;
+}
+
+
+//***************************************************************************
+// reader
+//***************************************************************************
+
+// A binary structure file opened for loading.  The file is mapped and
+// validated by hpcstruct_fmt_open(); the accessors below still check
+// their index or offset, so that a caller need not trust the file.
+typedef struct hpcstruct_fmt_t {
+
+  char endian;
+  hpcstruct_fmt_footer_t footer;
+  hpcio_map_t map;
+
+} hpcstruct_fmt_t;
+
+
+// Returns true if 'fs' begins with the binary magic.  Leaves 'fs' at
+// its beginning.
+bool
+hpcstruct_fmt_isBinary(FILE* fs);
+
+// Maps 'fs' and validates the header, the footer and every node.
+// Returns HPCFMT_OK or HPCFMT_ERR.
+int
+hpcstruct_fmt_open(hpcstruct_fmt_t* st, FILE* fs);
+
+void
+hpcstruct_fmt_close(hpcstruct_fmt_t* st);
+
+
+// Both return HPCFMT_ERR if 'i' is out of range.
+int
+hpcstruct_fmt_node(const hpcstruct_fmt_t* st, uint64_t i,
+		   hpcstruct_fmt_node_t* node);
+
+int
+hpcstruct_fmt_vma(const hpcstruct_fmt_t* st, uint64_t i,
+		  uint64_t* beg, uint64_t* end);
+
+// Returns NULL if 'off' is outside the string table.  (The table ends
+// with a NUL, so every string in it is terminated.)
+static inline const char*
+hpcstruct_fmt_str(const hpcstruct_fmt_t* st, uint32_t off)
+{
+  if (off >= st->footer.strSz) {
+    return NULL;
+  }
+  return (const char*)(st->map.beg + st->footer.strOff + off);
+}
+
+
+//***************************************************************************
+
+#if defined(__cplusplus)
+} /* extern "C" */
+#endif
+
+#endif /* prof_lean_hpcstruct_fmt_h */
@@ -142,6 +142,29 @@ getLoadModuleFromMap(uint lm_id)
   return id;
 }
 
+//**********************************************************************
+// Goal: This function is to avoid using different ID for the same file name.
+// During the writing of file dictionary table (see CallPath-Profile.cpp)
+// 	if a file has the exact absolute name with a previous file, 
+//	then we redirect its ID to the existing ID
+//
+// This function will check if any nodes refer to redirected ID or not.
+// 	if this is the case, it will return the existing file ID instead of
+//	the node's file ID.
+//**********************************************************************
+static uint
+getFileIdFromMap(uint file_id)
+{
+  uint id = file_id;
+  if (Prof::m_mapFileIDs.find(file_id) != Prof::m_mapFileIDs.end()) {
+    // the file ID should redirected to another file ID which has 
+    // exactly the same filename
+    id = Prof::m_mapFileIDs[file_id];
+  }
+  return id;
+}
+
+
 namespace CCT {
   
 Tree::Tree(const CallPath::Profile* metadata)
@@ -287,6 +310,134 @@ Tree::writeXML(std::ostream& os, uint metricBeg, uint metricEnd,
 }
 
 
+void
+Tree::makeColumns(Columns& cols, uint metricBeg, uint metricEnd) const
+{
+  for (int c = 0; c < HPCEXPDB_FMT_NumCols; ++c) {
+    cols.col[c].clear();
+  }
+  cols.kind.clear();
+  cols.flags.clear();
+
+  // -------------------------------------------------------
+  // topology and attributes, in the pre-order of writeXML()
+  // -------------------------------------------------------
+  std::vector<const ANode*> nodes;
+  std::vector<std::pair<const ANode*, uint32_t> > stack;
+  std::vector<const ANode*> kids;
+
+  if (m_root) {
+    stack.push_back(std::make_pair(m_root, (uint32_t)HPCEXPDB_FMT_NoParent));
+  }
+
+  while (!stack.empty()) {
+    const ANode* n = stack.back().first;
+    uint32_t parent = stack.back().second;
+    stack.pop_back();
+
+    uint32_t idx = parent;
+    if (n != m_root) {
+      idx = nodes.size();
+      nodes.push_back(n);
+
+      ANode::ANodeTy ty = n->type();
+      const Struct::ACodeNode* strct = n->structure();
+      uint sId = (strct) ? strct->id() : 0;
+      uint lm = 0, file = 0, proc = 0, cpId = 0;
+      uint8_t flg = 0;
+
+      if (ty == ANode::TyProcFrm || ty == ANode::TyProc) {
+	sId = getProcIdFromMap(sId);
+	if (strct) {
+	  const AProcNode* x = static_cast<const AProcNode*>(n);
+	  lm = x->lmId();
+	  if (ty == ANode::TyProcFrm) {
+	    lm = getLoadModuleFromMap(lm);
+	  }
+	  file = getFileIdFromMap(x->fileId());
+	  proc = getProcIdFromMap(x->procId());
+	  if (x->isAlien()) {
+	    flg |= HPCEXPDB_FMT_NodeAlien;
+	  }
+	}
+      }
+      else if (ty == ANode::TyLoop) {
+	file = getFileIdFromMap(static_cast<const Loop*>(n)->fileId());
+      }
+      else if (ty == ANode::TyStmt) {
+	uint id = static_cast<const Stmt*>(n)->cpId();
+	if (hpcrun_fmt_doRetainId(id)) {
+	  cpId = id;
+	}
+      }
+
+      cols.col[HPCEXPDB_FMT_ColId].push_back(n->id());
+      cols.col[HPCEXPDB_FMT_ColParent].push_back(parent);
+      cols.col[HPCEXPDB_FMT_ColStruct].push_back(sId);
+      cols.col[HPCEXPDB_FMT_ColLine].push_back(n->begLine());
+      cols.col[HPCEXPDB_FMT_ColLM].push_back(lm);
+      cols.col[HPCEXPDB_FMT_ColFile].push_back(file);
+      cols.col[HPCEXPDB_FMT_ColProc].push_back(proc);
+      cols.col[HPCEXPDB_FMT_ColCpId].push_back(cpId);
+      cols.kind.push_back(ty);
+      cols.flags.push_back(flg);
+    }
+
+    // push children in reverse so that they are popped in order
+    kids.clear();
+    for (ANodeSortedChildIterator it(n, ANodeSortedIterator::cmpByStructureInfo);
+	 it.current(); it++) {
+      kids.push_back(it.current());
+    }
+    for (uint k = kids.size(); k > 0; --k) {
+      stack.push_back(std::make_pair(kids[k - 1], idx));
+    }
+  }
+
+  // -------------------------------------------------------
+  // summary metrics: count the nonzeros of each metric, then place
+  // each value; rows within a column stay in node order
+  // -------------------------------------------------------
+  uint numMetrics = (metricBeg < metricEnd) ? metricEnd - metricBeg : 0;
+
+  cols.metricPtr.assign(numMetrics + 1, 0);
+  if (numMetrics > 0) {
+    for (uint i = 0; i < nodes.size(); ++i) {
+      MetricAccessor* ma = ANode::metric_accessor(nodes[i]->id());
+      for (uint m = ma->idx_ge(metricBeg); m < metricEnd;
+	   m = ma->idx_ge(m + 1)) {
+	if (ma->c_idx(m) != 0.0) {
+	  cols.metricPtr[m - metricBeg + 1]++;
+	}
+      }
+    }
+  }
+  for (uint j = 0; j < numMetrics; ++j) {
+    cols.metricPtr[j + 1] += cols.metricPtr[j];
+  }
+
+  uint64_t nnz = cols.metricPtr[numMetrics];
+  cols.values.resize(nnz);
+  cols.rows.resize(nnz);
+
+  if (nnz > 0) {
+    std::vector<uint64_t> pos(cols.metricPtr.begin(), cols.metricPtr.end() - 1);
+    for (uint i = 0; i < nodes.size(); ++i) {
+      MetricAccessor* ma = ANode::metric_accessor(nodes[i]->id());
+      for (uint m = ma->idx_ge(metricBeg); m < metricEnd;
+	   m = ma->idx_ge(m + 1)) {
+	double val = ma->c_idx(m);
+	if (val != 0.0) {
+	  uint64_t k = pos[m - metricBeg]++;
+	  cols.values[k] = val;
+	  cols.rows[k] = i;
+	}
+      }
+    }
+  }
+}
+
+
 std::ostream& 
 Tree::dump(std::ostream& os, uint oFlags) const
 {
@@ -1203,28 +1354,6 @@ Root::toStringMe(uint oFlags) const
 }
 
 
-//**********************************************************************
-// Goal: This function is to avoid using different ID for the same file name.
-// During the writing of file dictionary table (see CallPath-Profile.cpp)
-// 	if a file has the exact absolute name with a previous file, 
-//	then we redirect its ID to the existing ID
-//
-// This function will check if any nodes refer to redirected ID or not.
-// 	if this is the case, it will return the existing file ID instead of
-//	the node's file ID.
-//**********************************************************************
-static uint
-getFileIdFromMap(uint file_id)
-{
-  uint id = file_id;
-  if (Prof::m_mapFileIDs.find(file_id) != Prof::m_mapFileIDs.end()) {
-    // the file ID should redirected to another file ID which has 
-    // exactly the same filename
-    id = Prof::m_mapFileIDs[file_id];
-  }
-  return id;
-}
-
 string
 ProcFrm::toStringMe(uint oFlags) const
 {
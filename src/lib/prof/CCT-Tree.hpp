@@ -91,6 +91,7 @@
 #include <lib/isa/ISATypes.hpp>
 
 #include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/hpcexpdb-fmt.h>
 #include <lib/prof-lean/lush/lush-support.h>
 
 #include <lib/binutils/VMAInterval.hpp> // TODO
@@ -231,6 +232,29 @@ public:
   void
   ddump() const;
 
+  // -------------------------------------------------------
+  // Column-wise contents (for experiment.db)
+  // -------------------------------------------------------
+
+  // Columns: the nodes of writeXML() (all but the root), in the same
+  // order, as one array per attribute; and the nonzero values of the
+  // metrics [metricBeg, metricEnd) in compressed sparse column form.
+  // See prof-lean/hpcexpdb-fmt.h.
+  struct Columns {
+    std::vector<uint32_t> col[HPCEXPDB_FMT_NumCols];
+    std::vector<uint8_t>  kind;
+    std::vector<uint8_t>  flags;
+
+    std::vector<uint64_t> metricPtr;
+    std::vector<double>   values;
+    std::vector<uint32_t> rows;
+  };
+
+  // makeColumns: fills 'cols'.  Like writeXML(), expects the
+  // dictionaries of the profile to have been built.
+  void
+  makeColumns(Columns& cols, uint metricBeg, uint metricEnd) const;
+
 
   // Given a set of flags 'flags', determines whether we need to
   // ensure that certain characters are escaped.  Returns xml::ESC_TRUE
@@ -178,6 +178,10 @@ Profile::Profile(const std::string name)
 
   m_structure = NULL;
 
+  for (int i = 0; i < DictTy_NUMBER; ++i) {
+    m_isDictBuilt[i] = false;
+  }
+
   canonicalize();
 }
 
@@ -466,7 +470,7 @@ Profile::merge_fixTrace(const CCT::MergeEffectList* mrgEffects)
   while ( !feof(infs) ) {
     // 1. Read trace record (exit on EOF)
     hpctrace_fmt_datum_t datum;
-    ret = hpctrace_fmt_datum_fread(&datum, hdr.flags, infs);
+    ret = hpctrace_fmt_datum_fread(&datum, &hdr, infs);
     if (ret == HPCFMT_EOF) {
       break;
     } else if (ret == HPCFMT_ERR) {
@@ -562,11 +566,11 @@ getFileName(Struct::ANode* strct)
   return nm;
 }
 
-// writing XML dictionary in the header part of experiment.xml
+// collecting a dictionary for the header part of experiment.xml
 static void
-writeXML_help(std::ostream& os, const char* entry_nm,
+makeDictTable(Profile::DictTable& table,
 	      Struct::Tree* structure, const Struct::ANodeFilter* filter,
-	      int type, bool remove_redundancy)
+	      Profile::DictTy type, bool remove_redundancy)
 {
   Struct::ANode* root = structure ? structure->root() : NULL;
   if (!root) {
@@ -581,7 +585,7 @@ writeXML_help(std::ostream& os, const char* entry_nm,
 
     bool fake_procedure = false;
 
-    if (type == 1) { // LoadModule
+    if (type == Profile::DictTy_LM) {
       nm = static_cast<Prof::Struct::LM *> (strct)->pretty_name(); //strct->name().c_str();
       SimpleSymbolsFactory * sf = simpleSymbolsFactories.find(nm);
       if (sf) {
@@ -591,7 +595,7 @@ writeXML_help(std::ostream& os, const char* entry_nm,
         nm = sf->unified_name();
       }
     }
-    else if (type == 2) { // File
+    else if (type == Profile::DictTy_File) {
       nm = getFileName(strct);	
       // ---------------------------------------
       // avoid redundancy in XML filename dictionary
@@ -623,7 +627,7 @@ writeXML_help(std::ostream& os, const char* entry_nm,
         continue;
       }
     }
-    else if (type == 3) { // Proc
+    else if (type == Profile::DictTy_Proc) {
       const char *proc_name = strct->name().c_str();
       nm = normalize_name(proc_name, fake_procedure);
 
@@ -704,14 +708,11 @@ writeXML_help(std::ostream& os, const char* entry_nm,
       DIAG_Die(DIAG_UnexpectedInput);
     }
 
-    os << "    <" << entry_nm << " i" << MakeAttrNum(id)
-           << " n" << MakeAttrStr(nm);
-
-    if (fake_procedure) {
-      os << " f" << MakeAttrNum(1);
-    } 
-
-    os << "/>\n";
+    Profile::DictEntry entry;
+    entry.id = id;
+    entry.name = nm;
+    entry.isFake = fake_procedure;
+    table.push_back(entry);
   }
 }
 
@@ -731,6 +732,53 @@ writeXML_ProcFilter(const Struct::ANode& x, long GCC_ATTR_UNUSED type)
 }
 
 
+const Profile::DictTable&
+Profile::dictTable(DictTy ty) const
+{
+  if (!m_isDictBuilt[ty]) {
+    switch (ty) {
+      case DictTy_LM:
+	makeDictTable(m_dictTable[ty], m_structure,
+		      &Struct::ANodeTyFilter[Struct::ANode::TyLM], ty,
+		      m_remove_redundancy);
+	break;
+      case DictTy_File: {
+	Struct::ANodeFilter filt(writeXML_FileFilter, "FileTable", 0);
+	makeDictTable(m_dictTable[ty], m_structure, &filt, ty,
+		      m_remove_redundancy);
+	break;
+      }
+      case DictTy_Proc: {
+	Struct::ANodeFilter filt(writeXML_ProcFilter, "ProcTable", 0);
+	makeDictTable(m_dictTable[ty], m_structure, &filt, ty,
+		      true /*m_remove_redundancy*/);
+	break;
+      }
+      default:
+	DIAG_Die(DIAG_UnexpectedInput);
+    }
+    m_isDictBuilt[ty] = true;
+  }
+  return m_dictTable[ty];
+}
+
+
+static void
+writeXML_dict(std::ostream& os, const char* entry_nm,
+	      const Profile::DictTable& table)
+{
+  for (uint i = 0; i < table.size(); ++i) {
+    const Profile::DictEntry& x = table[i];
+    os << "    <" << entry_nm << " i" << MakeAttrNum(x.id)
+       << " n" << MakeAttrStr(x.name);
+    if (x.isFake) {
+      os << " f" << MakeAttrNum(1);
+    }
+    os << "/>\n";
+  }
+}
+
+
 std::ostream&
 Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
 		      uint oFlags, const char* GCC_ATTR_UNUSED pfx) const
@@ -859,17 +907,14 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
   //
   // -------------------------------------------------------
   os << "  <LoadModuleTable>\n";
-  writeXML_help(os, "LoadModule", m_structure,
-		&Struct::ANodeTyFilter[Struct::ANode::TyLM], 1,
-		m_remove_redundancy);
+  writeXML_dict(os, "LoadModule", dictTable(DictTy_LM));
   os << "  </LoadModuleTable>\n";
 
   // -------------------------------------------------------
   //
   // -------------------------------------------------------
   os << "  <FileTable>\n";
-  Struct::ANodeFilter filt1(writeXML_FileFilter, "FileTable", 0);
-  writeXML_help(os, "File", m_structure, &filt1, 2, m_remove_redundancy);
+  writeXML_dict(os, "File", dictTable(DictTy_File));
   os << "  </FileTable>\n";
 
   // -------------------------------------------------------
@@ -877,8 +922,7 @@ Profile::writeXML_hdr(std::ostream& os, uint metricBeg, uint metricEnd,
   // -------------------------------------------------------
   if ( !(oFlags & CCT::Tree::OFlg_Debug) ) {
     os << "  <ProcedureTable>\n";
-    Struct::ANodeFilter filt2(writeXML_ProcFilter, "ProcTable", 0);
-    writeXML_help(os, "Procedure", m_structure, &filt2, 3, true /*m_remove_redundancy*/);
+    writeXML_dict(os, "Procedure", dictTable(DictTy_Proc));
     os << "  </ProcedureTable>\n";
   }
 
@@ -927,6 +971,13 @@ static void
 fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
 		 epoch_flags_t flags);
 
+static const hpcrun_fmt_dict_t*
+fmt_dict_get(const std::string& fnm);
+
+static const char*
+fmt_hdr_search(const hpcrun_fmt_hdr_t& hdr, const hpcrun_fmt_dict_t* dict,
+	       const char* name);
+
 
 //***************************************************************************
 
@@ -975,9 +1026,17 @@ Profile::make(const char* fnm, uint rFlags, FILE* outfs)
 
   rFlags |= RFlg_HpcrunData; // TODO: for now assume an hpcrun file (verify!)
 
+  // Decode the CCT in place from a mapping of the file when possible.
+  hpcio_map_t map;
+  bool isMapped = (hpcio_map_fs(&map, fs) == 0);
+
   Profile* prof = NULL;
-  ret = fmt_fread(prof, fs, rFlags, fnm, fnm, outfs);
+  ret = fmt_fread(prof, fs, rFlags, fnm, fnm, outfs,
+		  (isMapped) ? &map : NULL);
   
+  if (isMapped) {
+    hpcio_unmap(&map);
+  }
   hpcio_fclose(fs);
 
   delete[] fsBuf;
@@ -988,7 +1047,8 @@ Profile::make(const char* fnm, uint rFlags, FILE* outfs)
 
 int
 Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
-		   std::string ctxtStr, const char* filename, FILE* outfs)
+		   std::string ctxtStr, const char* filename, FILE* outfs,
+		   hpcio_map_t* inmap)
 {
   int ret;
 
@@ -1010,6 +1070,22 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
     hpcrun_fmt_hdr_fprint(&hdr, outfs);
   }
 
+  // ------------------------------------------------------------
+  // dictionary: shared by the profiles of a process
+  // ------------------------------------------------------------
+  const hpcrun_fmt_dict_t* dict = NULL;
+
+  const char* dictNm = hpcfmt_nvpairList_search(&(hdr.nvps), HPCRUN_FMT_NV_dict);
+  if (dictNm) {
+    if (!filename) {
+      DIAG_Throw("profile refers to dictionary '" << dictNm << "' but has no file name");
+    }
+    dict = fmt_dict_get(FileUtil::dirname(filename) + "/" + dictNm);
+    if (outfs) {
+      hpcrun_fmt_dict_fprint(const_cast<hpcrun_fmt_dict_t*>(dict), outfs);
+    }
+  }
+
 
   // ------------------------------------------------------------
   // epoch: Read each epoch and merge them to form one Profile
@@ -1027,7 +1103,7 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
 
     try {
       ret = fmt_epoch_fread(myprof, infs, rFlags, hdr,
-			    ctxtStr, filename, outfs);
+			    ctxtStr, filename, outfs, inmap, dict);
       if (ret == HPCFMT_EOF) {
 	break;
       }
@@ -1059,6 +1135,12 @@ Profile::fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
   // ------------------------------------------------------------
 
   if (outfs) {
+    hpcrun_fmt_toc_t toc;
+    if (hpcrun_fmt_toc_fread(&toc, infs, malloc) == HPCFMT_OK) {
+      hpcrun_fmt_toc_fprint(&toc, outfs);
+    }
+    hpcrun_fmt_toc_free(&toc, free);
+
     fprintf(outfs, "\n[You look fine today! (num-epochs: %u)]\n", num_epochs);
   }
 
@@ -1072,7 +1154,8 @@ int
 Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 			 const hpcrun_fmt_hdr_t& hdr,
 			 std::string ctxtStr, const char* filename,
-			 FILE* outfs)
+			 FILE* outfs, hpcio_map_t* inmap,
+			 const hpcrun_fmt_dict_t* dict)
 {
   using namespace Prof;
 
@@ -1105,7 +1188,13 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   metric_tbl_t metricTbl;
   metric_aux_info_t *aux_info;
 
-  ret = hpcrun_fmt_metricTbl_fread(&metricTbl, &aux_info, infs, hdr.version, malloc);
+  if (dict) {
+    ret = hpcrun_fmt_metricTblRef_fread(&metricTbl, &aux_info, dict, infs);
+  }
+  else {
+    ret = hpcrun_fmt_metricTbl_fread(&metricTbl, &aux_info, infs, hdr.version,
+				     malloc);
+  }
   if (ret != HPCFMT_OK) {
     DIAG_Throw("error reading 'metric-tbl'");
   }
@@ -1119,7 +1208,12 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   // loadmap
   // ----------------------------------------
   loadmap_t loadmap_tbl;
-  ret = hpcrun_fmt_loadmap_fread(&loadmap_tbl, infs, malloc);
+  if (dict) {
+    ret = hpcrun_fmt_loadmapRef_fread(&loadmap_tbl, dict, infs, malloc);
+  }
+  else {
+    ret = hpcrun_fmt_loadmap_fread(&loadmap_tbl, infs, malloc);
+  }
   if (ret != HPCFMT_OK) {
     DIAG_Throw("error reading 'loadmap'");
   }
@@ -1141,7 +1235,7 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
   // program name
   // -------------------------
   string progNm;
-  val = hpcfmt_nvpairList_search(&(hdr.nvps), HPCRUN_FMT_NV_prog);
+  val = fmt_hdr_search(hdr, dict, HPCRUN_FMT_NV_prog);
   if (val && strlen(val) > 0) {
     progNm = val;
   }
@@ -1404,18 +1498,25 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
     prof->loadmap()->merge(loadmap);
   DIAG_Assert(mrgEffect->empty(), "Profile::fmt_epoch_fread: " << DIAG_UnexpectedInput);
 
-  hpcrun_fmt_loadmap_free(&loadmap_tbl, free);
+  if (dict) {
+    free(loadmap_tbl.lst); // the names are the dictionary's
+  }
+  else {
+    hpcrun_fmt_loadmap_free(&loadmap_tbl, free);
+  }
   delete mrgEffect;
 
 
   // ------------------------------------------------------------
   // cct
   // ------------------------------------------------------------
-  fmt_cct_fread(*prof, infs, rFlags, metricTbl, ctxtStr, outfs);
+  fmt_cct_fread(*prof, infs, rFlags, metricTbl, ctxtStr, outfs, inmap);
 
 
   hpcrun_fmt_epochHdr_free(&ehdr, free);
-  hpcrun_fmt_metricTbl_free(&metricTbl, free);
+  if (!dict) {
+    hpcrun_fmt_metricTbl_free(&metricTbl, free);
+  }
   
   return HPCFMT_OK;
 }
@@ -1424,7 +1525,8 @@ Profile::fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 int
 Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		       const metric_tbl_t& metricTbl,
-		       std::string ctxtStr, FILE* outfs)
+		       std::string ctxtStr, FILE* outfs,
+		       hpcio_map_t* inmap)
 {
   typedef std::map<int, CCT::ANode*> CCTIdToCCTNodeMap;
 
@@ -1437,8 +1539,19 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
   // ------------------------------------------------------------
   // Read number of cct nodes
   // ------------------------------------------------------------
+  // The headers were read through 'infs'; pick up the CCT records
+  // in the mapping at the same position.
+  if (inmap && hpcio_map_seek_fs(inmap, infs) != 0) {
+    inmap = NULL;
+  }
+
   uint64_t numNodes = 0;
-  hpcfmt_int8_fread(&numNodes, infs);
+  if (inmap) {
+    hpcfmt_int8_mread(&numNodes, inmap);
+  }
+  else {
+    hpcfmt_int8_fread(&numNodes, infs);
+  }
 
   // ------------------------------------------------------------
   // Read each CCT node
@@ -1474,7 +1587,9 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     // ----------------------------------------------------------
     // Read the node
     // ----------------------------------------------------------
-    ret = hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
+    ret = (inmap) ?
+      hpcrun_fmt_cct_node_mread(&nodeFmt, prof.m_flags, inmap) :
+      hpcrun_fmt_cct_node_fread(&nodeFmt, prof.m_flags, infs);
     if (ret != HPCFMT_OK) {
       DIAG_Throw("Error reading CCT node " << nodeFmt.id);
     }
@@ -1561,6 +1676,11 @@ Profile::fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
     cctNodeMap.insert(std::make_pair(nodeFmt.id, node));
   }
 
+  // Continue with the next epoch (if any) through 'infs'.
+  if (inmap && hpcio_fs_seek_map(infs, inmap) != 0) {
+    DIAG_Throw("Error seeking past CCT");
+  }
+
   if (outfs) {
     fprintf(outfs, "]\n");
   }
@@ -2072,3 +2192,47 @@ fmt_cct_makeNode(hpcrun_fmt_cct_node_t& n_fmt, const Prof::CCT::ANode& n,
   }
 }
 
+
+
+// Returns the dictionary in file 'fnm', read on first use and then
+// kept: the profiles of a process share one.
+static const hpcrun_fmt_dict_t*
+fmt_dict_get(const std::string& fnm)
+{
+  static std::map<std::string, hpcrun_fmt_dict_t*> dicts;
+
+  std::map<std::string, hpcrun_fmt_dict_t*>::iterator it = dicts.find(fnm);
+  if (it != dicts.end()) {
+    return it->second;
+  }
+
+  FILE* fs = hpcio_fopen_r(fnm.c_str());
+  if (!fs) {
+    DIAG_Throw("error opening dictionary '" << fnm << "'");
+  }
+
+  hpcrun_fmt_dict_t* dict = new hpcrun_fmt_dict_t;
+  int ret = hpcrun_fmt_dict_fread(dict, fs);
+  hpcio_fclose(fs);
+  if (ret != HPCFMT_OK) {
+    delete dict;
+    DIAG_Throw("error reading dictionary '" << fnm << "'");
+  }
+
+  dicts[fnm] = dict;
+  return dict;
+}
+
+
+// Searches the nv-pairs of the file-hdr and then those of its
+// dictionary, if any.
+static const char*
+fmt_hdr_search(const hpcrun_fmt_hdr_t& hdr, const hpcrun_fmt_dict_t* dict,
+	       const char* name)
+{
+  const char* val = hpcfmt_nvpairList_search(&(hdr.nvps), name);
+  if (!val && dict) {
+    val = hpcfmt_nvpairList_search(&(dict->nvps), name);
+  }
+  return val;
+}
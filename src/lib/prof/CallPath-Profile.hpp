@@ -292,21 +292,28 @@ public:
   // file stream 'infs', checking for errors, and constructs
   // appropriate Prof::Profile::CallPath objects.  If 'outfs' is
   // non-null, a textual form of the data is echoed to 'outfs' for
-  // human inspection.
+  // human inspection.  If 'inmap' is non-null, it maps the file
+  // underlying 'infs' and the CCT records are decoded from it in
+  // place; otherwise (pipes, memstreams) everything is read from
+  // 'infs'.  'dict' is the dictionary named by the file-hdr, if any.
 
   static int
   fmt_fread(Profile* &prof, FILE* infs, uint rFlags,
-	    std::string ctxtStr, const char* filename, FILE* outfs);
+	    std::string ctxtStr, const char* filename, FILE* outfs,
+	    hpcio_map_t* inmap = NULL);
 
   static int
   fmt_epoch_fread(Profile* &prof, FILE* infs, uint rFlags,
 		  const hpcrun_fmt_hdr_t& hdr,
-		  std::string ctxtStr, const char* filename, FILE* outfs);
+		  std::string ctxtStr, const char* filename, FILE* outfs,
+		  hpcio_map_t* inmap = NULL,
+		  const hpcrun_fmt_dict_t* dict = NULL);
 
   static int
   fmt_cct_fread(Profile& prof, FILE* infs, uint rFlags,
 		const metric_tbl_t& metricTbl,
-		std::string ctxtStr, FILE* outfs);
+		std::string ctxtStr, FILE* outfs,
+		hpcio_map_t* inmap = NULL);
 
 
   // fmt_*_fwrite(): Write the appropriate object as hpcrun_fmt to the
@@ -337,6 +344,32 @@ public:
   { return writeXML_hdr(os, 0, m_mMgr->size(), oFlags, pfx); }
 
 
+  // -------------------------------------------------------
+  // Dictionaries of the experiment database header
+  // -------------------------------------------------------
+
+  enum DictTy {
+    DictTy_LM   = 0, // <LoadModuleTable>
+    DictTy_File = 1, // <FileTable>
+    DictTy_Proc = 2, // <ProcedureTable>
+    DictTy_NUMBER
+  };
+
+  struct DictEntry {
+    uint id;
+    std::string name;
+    bool isFake;
+  };
+
+  typedef std::vector<DictEntry> DictTable;
+
+  // dictTable: returns the load module, file or procedure dictionary.
+  // Built once, on first use: building the file and procedure tables
+  // records the id redirections used when writing the CCT, so they
+  // must be requested before the CCT is written.
+  const DictTable&
+  dictTable(DictTy ty) const;
+
   // TODO: move Analysis::CallPath::write() here?
   //std::ostream& writeXML_cct(...) const;
 
@@ -389,6 +422,9 @@ private:
   Prof::Struct::Tree* m_structure;
  
   bool m_remove_redundancy;
+
+  mutable DictTable m_dictTable[DictTy_NUMBER];
+  mutable bool m_isDictBuilt[DictTy_NUMBER];
 };
 
 } // namespace CallPath
@@ -1003,6 +1003,44 @@ LM::buildMap(VMAIntervalMap<T>*& mp, ANode::ANodeTy ty) const
 }
 
 
+void
+LM::computeVMAMaps(std::vector<std::pair<VMAInterval, Proc*> >& procs,
+		   std::vector<std::pair<VMAInterval, Stmt*> >& stmts) const
+{
+  delete m_procMap;
+  m_procMap = NULL;
+  delete m_stmtMap;
+  m_stmtMap = NULL;
+
+  buildMapSorted(m_procMap, procs);
+  buildMapSorted(m_stmtMap, stmts);
+}
+
+
+template<typename T>
+static bool
+lt_first(const std::pair<VMAInterval, T>& x,
+	 const std::pair<VMAInterval, T>& y)
+{
+  return (x.first < y.first);
+}
+
+
+template<typename T>
+void
+LM::buildMapSorted(VMAIntervalMap<T>*& mp,
+		   std::vector<std::pair<VMAInterval, T> >& vec)
+{
+  std::stable_sort(vec.begin(), vec.end(), lt_first<T>);
+
+  // sorted input makes each hinted insert amortized constant time
+  mp = new VMAIntervalMap<T>;
+  for (uint i = 0; i < vec.size(); ++i) {
+    mp->insert(mp->end(), vec[i]);
+  }
+}
+
+
 template<typename T>
 bool
 LM::verifyMap(VMAIntervalMap<T>* m, const char* map_nm)
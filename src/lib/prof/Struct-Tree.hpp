@@ -68,6 +68,7 @@
 #include <list>
 #include <set>
 #include <map>
+#include <vector>
 
 #include <typeinfo>
 
@@ -1147,6 +1148,15 @@ public:
     findStmt(0);
   }
 
+  // computeVMAMaps: Builds the maps in bulk from the given (interval,
+  // node) pairs, which should cover all Procs and Stmts of this LM
+  // (e.g., a binary structure file).  Pairs are sorted (stably, so
+  // that as with insertInMap() the first of equal intervals wins) and
+  // inserted in order.
+  void
+  computeVMAMaps(std::vector<std::pair<VMAInterval, Proc*> >& procs,
+		 std::vector<std::pair<VMAInterval, Stmt*> >& stmts) const;
+
 
   Proc*
   findProc(VMA vma) const;
@@ -1224,6 +1234,11 @@ protected:
   void
   buildMap(VMAIntervalMap<T>*& mp, ANode::ANodeTy ty) const;
 
+  template<typename T>
+  static void
+  buildMapSorted(VMAIntervalMap<T>*& mp,
+		 std::vector<std::pair<VMAInterval, T> >& vec);
+
   template<typename T>
   void
   insertInMap(VMAIntervalMap<T>* mp, T x) const
@@ -0,0 +1,349 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+
+//***************************************************************************
+//
+// File:
+//   $HeadURL$
+//
+// Purpose:
+//   Loads a binary structure file (hpcstruct --binary) directly into a
+//   Prof::Struct::Tree.
+//
+// Description:
+//   [The set of functions, macros, etc. defined in the file]
+//
+//***************************************************************************
+
+//************************ System Include Files ******************************
+
+#include <stdio.h>
+
+#include <map>
+#include <set>
+#include <string>
+using std::string;
+
+#include <utility>
+#include <vector>
+
+//************************* User Include Files *******************************
+
+#include "PGMBinaryReader.hpp"
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcstruct-fmt.h>
+
+#include <lib/support/diagnostics.h>
+#include <lib/support/SrcFile.hpp>
+
+//************************ Forward Declarations ******************************
+
+//****************************************************************************
+
+namespace Prof {
+
+namespace Struct {
+
+bool
+isBinaryStructure(const char* filenm)
+{
+  FILE* fs = fopen(filenm, "r");
+  if (!fs) {
+    return false;
+  }
+  bool ret = hpcstruct_fmt_isBinary(fs);
+  fclose(fs);
+  return ret;
+}
+
+
+// The intervals of one load module, for LM::computeVMAMaps()
+struct LMIntervals {
+  std::vector<std::pair<VMAInterval, Proc*> > procs;
+  std::vector<std::pair<VMAInterval, Stmt*> > stmts;
+};
+
+
+// File names repeat for every alien and loop; the string table holds
+// each name once, so resolve each realpath once.
+typedef std::map<uint32_t, string> RealPathCache;
+
+static const string&
+realpathOf(RealPathCache& cache, const hpcstruct_fmt_t& st, uint32_t off,
+	   DocHandlerArgs& args)
+{
+  RealPathCache::iterator it = cache.find(off);
+  if (it == cache.end()) {
+    string path = args.realpath(hpcstruct_fmt_str(&st, off));
+    it = cache.insert(std::make_pair(off, path)).first;
+  }
+  return it->second;
+}
+
+
+// Copies the VMA intervals of 'node' to 'x' and, if 'vec' is
+// non-null, appends them (as merged by the set) to 'vec'.
+template<typename T>
+static void
+addVMAs(T* x, const hpcstruct_fmt_node_t& node, const hpcstruct_fmt_t& st,
+	std::vector<std::pair<VMAInterval, T*> >* vec)
+{
+  for (uint32_t k = 0; k < node.numVMA; ++k) {
+    uint64_t beg, end;
+    hpcstruct_fmt_vma(&st, node.vmaIdx + k, &beg, &end);
+    x->vmaSet().insert(beg, end);
+  }
+
+  if (vec) {
+    const VMAIntervalSet& vmaset = x->vmaSet();
+    for (VMAIntervalSet::const_iterator it = vmaset.begin();
+	 it != vmaset.end(); ++it) {
+      vec->push_back(std::make_pair(*it, x));
+    }
+  }
+}
+
+
+// hpcstruct_fmt_open() has checked these already; check them again
+// here so that indexing 'nodes', the string table and the VMA table
+// does not depend on it.
+static bool
+isValidNode(const hpcstruct_fmt_node_t& x, uint64_t i,
+	    const hpcstruct_fmt_t& st)
+{
+  if (x.parent != HPCSTRUCT_FMT_NoParent && x.parent >= i) {
+    return false;
+  }
+  if (!hpcstruct_fmt_str(&st, x.name) || !hpcstruct_fmt_str(&st, x.file)
+      || !hpcstruct_fmt_str(&st, x.linkName)) {
+    return false;
+  }
+  uint64_t numVMAs = st.footer.numVMAs;
+  return (x.vmaIdx <= numVMAs && x.numVMA <= numVMAs - x.vmaIdx);
+}
+
+
+static bool
+isCodeScope(const ANode* x)
+{
+  return (x && (x->type() == ANode::TyProc || x->type() == ANode::TyAlien
+		|| x->type() == ANode::TyLoop));
+}
+
+
+void
+read_PGMBinary(Tree& structure,
+	       const char* filenm,
+	       DocHandlerArgs& docHandlerArgs)
+{
+  FILE* fs = fopen(filenm, "r");
+  if (!fs) {
+    DIAG_Throw("Could not open binary structure file '" << filenm << "'.");
+  }
+
+  // the mapping outlives the stream
+  hpcstruct_fmt_t st;
+  int ret = hpcstruct_fmt_open(&st, fs);
+  fclose(fs);
+  if (ret != HPCFMT_OK) {
+    DIAG_Throw("ignoring '" << filenm << "' because it is not a valid binary structure file.");
+  }
+
+  Root* root = structure.root();
+  uint64_t numNodes = st.footer.numNodes;
+
+  // nodes and their load modules, by node index (parents precede
+  // children)
+  std::vector<ANode*> nodes(numNodes, (ANode*)NULL);
+  std::vector<LM*> nodeLM(numNodes, (LM*)NULL);
+
+  RealPathCache realpaths;
+  std::map<uint32_t, Proc*> idToProcMap;
+  std::map<LM*, LMIntervals> lmIntervals;
+  std::set<LM*> oldLMs; // already in 'structure' before this file
+
+  for (uint64_t i = 0; i < numNodes; ++i) {
+    hpcstruct_fmt_node_t x;
+    if (hpcstruct_fmt_node(&st, i, &x) != HPCFMT_OK
+	|| !isValidNode(x, i, st)) {
+      hpcstruct_fmt_close(&st);
+      DIAG_Throw("ignoring '" << filenm << "' because it is not a valid binary structure file.");
+    }
+
+    ANode* parent = NULL;
+    LM* lm = NULL;
+    if (x.parent != HPCSTRUCT_FMT_NoParent) {
+      parent = nodes[x.parent];
+      lm = nodeLM[x.parent];
+    }
+
+    const char* nm = hpcstruct_fmt_str(&st, x.name);
+    SrcFile::ln line = (SrcFile::ln)x.line;
+    bool isValid = true;
+
+    switch (x.kind) {
+      case HPCSTRUCT_FMT_LM: {
+	const string& lmnm = realpathOf(realpaths, st, x.name, docHandlerArgs);
+	lm = root->findLM(lmnm);
+	if (!lm) {
+	  lm = new LM(lmnm, root);
+	}
+	else if (lmIntervals.find(lm) == lmIntervals.end()) {
+	  oldLMs.insert(lm);
+	}
+	lmIntervals[lm];
+	nodes[i] = lm;
+	break;
+      }
+
+      case HPCSTRUCT_FMT_File: {
+	isValid = (parent && parent->type() == ANode::TyLM);
+	if (isValid) {
+	  const string& fnm = realpathOf(realpaths, st, x.name, docHandlerArgs);
+	  nodes[i] = File::demand(lm, fnm);
+	}
+	break;
+      }
+
+      case HPCSTRUCT_FMT_Proc: {
+	isValid = (parent && parent->type() == ANode::TyFile);
+	if (!isValid) {
+	  break;
+	}
+	File* file = dynamic_cast<File*>(parent);
+
+	// as in PGMDocHandler: VMA information fully qualifies procedures
+	Proc* proc = file->findProc(nm);
+	if (proc && !proc->vmaSet().empty() && x.numVMA > 0) {
+	  proc = NULL;
+	}
+
+	if (!proc) {
+	  proc = new Proc(nm, file, hpcstruct_fmt_str(&st, x.linkName),
+			  false, line, line);
+	  addVMAs(proc, x, st, &lmIntervals[lm].procs);
+	  proc->m_origId = x.id;
+	}
+	else {
+	  DIAG_Msg(0, "Warning: Found procedure '" << nm << "' multiple times within file '" << file->name() << "'; information for this procedure will be aggregated. If you do not want this, edit the STRUCTURE file and adjust the names by hand.");
+	}
+	idToProcMap[x.id] = proc;
+	nodes[i] = proc;
+	break;
+      }
+
+      case HPCSTRUCT_FMT_Alien: {
+	isValid = isCodeScope(parent);
+	if (!isValid) {
+	  break;
+	}
+	const string& fnm = realpathOf(realpaths, st, x.file, docHandlerArgs);
+	Alien* alien = new Alien(dynamic_cast<ACodeNode*>(parent), fnm,
+				 nm, nm, line, line);
+
+	Proc* proc = NULL;
+	if (x.procId != HPCSTRUCT_FMT_NoProc) {
+	  std::map<uint32_t, Proc*>::iterator it = idToProcMap.find(x.procId);
+	  proc = (it != idToProcMap.end()) ? it->second : NULL;
+	}
+	alien->proc(proc);
+	alien->m_origId = x.id;
+	nodes[i] = alien;
+	break;
+      }
+
+      case HPCSTRUCT_FMT_Loop: {
+	isValid = isCodeScope(parent);
+	if (!isValid) {
+	  break;
+	}
+	string fnm = realpathOf(realpaths, st, x.file, docHandlerArgs);
+	Loop* loop = new Loop(dynamic_cast<ACodeNode*>(parent), fnm,
+			      line, line);
+	loop->m_origId = x.id;
+	nodes[i] = loop;
+	break;
+      }
+
+      case HPCSTRUCT_FMT_Stmt: {
+	isValid = isCodeScope(parent);
+	if (!isValid) {
+	  break;
+	}
+	Stmt* stmt = new Stmt(dynamic_cast<ACodeNode*>(parent), line, line);
+	addVMAs(stmt, x, st, &lmIntervals[lm].stmts);
+	stmt->m_origId = x.id;
+	nodes[i] = stmt;
+	break;
+      }
+    }
+
+    if (!isValid) {
+      hpcstruct_fmt_close(&st);
+      DIAG_Throw("reading '" << filenm << "': misplaced node " << i << " (kind " << (uint)x.kind << ")");
+    }
+    nodeLM[i] = lm;
+  }
+
+  hpcstruct_fmt_close(&st);
+
+  // build the VMA maps in bulk.  a load module that was already
+  // present may have procs and stmts from other files.
+  for (std::map<LM*, LMIntervals>::iterator it = lmIntervals.begin();
+       it != lmIntervals.end(); ++it) {
+    LM* lm = it->first;
+    if (oldLMs.find(lm) != oldLMs.end()) {
+      lm->computeVMAMaps();
+    }
+    else {
+      lm->computeVMAMaps(it->second.procs, it->second.stmts);
+    }
+  }
+}
+
+
+} // namespace Struct
+
+} // namespace Prof
@@ -76,6 +76,7 @@ using std::string;
 //************************* User Include Files *******************************
 
 #include "PGMReader.hpp"
+#include "PGMBinaryReader.hpp"
 #include "XercesUtil.hpp"
 
 //*********************** Xerces Include Files *******************************
@@ -141,7 +142,13 @@ readStructure(Struct::Tree& structure,
 
   for (uint i = 0; i < structureFiles.size(); ++i) {
     const string& fnm = structureFiles[i];
-    read_PGM(structure, fnm.c_str(), docty, docargs);
+    if (docty == PGMDocHandler::Doc_STRUCT
+	&& isBinaryStructure(fnm.c_str())) {
+      read_PGMBinary(structure, fnm.c_str(), docargs);
+    }
+    else {
+      read_PGM(structure, fnm.c_str(), docty, docargs);
+    }
   }
 
   FiniXerces();
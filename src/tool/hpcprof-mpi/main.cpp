@@ -68,11 +68,13 @@
 #include <typeinfo>
 #include <signal.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include <string>
 using std::string;
 
 #include <vector>
+#include <algorithm> // max()
 using std::vector;
 
 #include <cstdlib> // getenv()
@@ -105,6 +107,29 @@ using std::vector;
 
 //*************************** Forward Declarations ***************************
 
+// A thread-level metric-db in sparse (version 02.00) form; see
+// hpcmetricDB_fmt_sparse_write().
+struct SparseMetricsDB {
+  uint64_t
+  size() const;
+
+  int
+  write(int fd, uint64_t off) const;
+
+  std::string name; // profile name (for metric-db sets)
+  uint groupId;
+
+  hpcmetricDB_fmt_hdr_t hdr;
+  uint32_t layout;
+  std::vector<uint32_t> majorIds;
+  std::vector<uint64_t> majorPtr;
+  std::vector<uint32_t> minorIds;
+  std::vector<double> values;
+};
+
+typedef std::vector<SparseMetricsDB*> SparseMetricsDBSet;
+
+
 static int
 realmain(int argc, char* const* argv);
 
@@ -148,14 +173,22 @@ static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank);
+		      SparseMetricsDBSet* dbSet, int myRank);
 
 static string
 makeDBFileName(const string& dbDir, uint groupId, const string& profileFile);
 
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm);
+	       const string& metricDBFnm, int metricDBFmt);
+
+static void
+makeMetricsDBSetEntry(Prof::CallPath::Profile& profGbl, uint mBegId,
+		      uint mEndId, int metricDBFmt, SparseMetricsDB& db);
+
+static void
+writeMetricsDBSet(const SparseMetricsDBSet& dbSet, const string& dbDir,
+		  int myRank, int numRanks);
 
 
 static void
@@ -663,10 +696,23 @@ makeThreadMetrics(Prof::CallPath::Profile& profGbl,
 		  const vector<uint>& groupIdToGroupSizeMap,
 		  int myRank, int numRanks)
 {
+  SparseMetricsDBSet dbSet;
+  SparseMetricsDBSet* dbSetPtr =
+    (args.db_makeMetricDB && args.db_singleMetricDB) ? &dbSet : NULL;
+
   for (uint i = 0; i < nArgs.paths->size(); ++i) {
     string& fnm = (*nArgs.paths)[i];
     uint groupId = (*nArgs.groupMap)[i];
-    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax, myRank);
+    makeThreadMetrics_Lcl(profGbl, fnm, args, groupId, nArgs.groupMax,
+			  dbSetPtr, myRank);
+  }
+
+  if (dbSetPtr) {
+    // N.B.: collective
+    writeMetricsDBSet(dbSet, args.db_dir, myRank, numRanks);
+    for (uint i = 0; i < dbSet.size(); ++i) {
+      delete dbSet[i];
+    }
   }
 }
 
@@ -877,7 +923,7 @@ static void
 makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
 		      const string& profileFile,
 		      const Analysis::Args& args, uint groupId, uint groupMax,
-		      int myRank)
+		      SparseMetricsDBSet* dbSet, int myRank)
 {
   Prof::Metric::Mgr* mMgrGbl = profGbl.metricMgr();
   Prof::CCT::Tree* cctGbl = profGbl.cct();
@@ -943,8 +989,18 @@ makeThreadMetrics_Lcl(Prof::CallPath::Profile& profGbl,
     // write local sampled metric values into database
     // -------------------------------------------------------
 
-    string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
-    writeMetricsDB(profGbl, mBeg, mEnd, dbFnm);
+    if (dbSet) {
+      // written later by writeMetricsDBSet()
+      SparseMetricsDB* db = new SparseMetricsDB;
+      db->name = FileUtil::rmSuffix(FileUtil::basename(profileFile.c_str()));
+      db->groupId = groupId;
+      makeMetricsDBSetEntry(profGbl, mBeg, mEnd, args.db_metricDBFmt, *db);
+      dbSet->push_back(db);
+    }
+    else {
+      string dbFnm = makeDBFileName(args.db_dir, groupId, profileFile);
+      writeMetricsDB(profGbl, mBeg, mEnd, dbFnm, args.db_metricDBFmt);
+    }
 
     // -------------------------------------------------------
     // reinitialize metric values for next time
@@ -972,10 +1028,67 @@ makeDBFileName(const string& dbDir, uint groupId, const string& profileFile)
 }
 
 
+// makeSparseMetricsDB: Collect the nonzero values of 'packedMetrics'
+// for a version 02.00 (sparse) metric-db, grouped by node
+// (HPCMETRICDB_LAYOUT_Node) or by metric (HPCMETRICDB_LAYOUT_Metric).
+static void
+makeSparseMetricsDB(const ParallelAnalysis::PackedMetrics& packedMetrics,
+		    const hpcmetricDB_fmt_hdr_t& hdr, int metricDBFmt,
+		    SparseMetricsDB& db)
+{
+  bool byNode = (metricDBFmt == Analysis::Args::MetricDBFmt_SparseNode);
+
+  uint numMajor = (byNode) ? hdr.numNodes : hdr.numMetrics;
+  uint numMinor = (byNode) ? hdr.numMetrics : hdr.numNodes;
+
+  db.hdr = hdr;
+  db.layout = (byNode) ? HPCMETRICDB_LAYOUT_Node : HPCMETRICDB_LAYOUT_Metric;
+  db.majorPtr.push_back(0);
+
+  // node ids start at 1 (cf. dense format); metric ids at 0
+  for (uint i = 0; i < numMajor; ++i) {
+    uint64_t nnzBeg = db.values.size();
+    for (uint j = 0; j < numMinor; ++j) {
+      uint nodeId = (byNode) ? i + 1 : j + 1;
+      uint mId    = (byNode) ? j : i;
+      double x = packedMetrics.idx(nodeId, mId);
+      if (x != 0.0) {
+	db.minorIds.push_back((byNode) ? mId : nodeId);
+	db.values.push_back(x);
+      }
+    }
+    if (db.values.size() > nnzBeg) {
+      db.majorIds.push_back((byNode) ? i + 1 : i);
+      db.majorPtr.push_back(db.values.size());
+    }
+  }
+}
+
+
+uint64_t
+SparseMetricsDB::size() const
+{
+  return hpcmetricDB_fmt_sparse_size(majorIds.size(), values.size());
+}
+
+
+// Writes the metric-db at 'off' with one pwrite() per section.
+int
+SparseMetricsDB::write(int fd, uint64_t off) const
+{
+  return
+    hpcmetricDB_fmt_sparse_write(fd, off, &hdr, layout, majorIds.size(),
+				 majorIds.empty() ? NULL : &majorIds[0],
+				 &majorPtr[0],
+				 minorIds.empty() ? NULL : &minorIds[0],
+				 values.empty() ? NULL : &values[0]);
+}
+
+
 // [mBegId, mEndId)
 static void
 writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
-	       const string& metricDBFnm)
+	       const string& metricDBFnm, int metricDBFmt)
 {
   const Prof::CCT::Tree& cct = *(profGbl.cct());
 
@@ -1013,6 +1126,15 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   hdr.numMetrics = mEndId - mBegId; // [mBegId mEndId)
 
   int ret;
+
+  if (metricDBFmt != Analysis::Args::MetricDBFmt_Dense) {
+    SparseMetricsDB db;
+    makeSparseMetricsDB(packedMetrics, hdr, metricDBFmt, db);
+    if (db.write(fileno(fs), 0) == HPCFMT_ERR) goto badwrite;
+    hpcio_fclose(fs);
+    return;
+  }
+
   ret = hpcmetricDB_fmt_hdr_fwrite(&hdr, fs);
   if (ret == HPCFMT_ERR) goto badwrite;
 
@@ -1020,13 +1142,16 @@ writeMetricsDB(Prof::CallPath::Profile& profGbl, uint mBegId, uint mEndId,
   //    - first row corresponds to node 1.
   //    - first column corresponds to first sampled metric.
   // cf. ParallelAnalysis::unpackMetrics: 
-
-  for (uint nodeId = 1; nodeId < numNodes + 1; ++nodeId) {
-    for (uint mId1 = 0, mId2 = mBegId; mId2 < mEndId; ++mId1, ++mId2) {
-      double mval = packedMetrics.idx(nodeId, mId1);
-      DIAG_MsgIf(0,  "  " << nodeId << " -> " << mval);
-      ret = hpcfmt_real8_fwrite(mval, fs);
-      if (ret == HPCFMT_ERR) goto badwrite;
+  //
+  // The values are in host byte order (cf. HPCMETRICDB_FMT_Endian) and
+  // rows [1, numNodes] are contiguous in 'packedMetrics', so write
+  // them all at once.
+
+  if (numNodes > 0 && hdr.numMetrics > 0) {
+    size_t numVals = (size_t)numNodes * hdr.numMetrics;
+    if (fwrite(&packedMetrics.idx(1, 0), sizeof(double), numVals, fs)
+	!= numVals) {
+      goto badwrite;
     }
   }
 
@@ -1045,6 +1170,157 @@ badwrite:
 }
 
 
+// [mBegId, mEndId)
+static void
+makeMetricsDBSetEntry(Prof::CallPath::Profile& profGbl, uint mBegId,
+		      uint mEndId, int metricDBFmt, SparseMetricsDB& db)
+{
+  const Prof::CCT::Tree& cct = *(profGbl.cct());
+  uint maxCCTId = cct.maxDenseId();
+
+  ParallelAnalysis::PackedMetrics packedMetrics(maxCCTId + 1, mBegId, mEndId,
+						mBegId, mEndId);
+
+  ParallelAnalysis::packMetrics(profGbl, packedMetrics);
+
+  hpcmetricDB_fmt_hdr_t hdr;
+  hdr.numNodes = packedMetrics.numNodes() - 1;
+  hdr.numMetrics = mEndId - mBegId;
+
+  makeSparseMetricsDB(packedMetrics, hdr, metricDBFmt, db);
+}
+
+
+// writeMetricsDBSet: Write the metric-dbs of all ranks into one file
+// (cf. HPCMETRICDB_SET_Fnm).  Each rank's metric-dbs occupy one
+// contiguous region, ordered by rank; a rank learns where its region
+// begins from an exclusive prefix sum of region sizes and writes it
+// with pwrite().  Rank 0 gathers the index entries and writes the
+// index.  Collective.
+static void
+writeMetricsDBSet(const SparseMetricsDBSet& dbSet, const string& dbDir,
+		  int myRank, int numRanks)
+{
+  string fnm = dbDir + "/" + HPCMETRICDB_SET_Fnm;
+
+  // -------------------------------------------------------
+  // create file (rank 0) and open it (everyone)
+  // -------------------------------------------------------
+  int fd = -1;
+  if (myRank == 0) {
+    fd = open(fnm.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || hpcmetricDB_set_hdr_write(fd) == HPCFMT_ERR) {
+      DIAG_EMsg("failed creating metric database " << fnm << "; aborting.");
+      prof_abort(-1);
+    }
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  if (myRank != 0) {
+    fd = open(fnm.c_str(), O_WRONLY);
+    if (fd < 0) {
+      DIAG_EMsg("failed opening metric database " << fnm << "; aborting.");
+      prof_abort(-1);
+    }
+  }
+
+  // -------------------------------------------------------
+  // write local metric-dbs
+  // -------------------------------------------------------
+  unsigned long long myLen = 0, myOff = 0;
+  for (uint i = 0; i < dbSet.size(); ++i) {
+    myLen += dbSet[i]->size();
+  }
+
+  MPI_Exscan(&myLen, &myOff, 1, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+	     MPI_COMM_WORLD);
+  if (myRank == 0) {
+    myOff = 0; // undefined on rank 0
+  }
+
+  std::vector<hpcmetricDB_set_entry_t> entries(dbSet.size());
+  string names;
+
+  uint64_t off = HPCMETRICDB_SET_FMT_HeaderLen + myOff;
+  for (uint i = 0; i < dbSet.size(); ++i) {
+    const SparseMetricsDB& db = *dbSet[i];
+
+    hpcmetricDB_set_entry_t& e = entries[i];
+    e.off = off;
+    e.len = db.size();
+    e.nameOff = names.size(); // relative to this rank's names
+    e.nameLen = db.name.size();
+    e.groupId = db.groupId;
+    names += db.name;
+
+    if (db.write(fd, off) == HPCFMT_ERR) {
+      DIAG_EMsg("failed writing metric database " << fnm << "; aborting.");
+      prof_abort(-1);
+    }
+    off += e.len;
+  }
+
+  // -------------------------------------------------------
+  // gather index entries and write index (rank 0)
+  // -------------------------------------------------------
+  int entriesSz = entries.size() * sizeof(hpcmetricDB_set_entry_t);
+  int namesSz = names.size();
+
+  vector<int> entriesSzs(numRanks), entriesDispls(numRanks);
+  vector<int> namesSzs(numRanks), namesDispls(numRanks);
+
+  MPI_Gather(&entriesSz, 1, MPI_INT, &entriesSzs[0], 1, MPI_INT, 0,
+	     MPI_COMM_WORLD);
+  MPI_Gather(&namesSz, 1, MPI_INT, &namesSzs[0], 1, MPI_INT, 0,
+	     MPI_COMM_WORLD);
+
+  uint64_t numEntriesGbl = 0;
+  uint64_t namesLenGbl = 0;
+  if (myRank == 0) {
+    for (int r = 0; r < numRanks; ++r) {
+      entriesDispls[r] = numEntriesGbl * sizeof(hpcmetricDB_set_entry_t);
+      namesDispls[r] = namesLenGbl;
+      numEntriesGbl += entriesSzs[r] / sizeof(hpcmetricDB_set_entry_t);
+      namesLenGbl += namesSzs[r];
+    }
+  }
+
+  std::vector<hpcmetricDB_set_entry_t> entriesGbl(numEntriesGbl + 1);
+  std::vector<char> namesGbl(namesLenGbl + 1);
+
+  MPI_Gatherv(entries.empty() ? NULL : &entries[0], entriesSz, MPI_BYTE,
+	      &entriesGbl[0], &entriesSzs[0], &entriesDispls[0], MPI_BYTE,
+	      0, MPI_COMM_WORLD);
+  MPI_Gatherv((void*)names.data(), namesSz, MPI_CHAR,
+	      &namesGbl[0], &namesSzs[0], &namesDispls[0], MPI_CHAR,
+	      0, MPI_COMM_WORLD);
+
+  if (myRank == 0) {
+    // make name offsets relative to the global names; find end of data
+    uint64_t indexOff = HPCMETRICDB_SET_FMT_HeaderLen;
+    uint64_t k = 0;
+    for (int r = 0; r < numRanks; ++r) {
+      uint numEntries = entriesSzs[r] / sizeof(hpcmetricDB_set_entry_t);
+      for (uint i = 0; i < numEntries; ++i, ++k) {
+	entriesGbl[k].nameOff += namesDispls[r];
+	indexOff = std::max(indexOff, entriesGbl[k].off + entriesGbl[k].len);
+      }
+    }
+
+    int ret = hpcmetricDB_set_index_write(fd, indexOff, &entriesGbl[0],
+					  numEntriesGbl, &namesGbl[0],
+					  namesLenGbl);
+    if (ret == HPCFMT_ERR) {
+      DIAG_EMsg("failed writing metric database " << fnm << "; aborting.");
+      prof_abort(-1);
+    }
+  }
+
+  close(fd);
+}
+
+
 //***************************************************************************
 
 static void
@@ -0,0 +1,287 @@
+// -*-Mode: C++;-*-
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//***************************************************************************
+//
+// File:
+//   src/tool/hpcquery/main.cpp
+//
+// Purpose:
+//   a program that shows the hottest call paths of a running program
+//
+// Description:
+//   connects to the live query socket of a process measured with
+//   'hpcrun --live-query', reads the merged profile snapshot it sends
+//   (hpcrun-fmt) and prints the call paths with the largest exclusive
+//   value of one metric.
+//
+//***************************************************************************
+
+//***************************************************************************
+// global include files
+//***************************************************************************
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+
+
+//***************************************************************************
+// local include files
+//***************************************************************************
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+
+
+//***************************************************************************
+// local types
+//***************************************************************************
+
+struct Node {
+  uint32_t parent;
+  uint16_t lm_id;
+  uint64_t lm_ip;
+  double value;
+};
+
+
+// orders node indices by decreasing value
+struct ByValue {
+  ByValue(const std::vector<Node>& nodes) : m_nodes(nodes) { }
+
+  bool
+  operator()(uint32_t a, uint32_t b) const
+  { return m_nodes[a].value > m_nodes[b].value; }
+
+  const std::vector<Node>& m_nodes;
+};
+
+
+
+//***************************************************************************
+// private operations
+//***************************************************************************
+
+static void
+usage(const char* prog)
+{
+  fprintf(stderr,
+	  "usage: %s [-n <num-paths>] [-m <metric-id>] <socket>\n"
+	  "  <socket>  hpcrun-<pid>.sock in the measurement directory of a\n"
+	  "            process run with 'hpcrun --live-query'\n"
+	  "  -n        number of call paths to show {10}\n"
+	  "  -m        metric to rank call paths by {0}\n", prog);
+  exit(-1);
+}
+
+
+static FILE*
+connect_socket(const char* prog, const char* path)
+{
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "%s: socket path too long: %s\n", prog, path);
+    exit(-1);
+  }
+  strcpy(addr.sun_path, path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+    fprintf(stderr, "%s: unable to connect to %s: %s\n", prog, path,
+	    strerror(errno));
+    exit(-1);
+  }
+  return fdopen(fd, "r");
+}
+
+
+static double
+metric_value(const metric_desc_t& desc, const hpcrun_metricVal_t& val)
+{
+  if (desc.flags.fields.valFmt == MetricFlags_ValFmt_Real) {
+    return val.r;
+  }
+  return (double) val.i;
+}
+
+
+
+//***************************************************************************
+// interface functions
+//***************************************************************************
+
+int
+main(int argc, char **argv)
+{
+  uint numPaths = 10;
+  uint metricId = 0;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:m:")) != -1) {
+    switch (opt) {
+    case 'n': numPaths = strtoul(optarg, NULL, 10); break;
+    case 'm': metricId = strtoul(optarg, NULL, 10); break;
+    default:  usage(argv[0]);
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+  }
+
+  FILE* infs = connect_socket(argv[0], argv[optind]);
+
+  hpcrun_fmt_hdr_t hdr;
+  hpcrun_fmt_epochHdr_t ehdr;
+  metric_tbl_t metricTbl;
+  metric_aux_info_t* aux_info;
+  loadmap_t loadmap;
+  uint64_t numNodes = 0;
+
+  if (hpcrun_fmt_hdr_fread(&hdr, infs, malloc) != HPCFMT_OK
+      || hpcrun_fmt_epochHdr_fread(&ehdr, infs, malloc) != HPCFMT_OK
+      || hpcrun_fmt_metricTbl_fread(&metricTbl, &aux_info, infs, hdr.version,
+				    malloc) != HPCFMT_OK
+      || hpcrun_fmt_loadmap_fread(&loadmap, infs, malloc) != HPCFMT_OK
+      || hpcfmt_int8_fread(&numNodes, infs) != HPCFMT_OK) {
+    fprintf(stderr, "%s: error reading the profile snapshot\n", argv[0]);
+    exit(-1);
+  }
+
+  if (metricId >= metricTbl.len) {
+    fprintf(stderr, "%s: no metric %u; the metrics are:\n", argv[0], metricId);
+    for (uint i = 0; i < metricTbl.len; i++) {
+      fprintf(stderr, "  %u: %s\n", i, metricTbl.lst[i].name);
+    }
+    exit(-1);
+  }
+  const metric_desc_t& metric = metricTbl.lst[metricId];
+
+  std::map<uint16_t, std::string> lmNames;
+  for (uint i = 0; i < loadmap.len; i++) {
+    lmNames[loadmap.lst[i].id] = loadmap.lst[i].name;
+  }
+
+  // ------------------------------------------------------------
+  // read the cct: a node's parent is written before the node
+  // ------------------------------------------------------------
+  std::vector<Node> nodes;
+  std::map<uint32_t, uint32_t> idToNode;
+  std::vector<hpcrun_metricVal_t> metrics(metricTbl.len);
+  double total = 0;
+
+  hpcrun_fmt_cct_node_t nodeFmt;
+  nodeFmt.num_metrics = metricTbl.len;
+  nodeFmt.metrics = &metrics[0];
+
+  for (uint64_t i = 0; i < numNodes; i++) {
+    if (hpcrun_fmt_cct_node_fread(&nodeFmt, ehdr.flags, infs) != HPCFMT_OK) {
+      fprintf(stderr, "%s: error reading cct node %" PRIu64 "\n", argv[0], i);
+      exit(-1);
+    }
+    // leaves have negative ids
+    uint32_t id = (uint32_t) abs((int32_t) nodeFmt.id);
+    std::map<uint32_t, uint32_t>::iterator parent = idToNode.find(nodeFmt.id_parent);
+
+    Node n;
+    n.parent = (parent == idToNode.end()) ? UINT32_MAX : parent->second;
+    n.lm_id = nodeFmt.lm_id;
+    n.lm_ip = nodeFmt.lm_ip;
+    n.value = metric_value(metric, metrics[metricId]);
+    total += n.value;
+
+    idToNode[id] = nodes.size();
+    nodes.push_back(n);
+  }
+  hpcio_fclose(infs);
+
+  // ------------------------------------------------------------
+  // print the call paths of the nodes with the largest values
+  // ------------------------------------------------------------
+  std::vector<uint32_t> order;
+  for (uint32_t i = 0; i < nodes.size(); i++) {
+    if (nodes[i].value > 0) order.push_back(i);
+  }
+  numPaths = std::min(numPaths, (uint) order.size());
+  std::partial_sort(order.begin(), order.begin() + numPaths, order.end(),
+		    ByValue(nodes));
+
+  printf("%s: %" PRIu64 " call path nodes, total %s = %g\n",
+	 argv[optind], numNodes, metric.name, total);
+
+  for (uint k = 0; k < numPaths; k++) {
+    const Node& leaf = nodes[order[k]];
+    printf("\n#%u  %g (%.1f%%)\n", k + 1, leaf.value,
+	   (total > 0) ? 100.0 * leaf.value / total : 0.0);
+
+    std::vector<uint32_t> path;
+    for (uint32_t i = order[k]; i != UINT32_MAX; i = nodes[i].parent) {
+      path.push_back(i);
+    }
+    for (size_t d = path.size(); d-- > 0; ) {
+      const Node& n = nodes[path[d]];
+      if (n.lm_id == HPCRUN_FMT_LMId_NULL) continue; // root and placeholders
+      printf("    %s+0x%" PRIx64 "\n", lmNames[n.lm_id].c_str(), n.lm_ip);
+    }
+  }
+
+  return 0;
+}
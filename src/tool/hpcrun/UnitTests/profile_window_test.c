@@ -0,0 +1,256 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//******************************************************************************
+// File: profile_window_test.c
+// Purpose: check that closing a profile window starts the next one from
+//   zero (HPCRUN_PROFILE_WINDOW)
+//
+// A window is closed by copying every node's metrics, as
+// window_copy_node in write_data.c does (each lookup splays the
+// thread's cct2metrics map), and then resetting the map.  The test
+// writes two windows in hpcrun-fmt cct node records, reads them back
+// and checks that the second window holds only its own counts, and
+// that the nodes keep their metric sets across windows.
+//
+// As hpcserver's UnitTests, the test is not part of the build or of
+// 'make check'.  Build and run it by hand from src/tool/hpcrun, with
+// the include flags of hpcrun and -DNO_HPCRUN_MSGS, linking
+// cct2metrics.c and, from prof-lean, hpcrun-fmt.c hpcfmt.c hpcio.c
+// hpcio-buffer.c hpcio-z.c spinlock.c lush/lush-support.c (and -llzma).
+//******************************************************************************
+
+#undef NDEBUG
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <hpcrun/cct2metrics.h>
+#include <hpcrun/metrics.h>
+#include <hpcrun/thread_data.h>
+
+#include <lib/prof-lean/hpcrun-fmt.h>
+
+
+//******************************************************************************
+// stand-ins for the hpcrun runtime used by cct2metrics.c
+//******************************************************************************
+
+#define NUM_METRICS 2
+#define NUM_NODES   200
+
+struct metric_set_t {
+  hpcrun_metricVal_t v1;
+};
+
+thread_data_t* (*hpcrun_get_thread_data)(void) = NULL;
+
+void*
+hpcrun_malloc(size_t size)
+{
+  return malloc(size);
+}
+
+int
+debug_flag_get(dbg_category flag)
+{
+  return 0;
+}
+
+void
+hpcrun_emsg(const char *fmt,...)
+{
+  abort();
+}
+
+int
+hpcrun_get_num_metrics(void)
+{
+  return NUM_METRICS;
+}
+
+static int num_sets = 0;
+
+metric_set_t*
+hpcrun_metric_set_new(void)
+{
+  num_sets++;
+  return malloc(NUM_METRICS * sizeof(hpcrun_metricVal_t));
+}
+
+cct_metric_data_t*
+hpcrun_metric_set_loc(metric_set_t* s, int id)
+{
+  return &(s->v1) + id;
+}
+
+void
+hpcrun_metric_set_combine(metric_set_t* dst, metric_set_t* src)
+{
+  for (int i = 0; i < NUM_METRICS; i++) {
+    hpcrun_metric_set_loc(dst, i)->i += hpcrun_metric_set_loc(src, i)->i;
+  }
+}
+
+
+//******************************************************************************
+// test
+//******************************************************************************
+
+// the cct nodes are only used as keys of the map
+static char nodes[NUM_NODES];
+
+#define NODE(i) ((cct_node_id_t) &(nodes[i]))
+
+
+// take 'count' samples of metric 'metric_id' in node 'i'
+static void
+sample(cct2metrics_t** map, int i, int metric_id, uint64_t count)
+{
+  metric_set_t* set = hpcrun_get_metric_set_specific(map, NODE(i));
+  if (! set) {
+    set = hpcrun_metric_set_new();
+    memset(set, 0, NUM_METRICS * sizeof(hpcrun_metricVal_t));
+    cct2metrics_assoc_specific(map, NODE(i), set);
+  }
+  hpcrun_metric_set_loc(set, metric_id)->i += count;
+}
+
+
+// write the metrics of all nodes and close the window
+static void
+close_window(cct2metrics_t** map, FILE* fs)
+{
+  epoch_flags_t flags = { .bits = 0 };
+  hpcrun_metricVal_t metrics[NUM_METRICS];
+  hpcrun_fmt_cct_node_t rec;
+  hpcrun_fmt_cct_node_init(&rec);
+  rec.num_metrics = NUM_METRICS;
+  rec.metrics = metrics;
+
+  // a stride through the nodes splays the map well away from its
+  // root before the reset
+  for (int k = 0; k < NUM_NODES; k++) {
+    int i = (k * 7) % NUM_NODES;
+    rec.id = i + 1;
+    memset(metrics, 0, sizeof(metrics));
+    metric_set_t* set = hpcrun_get_metric_set_specific(map, NODE(i));
+    if (set) {
+      memcpy(metrics, set, sizeof(metrics));
+    }
+    assert(hpcrun_fmt_cct_node_fwrite(&rec, flags, fs) == HPCFMT_OK);
+  }
+
+  hpcrun_cct2metrics_reset(map);
+}
+
+
+// read one window back into 'vals', indexed by node
+static void
+read_window(FILE* fs, uint64_t vals[NUM_NODES][NUM_METRICS])
+{
+  epoch_flags_t flags = { .bits = 0 };
+  hpcrun_metricVal_t metrics[NUM_METRICS];
+  hpcrun_fmt_cct_node_t rec;
+  hpcrun_fmt_cct_node_init(&rec);
+  rec.num_metrics = NUM_METRICS;
+  rec.metrics = metrics;
+
+  for (int k = 0; k < NUM_NODES; k++) {
+    assert(hpcrun_fmt_cct_node_fread(&rec, flags, fs) == HPCFMT_OK);
+    assert(1 <= rec.id && rec.id <= NUM_NODES);
+    for (int m = 0; m < NUM_METRICS; m++) {
+      vals[rec.id - 1][m] = metrics[m].i;
+    }
+  }
+}
+
+
+int
+main(int argc, char** argv)
+{
+  cct2metrics_t* map;
+  hpcrun_cct2metrics_init(&map);
+
+  FILE* fs = tmpfile();
+  assert(fs);
+
+  // window 0: every node has samples of both metrics
+  for (int i = 0; i < NUM_NODES; i++) {
+    sample(&map, i, 0, 100 + i);
+    sample(&map, i, 1, 1);
+  }
+  close_window(&map, fs);
+
+  // window 1: only every third node, and only metric 1.  the nodes
+  // must be found again in the map, not get a second metric set
+  for (int i = 0; i < NUM_NODES; i += 3) {
+    sample(&map, i, 1, 5);
+  }
+  assert(num_sets == NUM_NODES);
+  close_window(&map, fs);
+
+  static uint64_t win0[NUM_NODES][NUM_METRICS];
+  static uint64_t win1[NUM_NODES][NUM_METRICS];
+  rewind(fs);
+  read_window(fs, win0);
+  read_window(fs, win1);
+  fclose(fs);
+
+  for (int i = 0; i < NUM_NODES; i++) {
+    assert(win0[i][0] == 100 + i);
+    assert(win0[i][1] == 1);
+
+    assert(win1[i][0] == 0);
+    assert(win1[i][1] == ((i % 3 == 0) ? 5 : 0));
+  }
+
+  printf("profile windows: second window has no counts of the first\n");
+  return 0;
+}
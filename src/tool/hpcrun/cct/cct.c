@@ -72,10 +72,12 @@
 #include <string.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <sys/mman.h>
 
 //*************************** User Include Files ****************************
 
 #include <memory/hpcrun-malloc.h>
+#include <memory/mmap.h>
 #include <hpcrun/metrics.h>
 #include <messages/messages.h>
 #include <lib/prof-lean/splay-macros.h>
@@ -104,6 +106,10 @@ struct cct_node_t {
   cct_addr_t addr;
 
   bool is_leaf;
+
+  // referenced from outside the cct (eg, a thread creation context),
+  // so the node must outlive its epoch.
+  bool is_pinned;
   
   // ---------------------------------------------------------
   // tree structure
@@ -148,8 +154,8 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   size_t sz = sizeof(cct_node_t);
   cct_node_t *node;
 
-  // FIXME: when multiple epochs really work, this will always be freeable.
-  // WARN ME (krentel) if/when we really use freeable memory.
+  // With FREEABLE, the nodes of an epoch's cct are released when the
+  // epoch is reset (see hpcrun_cct_retire).
   if (ENABLED(FREEABLE)) {
     node = hpcrun_malloc_freeable(sz);
   }
@@ -171,6 +177,7 @@ cct_node_create(cct_addr_t* addr, cct_node_t* parent)
   node->right = NULL;
 
   node->is_leaf = false;
+  node->is_pinned = false;
 
   return node;
 }
@@ -255,10 +262,13 @@ walk_path_l(cct_node_t* node, cct_op_t op, cct_op_arg_t arg, size_t level)
 //
 
 typedef struct {
+  cct2metrics_t** cct2metrics_map;  // owner's map: splays update its root
   hpcfmt_uint_t num_metrics;
   FILE* fs;
   epoch_flags_t flags;
   hpcrun_fmt_cct_node_t* tmp_node;
+  uint64_t* idx;     // cct-idx entries, or NULL
+  uint64_t num_idx;
 } write_arg_t;
 
 
@@ -291,9 +301,25 @@ lwrite(cct_node_t* node, cct_op_arg_t arg, size_t level)
   tmp->lm_ip = (hpcfmt_vma_t) (uintptr_t) (addr->ip_norm).lm_ip;
 
   tmp->num_metrics = my_arg->num_metrics;
-  hpcrun_metric_set_dense_copy(tmp->metrics, hpcrun_get_metric_set(node),
+  hpcrun_metric_set_dense_copy(tmp->metrics,
+			       hpcrun_get_metric_set_specific(my_arg->cct2metrics_map, node),
 			       my_arg->num_metrics);
   hpcrun_fmt_cct_node_fwrite(tmp, flags, my_arg->fs);
+
+  if (my_arg->idx) {
+    uint64_t id = (uint32_t) hpcrun_cct_persistent_id(node);
+    my_arg->idx[my_arg->num_idx] = (id << 32) | my_arg->num_idx;
+    my_arg->num_idx++;
+  }
+}
+
+
+static int
+cmp_idx(const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*) a;
+  uint64_t y = *(const uint64_t*) b;
+  return (x < y) ? -1 : (x > y);
 }
 
 //
@@ -492,6 +518,14 @@ hpcrun_cct_retained(cct_node_t* x)
   return (x->persistent_id & HPCRUN_FMT_RetainIdFlag);
 }
 
+// mark a node as referenced from outside of its cct, so that it
+// (and its path to the root) survives hpcrun_cct_retire.
+void
+hpcrun_cct_pin(cct_node_t* x)
+{
+  x->is_pinned = true;
+}
+
 //
 // Walking functions section:
 //
@@ -583,23 +617,39 @@ hpcrun_cct_insert_path(cct_node_t ** root, cct_node_t* path)
 // Writing operation
 //
 int
-hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags)
+hpcrun_cct_fwrite(cct2metrics_t** cct2metrics_map, cct_node_t* cct, FILE* fs,
+		  epoch_flags_t flags, hpcrun_fmt_tocEntry_t* toc)
 {
   if (!fs) return HPCRUN_ERR;
 
-  hpcfmt_int8_fwrite((uint64_t) hpcrun_cct_num_nodes(cct), fs);
-  TMSG(DATA_WRITE, "num cct nodes = %d", hpcrun_cct_num_nodes(cct));
-
+  size_t num_nodes = hpcrun_cct_num_nodes(cct);
   hpcfmt_uint_t num_metrics = hpcrun_get_num_metrics();
+
+  if (toc) {
+    toc->cctOff = ftello(fs);
+    toc->numNodes = num_nodes;
+    toc->numMetrics = num_metrics;
+    toc->nodeSz = hpcrun_fmt_cct_node_size(flags, num_metrics);
+  }
+
+  hpcfmt_int8_fwrite((uint64_t) num_nodes, fs);
+  TMSG(DATA_WRITE, "num cct nodes = %d", num_nodes);
   TMSG(DATA_WRITE, "num metrics in a cct node = %d", num_metrics);
   
   hpcrun_fmt_cct_node_t tmp_node;
 
+  // the cct-idx sorts (id, position) pairs of the nodes
+  size_t idx_size = num_nodes * sizeof(uint64_t);
+  uint64_t* idx = (num_nodes > 0) ? hpcrun_mmap_anon(idx_size) : NULL;
+
   write_arg_t write_arg = {
+    .cct2metrics_map = cct2metrics_map,
     .num_metrics = num_metrics,
     .fs          = fs,
     .flags       = flags,
     .tmp_node    = &tmp_node,
+    .idx         = idx,
+    .num_idx     = 0,
   };
   
   hpcrun_metricVal_t metrics[num_metrics];
@@ -607,6 +657,19 @@ hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags)
 
   hpcrun_cct_walk_node_1st(cct, lwrite, &write_arg);
 
+  if (toc) {
+    toc->cctIdxOff = ftello(fs);
+  }
+  if (idx) {
+    qsort(idx, write_arg.num_idx, sizeof(uint64_t), cmp_idx);
+    hpcrun_fmt_cctIdx_fwrite(idx, write_arg.num_idx, fs);
+    munmap(idx, idx_size);
+  }
+  else {
+    // no memory for the index: an empty one keeps the file readable
+    hpcrun_fmt_cctIdx_fwrite(NULL, 0, fs);
+  }
+
   return HPCRUN_OK;
 }
 
@@ -668,6 +731,7 @@ static void cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src);
 typedef struct {
   cct_node_t* targ;
   merge_op_t fn;
+  cct_op_t join;
   merge_op_arg_t arg;
 } mjarg_t;
 
@@ -679,13 +743,18 @@ void
 hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
 		 merge_op_t merge, merge_op_arg_t arg)
 {
-  if (hpcrun_cct_is_leaf (cct_a) && hpcrun_cct_is_leaf(cct_b)) {
-    merge(cct_a, cct_b, arg);
-  }
+  hpcrun_cct_merge_join(cct_a, cct_b, merge, NULL, arg);
+}
+
+void
+hpcrun_cct_merge_join(cct_node_t* cct_a, cct_node_t* cct_b,
+		      merge_op_t merge, cct_op_t join, merge_op_arg_t arg)
+{
+  merge(cct_a, cct_b, arg);
   if (! cct_b->children)
     cct_b->children = cct_a->children;
   else {
-    mjarg_t local = (mjarg_t) {.targ = cct_a, .fn = merge, .arg = arg};
+    mjarg_t local = (mjarg_t) {.targ = cct_a, .fn = merge, .join = join, .arg = arg};
     hpcrun_cct_walkset(cct_b->children, merge_or_join, (cct_op_arg_t) &local);
   }
 }
@@ -699,9 +768,11 @@ merge_or_join(cct_node_t* n, cct_op_arg_t a, size_t l)
   mjarg_t* the_arg = (mjarg_t*) a;
   cct_node_t* targ = the_arg->targ;
   if (cct_child_find_cache(targ, hpcrun_cct_addr(n)))
-    hpcrun_cct_merge(splay_cache.node, n, the_arg->fn, the_arg->arg);
-  else
+    hpcrun_cct_merge_join(splay_cache.node, n, the_arg->fn, the_arg->join, the_arg->arg);
+  else {
     cct_disjoint_union_cached(targ, n);
+    if (the_arg->join) the_arg->join(n, the_arg->arg, l);
+  }
 }
 
 static cct_addr_t dc = ADDR2_I(-1, -1);
@@ -765,3 +836,47 @@ cct_disjoint_union_cached(cct_node_t* target, cct_node_t* src)
   }
   target->children = src;
 }
+
+//
+// Retiring a cct:
+//   Nodes are released post-order.  A node that is pinned, retained,
+//   or has such a descendant is kept: its parent path may still be
+//   walked (creation contexts, trace call paths), but its child set
+//   is cleared, since the children may be gone.
+//
+
+static bool cct_retire_node(cct_node_t* node);
+
+static bool
+cct_retire_set(cct_node_t* set)
+{
+  if (! set) return true;
+
+  bool released = cct_retire_set(set->left);
+  released = cct_retire_set(set->right) && released;
+  return cct_retire_node(set) && released;
+}
+
+static bool
+cct_retire_node(cct_node_t* node)
+{
+  bool released = cct_retire_set(node->children);
+
+  if (! released || node->is_pinned || hpcrun_cct_retained(node)) {
+    node->children = NULL;
+    node->left = node->right = NULL;
+    return false;
+  }
+  hpcrun_free_deferred(node);
+  return true;
+}
+
+bool
+hpcrun_cct_retire(cct_node_t* cct)
+{
+  if (! cct) return true;
+
+  splay_cache.node = NULL;
+  splay_cache.found = false;
+  return cct_retire_node(cct);
+}
@@ -177,6 +177,10 @@ extern void hpcrun_cct_retain(cct_node_t* x);
 // call path.
 extern int hpcrun_cct_retained(cct_node_t* x);
 
+// mark a node as referenced from outside its cct (eg, by the creation
+// context of a thread), so that it outlives its epoch.
+extern void hpcrun_cct_pin(cct_node_t* x);
+
 
 // Walking functions section:
 //
@@ -241,9 +245,16 @@ extern void hpcrun_walk_path(cct_node_t* node, cct_op_t op, cct_op_arg_t arg);
 //
 extern void hpcrun_cct_walkset(cct_node_t* cct, cct_op_t fn, cct_op_arg_t arg);
 //
-// Writing operation
+// Writing operation: metrics of each node are looked up in the given
+// cct2metrics map (passed by reference, as lookups splay it), so a
+// thread may write the cct of another thread.
+//
+struct cct2metrics_t;
+
+// If 'toc' is non-NULL, fills in its cct fields.
 //
-int hpcrun_cct_fwrite(cct_node_t* cct, FILE* fs, epoch_flags_t flags);
+int hpcrun_cct_fwrite(struct cct2metrics_t** cct2metrics_map, cct_node_t* cct,
+		      FILE* fs, epoch_flags_t flags, hpcrun_fmt_tocEntry_t* toc);
 //
 // Utilities
 //
@@ -262,10 +273,30 @@ extern cct_node_t* hpcrun_cct_find_addr(cct_node_t* cct, cct_addr_t* addr);
 //    NOTE: this merge operation presumes
 //       cct_addr_data(CCT_A) == cct_addr_data(CCT_B)
 //
+//    NOTE: paths of CCT_B that are not in CCT_A are moved, not copied,
+//       so CCT_B must not be used after the merge.
+//
 typedef void* merge_op_arg_t;
 typedef void (*merge_op_t)(cct_node_t* a, cct_node_t*b, merge_op_arg_t arg);
 
 extern void hpcrun_cct_merge(cct_node_t* cct_a, cct_node_t* cct_b,
 			     merge_op_t merge, merge_op_arg_t arg);
 
+//
+// as hpcrun_cct_merge, but also call 'join' on the root of each
+// subtree of CCT_B that is moved into CCT_A (if 'join' is non-NULL).
+//
+extern void hpcrun_cct_merge_join(cct_node_t* cct_a, cct_node_t* cct_b,
+				  merge_op_t merge, cct_op_t join,
+				  merge_op_arg_t arg);
+
+//
+// Release the nodes of a cct that is no longer in use (the cct of a
+// reset epoch) to the freeable allocator.  Only meaningful for nodes
+// from hpcrun_malloc_freeable, ie, with the FREEABLE debug flag.
+// Pinned and retained nodes, with their ancestors, are kept.
+// Returns true if the whole cct was released.
+//
+extern bool hpcrun_cct_retire(cct_node_t* cct);
+
 #endif // cct_h
@@ -104,7 +104,9 @@ hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt)
 // Write to file for cct bundle: 
 //
 int 
-hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl)
+hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl,
+			 struct cct2metrics_t** cct2metrics_map,
+			 hpcrun_fmt_tocEntry_t* toc)
 {
   if (!fs) { return HPCRUN_ERR; }
 
@@ -123,7 +125,50 @@ hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* bndl)
 
   // write out newly constructed cct
 
-  return hpcrun_cct_fwrite(bndl->top, fs, flags);
+  return hpcrun_cct_fwrite(cct2metrics_map, bndl->top, fs, flags, toc);
+}
+
+//
+// Merge two cct bundles:
+//   the main trees and the partial unwind trees are merged separately,
+//   since the partial unwind tree is only attached to the main tree
+//   when the bundle is written.
+//
+void
+hpcrun_cct_bundle_merge(cct_bundle_t* dst, cct_bundle_t* src,
+			merge_op_t merge, cct_op_t join, merge_op_arg_t arg)
+{
+  hpcrun_cct_merge_join(dst->top, src->top, merge, join, arg);
+
+  // if 'src' was already written, its partial unwind tree is part of
+  // src->top and was merged above.
+  if (! hpcrun_cct_parent(src->partial_unw_root)) {
+    hpcrun_cct_merge_join(dst->partial_unw_root, src->partial_unw_root,
+			  merge, join, arg);
+  }
+  dst->num_nodes += src->num_nodes;
+}
+
+//
+// Release the nodes of a bundle that is no longer in use.
+//   the partial unwind tree (and the idle node under it) are only
+//   part of the main tree if the bundle was written.
+//
+void
+hpcrun_cct_bundle_retire(cct_bundle_t* bundle)
+{
+  bool partial_attached = hpcrun_cct_parent(bundle->partial_unw_root) != NULL;
+  bool idle_attached = hpcrun_cct_parent(bundle->special_idle_node) != NULL;
+
+  hpcrun_cct_retire(bundle->top);
+  if (! partial_attached) {
+    hpcrun_cct_retire(bundle->partial_unw_root);
+  }
+  if (! idle_attached) {
+    hpcrun_cct_retire(bundle->special_idle_node);
+  }
+  bundle->top = bundle->tree_root = bundle->thread_root = NULL;
+  bundle->partial_unw_root = bundle->special_idle_node = NULL;
 }
 
 //
@@ -85,7 +85,23 @@ extern void hpcrun_cct_bundle_init(cct_bundle_t* bundle, cct_ctxt_t* ctxt);
 //
 // IO for cct bundle
 //
-extern int hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* x);
+extern int hpcrun_cct_bundle_fwrite(FILE* fs, epoch_flags_t flags, cct_bundle_t* x,
+				    struct cct2metrics_t** cct2metrics_map,
+				    hpcrun_fmt_tocEntry_t* toc);
+
+//
+// merge cct bundle 'src' into 'dst' (see hpcrun_cct_merge_join).
+// 'src' must not be used afterwards.
+//
+extern void hpcrun_cct_bundle_merge(cct_bundle_t* dst, cct_bundle_t* src,
+				    merge_op_t merge, cct_op_t join,
+				    merge_op_arg_t arg);
+
+//
+// release the nodes of bundle 'bundle' (see hpcrun_cct_retire).
+// 'bundle' must be re-initialized before it is used again.
+//
+extern void hpcrun_cct_bundle_retire(cct_bundle_t* bundle);
 
 //
 // utility functions
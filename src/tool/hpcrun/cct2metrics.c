@@ -130,12 +130,18 @@ hpcrun_reify_metric_set(cct_node_id_t cct_id)
 metric_set_t*
 hpcrun_get_metric_set(cct_node_id_t cct_id)
 {
-  cct2metrics_t* map = THREAD_LOCAL_MAP();
+  return hpcrun_get_metric_set_specific(&THREAD_LOCAL_MAP(), cct_id);
+}
+
+metric_set_t*
+hpcrun_get_metric_set_specific(cct2metrics_t** map_p, cct_node_id_t cct_id)
+{
+  cct2metrics_t* map = *map_p;
   TMSG(CCT2METRICS, "GET_METRIC_SET for %p, using map %p", cct_id, map);
   if (! map) return NULL;
 
   map = splay(map, cct_id);
-  THREAD_LOCAL_MAP() = map;
+  *map_p = map;
   TMSG(CCT2METRICS, " -- After Splay map = %p", cct_id, map);
 
   if (map->node == cct_id) {
@@ -161,7 +167,13 @@ hpcrun_has_metric_set(cct_node_id_t cct_id)
 void
 cct2metrics_assoc(cct_node_id_t node, metric_set_t* metrics)
 {
-  cct2metrics_t* map = THREAD_LOCAL_MAP();
+  cct2metrics_assoc_specific(&THREAD_LOCAL_MAP(), node, metrics);
+}
+
+void
+cct2metrics_assoc_specific(cct2metrics_t** map_p, cct_node_id_t node, metric_set_t* metrics)
+{
+  cct2metrics_t* map = *map_p;
   TMSG(CCT2METRICS, "CCT2METRICS_ASSOC for %p, using map %p", node, map);
   if (! map) {
     map = cct2metrics_new(node, metrics);
@@ -192,7 +204,48 @@ cct2metrics_assoc(cct_node_id_t node, metric_set_t* metrics)
       TMSG(CCT2METRICS, " -- new map after insertion %p.(%p, %p)", map->node, map->left, map->right);
     }
   }
-  THREAD_LOCAL_MAP() = map;
-  TMSG(CCT2METRICS, "METRICS_ASSOC final, THREAD_LOCAL_MAP = %p", THREAD_LOCAL_MAP());
-  if (ENABLED(CCT2METRICS)) splay_tree_dump(THREAD_LOCAL_MAP());
+  *map_p = map;
+  TMSG(CCT2METRICS, "METRICS_ASSOC final, map = %p", *map_p);
+  if (ENABLED(CCT2METRICS)) splay_tree_dump(*map_p);
+}
+
+//
+// combine the metrics of 'src' into those of 'dst' (see
+// hpcrun_metric_set_combine).
+// the two nodes may live in different maps (ie, different threads).
+//
+void
+hpcrun_cct2metrics_accumulate(cct2metrics_t** dst_map, cct_node_id_t dst,
+			      cct2metrics_t** src_map, cct_node_id_t src)
+{
+  metric_set_t* src_set = hpcrun_get_metric_set_specific(src_map, src);
+  if (! src_set) return;
+
+  metric_set_t* dst_set = hpcrun_get_metric_set_specific(dst_map, dst);
+  if (dst_set) {
+    hpcrun_metric_set_combine(dst_set, src_set);
+  }
+  else {
+    // nothing to combine with: 'dst' takes over the metrics of 'src'
+    cct2metrics_assoc_specific(dst_map, dst, src_set);
+  }
+}
+
+static void
+help_reset_metrics(cct2metrics_t* tree, size_t set_size)
+{
+  if (! tree) return;
+
+  if (tree->metrics) {
+    memset(tree->metrics, 0, set_size);
+  }
+  help_reset_metrics(tree->left, set_size);
+  help_reset_metrics(tree->right, set_size);
+}
+
+void
+hpcrun_cct2metrics_reset(cct2metrics_t** map)
+{
+  TMSG(CCT2METRICS, "RESET map %p", *map);
+  help_reset_metrics(*map, hpcrun_get_num_metrics() * sizeof(cct_metric_data_t));
 }
@@ -51,6 +51,32 @@ extern bool hpcrun_has_metric_set(cct_node_id_t cct_id);
 
 extern void cct2metrics_assoc(cct_node_t* node, metric_set_t* metrics);
 
+//
+// variants of the above that operate on an explicitly given map
+// rather than the map of the calling thread. These are used when one
+// thread manipulates the profile of another (eg, when thread profiles
+// are merged at process exit).
+//
+extern metric_set_t* hpcrun_get_metric_set_specific(cct2metrics_t** map,
+						    cct_node_id_t cct_id);
+
+extern void cct2metrics_assoc_specific(cct2metrics_t** map,
+				       cct_node_t* node, metric_set_t* metrics);
+
+//
+// add the metrics of node 'src' (found in 'src_map') into the metrics
+// of node 'dst' (found in 'dst_map'), creating a metric set for 'dst'
+// if necessary.
+//
+extern void hpcrun_cct2metrics_accumulate(cct2metrics_t** dst_map, cct_node_id_t dst,
+					  cct2metrics_t** src_map, cct_node_id_t src);
+
+//
+// zero every metric set in 'map', keeping the sets (and the cct nodes
+// they belong to) in place.
+//
+extern void hpcrun_cct2metrics_reset(cct2metrics_t** map);
+
 //extern cct2metrics_t* cct2metrics_new(cct_node_id_t node, metric_set_t* metrics);
 
 typedef enum {SET, INCR} update_metric_t;
@@ -54,6 +54,13 @@ cct_backtrace_finalize(
 }
 
 
+bool
+cct_backtrace_finalize_registered(void)
+{
+  return finalizers != NULL || cursor_finalize != NULL;
+}
+
+
 cct_node_t *
 cct_cursor_finalize(
   cct_bundle_t *cct,
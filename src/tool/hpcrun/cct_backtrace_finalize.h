@@ -59,4 +59,7 @@ extern cct_node_t *cct_cursor_finalize(
   cct_node_t *cursor
 );
 
+
+extern bool cct_backtrace_finalize_registered(void);
+
 #endif
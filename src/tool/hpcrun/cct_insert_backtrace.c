@@ -90,9 +90,14 @@ hpcrun_kernel_callpath_register(hpcrun_kernel_callpath_t kcp)
 	hpcrun_kernel_callpath = kcp;
 }
 
+//
+// if 'parents' is not NULL, parents[i] receives the node below which
+// frame path_end + i is inserted
+//
 static cct_node_t*
 cct_insert_raw_backtrace(cct_node_t* cct,
-                            frame_t* path_beg, frame_t* path_end)
+                            frame_t* path_beg, frame_t* path_end,
+                            cct_node_t** parents)
 {
   TMSG(BT_INSERT, "%s : start", __func__);
   if (!cct) return NULL; // nowhere to insert
@@ -105,6 +110,7 @@ cct_insert_raw_backtrace(cct_node_t* cct,
 
   ip_normalized_t parent_routine = ip_normalized_NULL;
   for(; path_beg >= path_end; path_beg--){
+    if (parents) parents[path_beg - path_end] = cct;
     if ( (! retain_recursion) &&
 	 (path_beg >= path_end + 1) && 
          ip_normalized_eq(&(path_beg->the_function), &(parent_routine)) &&
@@ -141,9 +147,9 @@ hpcrun_set_retain_recursion_mode(bool mode)
 }
 
 
-// See usage in header.
-cct_node_t*
-hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* path_end)
+static cct_node_t*
+cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* path_end,
+		     cct_node_t** parents)
 {
   TMSG(FENCE, "insert backtrace into treenode %p", treenode);
   TMSG(FENCE, "backtrace below");
@@ -152,7 +158,7 @@ hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* pa
     ENABLE(BT_INSERT);
   }
 
-  cct_node_t* path = cct_insert_raw_backtrace(treenode, path_beg, path_end);
+  cct_node_t* path = cct_insert_raw_backtrace(treenode, path_beg, path_end, parents);
   if (! bt_ins) DISABLE(BT_INSERT);
 
   // Put lush as_info class correction here
@@ -174,14 +180,14 @@ hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* pa
   return path;
 }
 
-// See usage in header.
-cct_node_t*
-hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
-				     int metric_id,
-				     frame_t* path_beg, frame_t* path_end,
-				     cct_metric_data_t datum, void *data_aux)
+static cct_node_t*
+cct_insert_backtrace_w_metric(cct_node_t* treenode,
+			      int metric_id,
+			      frame_t* path_beg, frame_t* path_end,
+			      cct_metric_data_t datum, void *data_aux,
+			      cct_node_t** parents)
 {
-  cct_node_t* path = hpcrun_cct_insert_backtrace(treenode, path_beg, path_end);
+  cct_node_t* path = cct_insert_backtrace(treenode, path_beg, path_end, parents);
 
   if (hpcrun_kernel_callpath) {
     path = hpcrun_kernel_callpath(path, data_aux);
@@ -199,6 +205,24 @@ hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
   return path;
 }
 
+// See usage in header.
+cct_node_t*
+hpcrun_cct_insert_backtrace(cct_node_t* treenode, frame_t* path_beg, frame_t* path_end)
+{
+  return cct_insert_backtrace(treenode, path_beg, path_end, NULL);
+}
+
+// See usage in header.
+cct_node_t*
+hpcrun_cct_insert_backtrace_w_metric(cct_node_t* treenode,
+				     int metric_id,
+				     frame_t* path_beg, frame_t* path_end,
+				     cct_metric_data_t datum, void *data_aux)
+{
+  return cct_insert_backtrace_w_metric(treenode, metric_id, path_beg, path_end,
+				       datum, data_aux, NULL);
+}
+
 //
 // Insert new backtrace in cct
 //
@@ -351,6 +375,11 @@ hpcrun_cct_record_backtrace_w_metric(cct_bundle_t* cct, bool partial,
     cct_cursor = cct->thread_root;
     TMSG(FENCE, "Thread stop ==> cursor = %p", cct_cursor);
   }
+  if (bt->prefix) {
+    // the outer frames are those of the previous backtrace
+    cct_cursor = bt->prefix;
+    TMSG(FENCE, "Prefix reuse ==> cursor = %p", cct_cursor);
+  }
 
   cct_cursor = cct_cursor_finalize(cct, bt, cct_cursor);
 
@@ -358,9 +387,16 @@ hpcrun_cct_record_backtrace_w_metric(cct_bundle_t* cct, bool partial,
   TMSG(FENCE, "further sanity check: bt->last frame = (%d, %p)", 
        bt->last->ip_norm.lm_id, bt->last->ip_norm.lm_ip);
 
-  return hpcrun_cct_insert_backtrace_w_metric(cct_cursor, metricId,
-					      bt->last, bt->begin, 
-					      (cct_metric_data_t) metricIncr, data);
+  cct_node_t** parents = partial ? NULL : hpcrun_bt_prefix_parents(bt);
+
+  cct_node_t* path =
+    cct_insert_backtrace_w_metric(cct_cursor, metricId,
+				  bt->last, bt->begin,
+				  (cct_metric_data_t) metricIncr, data, parents);
+
+  if (parents) hpcrun_bt_prefix_update(bt);
+
+  return path;
 
 }
 
@@ -390,6 +426,7 @@ help_hpcrun_backtrace2cct(cct_bundle_t* bundle, ucontext_t* context,
     if ( bt.fence == FENCE_MAIN &&
 	 ! bt.partial_unwind &&
 	 ! tramp_found &&
+	 ! bt.prefix &&
 	 (bt.last == bt.begin || 
 	  ! hpcrun_inbounds_main(hpcrun_frame_get_unnorm(bt.last - 1)))) {
       hpcrun_bt_dump(TD_GET(btbuf_cur), "WRONG MAIN");
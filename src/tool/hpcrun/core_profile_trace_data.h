@@ -29,10 +29,17 @@ typedef struct core_profile_trace_data_t {
   uint64_t trace_min_time_us;
   uint64_t trace_max_time_us;
 
+  // ----------------------------------------
+  // continuous profiling: window whose metrics
+  // are accumulating (see write_data.c)
+  // ----------------------------------------
+  uint64_t profile_window;
+
   // ----------------------------------------
   // IO support
   // ----------------------------------------
   FILE* hpcrun_file;
+  struct profile_toc_s* hpcrun_file_toc; // epochs written to hpcrun_file
   void* trace_buffer;
   hpcio_outbuf_t trace_outbuf;
 
@@ -49,9 +49,20 @@ const char* HPCRUN_OPT_LUSH_AGENTS = "HPCRUN_OPT_LUSH_AGENTS";
 
 const char* HPCRUN_OUT_PATH        = "HPCRUN_OUT_PATH";
 const char* HPCRUN_TRACE           = "HPCRUN_TRACE";
+const char* HPCRUN_COMPRESS        = "HPCRUN_COMPRESS";
 
 const char* PAPI_EVENT_LIST        = "PAPI_EVENT_LIST";
 
 const char* HPCRUN_EVENT_LIST      = "HPCRUN_EVENT_LIST";
 const char* HPCRUN_MEMSIZE         = "HPCRUN_MEMSIZE";
 const char* HPCRUN_LOW_MEMSIZE     = "HPCRUN_LOW_MEMSIZE";
+const char* HPCRUN_MEMSTORE_HUGEPAGES = "HPCRUN_MEMSTORE_HUGEPAGES";
+const char* HPCRUN_MEMSTORE_NUMA   = "HPCRUN_MEMSTORE_NUMA";
+
+const char* HPCRUN_MERGE_THREADS   = "HPCRUN_MERGE_THREADS";
+const char* HPCRUN_REUSE_THREADS   = "HPCRUN_REUSE_THREADS";
+
+const char* HPCRUN_UNWIND_REUSE    = "HPCRUN_UNWIND_REUSE";
+
+const char* HPCRUN_PROFILE_WINDOW  = "HPCRUN_PROFILE_WINDOW";
+const char* HPCRUN_LIVE_QUERY      = "HPCRUN_LIVE_QUERY";
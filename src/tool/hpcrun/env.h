@@ -84,9 +84,20 @@ extern const char* HPCRUN_OPT_LUSH_AGENTS;
 extern const char* HPCRUN_OUT_PATH;
 
 extern const char* HPCRUN_TRACE;
+extern const char* HPCRUN_COMPRESS;
 
 extern const char* HPCRUN_EVENT_LIST;
 extern const char* HPCRUN_MEMSIZE;
 extern const char* HPCRUN_LOW_MEMSIZE;
+extern const char* HPCRUN_MEMSTORE_HUGEPAGES;
+extern const char* HPCRUN_MEMSTORE_NUMA;
+
+extern const char* HPCRUN_MERGE_THREADS;
+extern const char* HPCRUN_REUSE_THREADS;
+
+extern const char* HPCRUN_UNWIND_REUSE;
+
+extern const char* HPCRUN_PROFILE_WINDOW;
+extern const char* HPCRUN_LIVE_QUERY;
 
 #endif /* hpcrun_env_h */
@@ -155,5 +155,21 @@ hpcrun_epoch_reset(void)
   TMSG(EPOCH_RESET, "check new loadmap = old loadmap = %d", newepoch->loadmap == epoch->loadmap);
   hpcrun_cct_bundle_init(&(newepoch->csdata), newepoch->csdata_ctxt); // reset cct
   hpcrun_reset_epoch(newepoch);
+  // nodes of the old cct must not be updated anymore (see
+  // hpcrun_sample_callpath_again)
+  TD_GET(epoch_gen)++;
+
+  //
+  // with freeable cct nodes, the (already written) ccts of the old
+  // epochs can go.  their metrics go too, since the released nodes
+  // will be reused by the new cct.
+  //
+  if (ENABLED(FREEABLE)) {
+    for (epoch_t *old = epoch; old != NULL; old = old->next) {
+      hpcrun_cct_bundle_retire(&(old->csdata));
+    }
+    TD_GET(core_profile_trace_data.cct2metrics_map) = NULL;
+    TMSG(EPOCH_RESET, "released ccts of old epochs");
+  }
   TMSG(EPOCH_RESET," ==> no new epoch for next sample = %d", newepoch->loadmap == hpcrun_getLoadmap());
 }
@@ -110,6 +110,7 @@
 #include <stdlib.h>  // realpath
 #include <string.h>  // strerror
 #include <unistd.h>  // gethostid
+#include <inttypes.h>  // PRIu64
 #include <sys/time.h>   // gettimeofday
 #include <sys/types.h>  // struct stat
 #include <sys/stat.h>   // stat 
@@ -128,6 +129,7 @@
 #include "loadmap.h"
 #include "sample_prob.h"
 
+#include <lib/prof-lean/hpcio-z.h>
 #include <lib/prof-lean/spinlock.h>
 #include <lib/support-lean/OSUtil.h>
 
@@ -139,6 +141,9 @@
 // directory/progname-rank-thread-hostid-pid-gen.suffix
 #define FILENAME_TEMPLATE  "%s/%s-%06u-%03d-" HOSTID_FORMAT "-%u-%d.%s"
 
+// progname-hostid-pid-gen.suffix, one per process
+#define DICTNAME_TEMPLATE  "%s-" HOSTID_FORMAT "-%u-%d.%s"
+
 #define FILES_RANDOM_GEN  4
 #define FILES_MAX_GEN     11
 
@@ -168,6 +173,9 @@ static char output_directory[PATH_MAX] = {'\0'};
 static char executable_name[PATH_MAX] = {'\0'};
 static char executable_pathname[PATH_MAX] = {'\0'};
 
+// compression level for profiles and traces, -1 = uncompressed
+static int compress_level = -1;
+
 // These variables are protected by the files lock.
 // Opening or renaming a file must acquire the lock.
 
@@ -175,6 +183,7 @@ static spinlock_t files_lock = SPINLOCK_UNLOCKED;
 static pid_t mypid = 0;
 static struct fileid earlyid;
 static struct fileid lateid;
+static struct fileid dictid;
 static int log_done = 0;
 static int log_rename_done = 0;
 static int log_rename_ret = 0;
@@ -187,6 +196,31 @@ static int log_rename_ret = 0;
 // In general, the external functions acquire the files lock and the
 // internal functions require that the lock is already held.
 
+// HPCRUN_COMPRESS is a compression level, 0 (fastest) to 9, or empty
+// for the default level.
+static void
+hpcrun_files_set_compress(void)
+{
+  char *str = getenv(HPCRUN_COMPRESS);
+
+  if (str == NULL) {
+    return;
+  }
+  if (*str == '\0') {
+    compress_level = HPCIO_Z_LevelDefault;
+    return;
+  }
+
+  char *end = NULL;
+  long level = strtol(str, &end, 10);
+  if (*end != '\0' || hpcio_z_enc_worksz((int) level) == 0) {
+    EMSG("HPCToolkit: ignoring invalid compression level: '%s'", str);
+    return;
+  }
+  compress_level = (int) level;
+}
+
+
 // Reset the file ids on first use (pid 0) or after fork.
 static void
 hpcrun_files_init(void)
@@ -199,6 +233,7 @@ hpcrun_files_init(void)
     earlyid.host = OSUtil_hostid();
     earlyid.gen = 0;
     lateid = earlyid;
+    dictid = earlyid;
     log_done = 0;
     log_rename_done = 0;
     log_rename_ret = 0;
@@ -406,6 +441,8 @@ hpcrun_files_set_directory()
   if (!rpath) {
     hpcrun_abort("hpcrun: could not access directory `%s': %s", path, strerror(errno));
   }
+
+  hpcrun_files_set_compress();
 }
 
 
@@ -416,6 +453,15 @@ hpcrun_files_output_directory()
 }
 
 
+// Returns the compression level for profiles and traces, or -1 if
+// they are written uncompressed.
+int
+hpcrun_files_compress_level(void)
+{
+  return compress_level;
+}
+
+
 void 
 hpcrun_files_set_executable(char *execname)
 {
@@ -480,6 +526,74 @@ hpcrun_open_profile_file(int rank, int thread)
 }
 
 
+// Returns: file descriptor for the profile of one time window in
+// continuous-profiling mode, named like the thread's profile with a
+// window tag before the suffix (...-gen.w000012.hpcrun), so a subset
+// of windows can be selected by name.  Unlike the final profile, this
+// does not rename the log file: the MPI rank may not be known yet.
+int
+hpcrun_open_profile_window_file(int rank, int thread, uint64_t window)
+{
+  char suffix[64];
+  int ret;
+
+  snprintf(suffix, sizeof(suffix), "w%06" PRIu64 ".%s",
+	   window, HPCRUN_ProfileFnmSfx);
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+  ret = hpcrun_open_file(rank, thread, suffix, FILES_LATE);
+  spinlock_unlock(&files_lock);
+
+  return ret;
+}
+
+
+// Returns: file descriptor for the process's dictionary, whose file
+// name (without the directory) is copied to 'name' of size 'len'.
+int
+hpcrun_open_dictionary_file(char *name, size_t len)
+{
+  char path[PATH_MAX];
+  int fd, ret;
+
+  spinlock_lock(&files_lock);
+  hpcrun_files_init();
+
+  name[0] = '\0';
+  if (! hpcrun_sample_prob_active()) {
+    fd = open("/dev/null", O_WRONLY);
+    spinlock_unlock(&files_lock);
+    return fd;
+  }
+
+  for (;;) {
+    errno = 0;
+    ret = snprintf(name, len, DICTNAME_TEMPLATE, executable_name,
+		   dictid.host, mypid, dictid.gen, HPCRUN_DictFnmSfx);
+    if ((size_t) ret >= len
+	|| snprintf(path, PATH_MAX, "%s/%s", output_directory, name) >= PATH_MAX) {
+      fd = -1;
+      errno = ENAMETOOLONG;
+      break;
+    }
+    fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd >= 0 || errno != EEXIST || hpcrun_files_next_id(&dictid) != 0) {
+      break;
+    }
+  }
+  dictid.done = 1;
+  spinlock_unlock(&files_lock);
+
+  if (fd < 0) {
+    EMSG("hpctoolkit: unable to open %s file: '%s': %s",
+	 HPCRUN_DictFnmSfx, name, strerror(errno));
+  }
+
+  return fd;
+}
+
+
 // Note: we use the log file as the lock for the file names, so we
 // need to rename the log file as the first late action.  Since this
 // is out of sequence, we save the return value and return it when the
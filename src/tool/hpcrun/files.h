@@ -47,6 +47,9 @@
 #ifndef files_h
 #define files_h
 
+#include <stddef.h>
+#include <stdint.h>
+
 
 //*****************************************************************************
 // forward declarations
@@ -58,10 +61,13 @@ void hpcrun_files_set_executable(char *execname);
 const char *hpcrun_files_executable_pathname();
 const char *hpcrun_files_executable_name();
 const char *hpcrun_files_output_directory();
+int hpcrun_files_compress_level(void);
 
 int hpcrun_open_log_file(void);
 int hpcrun_open_trace_file(int thread);
 int hpcrun_open_profile_file(int rank, int thread);
+int hpcrun_open_profile_window_file(int rank, int thread, uint64_t window);
+int hpcrun_open_dictionary_file(char *name, size_t len);
 int hpcrun_rename_log_file(int rank);
 int hpcrun_rename_trace_file(int rank, int thread);
 
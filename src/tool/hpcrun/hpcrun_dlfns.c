@@ -62,6 +62,7 @@
 
 #include "hpcrun_dlfns.h"
 #include "fnbounds_interface.h"
+#include "loadmap.h"
 #include "sample_event.h"
 #include "thread_data.h"
 
@@ -71,36 +72,42 @@
 
 
 //
-// Protect dlopen(), dlclose() and dl_iterate_phdr() with a readers-
-// writers lock.  That is, either one writer and no readers, or else
-// no writers and any number of readers.
+// Protect dlclose() and dl_iterate_phdr() with a readers-writers
+// lock.  That is, either one writer and no readers, or else no
+// writers and any number of readers.
 //
-// dlopen and dlclose modify the internal dl data structures, so
-// they're writers, dl_iterate_phdr (via sampling or pthread_create)
-// is a reader.  Note: this lock needs to be process-wide.
+// dlclose unmaps code and removes load modules and unwind recipes, so
+// it's a writer.  Sampling and pthread_create are readers.  Note:
+// this lock needs to be process-wide.
 //
-// Now allow a writer to lock against itself.  That is, we record the
-// thread id of the writer and if a nested dlopen (from init ctor)
-// happens in the same thread, then we allow the thread to proceed.
-// Normally, this would be dangerous (exposes inconsistent state).
-// But in this case, the init ctor occurs after the dangerous part.
-// This is necessary to handle nested dlopens in an init constructor.
+// dlopen does not take the writers lock.  A new module is published
+// to the loadmap (and unpoisoned in the recipe map) only after it is
+// fully analyzed, so a sample taken during dlopen unwinds against a
+// consistent snapshot of the modules that were already there.  The
+// only sample we can't handle is one whose IP lies in the module
+// being mapped (e.g., in its init constructor), and those are
+// deferred, see hpcrun_dlopen_defer_sample().
 //
-// And if we could just separate dlopen() into mmap() and its init
-// constructor, then we'd only need to block the mmap part. :-(
+// Allow a writer to lock against itself.  That is, we record the
+// thread id of the writer and if a nested dlclose or dlopen (from a
+// fini dtor) happens in the same thread, then we allow the thread to
+// proceed.
 //
 // DLOPEN_RISKY disables the read locks (always succeed), so that
-// sampling will never be blocked in this case.  But we keep the write
-// locks for the benefit of the fnbounds functions.
+// sampling will never be blocked in this case, and it lets fnbounds
+// analyze the module being mapped from inside the sample instead of
+// deferring the sample.  But we keep the write locks for the benefit
+// of the fnbounds functions.
 //
 static spinlock_t dlopen_lock = SPINLOCK_UNLOCKED;
 static atomic_long dlopen_num_readers = ATOMIC_VAR_INIT(0);
 static volatile long dlopen_num_writers = 0;
 static int  dlopen_writer_tid = -1;
 static atomic_long num_dlopen_pending = ATOMIC_VAR_INIT(0);
+static __thread long dlopen_depth = 0;
+static __thread long dlclose_depth = 0;
 
 
-// We use this only in the DLOPEN_RISKY case.
 long
 hpcrun_dlopen_pending(void)
 {
@@ -140,16 +147,6 @@ hpcrun_dlopen_write_unlock(void)
 }
 
 
-// Downgrade the dlopen lock from a writers lock to a readers lock.
-// Must already hold the writers lock.
-static void
-hpcrun_dlopen_downgrade_lock(void)
-{
-  atomic_fetch_add_explicit(&dlopen_num_readers, 1L, memory_order_relaxed);
-  dlopen_num_writers = 0;
-}
-
-
 // Readers try to acquire a lock, but they don't wait if that fails.
 // Returns: 1 if acquired, else 0 if not.
 int
@@ -175,36 +172,50 @@ hpcrun_dlopen_read_unlock(void)
 }
 
 
+// An async sample taken while a dlopen is pending is deferred only if
+// its IP is not covered by any load module published so far.
+// Returns: 1 if the sample should be deferred, else 0.
+int
+hpcrun_dlopen_defer_sample(void *ip)
+{
+  if (hpcrun_dlopen_pending() == 0 || ENABLED(DLOPEN_RISKY)) {
+    return 0;
+  }
+  return hpcrun_loadmap_findByAddr(ip, ip) == NULL;
+}
+
+
 void 
 hpcrun_pre_dlopen(const char *path, int flags)
 {
-  hpcrun_dlopen_write_lock();
   atomic_fetch_add_explicit(&num_dlopen_pending, 1L, memory_order_relaxed);
+  dlopen_depth++;
   TD_GET(inside_dlfcn) = true;
 }
 
 
-// It's safe to downgrade the lock during fnbounds_map_open_dsos()
-// because it acquires the dl-iterate lock before the fnbounds lock,
-// and that order is consistent with sampling.  Note: can only
-// downgrade the lock on the last (outermost) dlopen.
+// fnbounds_map_open_dsos() runs under the readers lock, which only
+// excludes a concurrent dlclose.  It acquires the dl-iterate lock
+// before the fnbounds lock, and that order is consistent with
+// sampling.  If this thread already holds the writers lock (dlopen
+// from a fini dtor), then it already excludes everyone else.
 //
 void 
 hpcrun_dlopen(const char *module_name, int flags, void *handle)
 {
-  int outermost = (dlopen_num_writers == 1);
+  int writer = (dlclose_depth > 0);
 
   TMSG(LOADMAP, "dlopen: handle = %p, name = %s", handle, module_name);
-  if (outermost) {
-    hpcrun_dlopen_downgrade_lock();
+  if (! writer) {
+    while (! hpcrun_dlopen_read_lock()) ;
   }
   fnbounds_map_open_dsos();
   atomic_fetch_add_explicit(&num_dlopen_pending, -1L, memory_order_relaxed);
-  if (outermost) {
-    TD_GET(inside_dlfcn) = false;
+  if (! writer) {
     hpcrun_dlopen_read_unlock();
-  } else {
-    hpcrun_dlopen_write_unlock();
+  }
+  if (--dlopen_depth == 0 && ! writer) {
+    TD_GET(inside_dlfcn) = false;
   }
 }
 
@@ -213,6 +224,7 @@ void
 hpcrun_dlclose(void *handle)
 {
   hpcrun_dlopen_write_lock();
+  dlclose_depth++;
   TD_GET(inside_dlfcn) = true;
 }
 
@@ -228,6 +240,7 @@ hpcrun_post_dlclose(void *handle, int ret)
 
   TMSG(LOADMAP, "dlclose: handle = %p", handle);
   fnbounds_unmap_closed_dsos();
+  dlclose_depth--;
   if (outermost) {
     TD_GET(inside_dlfcn) = false;
   }
@@ -56,5 +56,6 @@ void hpcrun_dlclose(void *handle);
 void hpcrun_post_dlclose(void *handle, int ret);
 
 long hpcrun_dlopen_pending(void);
+int  hpcrun_dlopen_defer_sample(void *ip);
 
 #endif
@@ -79,6 +79,9 @@ static atomic_long trolled = ATOMIC_VAR_INIT(0);
 static atomic_long frames_total = ATOMIC_VAR_INIT(0);
 static atomic_long trolled_frames = ATOMIC_VAR_INIT(0);
 
+static atomic_long validation_cache_hits = ATOMIC_VAR_INIT(0);
+static atomic_long validation_cache_misses = ATOMIC_VAR_INIT(0);
+
 //***************************************************************************
 // interface operations
 //***************************************************************************
@@ -97,6 +100,8 @@ hpcrun_stats_reinit(void)
   atomic_store_explicit(&trolled, 0, memory_order_relaxed);
   atomic_store_explicit(&frames_total, 0, memory_order_relaxed);
   atomic_store_explicit(&trolled_frames, 0, memory_order_relaxed);
+  atomic_store_explicit(&validation_cache_hits, 0, memory_order_relaxed);
+  atomic_store_explicit(&validation_cache_misses, 0, memory_order_relaxed);
 }
 
 
@@ -315,6 +320,22 @@ hpcrun_stats_trolled_frames(void)
   return atomic_load_explicit(&trolled_frames, memory_order_relaxed);
 }
 
+//---------------------------------------------------------------------
+// lookups in the return address validation cache
+//---------------------------------------------------------------------
+
+void
+hpcrun_stats_validation_cache_hit_inc(void)
+{
+  atomic_fetch_add_explicit(&validation_cache_hits, 1L, memory_order_relaxed);
+}
+
+void
+hpcrun_stats_validation_cache_miss_inc(void)
+{
+  atomic_fetch_add_explicit(&validation_cache_misses, 1L, memory_order_relaxed);
+}
+
 //----------------------------
 // samples yielded due to deadlock prevention
 //----------------------------
@@ -362,6 +383,13 @@ hpcrun_stats_print_summary(void)
        frames_total, trolled_frames,
        num_unwind_intervals_total,  num_unwind_intervals_suspicious);
 
+  long vc_hits = atomic_load_explicit(&validation_cache_hits, memory_order_relaxed);
+  long vc_misses = atomic_load_explicit(&validation_cache_misses, memory_order_relaxed);
+  if (vc_hits + vc_misses > 0) {
+    AMSG("RETURN ADDRESS VALIDATION CACHE: hits: %ld, misses: %ld",
+	 vc_hits, vc_misses);
+  }
+
   if (hpcrun_get_disabled()) {
     AMSG("SAMPLING HAS BEEN DISABLED");
   }
@@ -158,6 +158,13 @@ long hpcrun_stats_frames_total(void);
 void hpcrun_stats_trolled_frames_inc(long amt);
 long hpcrun_stats_trolled_frames(void);
 
+//---------------------------------------------------------------------
+// lookups in the return address validation cache
+//---------------------------------------------------------------------
+
+void hpcrun_stats_validation_cache_hit_inc(void);
+void hpcrun_stats_validation_cache_miss_inc(void);
+
 //-----------------------------
 // print summary
 //-----------------------------
@@ -0,0 +1,644 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+
+//******************************************************************************
+// File: live_query.c
+// Purpose: serve snapshots of the profiles of all threads over a Unix socket
+//
+// With HPCRUN_LIVE_QUERY set, a helper thread listens on the Unix socket
+// <measurement-dir>/hpcrun-<pid>.sock.  Each connection requests one
+// snapshot.  The helper announces it, and at the end of its next sample
+// each thread copies its own CCTs and metrics into a flat, mmap-ed part:
+// there, the thread is the only one that touches its CCT and no other
+// sample can interrupt it, so no node is seen half-inserted.  Sampling
+// goes on throughout.  The helper collects the parts, waiting at most
+// LIVE_QUERY_WAIT_MS for threads that do not sample, merges them by
+// call path and writes the result to the connection as a profile in
+// hpcrun-fmt (one epoch, no trace).
+//
+// A snapshot only covers the threads that are alive.  The profile of a
+// thread that has exited is either in its own file already or, when
+// threads are merged or their data reused, held by the thread manager
+// until it is written at process exit; it is not part of a snapshot.
+//
+// The helper is not a monitored thread: it has no thread data, takes no
+// samples and must not use the memstore (hpcrun_malloc).  All its memory
+// is mmap-ed and unmapped when the snapshot has been written.
+//******************************************************************************
+
+
+
+//******************************************************************************
+// system include files
+//******************************************************************************
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+
+//******************************************************************************
+// local include files
+//******************************************************************************
+
+#include "env.h"
+#include "epoch.h"
+#include "files.h"
+#include "hpcrun_dlfns.h"
+#include "live_query.h"
+#include "loadmap.h"
+#include "metrics.h"
+#include "threadmgr.h"
+
+#include <cct/cct.h>
+#include <cct/cct_bundle.h>
+#include <memory/mmap.h>
+#include <messages/messages.h>
+#include <monitor.h>
+
+#include <lib/prof-lean/hpcfmt.h>
+#include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/stdatomic.h>
+#include <lib/support-lean/OSUtil.h>
+
+
+
+//******************************************************************************
+// macros
+//******************************************************************************
+
+#define LIVE_QUERY_NO_PARENT  UINT32_MAX
+#define LIVE_QUERY_EMPTY      UINT32_MAX
+
+// how long to wait for the parts of threads that do not sample
+#define LIVE_QUERY_WAIT_MS  1000
+#define LIVE_QUERY_POLL_MS  10
+
+// persistent ids of the merged tree: even, starting past the reserved ids
+#define LIVE_QUERY_ID(i)  (2 * (uint32_t) (i) + 12)
+
+
+
+//******************************************************************************
+// type declarations
+//******************************************************************************
+
+typedef struct live_query_node_t {
+  uint32_t parent;       // index of the parent node, or LIVE_QUERY_NO_PARENT
+  uint16_t lm_id;
+  bool has_children;     // only maintained in the merged tree
+  uintptr_t lm_ip;
+} live_query_node_t;
+
+
+// the copy of the CCTs of one thread
+typedef struct live_query_part_t {
+  struct live_query_part_t *next;
+  uint64_t gen;                  // snapshot the part belongs to
+  size_t size;                   // bytes mapped, including this header
+  uint32_t num_nodes;
+  uint32_t num_metrics;
+  live_query_node_t *nodes;      // in preorder: parents come first
+  hpcrun_metricVal_t *metrics;   // num_nodes x num_metrics
+  uint32_t *scratch;             // num_nodes + 2 entries
+} live_query_part_t;
+
+
+// the merged tree: nodes are keyed by (parent, lm_id, lm_ip)
+typedef struct live_query_tree_t {
+  size_t size;
+  uint32_t num_nodes;
+  uint32_t num_metrics;
+  uint32_t table_mask;
+  live_query_node_t *nodes;
+  hpcrun_metricVal_t *metrics;
+  uint32_t *table;
+} live_query_tree_t;
+
+
+typedef struct copy_arg_t {
+  live_query_part_t *part;
+  cct2metrics_t **map;
+} copy_arg_t;
+
+
+
+//******************************************************************************
+// private data
+//******************************************************************************
+
+static char socket_path[sizeof(((struct sockaddr_un *) 0)->sun_path)];
+static int listen_fd = -1;
+
+static atomic_int snapshot_open = ATOMIC_VAR_INIT(0);
+static atomic_uint_least64_t snapshot_gen = ATOMIC_VAR_INIT(0);
+static _Atomic(live_query_part_t *) snapshot_parts = ATOMIC_VAR_INIT(NULL);
+static atomic_int snapshot_num_parts = ATOMIC_VAR_INIT(0);
+
+static __thread uint64_t snapshot_gen_seen = 0;
+
+
+
+//******************************************************************************
+// private operations: sampled threads
+//******************************************************************************
+
+static void
+count_node(cct_node_t *node, cct_op_arg_t arg, size_t level)
+{
+  (*(size_t *) arg)++;
+}
+
+
+static void
+copy_node(cct_node_t *node, cct_op_arg_t arg, size_t level)
+{
+  copy_arg_t *a = (copy_arg_t *) arg;
+  live_query_part_t *part = a->part;
+  uint32_t i = part->num_nodes++;
+  cct_addr_t *addr = hpcrun_cct_addr(node);
+
+  // the nodes of the path to 'node' are the last ones seen at each level
+  part->scratch[level] = i;
+  part->nodes[i].parent = (level > 0) ? part->scratch[level - 1] : LIVE_QUERY_NO_PARENT;
+  part->nodes[i].lm_id = addr->ip_norm.lm_id;
+  part->nodes[i].lm_ip = addr->ip_norm.lm_ip;
+  part->nodes[i].has_children = false;
+
+  hpcrun_metric_set_dense_copy(part->metrics + (size_t) i * part->num_metrics,
+			       hpcrun_get_metric_set_specific(a->map, node),
+			       part->num_metrics);
+}
+
+
+// walk the ccts of all epochs, attaching each partial unwind tree that
+// was not written yet below the top of its epoch (scratch[0] after the
+// walk of the top).
+static void
+walk_epochs(core_profile_trace_data_t *cptd, cct_op_t op, cct_op_arg_t arg)
+{
+  for (epoch_t *e = cptd->epoch; e; e = e->next) {
+    cct_bundle_t *cct = &(e->csdata);
+    hpcrun_cct_walk_node_1st(cct->top, op, arg);
+    if (! hpcrun_cct_parent(cct->partial_unw_root)) {
+      hpcrun_cct_walk_node_1st_w_level(cct->partial_unw_root, op, arg, 1);
+    }
+  }
+}
+
+
+static void
+push_part(live_query_part_t *part)
+{
+  live_query_part_t *head = atomic_load_explicit(&snapshot_parts, memory_order_relaxed);
+  do {
+    part->next = head;
+  } while (! atomic_compare_exchange_weak_explicit(&snapshot_parts, &head, part,
+						   memory_order_release,
+						   memory_order_relaxed));
+  atomic_fetch_add_explicit(&snapshot_num_parts, 1, memory_order_release);
+}
+
+
+
+//******************************************************************************
+// private operations: helper thread
+//******************************************************************************
+
+static void
+sleep_ms(long ms)
+{
+  struct timespec ts = { .tv_sec = 0, .tv_nsec = ms * 1000000 };
+  nanosleep(&ts, NULL);
+}
+
+
+static void
+free_parts(live_query_part_t *part)
+{
+  while (part) {
+    live_query_part_t *next = part->next;
+    munmap(part, part->size);
+    part = next;
+  }
+}
+
+
+static uint32_t
+tree_insert(live_query_tree_t *tree, uint32_t parent, uint16_t lm_id, uintptr_t lm_ip)
+{
+  uint64_t h = ((uint64_t) parent * 0x9E3779B97F4A7C15ull)
+    ^ ((uint64_t) lm_ip * 0xC2B2AE3D27D4EB4Full) ^ lm_id;
+  h ^= h >> 31;
+
+  for (uint32_t slot = h & tree->table_mask; ; slot = (slot + 1) & tree->table_mask) {
+    uint32_t i = tree->table[slot];
+    if (i == LIVE_QUERY_EMPTY) {
+      i = tree->num_nodes++;
+      tree->nodes[i].parent = parent;
+      tree->nodes[i].lm_id = lm_id;
+      tree->nodes[i].lm_ip = lm_ip;
+      tree->nodes[i].has_children = false;
+      if (parent != LIVE_QUERY_NO_PARENT) {
+	tree->nodes[parent].has_children = true;
+      }
+      tree->table[slot] = i;
+      return i;
+    }
+    live_query_node_t *n = &(tree->nodes[i]);
+    if (n->parent == parent && n->lm_id == lm_id && n->lm_ip == lm_ip) {
+      return i;
+    }
+  }
+}
+
+
+//
+// merge the parts of snapshot 'gen' by call path.
+// returns: false if out of memory
+//
+static bool
+tree_merge(live_query_tree_t *tree, live_query_part_t *parts, uint64_t gen)
+{
+  size_t total = 0;
+  for (live_query_part_t *p = parts; p; p = p->next) {
+    if (p->gen == gen) total += p->num_nodes;
+  }
+
+  uint32_t table_size = 16;
+  while (table_size < 2 * total) table_size *= 2;
+
+  // a part exists, so the thread that made it has finalized the metric
+  // table: this does not allocate
+  tree->num_nodes = 0;
+  tree->num_metrics = hpcrun_get_num_metrics();
+  tree->table_mask = table_size - 1;
+  tree->size = total * sizeof(live_query_node_t)
+    + total * tree->num_metrics * sizeof(hpcrun_metricVal_t)
+    + table_size * sizeof(uint32_t);
+
+  char *mem = hpcrun_mmap_anon(tree->size);
+  if (mem == NULL) return false;
+
+  tree->nodes = (live_query_node_t *) mem;
+  tree->metrics = (hpcrun_metricVal_t *) (tree->nodes + total);
+  tree->table = (uint32_t *) (tree->metrics + total * tree->num_metrics);
+  memset(tree->table, 0xff, table_size * sizeof(uint32_t));
+
+  for (live_query_part_t *p = parts; p; p = p->next) {
+    if (p->gen != gen) continue;
+
+    int num_metrics = (p->num_metrics < tree->num_metrics) ?
+      p->num_metrics : tree->num_metrics;
+
+    // reuse the scratch space of the part to map its nodes to merged nodes
+    uint32_t *map = p->scratch;
+    for (uint32_t k = 0; k < p->num_nodes; k++) {
+      live_query_node_t *n = &(p->nodes[k]);
+      uint32_t parent = (n->parent == LIVE_QUERY_NO_PARENT) ?
+	LIVE_QUERY_NO_PARENT : map[n->parent];
+      uint32_t i = tree_insert(tree, parent, n->lm_id, n->lm_ip);
+      map[k] = i;
+
+      metric_set_t *set = (metric_set_t *) (tree->metrics + (size_t) i * tree->num_metrics);
+      hpcrun_metricVal_t *vals = p->metrics + (size_t) k * p->num_metrics;
+      for (int m = 0; m < num_metrics; m++) {
+	// combine as sampling into one thread would (eg, max for a max)
+	metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(m);
+	if (! upd_proc) upd_proc = hpcrun_metric_std_inc;
+	upd_proc(m, set, vals[m]);
+      }
+    }
+  }
+  return true;
+}
+
+
+static void
+tree_fwrite(FILE *fs, live_query_tree_t *tree, int num_threads)
+{
+  const uint bufSZ = 32; // sufficient to hold a 64-bit integer in base 10
+
+  const char* jobIdStr = OSUtil_jobid();
+  if (!jobIdStr) {
+    jobIdStr = "";
+  }
+
+  char hostidStr[bufSZ];
+  snprintf(hostidStr, bufSZ, "%lx", OSUtil_hostid());
+
+  char pidStr[bufSZ];
+  snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
+
+  char numThreadsStr[bufSZ];
+  snprintf(numThreadsStr, bufSZ, "%d", num_threads);
+
+  hpcrun_fmt_hdr_fwrite(fs,
+                        HPCRUN_FMT_NV_prog, hpcrun_files_executable_name(),
+                        HPCRUN_FMT_NV_progPath, hpcrun_files_executable_pathname(),
+			HPCRUN_FMT_NV_envPath, getenv("PATH"),
+                        HPCRUN_FMT_NV_jobId, jobIdStr,
+                        HPCRUN_FMT_NV_mpiRank, "0",
+                        HPCRUN_FMT_NV_tid, "0",
+                        HPCRUN_FMT_NV_hostid, hostidStr,
+                        HPCRUN_FMT_NV_pid, pidStr,
+			HPCRUN_FMT_NV_traceMinTime, "0",
+			HPCRUN_FMT_NV_traceMaxTime, "0",
+			HPCRUN_FMT_NV_numThreads, numThreadsStr,
+                        NULL);
+
+  // the snapshot has no logical unwind information and, as it merges
+  // all epochs, no epoch nv-pairs
+  epoch_flags_t flags = { .bits = 0 };
+  hpcrun_fmt_epochHdr_fwrite(fs, flags, 1, NULL);
+
+  hpcrun_fmt_metricTbl_fwrite(hpcrun_get_metric_tbl(), NULL, fs);
+
+  // the loadmap only changes under the dlopen lock
+  while (! hpcrun_dlopen_read_lock()) {
+    sleep_ms(1);
+  }
+  hpcrun_loadmap_t* loadmap = hpcrun_getLoadmap();
+  hpcfmt_int4_fwrite(loadmap->size, fs);
+  for (load_module_t* lm_src = loadmap->lm_end; (lm_src); lm_src = lm_src->prev) {
+    loadmap_entry_t lm_entry;
+    lm_entry.id = lm_src->id;
+    lm_entry.name = lm_src->name;
+    lm_entry.flags = 0;
+    hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+  }
+  hpcrun_dlopen_read_unlock();
+
+  hpcfmt_int8_fwrite((uint64_t) tree->num_nodes, fs);
+
+  hpcrun_fmt_cct_node_t tmp;
+  memset(&tmp, 0, sizeof(tmp));
+  tmp.num_metrics = tree->num_metrics;
+
+  for (uint32_t i = 0; i < tree->num_nodes; i++) {
+    live_query_node_t *n = &(tree->nodes[i]);
+
+    // if no children, chg sign of id when written out
+    tmp.id = LIVE_QUERY_ID(i);
+    if (! n->has_children) {
+      tmp.id = - tmp.id;
+    }
+    tmp.id_parent = (n->parent == LIVE_QUERY_NO_PARENT) ? 0 : LIVE_QUERY_ID(n->parent);
+    tmp.lm_id = n->lm_id;
+    tmp.lm_ip = (hpcfmt_vma_t) n->lm_ip;
+    tmp.metrics = tree->metrics + (size_t) i * tree->num_metrics;
+    hpcrun_fmt_cct_node_fwrite(&tmp, flags, fs);
+  }
+}
+
+
+static void
+live_query_serve(int fd)
+{
+  // drop parts that arrived after the previous snapshot was closed
+  free_parts(atomic_exchange(&snapshot_parts, NULL));
+  atomic_store(&snapshot_num_parts, 0);
+
+  uint64_t gen = atomic_fetch_add(&snapshot_gen, 1) + 1;
+  atomic_store_explicit(&snapshot_open, 1, memory_order_release);
+
+  int num_threads = hpcrun_threadmgr_thread_count();
+  for (int waited = 0; waited < LIVE_QUERY_WAIT_MS; waited += LIVE_QUERY_POLL_MS) {
+    if (atomic_load_explicit(&snapshot_num_parts, memory_order_acquire) >= num_threads) {
+      break;
+    }
+    sleep_ms(LIVE_QUERY_POLL_MS);
+  }
+
+  atomic_store_explicit(&snapshot_open, 0, memory_order_release);
+  live_query_part_t *parts = atomic_exchange(&snapshot_parts, NULL);
+
+  int num_parts = 0;
+  for (live_query_part_t *p = parts; p; p = p->next) {
+    if (p->gen == gen) num_parts++;
+  }
+  if (num_parts < num_threads) {
+    TMSG(LIVE_QUERY, "snapshot %"PRIu64": %d of %d threads did not sample",
+	 gen, num_threads - num_parts, num_threads);
+  }
+
+  // without a part, the metric table may not be final yet, and
+  // finalizing it would allocate from the memstore
+  live_query_tree_t tree;
+  if (num_parts > 0 && tree_merge(&tree, parts, gen)) {
+    FILE *fs = fdopen(fd, "w");
+    if (fs) {
+      tree_fwrite(fs, &tree, num_parts);
+      fclose(fs);
+      fd = -1;
+    }
+    munmap(tree.nodes, tree.size);
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  free_parts(parts);
+}
+
+
+static void *
+live_query_server(void *arg)
+{
+  for (;;) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      break; // socket shut down at process exit
+    }
+    live_query_serve(fd);
+  }
+  return NULL;
+}
+
+
+
+//******************************************************************************
+// interface operations
+//******************************************************************************
+
+void
+hpcrun_live_query_init(void)
+{
+  // after fork, the socket belongs to the parent
+  if (listen_fd >= 0) {
+    close(listen_fd);
+    listen_fd = -1;
+  }
+
+  if (getenv(HPCRUN_LIVE_QUERY) == NULL) {
+    return;
+  }
+
+  int len = snprintf(socket_path, sizeof(socket_path), "%s/hpcrun-%u.sock",
+		     hpcrun_files_output_directory(), OSUtil_pid());
+  if (len < 0 || len >= sizeof(socket_path)) {
+    EMSG("HPCToolkit: live query disabled: socket path in '%s' is too long",
+	 hpcrun_files_output_directory());
+    return;
+  }
+
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, socket_path);
+
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    EMSG("HPCToolkit: live query disabled: socket failed: %s", strerror(errno));
+    return;
+  }
+  unlink(socket_path);
+  if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 4) != 0) {
+    EMSG("HPCToolkit: live query disabled: unable to listen on '%s': %s",
+	 socket_path, strerror(errno));
+    close(fd);
+    return;
+  }
+  listen_fd = fd;
+
+  // the helper inherits a mask with all signals blocked, so that it
+  // never runs a sample handler, and is hidden from libmonitor
+  sigset_t all, old;
+  sigfillset(&all);
+  monitor_real_pthread_sigmask(SIG_SETMASK, &all, &old);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  monitor_disable_new_threads();
+  int ret = pthread_create(&thread, &attr, live_query_server, NULL);
+  monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  monitor_real_pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (ret != 0) {
+    EMSG("HPCToolkit: live query disabled: unable to create thread: %s", strerror(ret));
+    close(listen_fd);
+    listen_fd = -1;
+    unlink(socket_path);
+    return;
+  }
+  AMSG("LIVE QUERY: listening on %s", socket_path);
+}
+
+
+void
+hpcrun_live_query_fini(void)
+{
+  if (listen_fd < 0) {
+    return;
+  }
+
+  // wakes up the helper thread in accept()
+  shutdown(listen_fd, SHUT_RDWR);
+  unlink(socket_path);
+  listen_fd = -1;
+}
+
+
+void
+hpcrun_live_query_check(core_profile_trace_data_t *cptd)
+{
+  if (! atomic_load_explicit(&snapshot_open, memory_order_acquire)) {
+    return;
+  }
+  uint64_t gen = atomic_load_explicit(&snapshot_gen, memory_order_acquire);
+  if (gen == snapshot_gen_seen) {
+    return;
+  }
+  snapshot_gen_seen = gen;
+
+  size_t num_nodes = 0;
+  walk_epochs(cptd, count_node, &num_nodes);
+
+  size_t num_metrics = hpcrun_get_num_metrics();
+  size_t size = sizeof(live_query_part_t)
+    + num_nodes * sizeof(live_query_node_t)
+    + num_nodes * num_metrics * sizeof(hpcrun_metricVal_t)
+    + (num_nodes + 2) * sizeof(uint32_t);
+
+  live_query_part_t *part = hpcrun_mmap_anon(size);
+  if (part == NULL) {
+    return;
+  }
+  part->gen = gen;
+  part->size = size;
+  part->num_nodes = 0;
+  part->num_metrics = num_metrics;
+  part->nodes = (live_query_node_t *) (part + 1);
+  part->metrics = (hpcrun_metricVal_t *) (part->nodes + num_nodes);
+  part->scratch = (uint32_t *) (part->metrics + num_nodes * num_metrics);
+
+  copy_arg_t arg = {
+    .part = part,
+    .map = &(cptd->cct2metrics_map),
+  };
+  walk_epochs(cptd, copy_node, &arg);
+
+  TMSG(LIVE_QUERY, "thread %d: copied %u nodes for snapshot %"PRIu64,
+       cptd->id, part->num_nodes, gen);
+  push_part(part);
+}
@@ -57,6 +57,7 @@
 
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define LOADMAP_DEBUG 0
 
@@ -359,20 +360,24 @@ static void
 hpcrun_loadmap_pushFront(load_module_t* lm)
 {
   TMSG(LOADMAP, "push front: %s", lm->name);
-  // link 'm' at the head of the list of loaded modules
+  // link 'm' at the head of the list of loaded modules.  Samples walk
+  // the list without a lock (also during dlopen), so 'lm' must be
+  // fully initialized before it becomes reachable from lm_head.
   if (s_loadmap_ptr->lm_head) {
     TMSG(LOADMAP, "previous front = %s", s_loadmap_ptr->lm_head->name);
-    s_loadmap_ptr->lm_head->prev = lm;
     lm->next = s_loadmap_ptr->lm_head;
     lm->prev = NULL;
+    atomic_thread_fence(memory_order_release);
+    s_loadmap_ptr->lm_head->prev = lm;
     s_loadmap_ptr->lm_head = lm;
   }
   else {
     TMSG(LOADMAP, " ->First entry");
-    s_loadmap_ptr->lm_head = lm;
-    s_loadmap_ptr->lm_end = lm;
     lm->next = NULL;
     lm->prev = NULL;
+    atomic_thread_fence(memory_order_release);
+    s_loadmap_ptr->lm_end = lm;
+    s_loadmap_ptr->lm_head = lm;
   }
 }
 
@@ -115,6 +115,7 @@
 #include "thread_use.h"
 #include "trace.h"
 #include "write_data.h"
+#include "live_query.h"
 #include <utilities/token-iter.h>
 
 #include <memory/hpcrun-malloc.h>
@@ -413,10 +414,22 @@ hpcrun_init_internal(bool is_child)
   hpcrun_trace_init(); // this must go after thread initialization
   hpcrun_trace_open(&(TD_GET(core_profile_trace_data)));
 
+  hpcrun_threadmgr_init(); // this must go after trace initialization
+
   // Decide whether to retain full single recursion, or collapse recursive calls to
   // first instance of recursive call
   hpcrun_set_retain_recursion_mode(getenv("HPCRUN_RETAIN_RECURSION") != NULL);
 
+  // Stop unwinding where a backtrace joins the call chain of the previous
+  // backtrace of the thread (ignored with RETCNT, which uses trampolines)
+  hpcrun_set_unwind_reuse_mode(getenv(HPCRUN_UNWIND_REUSE) != NULL);
+
+  // Continuous profiling: write a profile per thread and time window
+  hpcrun_profile_window_init();
+
+  // Serve snapshots of the profiles of all threads on a Unix socket
+  hpcrun_live_query_init();
+
   // Initialize logical unwinding agents (LUSH)
   if (opts.lush_agent_paths[0] != '\0') {
     epoch_t* epoch = TD_GET(core_profile_trace_data.epoch);
@@ -596,6 +609,8 @@ void
 hpcrun_fini_internal()
 {
   hpcrun_disable_sampling();
+  hpcrun_live_query_fini();
+  hpcrun_profile_window_fini();
 
   TMSG(FINI, "process");
 
@@ -624,6 +639,7 @@ hpcrun_fini_internal()
     // This typically means flushing files that were not done by their creators.
 
     hpcrun_process_aux_cleanup_action();
+    hpcrun_threadmgr_profile_fini();
     hpcrun_write_profile_data(&(TD_GET(core_profile_trace_data)));
     hpcrun_trace_close(&(TD_GET(core_profile_trace_data)));
     fnbounds_fini();
@@ -668,7 +684,14 @@ hpcrun_thread_init(int id, local_thread_data_t* local_thread_data) // cct_ctxt_t
   cct_ctxt_t* thr_ctxt = local_thread_data ? local_thread_data->thr_ctxt : NULL;
 
   hpcrun_mmap_init();
-  thread_data_t* td = hpcrun_allocate_thread_data(id);
+
+  // with HPCRUN_REUSE_THREADS, take over the data (and profile) of a
+  // finished thread with the same creation context, if there is one.
+  thread_data_t* td = hpcrun_threadmgr_data_get(thr_ctxt);
+  bool reuse = (td != NULL);
+  if (! reuse) {
+    td = hpcrun_allocate_thread_data(id);
+  }
   td->inside_hpcrun = 1;  // safe enter, disable signals
 
   hpcrun_set_thread_data(td);
@@ -677,16 +700,23 @@ hpcrun_thread_init(int id, local_thread_data_t* local_thread_data) // cct_ctxt_t
   if (ENABLED(THREAD_CTXT))
     hpcrun_walk_path(thr_ctxt->context, logit, (cct_op_arg_t) (intptr_t) id);
   //
-  hpcrun_thread_data_init(id, thr_ctxt, 0, hpcrun_get_num_sample_sources());
+  if (reuse) {
+    hpcrun_thread_data_reuse_init(id, hpcrun_get_num_sample_sources());
+  }
+  else {
+    hpcrun_thread_data_init(id, thr_ctxt, 0, hpcrun_get_num_sample_sources());
+  }
 
   epoch_t* epoch = TD_GET(core_profile_trace_data.epoch);
 
   // handle event sets for sample sources
   SAMPLE_SOURCES(gen_event_set,lush_metrics);
 
-  // set up initial 'epoch'
-  TMSG(EPOCH,"process init setting up initial epoch/loadmap");
-  hpcrun_epoch_init(thr_ctxt);
+  // set up initial 'epoch' (a reused one keeps its cct)
+  if (! reuse) {
+    TMSG(EPOCH,"process init setting up initial epoch/loadmap");
+    hpcrun_epoch_init(thr_ctxt);
+  }
 
   // sample sources take thread specific action prior to start (often is a 'registration' action);
   SAMPLE_SOURCES(thread_init_action);
@@ -725,6 +755,17 @@ hpcrun_thread_fini(epoch_t *epoch)
       return;
     }
 
+    // with HPCRUN_REUSE_THREADS, the thread data is handed to a later
+    // thread and its profile is written at process exit
+    if (hpcrun_threadmgr_data_put(hpcrun_get_thread_data())) {
+      return;
+    }
+
+    // with HPCRUN_MERGE_THREADS, the profile is written at process exit
+    if (hpcrun_threadmgr_profile_defer(&(TD_GET(core_profile_trace_data)))) {
+      return;
+    }
+
     hpcrun_write_profile_data(&(TD_GET(core_profile_trace_data)));
     hpcrun_trace_close(&(TD_GET(core_profile_trace_data)));
   }
@@ -1005,6 +1046,10 @@ monitor_thread_pre_create(void)
   }
   
   cct_node_t* n = hpcrun_gen_thread_ctxt(&context);
+  if (n) {
+    // the new thread's profile refers to n
+    hpcrun_cct_pin(n);
+  }
 
   TMSG(THREAD,"before lush malloc");
   TMSG(MALLOC," -thread_precreate: lush malloc");
@@ -1085,6 +1130,7 @@ monitor_fini_thread(void* init_thread_data)
 
   epoch_t *epoch = (epoch_t *)init_thread_data;
   hpcrun_thread_fini(epoch);
+  hpcrun_freeable_thread_fini();
   hpcrun_safe_exit();
 }
 
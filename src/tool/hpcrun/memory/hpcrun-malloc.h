@@ -86,14 +86,31 @@ extern "C" {
 // NOTE: This memory cannot be freed! 
 //---------------------------------------------------------------------------
 void* hpcrun_malloc(size_t size);
+
+//---------------------------------------------------------------------------
+// Function: hpcrun_malloc_freeable, hpcrun_free, hpcrun_free_deferred
+//
+// Purpose: allocate memory that can be freed.  Use hpcrun_free() if
+//      no other thread can reach the block, else hpcrun_free_deferred(),
+//      which reuses the block only after every thread has left its
+//      hpcrun_freeable_enter/exit() section.  All are signal-safe.
+//---------------------------------------------------------------------------
 void* hpcrun_malloc_freeable(size_t size);
+void hpcrun_free(void* ptr);
+void hpcrun_free_deferred(void* ptr);
 
 #else
 #define hpcrun_malloc malloc
 #define hpcrun_malloc_freeable malloc
+#define hpcrun_free free
+#define hpcrun_free_deferred free
 
 #endif // VALGRIND
 
+void hpcrun_freeable_enter(void);
+void hpcrun_freeable_exit(void);
+void hpcrun_freeable_thread_fini(void);
+
 void hpcrun_memory_reinit(void);
 void hpcrun_reclaim_freeable_mem(void);
 void hpcrun_memory_summary(void);
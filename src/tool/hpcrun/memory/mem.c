@@ -47,9 +47,16 @@
 //
 // The new memory allocator.  We mmap() a large, single region (4 Meg)
 // per thread and dole out pieces via hpcrun_malloc().  Pieces are
-// either freeable (CCT nodes) or not freeable (everything else).
-// When memory gets low, we write out an epoch and reclaim the CCT
-// nodes.
+// either freeable (hpcrun_malloc_freeable) or not freeable (everything
+// else).  Freeable pieces are recycled through per-thread free lists,
+// and pieces that other threads may still be reading are reclaimed
+// only after every thread has passed a quiescent state (see below).
+//
+// Optionally, memstores are backed by huge pages (transparent or
+// explicit, HPCRUN_MEMSTORE_HUGEPAGES) to reduce TLB misses in CCT and
+// metric traversal, and bound to the NUMA node of the thread that
+// creates them (HPCRUN_MEMSTORE_NUMA) rather than to the node of the
+// thread that happens to touch them first.
 //
 
 #include <sys/mman.h>
@@ -58,10 +65,13 @@
 
 #include <errno.h>
 #include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/syscall.h>
 
 // no redefinition of hpcrun_malloc and friends inside mem.c
 #define _IN_MEM_C 1
@@ -74,15 +84,31 @@
 #include "thread_data.h"
 
 #include <messages/messages.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #define DEFAULT_MEMSIZE   (4 * 1024 * 1024)
 #define MIN_LOW_MEMSIZE  (80 * 1024)
 #define DEFAULT_PAGESIZE  4096
+#define HUGE_PAGESIZE     (2 * 1024 * 1024)
+#define MAX_NUMA_NODES    64
+
+// from <numaif.h>, which we don't want to depend on
+#ifndef MPOL_PREFERRED
+#define MPOL_PREFERRED  1
+#endif
+
+enum hugepage_mode_e {
+  HUGEPAGE_NONE,
+  HUGEPAGE_TRANSPARENT,   // madvise(MADV_HUGEPAGE)
+  HUGEPAGE_EXPLICIT       // mmap(MAP_HUGETLB), needs reserved huge pages
+};
 
 static size_t memsize = DEFAULT_MEMSIZE;
 static size_t low_memsize = MIN_LOW_MEMSIZE;
 static size_t pagesize = DEFAULT_PAGESIZE;
 static int allow_extra_mmap = 1;
+static enum hugepage_mode_e hugepage_mode = HUGEPAGE_NONE;
+static int numa_local = 0;
 
 static long num_segments = 0;
 static long total_allocation = 0;
@@ -91,7 +117,78 @@ static long num_failures = 0;
 static long total_freeable = 0;
 static long total_non_freeable = 0;
 
+// memstores per NUMA node (node -1: unknown)
+static long node_segments[MAX_NUMA_NODES];
+static long node_allocation[MAX_NUMA_NODES];
+static long unknown_node_segments = 0;
+static long hugepage_segments = 0;
+
 static int out_of_mem_mesg = 0;
+static int hugepage_fail_mesg = 0;
+
+//------------------------------------------------------------------
+// Freeable memory
+//------------------------------------------------------------------
+//
+// Freeable blocks are carved from the memstore (or mmap-ed directly,
+// if large) behind a small header that records their size class and
+// links them on free lists, so the block itself is left untouched
+// until it is reused.  Freed blocks go on the free list of the
+// freeing thread and are reused by that thread, so neither allocation
+// nor free takes a lock and both are safe in a signal handler.  Large
+// blocks are munmap-ed.
+//
+// Blocks that other threads may still be reading (unwind recipes of
+// an unmapped module, the cct of a discarded epoch) are retired with
+// hpcrun_free_deferred() instead.  Threads bracket their reads of
+// shared freeable data with hpcrun_freeable_enter/exit() (once per
+// sample); outside of that, a thread is quiescent.  The global epoch
+// advances once every active thread has observed the current epoch,
+// and a block retired in epoch e is reclaimed when the global epoch
+// reaches e + 2.
+//
+
+// size classes: multiples of 16 bytes up to 256, then powers of 2
+// up to 64K.  Larger blocks are mmap-ed.
+#define FREEABLE_QUANTUM       16
+#define FREEABLE_NUM_SMALL     16
+#define FREEABLE_SMALL_MAX    (FREEABLE_QUANTUM * FREEABLE_NUM_SMALL)
+#define FREEABLE_NUM_CLASSES  (FREEABLE_NUM_SMALL + 8)
+#define FREEABLE_MAX_SIZE     (FREEABLE_SMALL_MAX << 8)
+#define FREEABLE_LARGE        FREEABLE_NUM_CLASSES
+#define FREEABLE_LARGE_PREFIX  16
+#define FREEABLE_MAGIC        0x46524545
+#define FREEABLE_NUM_LIMBO    3
+#define FREEABLE_SCAN_PERIOD  64
+
+// A large block's mapping starts with its size, FREEABLE_LARGE_PREFIX
+// bytes ahead of the header.
+typedef struct freeable_hdr_s {
+  struct freeable_hdr_s *next;   // free or limbo list
+  uint32_t sclass;               // size class, or FREEABLE_LARGE
+  uint32_t magic;
+} freeable_hdr_t;
+
+// One per thread, never deleted.  The record of an exited thread
+// (and any blocks it still holds) is adopted by the next new thread.
+typedef struct freeable_rec_s {
+  struct freeable_rec_s *next;
+  atomic_int owned;
+  atomic_ulong announce;     // (epoch << 1) | active
+  int nesting;
+  long num_retired;
+  freeable_hdr_t *free_list[FREEABLE_NUM_CLASSES];
+  freeable_hdr_t *limbo[FREEABLE_NUM_LIMBO];
+  unsigned long limbo_epoch[FREEABLE_NUM_LIMBO];
+} freeable_rec_t;
+
+static _Atomic(freeable_rec_t *) freeable_registry = ATOMIC_VAR_INIT(NULL);
+static atomic_ulong freeable_epoch = ATOMIC_VAR_INIT(0);
+static __thread freeable_rec_t *freeable_self = NULL;
+
+static long freeable_reused = 0;
+static long freeable_released = 0;
+static long freeable_unmapped = 0;
 
 //------------------------------------------------------------------
 // Internal functions
@@ -140,9 +237,28 @@ hpcrun_mem_init(void)
       low_memsize = MIN_LOW_MEMSIZE;
   }
 
+  str = getenv(HPCRUN_MEMSTORE_HUGEPAGES);
+  if (str != NULL) {
+    if (strcmp(str, "thp") == 0 || strcmp(str, "transparent") == 0) {
+      hugepage_mode = HUGEPAGE_TRANSPARENT;
+    } else if (strcmp(str, "explicit") == 0) {
+      hugepage_mode = HUGEPAGE_EXPLICIT;
+    } else {
+      EMSG("%s: unknown value for %s: '%s' (want thp or explicit)",
+	   __func__, HPCRUN_MEMSTORE_HUGEPAGES, str);
+    }
+  }
+  if (hugepage_mode != HUGEPAGE_NONE) {
+    memsize = ((memsize + HUGE_PAGESIZE - 1)/HUGE_PAGESIZE) * HUGE_PAGESIZE;
+  }
+
+  str = getenv(HPCRUN_MEMSTORE_NUMA);
+  numa_local = (str != NULL && strcmp(str, "local") == 0);
+
   TMSG(MALLOC, "%s: pagesize = %ld, memsize = %ld, "
-       "low memsize = %ld, extra mmap = %d",
-       __func__, pagesize, memsize, low_memsize, allow_extra_mmap);
+       "low memsize = %ld, extra mmap = %d, huge pages = %d, numa local = %d",
+       __func__, pagesize, memsize, low_memsize, allow_extra_mmap,
+       hugepage_mode, numa_local);
   init_done = 1;
 }
 
@@ -192,6 +308,286 @@ hpcrun_mmap_anon(size_t size)
   return addr;
 }
 
+// The NUMA node of the cpu this thread is running on, else -1.
+static int
+current_numa_node(void)
+{
+#ifdef SYS_getcpu
+  unsigned int cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+    return (int) node;
+  }
+#endif
+  return -1;
+}
+
+// Prefer (but don't require) pages of [addr, addr + size) on 'node'.
+static void
+bind_to_numa_node(void *addr, size_t size, int node)
+{
+#ifdef SYS_mbind
+  unsigned long nodemask[MAX_NUMA_NODES / (8 * sizeof(unsigned long))];
+
+  if (node < 0 || node >= MAX_NUMA_NODES) {
+    return;
+  }
+  memset(nodemask, 0, sizeof(nodemask));
+  nodemask[node / (8 * sizeof(unsigned long))] =
+    1UL << (node % (8 * sizeof(unsigned long)));
+
+  if (syscall(SYS_mbind, addr, size, MPOL_PREFERRED, nodemask,
+	      MAX_NUMA_NODES + 1, 0) != 0) {
+    TMSG(MALLOC, "%s: mbind to node %d failed: %s",
+	 __func__, node, strerror(errno));
+  }
+#endif
+}
+
+//
+// Returns: a huge-page aligned region of 'size' bytes that the kernel
+// may back with transparent huge pages, else NULL on failure.
+//
+static void *
+hpcrun_mmap_thp(size_t size)
+{
+#if defined(MADV_HUGEPAGE) && defined(MAP_ANONYMOUS)
+  // over-allocate, then trim to a huge page boundary at both ends
+  size_t len = size + HUGE_PAGESIZE;
+  char *addr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (addr == MAP_FAILED) {
+    return NULL;
+  }
+  char *start = (char *) (((uintptr_t) addr + HUGE_PAGESIZE - 1)
+			  & ~((uintptr_t) HUGE_PAGESIZE - 1));
+  if (start > addr) {
+    munmap(addr, start - addr);
+  }
+  if (start + size < addr + len) {
+    munmap(start + size, (addr + len) - (start + size));
+  }
+  if (madvise(start, size, MADV_HUGEPAGE) != 0) {
+    TMSG(MALLOC, "%s: madvise(MADV_HUGEPAGE) failed: %s",
+	 __func__, strerror(errno));
+  }
+  return start;
+#else
+  return NULL;
+#endif
+}
+
+//
+// Returns: a region of 'size' bytes backed by explicit (hugetlbfs)
+// huge pages, else NULL on failure (eg, no huge pages reserved).
+//
+static void *
+hpcrun_mmap_hugetlb(size_t size)
+{
+#if defined(MAP_HUGETLB) && defined(MAP_ANONYMOUS)
+  void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  return (addr == MAP_FAILED) ? NULL : addr;
+#else
+  return NULL;
+#endif
+}
+
+//
+// Returns: address of a new memstore region of 'size' bytes, backed
+// by huge pages and bound to this thread's NUMA node if so requested,
+// else NULL on failure.  Falls back to plain pages if huge pages are
+// not available.
+//
+static void *
+hpcrun_mmap_memstore(size_t size)
+{
+  void *addr = NULL;
+  int node = current_numa_node();
+
+  if (hugepage_mode == HUGEPAGE_TRANSPARENT) {
+    addr = hpcrun_mmap_thp(size);
+  } else if (hugepage_mode == HUGEPAGE_EXPLICIT) {
+    addr = hpcrun_mmap_hugetlb(size);
+  }
+
+  if (addr != NULL) {
+    num_segments++;
+    total_allocation += size;
+    hugepage_segments++;
+  } else {
+    if (hugepage_mode != HUGEPAGE_NONE && ! hugepage_fail_mesg) {
+      EMSG("%s: unable to map huge pages, using normal pages", __func__);
+      hugepage_fail_mesg = 1;
+    }
+    addr = hpcrun_mmap_anon(size);
+    if (addr == NULL) {
+      return NULL;
+    }
+  }
+
+  // bind before the first touch decides the placement
+  if (numa_local) {
+    bind_to_numa_node(addr, size, node);
+  }
+
+  if (0 <= node && node < MAX_NUMA_NODES) {
+    node_segments[node]++;
+    node_allocation[node] += size;
+  } else {
+    unknown_node_segments++;
+  }
+
+  TMSG(MALLOC, "%s: size = %ld, node = %d, addr = %p",
+       __func__, size, node, addr);
+  return addr;
+}
+
+// The freeable record of this thread, adopting the record of an
+// exited thread or making a new one on first use.
+static freeable_rec_t *
+freeable_rec_get(void)
+{
+  freeable_rec_t *rec = freeable_self;
+  freeable_rec_t *head;
+
+  if (rec != NULL) {
+    return rec;
+  }
+
+  for (rec = atomic_load(&freeable_registry); rec != NULL; rec = rec->next) {
+    int unowned = 0;
+    if (! atomic_load_explicit(&rec->owned, memory_order_relaxed)
+	&& atomic_compare_exchange_strong(&rec->owned, &unowned, 1)) {
+      freeable_self = rec;
+      return rec;
+    }
+  }
+
+  rec = hpcrun_malloc(sizeof(freeable_rec_t));
+  if (rec == NULL) {
+    return NULL;
+  }
+  memset(rec, 0, sizeof(freeable_rec_t));
+  atomic_init(&rec->owned, 1);
+  atomic_init(&rec->announce, 0);
+
+  head = atomic_load(&freeable_registry);
+  do {
+    rec->next = head;
+  } while (! atomic_compare_exchange_weak(&freeable_registry, &head, rec));
+
+  freeable_self = rec;
+  return rec;
+}
+
+// Returns: header of freeable block 'ptr', else NULL if 'ptr' is not
+// from hpcrun_malloc_freeable().
+static freeable_hdr_t *
+freeable_header(void *ptr)
+{
+  freeable_hdr_t *hdr;
+
+  if (ptr == NULL) {
+    return NULL;
+  }
+  hdr = ((freeable_hdr_t *) ptr) - 1;
+  if (hdr->magic != FREEABLE_MAGIC || hdr->sclass > FREEABLE_LARGE) {
+    EMSG("%s: %p is not freeable memory", __func__, ptr);
+    return NULL;
+  }
+  return hdr;
+}
+
+static int
+freeable_class(size_t size)
+{
+  int sclass = FREEABLE_NUM_SMALL;
+  size_t class_size = 2 * FREEABLE_SMALL_MAX;
+
+  if (size <= FREEABLE_SMALL_MAX) {
+    return (size - 1) / FREEABLE_QUANTUM;
+  }
+  while (class_size < size) {
+    class_size <<= 1;
+    sclass++;
+  }
+  return sclass;
+}
+
+static size_t
+freeable_class_size(int sclass)
+{
+  if (sclass < FREEABLE_NUM_SMALL) {
+    return (sclass + 1) * FREEABLE_QUANTUM;
+  }
+  return ((size_t) FREEABLE_SMALL_MAX) << (sclass - FREEABLE_NUM_SMALL + 1);
+}
+
+// Put a block back on 'rec's free list, or unmap it if large.
+static void
+freeable_release(freeable_rec_t *rec, freeable_hdr_t *hdr)
+{
+  if (hdr->sclass == FREEABLE_LARGE) {
+    char *start = ((char *) hdr) - FREEABLE_LARGE_PREFIX;
+    size_t size = *(size_t *) start;
+    freeable_unmapped += size;
+    total_freeable -= size;
+    munmap(start, size);
+    return;
+  }
+  if (rec == NULL) {
+    return;
+  }
+
+  hdr->next = rec->free_list[hdr->sclass];
+  rec->free_list[hdr->sclass] = hdr;
+  freeable_released++;
+}
+
+static void
+freeable_release_list(freeable_rec_t *rec, freeable_hdr_t *hdr)
+{
+  while (hdr != NULL) {
+    freeable_hdr_t *next = hdr->next;
+    freeable_release(rec, hdr);
+    hdr = next;
+  }
+}
+
+// Advance the global epoch if every active thread has seen it.
+// Returns: the global epoch.
+static unsigned long
+freeable_try_advance(void)
+{
+  unsigned long epoch = atomic_load(&freeable_epoch);
+  freeable_rec_t *rec;
+
+  for (rec = atomic_load(&freeable_registry); rec != NULL; rec = rec->next) {
+    unsigned long announce = atomic_load(&rec->announce);
+    if ((announce & 1) && (announce >> 1) != epoch) {
+      return epoch;
+    }
+  }
+  if (atomic_compare_exchange_strong(&freeable_epoch, &epoch, epoch + 1)) {
+    epoch++;
+  }
+  return epoch;
+}
+
+// Reuse the blocks retired by 'rec' that no thread can still see.
+static void
+freeable_reclaim(freeable_rec_t *rec)
+{
+  unsigned long epoch = freeable_try_advance();
+
+  for (int slot = 0; slot < FREEABLE_NUM_LIMBO; slot++) {
+    if (rec->limbo[slot] != NULL && rec->limbo_epoch[slot] + 2 <= epoch) {
+      freeable_release_list(rec, rec->limbo[slot]);
+      rec->limbo[slot] = NULL;
+    }
+  }
+}
+
 //------------------------------------------------------------------
 // External functions
 //------------------------------------------------------------------
@@ -200,10 +596,13 @@ hpcrun_mmap_anon(size_t size)
 // memstore layout:
 //
 //   +------------------+------------+----------------+
-//   |  freeable (cct)  |            |  non-freeable  |
+//   |     (unused)     |            |  all blocks    |
 //   +------------------+------------+----------------+
 //   mi_start           mi_low       mi_high
 //
+// Freeable blocks are allocated at the high end, too, and are never
+// given back to the memstore, only reused through the free lists.
+//
 
 // After fork(), the parent's memstores are still allocated in the
 // child, so don't reset num_segments.
@@ -211,6 +610,17 @@ hpcrun_mmap_anon(size_t size)
 void
 hpcrun_memory_reinit(void)
 {
+  // In the child after fork(), only this thread exists, so the other
+  // threads can neither hold freeable memory nor block reclamation.
+  freeable_rec_t *rec;
+  for (rec = atomic_load(&freeable_registry); rec != NULL; rec = rec->next) {
+    if (rec != freeable_self) {
+      rec->nesting = 0;
+      atomic_store(&rec->announce, 0);
+      atomic_store(&rec->owned, 0);
+    }
+  }
+
   num_reclaims = 0;
   num_failures = 0;
   total_freeable = 0;
@@ -237,7 +647,7 @@ hpcrun_make_memstore(hpcrun_meminfo_t *mi, int is_child)
     return;
   }
 
-  addr = hpcrun_mmap_anon(memsize);
+  addr = hpcrun_mmap_memstore(memsize);
   if (addr == NULL) {
     if (! out_of_mem_mesg) {
       EMSG("%s: out of memory, shutting down sampling", __func__);
@@ -255,7 +665,8 @@ hpcrun_make_memstore(hpcrun_meminfo_t *mi, int is_child)
   TMSG(MALLOC, "new memstore: [%p, %p)", mi->mi_start, mi->mi_high);
 }
 
-// Reclaim the freeable CCT memory at the low end.
+// Reclaim the freeable memory retired by this thread that no other
+// thread can still reach.
 void
 hpcrun_reclaim_freeable_mem(void)
 {
@@ -263,6 +674,9 @@ hpcrun_reclaim_freeable_mem(void)
 
   mi->mi_low = mi->mi_start;
   TD_GET(mem_low) = 0;
+  if (freeable_self != NULL && freeable_self->nesting == 0) {
+    freeable_reclaim(freeable_self);
+  }
   num_reclaims++;
   TMSG(MALLOC, "%s: %d", __func__, num_reclaims);
 }
@@ -344,43 +758,168 @@ hpcrun_malloc(size_t size)
 }
 
 //
-// Returns: address of freeable region at the high end,
+// Returns: address of a freeable block of at least 'size' bytes,
 // else NULL on failure.
 //
 void *
 hpcrun_malloc_freeable(size_t size)
 {
-  return hpcrun_malloc(size);
+  freeable_rec_t *rec;
+  freeable_hdr_t *hdr;
+  size_t need;
+  int sclass;
 
-  // For now, don't bother with freeable memory.
-#if 0
-  hpcrun_meminfo_t *mi = &TD_GET(memstore);
-  void *addr, *ans;
+  if (size == 0) {
+    return NULL;
+  }
+  need = round_up(size) + sizeof(freeable_hdr_t);
+
+  // Large blocks get their own region, so they can be returned to
+  // the system when freed.
+  if (need > FREEABLE_MAX_SIZE) {
+    need = hpcrun_align_pagesize(need + FREEABLE_LARGE_PREFIX);
+    char *start = hpcrun_mmap_anon(need);
+    if (start == NULL) {
+      num_failures++;
+      return NULL;
+    }
+    *(size_t *) start = need;
+    hdr = (freeable_hdr_t *) (start + FREEABLE_LARGE_PREFIX);
+    hdr->next = NULL;
+    hdr->sclass = FREEABLE_LARGE;
+    hdr->magic = FREEABLE_MAGIC;
+    total_freeable += need;
+    TMSG(MALLOC, "%s: size = %ld, addr = %p (mmap)", __func__, size, hdr + 1);
+    return hdr + 1;
+  }
 
-  size = round_up(size);
-  addr = mi->mi_low + size;
+  sclass = freeable_class(need);
+  rec = freeable_rec_get();
+  if (rec != NULL && rec->free_list[sclass] != NULL) {
+    hdr = rec->free_list[sclass];
+    rec->free_list[sclass] = hdr->next;
+    hdr->next = NULL;
+    freeable_reused++;
+    TMSG(MALLOC, "%s: size = %ld, addr = %p (reused)", __func__, size, hdr + 1);
+    return hdr + 1;
+  }
 
-  // Recoverable out of memory.
-  if (addr >= mi->mi_high) {
-    TD_GET(mem_low) = 1;
-    TMSG(MALLOC, "%s: size = %ld, failure: temporary out of memory",
-	 __func__, size);
-    num_failures++;
+  need = freeable_class_size(sclass);
+  hdr = hpcrun_malloc(need);
+  if (hdr == NULL) {
     return NULL;
   }
+  total_non_freeable -= need;
+  total_freeable += need;
+
+  hdr->next = NULL;
+  hdr->sclass = sclass;
+  hdr->magic = FREEABLE_MAGIC;
+  TMSG(MALLOC, "%s: size = %ld, addr = %p", __func__, size, hdr + 1);
+  return hdr + 1;
+}
 
-  // Low on memory.
-  if (addr + low_memsize > mi->mi_high) {
-    TD_GET(mem_low) = 1;
-    TMSG(MALLOC, "%s: low on memory, setting epoch flush flag", __func__);
+//
+// Free a block from hpcrun_malloc_freeable() that no other thread
+// can reach.  The block is reused by the calling thread.
+//
+void
+hpcrun_free(void *ptr)
+{
+  freeable_hdr_t *hdr = freeable_header(ptr);
+
+  if (hdr == NULL) {
+    return;
   }
+  freeable_release(freeable_rec_get(), hdr);
+}
 
-  ans = mi->mi_low;
-  mi->mi_low = addr;
-  total_freeable += size;
-  TMSG(MALLOC, "%s: size = %ld, addr = %p", __func__, size, addr);
-  return ans;
-#endif
+//
+// Free a block from hpcrun_malloc_freeable() that other threads may
+// still be reading.  The block is reused once all threads have passed
+// through a quiescent state.
+//
+void
+hpcrun_free_deferred(void *ptr)
+{
+  freeable_hdr_t *hdr = freeable_header(ptr);
+  freeable_rec_t *rec;
+  unsigned long epoch;
+  int slot;
+
+  if (hdr == NULL || (rec = freeable_rec_get()) == NULL) {
+    return;
+  }
+
+  epoch = atomic_load(&freeable_epoch);
+  slot = epoch % FREEABLE_NUM_LIMBO;
+
+  // the slot's previous blocks are at least FREEABLE_NUM_LIMBO
+  // epochs old, so nobody can see them anymore.
+  if (rec->limbo_epoch[slot] != epoch) {
+    freeable_release_list(rec, rec->limbo[slot]);
+    rec->limbo[slot] = NULL;
+    rec->limbo_epoch[slot] = epoch;
+  }
+
+  hdr->next = rec->limbo[slot];
+  rec->limbo[slot] = hdr;
+
+  rec->num_retired++;
+  if (rec->nesting == 0 && rec->num_retired % FREEABLE_SCAN_PERIOD == 0) {
+    freeable_reclaim(rec);
+  }
+}
+
+//
+// Begin and end a section in which this thread may read freeable
+// memory that other threads can retire (unwind recipes, ...).
+// Sections nest.  Outside of all sections, the thread is quiescent.
+//
+void
+hpcrun_freeable_enter(void)
+{
+  freeable_rec_t *rec = freeable_rec_get();
+
+  if (rec != NULL && rec->nesting++ == 0) {
+    unsigned long epoch = atomic_load(&freeable_epoch);
+    atomic_store(&rec->announce, (epoch << 1) | 1);
+  }
+}
+
+void
+hpcrun_freeable_exit(void)
+{
+  freeable_rec_t *rec = freeable_self;
+
+  if (rec == NULL || rec->nesting == 0) {
+    return;
+  }
+  if (--rec->nesting == 0) {
+    atomic_store(&rec->announce, 0);
+    if (rec->limbo[0] != NULL || rec->limbo[1] != NULL || rec->limbo[2] != NULL) {
+      freeable_reclaim(rec);
+    }
+  }
+}
+
+//
+// The thread is exiting: give up its record (along with its free and
+// retired blocks) to the next new thread.
+//
+void
+hpcrun_freeable_thread_fini(void)
+{
+  freeable_rec_t *rec = freeable_self;
+
+  if (rec == NULL) {
+    return;
+  }
+  rec->nesting = 0;
+  atomic_store(&rec->announce, 0);
+  freeable_reclaim(rec);
+  freeable_self = NULL;
+  atomic_store(&rec->owned, 0);
 }
 
 void
@@ -395,4 +934,26 @@ hpcrun_memory_summary(void)
   AMSG("MEMORY: total freeable: %.1f meg, total non-freeable: %.1f meg, "
        "malloc failures: %ld",
        total_freeable/meg, total_non_freeable/meg, num_failures);
+
+  AMSG("MEMORY: freeable blocks released: %ld, reused: %ld, "
+       "unmapped: %.1f meg, reclamation epoch: %lu",
+       freeable_released, freeable_reused, freeable_unmapped/meg,
+       atomic_load(&freeable_epoch));
+
+  if (hugepage_mode != HUGEPAGE_NONE) {
+    AMSG("MEMORY: memstores on huge pages (%s): %ld",
+	 (hugepage_mode == HUGEPAGE_TRANSPARENT) ? "transparent" : "explicit",
+	 hugepage_segments);
+  }
+
+  for (int node = 0; node < MAX_NUMA_NODES; node++) {
+    if (node_segments[node] > 0) {
+      AMSG("MEMORY: numa node %d: memstores: %ld, allocation: %.1f meg%s",
+	   node, node_segments[node], node_allocation[node]/meg,
+	   numa_local ? " (bound)" : "");
+    }
+  }
+  if (unknown_node_segments > 0) {
+    AMSG("MEMORY: numa node unknown: memstores: %ld", unknown_node_segments);
+  }
 }
@@ -487,6 +487,23 @@ hpcrun_metric_std_inc(int metric_id, metric_set_t* set,
   hpcrun_metric_std(metric_id, set, '+', incr);
 }
 
+//
+// combine two metric sets: a metric accumulated with a non standard
+// update procedure (eg, min or max) is combined with that procedure,
+// so that merging two sets gives the same values as sampling into one.
+//
+void
+hpcrun_metric_set_combine(metric_set_t* dst, metric_set_t* src)
+{
+  hpcrun_get_num_metrics(); // ensure that metrics are finalized
+
+  for (int i = 0; i < n_metrics; i++) {
+    metric_upd_proc_t* upd_proc = metric_proc_tbl[i];
+    if (! upd_proc) upd_proc = hpcrun_metric_std_inc;
+    upd_proc(i, dst, *hpcrun_metric_set_loc(src, i));
+  }
+}
+
 //
 // copy a metric set
 //
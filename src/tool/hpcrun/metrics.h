@@ -154,6 +154,11 @@ extern void hpcrun_metric_std_set(int metric_id, metric_set_t* set,
 extern void hpcrun_metric_std_inc(int metric_id, metric_set_t* set,
 				  hpcrun_metricVal_t incr);
 //
+// combine the values of 'src' into 'dst', each with the update
+// procedure of its metric (metrics without one are summed)
+//
+extern void hpcrun_metric_set_combine(metric_set_t* dst, metric_set_t* src);
+//
 // copy a metric set
 //
 extern void hpcrun_metric_set_dense_copy(cct_metric_data_t* dest,
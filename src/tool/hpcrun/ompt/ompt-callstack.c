@@ -46,13 +46,15 @@
 
 
 //******************************************************************************
-// local includes  
+// local includes
 //******************************************************************************
 
 #include <ompt.h>
 
 #include <lib/prof-lean/placeholders.h>
+#include <lib/prof-lean/stdatomic.h>
 #include <hpcrun/cct_backtrace_finalize.h>
+#include <hpcrun/memory/hpcrun-malloc.h>
 #include <hpcrun/sample_event.h>
 #include <hpcrun/trace.h>
 #include <hpcrun/unresolved.h>
@@ -64,7 +66,7 @@
 #include "ompt-region.h"
 #include "ompt-task-map.h"
 
-#if defined(HOST_CPU_PPC) 
+#if defined(HOST_CPU_PPC)
 #include "ppc64-gnu-omp.h"
 #elif defined(HOST_CPU_x86) || defined(HOST_CPU_x86_64)
 #include "x86-gnu-omp.h"
@@ -79,6 +81,13 @@
 
 #define OMPT_DEBUG 1
 
+// per-thread memo of region contexts in the thread's own cct
+#define REGION_CONTEXT_LRU_SIZE 8
+
+// process-wide map from region id to a copy of the resolved region
+// path (power of 2)
+#define REGION_PATH_MAP_SIZE 1024
+
 #if OMPT_DEBUG
 #define elide_debug_dump(t,i,o,r) if (ompt_callstack_debug) stack_dump(t,i,o,r)
 #else
@@ -87,9 +96,44 @@
 
 
 //******************************************************************************
-// private variables 
+// types
 //******************************************************************************
 
+typedef struct region_context_s {
+  uint64_t region_id;
+  cct_node_t *context;   // in the cct of this thread
+  uint64_t epoch_gen;    // epoch of this thread when context was created
+} region_context_t;
+
+// the root a region path hangs from
+typedef enum {
+  REGION_ROOT_TREE,
+  REGION_ROOT_PARTIAL,
+  REGION_ROOT_UNRESOLVED
+} region_root_kind_t;
+
+// a copy of the frames of a resolved region path, below its root,
+// outermost first.  it refers to no cct node, so it outlives the
+// epochs of the thread that resolved it.  immutable once published
+// in region_path_map.
+typedef struct region_path_s {
+  uint64_t region_id;
+  region_root_kind_t root_kind;
+  uint32_t depth;
+  cct_addr_t frames[];
+} region_path_t;
+
+
+
+//******************************************************************************
+// private variables
+//******************************************************************************
+
+// most recently used first
+static __thread region_context_t region_context_lru[REGION_CONTEXT_LRU_SIZE];
+
+static atomic_uintptr_t region_path_map[REGION_PATH_MAP_SIZE];
+
 static cct_backtrace_finalize_entry_t ompt_finalizer;
 
 static int ompt_eager_context = 0;
@@ -101,15 +145,15 @@ static int ompt_callstack_debug = 0;
 // private  operations
 //******************************************************************************
 
-static void 
+static void
 stack_dump(
-  char *tag, 
-  frame_t *inner, 
-  frame_t *outer, 
+  char *tag,
+  frame_t *inner,
+  frame_t *outer,
   uint64_t region_id
-) 
+)
 {
-  EMSG("-----%s start", tag); 
+  EMSG("-----%s start", tag);
   for (frame_t* x = inner; x <= outer; ++x) {
     void* ip;
     hpcrun_unw_get_ip_unnorm_reg(&(x->cursor), &ip);
@@ -119,27 +163,27 @@ stack_dump(
 
     EMSG("ip = %p (%p), load module = %s", ip, x->ip_norm.lm_ip, lm_name);
   }
-  EMSG("-----%s end", tag); 
-  EMSG("<0x%lx>\n", region_id); 
+  EMSG("-----%s end", tag);
+  EMSG("<0x%lx>\n", region_id);
 }
 
 
 static int
 interval_contains(
-  void *lower, 
-  void *upper, 
+  void *lower,
+  void *upper,
   void *addr
 )
 {
   uint64_t uaddr  = (uint64_t) addr;
   uint64_t ulower = (uint64_t) lower;
   uint64_t uupper = (uint64_t) upper;
-  
+
   return ((ulower <= uaddr) & (uaddr <= uupper));
 }
 
 
-static ompt_state_t 
+static ompt_state_t
 check_state()
 {
   uint64_t wait_id;
@@ -147,7 +191,7 @@ check_state()
 }
 
 
-static void 
+static void
 set_frame(frame_t *f, ompt_placeholder_t *ph)
 {
   f->cursor.pc_unnorm = ph->pc;
@@ -156,12 +200,12 @@ set_frame(frame_t *f, ompt_placeholder_t *ph)
 }
 
 
-static void 
-collapse_callstack(backtrace_info_t *bt, ompt_placeholder_t *placeholder) 
+static void
+collapse_callstack(backtrace_info_t *bt, ompt_placeholder_t *placeholder)
 
 {
   set_frame(bt->last, placeholder);
-  bt->begin = bt->last; 
+  bt->begin = bt->last;
   bt->bottom_frame_elided = false;
   bt->partial_unwind = false;
 }
@@ -169,8 +213,8 @@ collapse_callstack(backtrace_info_t *bt, ompt_placeholder_t *placeholder)
 
 static void
 ompt_elide_runtime_frame(
-  backtrace_info_t *bt, 
-  uint64_t region_id, 
+  backtrace_info_t *bt,
+  uint64_t region_id,
   int isSync
 )
 {
@@ -183,14 +227,14 @@ ompt_elide_runtime_frame(
     collapse_callstack(bt, &ompt_placeholders.ompt_barrier_wait);
     return;
   case ompt_state_idle:
-    if (!TD_GET(master)) { 
+    if (!TD_GET(master)) {
       collapse_callstack(bt, &ompt_placeholders.ompt_idle);
       return;
     }
   default: break;
   }
 
-  frame_t **bt_outer = &bt->last; 
+  frame_t **bt_outer = &bt->last;
   frame_t **bt_inner = &bt->begin;
 
   frame_t *bt_outer_at_entry = *bt_outer;
@@ -203,45 +247,45 @@ ompt_elide_runtime_frame(
 
   TD_GET(omp_task_context) = 0;
 
-  elide_debug_dump("ORIGINAL", *bt_inner, *bt_outer, region_id); 
+  elide_debug_dump("ORIGINAL", *bt_inner, *bt_outer, region_id);
 
   //---------------------------------------------------------------
-  // handle all of the corner cases that can occur at the top of 
+  // handle all of the corner cases that can occur at the top of
   // the stack first
   //---------------------------------------------------------------
 
   if (!frame0) {
-    // corner case: the innermost task (if any) has no frame info. 
+    // corner case: the innermost task (if any) has no frame info.
     // no action necessary. just return.
     goto clip_base_frames;
   }
 
   while ((frame0->reenter_runtime_frame == 0) && (frame0->exit_runtime_frame == 0)) {
-    // corner case: the top frame has been set up, but not filled in. 
+    // corner case: the top frame has been set up, but not filled in.
     // ignore this frame.
     frame0 = hpcrun_ompt_get_task_frame(++i);
 
     if (!frame0) {
-      // corner case: the innermost task (if any) has no frame info. 
+      // corner case: the innermost task (if any) has no frame info.
       goto clip_base_frames;
     }
   }
 
-  if (frame0->exit_runtime_frame && 
+  if (frame0->exit_runtime_frame &&
       (((uint64_t) frame0->exit_runtime_frame) < ((uint64_t) (*bt_inner)->cursor.sp))) {
-    // corner case: the top frame has been set up, exit frame has been filled in; 
-    // however, exit_runtime_frame points beyond the top of stack. the final call 
+    // corner case: the top frame has been set up, exit frame has been filled in;
+    // however, exit_runtime_frame points beyond the top of stack. the final call
     // to user code hasn't been made yet. ignore this frame.
     frame0 = hpcrun_ompt_get_task_frame(++i);
   }
 
   if (!frame0) {
-    // corner case: the innermost task (if any) has no frame info. 
+    // corner case: the innermost task (if any) has no frame info.
     goto clip_base_frames;
   }
 
-  if (frame0->reenter_runtime_frame) { 
-    // the sample was received inside the runtime; 
+  if (frame0->reenter_runtime_frame) {
+    // the sample was received inside the runtime;
     // elide frames from top of stack down to runtime entry
     int found = 0;
     for (it = *bt_inner; it <= *bt_outer; it++) {
@@ -278,18 +322,18 @@ ompt_elide_runtime_frame(
     void *high_sp = (*bt_outer)->cursor.sp;
 
     // if a frame marker is inside the call stack, set its flag to true
-    bool exit0_flag = 
+    bool exit0_flag =
       interval_contains(low_sp, high_sp, frame0->exit_runtime_frame);
 
-    /* start from the top of the stack (innermost frame). 
+    /* start from the top of the stack (innermost frame).
        find the matching frame in the callstack for each of the markers in the
        stack. look for them in the order in which they should occur.
 
        optimization note: this always starts at the top of the stack. this can
-       lead to quadratic cost. could pick up below where you left off cutting in 
+       lead to quadratic cost. could pick up below where you left off cutting in
        previous iterations.
     */
-    it = *bt_inner; 
+    it = *bt_inner;
     if(exit0_flag) {
       for (; it <= *bt_outer; it++) {
         if((uint64_t)(it->cursor.sp) > (uint64_t)(frame0->exit_runtime_frame)) {
@@ -308,8 +352,8 @@ ompt_elide_runtime_frame(
     frame1 = hpcrun_ompt_get_task_frame(++i);
     if (!frame1) break;
 
-    bool reenter1_flag = 
-      interval_contains(low_sp, high_sp, frame1->reenter_runtime_frame); 
+    bool reenter1_flag =
+      interval_contains(low_sp, high_sp, frame1->reenter_runtime_frame);
     if(reenter1_flag) {
       for (; it <= *bt_outer; it++) {
         if((uint64_t)(it->cursor.sp) > (uint64_t)(frame1->reenter_runtime_frame)) {
@@ -324,14 +368,14 @@ ompt_elide_runtime_frame(
 #if 1
       // laksono 2014.07.08: hack removing one more frame to avoid redundancy with the parent
       // It seems the last frame of the master is the same as the first frame of the workers thread
-      // By eliminating the topmost frame we should avoid the appearance of the same frame twice 
+      // By eliminating the topmost frame we should avoid the appearance of the same frame twice
       //  in the callpath
-      memmove(*bt_inner+(reenter1-exit0+1), *bt_inner, 
+      memmove(*bt_inner+(reenter1-exit0+1), *bt_inner,
 	      (exit0 - *bt_inner)*sizeof(frame_t));
       *bt_inner = *bt_inner + (reenter1 - exit0 + 1);
 #else
       // was missing a frame with intel's runtime; eliminate +1 -- johnmc
-      memmove(*bt_inner+(reenter1-exit0), *bt_inner, 
+      memmove(*bt_inner+(reenter1-exit0), *bt_inner,
 	      (exit0 - *bt_inner)*sizeof(frame_t));
       *bt_inner = *bt_inner + (reenter1 - exit0);
 #endif
@@ -351,15 +395,15 @@ ompt_elide_runtime_frame(
 
   bt->trace_pc = (*bt_inner)->cursor.pc_unnorm;
 
-  elide_debug_dump("ELIDED", *bt_inner, *bt_outer, region_id); 
+  elide_debug_dump("ELIDED", *bt_inner, *bt_outer, region_id);
   return;
 
  clip_base_frames:
   {
     int master = TD_GET(master);
-    if (!master) { 
+    if (!master) {
       set_frame(*bt_outer, &ompt_placeholders.ompt_idle);
-      *bt_inner = *bt_outer; 
+      *bt_inner = *bt_outer;
       bt->bottom_frame_elided = false;
       bt->partial_unwind = false;
       bt->trace_pc = (*bt_inner)->cursor.pc_unnorm;
@@ -382,26 +426,50 @@ ompt_elide_runtime_frame(
     } else {
       /* no idle frame. show the whole stack. */
     }
-    
-    elide_debug_dump("ELIDED INNERMOST FRAMES", *bt_inner, *bt_outer, region_id); 
+
+    elide_debug_dump("ELIDED INNERMOST FRAMES", *bt_inner, *bt_outer, region_id);
     return;
   }
 }
 
 
+//
+// a context memoized by a thread lives in its cct: it is valid only as long
+// as the thread's epoch (see hpcrun_epoch_reset) has not changed.
+//
 static cct_node_t *
 memoized_context_get(thread_data_t* td, uint64_t region_id)
 {
-  return (td->outer_region_id == region_id && td->outer_region_context) ? 
-    td->outer_region_context : 
-    NULL;
+  for (int i = 0; i < REGION_CONTEXT_LRU_SIZE; i++) {
+    region_context_t entry = region_context_lru[i];
+    if (entry.region_id == region_id && entry.context) {
+      if (entry.epoch_gen != td->epoch_gen) return NULL;
+
+      // move to front
+      for (; i > 0; i--) region_context_lru[i] = region_context_lru[i - 1];
+      region_context_lru[0] = entry;
+
+      return entry.context;
+    }
+  }
+  return NULL;
 }
 
 static void
 memoized_context_set(thread_data_t* td, uint64_t region_id, cct_node_t *result)
 {
-    td->outer_region_id = region_id;
-    td->outer_region_context = result;
+  // evict the least recently used entry, or a stale one for region_id
+  int i;
+  for (i = 0; i < REGION_CONTEXT_LRU_SIZE - 1; i++) {
+    if (region_context_lru[i].region_id == region_id) break;
+  }
+  for (; i > 0; i--) region_context_lru[i] = region_context_lru[i - 1];
+
+  region_context_lru[0] = (region_context_t) {
+    .region_id = region_id,
+    .context = result,
+    .epoch_gen = td->epoch_gen
+  };
 }
 
 
@@ -413,18 +481,128 @@ region_root(cct_node_t *_node)
   while (node) {
     cct_addr_t *addr = hpcrun_cct_addr(node);
     if (IS_UNRESOLVED_ROOT(addr)) {
-      root = hpcrun_get_thread_epoch()->csdata.unresolved_root; 
+      root = hpcrun_get_thread_epoch()->csdata.unresolved_root;
       break;
     } else if (IS_PARTIAL_ROOT(addr)) {
-      root = hpcrun_get_thread_epoch()->csdata.partial_unw_root; 
+      root = hpcrun_get_thread_epoch()->csdata.partial_unw_root;
       break;
     }
     node = hpcrun_cct_parent(node);
   }
-  if (node == NULL) root = hpcrun_get_thread_epoch()->csdata.tree_root; 
+  if (node == NULL) root = hpcrun_get_thread_epoch()->csdata.tree_root;
   return root;
 }
 
+static atomic_uintptr_t *
+region_path_slot(uint64_t region_id)
+{
+  uint64_t h = region_id * 0x9E3779B97F4A7C15ull;
+  return &region_path_map[(h >> 32) & (REGION_PATH_MAP_SIZE - 1)];
+}
+
+
+//
+// lock-free lookup in the process-wide region path map. callers are
+// inside a sample, i.e., a hpcrun_freeable_enter/exit section, so an
+// entry replaced concurrently is not reused while it is being read.
+//
+static region_path_t *
+region_path_get(uint64_t region_id)
+{
+  region_path_t *entry = (region_path_t *)
+    atomic_load_explicit(region_path_slot(region_id), memory_order_acquire);
+
+  return (entry && entry->region_id == region_id) ? entry : NULL;
+}
+
+
+//
+// the map is direct mapped: a newer region evicts the older region that
+// hashes to the same slot. region ids are not reused, so an evicted region
+// is rarely asked for again, and then hpcrun_region_lookup answers.
+//
+static void
+region_path_set(region_path_t *entry)
+{
+  uintptr_t old = atomic_exchange_explicit(region_path_slot(entry->region_id),
+					   (uintptr_t) entry,
+					   memory_order_acq_rel);
+  if (old) hpcrun_free_deferred((void *) old);
+}
+
+
+//
+// copy the frames of 'path' below its root, or return NULL if out of
+// memory. the frames keep no lush logical ip: the copy must not point
+// into the memory of the thread that resolved the region.
+//
+static region_path_t *
+region_path_copy(uint64_t region_id, cct_node_t *path)
+{
+  uint32_t depth = 0;
+  cct_node_t *node;
+  for (node = path; hpcrun_cct_parent(node); node = hpcrun_cct_parent(node)) {
+    depth++;
+  }
+
+  region_root_kind_t root_kind = REGION_ROOT_TREE;
+  cct_addr_t *root_addr = hpcrun_cct_addr(node);
+  if (IS_UNRESOLVED_ROOT(root_addr)) {
+    root_kind = REGION_ROOT_UNRESOLVED;
+  } else if (IS_PARTIAL_ROOT(root_addr)) {
+    root_kind = REGION_ROOT_PARTIAL;
+  }
+
+  region_path_t *entry =
+    hpcrun_malloc_freeable(sizeof(region_path_t) + depth * sizeof(cct_addr_t));
+  if (entry == NULL) return NULL;
+
+  entry->region_id = region_id;
+  entry->root_kind = root_kind;
+  entry->depth = depth;
+
+  uint32_t i = depth;
+  for (node = path; hpcrun_cct_parent(node); node = hpcrun_cct_parent(node)) {
+    cct_addr_t *addr = hpcrun_cct_addr(node);
+    i--;
+    entry->frames[i].as_info = addr->as_info;
+    entry->frames[i].ip_norm = addr->ip_norm;
+    entry->frames[i].lip = NULL;
+  }
+
+  return entry;
+}
+
+
+//
+// insert the frames of 'entry' below the matching root of this thread's
+// epoch; returns the leaf.
+//
+static cct_node_t *
+region_path_insert(region_path_t *entry)
+{
+  cct_bundle_t *cct = &(hpcrun_get_thread_epoch()->csdata);
+  cct_node_t *node;
+
+  switch (entry->root_kind) {
+  case REGION_ROOT_UNRESOLVED:
+    node = cct->unresolved_root;
+    break;
+  case REGION_ROOT_PARTIAL:
+    node = cct->partial_unw_root;
+    break;
+  default:
+    node = cct->tree_root;
+    break;
+  }
+
+  for (uint32_t i = 0; i < entry->depth; i++) {
+    node = hpcrun_cct_insert_addr(node, &(entry->frames[i]));
+  }
+  return node;
+}
+
+
 static cct_node_t *
 lookup_region_id(uint64_t region_id)
 {
@@ -434,11 +612,27 @@ lookup_region_id(uint64_t region_id)
   if (hpcrun_trace_isactive()) {
     result = memoized_context_get(td, region_id);
     if (result) return result;
-  
-    cct_node_t *t0_path = hpcrun_region_lookup(region_id);
-    if (t0_path) {
-      cct_node_t *rroot = region_root(t0_path);
-      result = hpcrun_cct_insert_path_return_leaf(rroot, t0_path);
+
+    // the first thread that resolves a region publishes a copy of its
+    // path to all
+    region_path_t *entry = region_path_get(region_id);
+    if (entry == NULL) {
+      cct_node_t *t0_path = hpcrun_region_lookup(region_id);
+      if (t0_path) {
+	entry = region_path_copy(region_id, t0_path);
+	if (entry) {
+	  region_path_set(entry);
+	} else {
+	  cct_node_t *rroot = region_root(t0_path);
+	  result = hpcrun_cct_insert_path_return_leaf(rroot, t0_path);
+	}
+      }
+    }
+
+    if (entry) {
+      result = region_path_insert(entry);
+    }
+    if (result) {
       memoized_context_set(td, region_id, result);
     }
   }
@@ -448,8 +642,8 @@ lookup_region_id(uint64_t region_id)
 
 
 cct_node_t *
-ompt_region_context(uint64_t region_id, 
-		    ompt_context_type_t ctype, 
+ompt_region_context(uint64_t region_id,
+		    ompt_context_type_t ctype,
 		    int levels_to_skip,
                     int adjust_callsite)
 {
@@ -461,26 +655,26 @@ ompt_region_context(uint64_t region_id,
   TMSG(DEFER_CTXT, "unwind the callstack for region 0x%lx", region_id);
 
   if (node && adjust_callsite) {
-    // extract the load module and offset of the leaf CCT node at the 
+    // extract the load module and offset of the leaf CCT node at the
     // end of a call path representing a parallel region
     cct_addr_t *n = hpcrun_cct_addr(node);
-    cct_node_t *n_parent = hpcrun_cct_parent(node); 
-    uint16_t lm_id = n->ip_norm.lm_id; 
+    cct_node_t *n_parent = hpcrun_cct_parent(node);
+    uint16_t lm_id = n->ip_norm.lm_id;
     uintptr_t lm_ip = n->ip_norm.lm_ip;
     uintptr_t master_outlined_fn_return_addr;
 
-    // adjust the address to point to return address of the call to 
+    // adjust the address to point to return address of the call to
     // the outlined function in the master
     if (ctype == ompt_context_begin) {
       void *ip = hpcrun_denormalize_ip(&(n->ip_norm));
       uint64_t offset = offset_to_pc_after_next_call(ip);
       master_outlined_fn_return_addr = lm_ip + offset;
-    } else { 
+    } else {
       uint64_t offset = length_of_call_instruction();
       master_outlined_fn_return_addr = lm_ip - offset;
     }
     // ensure that there is a leaf CCT node with the proper return address
-    // to use as the context. when using the GNU API for OpenMP, it will 
+    // to use as the context. when using the GNU API for OpenMP, it will
     // be a sibling to one returned by sample_callpath.
     cct_node_t *sibling = hpcrun_cct_insert_addr
       (n_parent, &(ADDR2(lm_id, master_outlined_fn_return_addr)));
@@ -491,11 +685,11 @@ ompt_region_context(uint64_t region_id,
 }
 
 cct_node_t *
-ompt_parallel_begin_context(ompt_parallel_id_t region_id, int levels_to_skip, 
+ompt_parallel_begin_context(ompt_parallel_id_t region_id, int levels_to_skip,
                             int adjust_callsite)
 {
-  if (ompt_eager_context) 
-    return ompt_region_context(region_id, ompt_context_begin, 
+  if (ompt_eager_context)
+    return ompt_region_context(region_id, ompt_context_begin,
                                ++levels_to_skip, adjust_callsite);
   else return NULL;
 }
@@ -503,9 +697,9 @@ ompt_parallel_begin_context(ompt_parallel_id_t region_id, int levels_to_skip,
 
 static void
 ompt_backtrace_finalize(
-  backtrace_info_t *bt, 
+  backtrace_info_t *bt,
   int isSync
-) 
+)
 {
   // ompt: elide runtime frames
   // if that is the case, then it will later become available in a deferred fashion.
@@ -522,7 +716,7 @@ ompt_backtrace_finalize(
 
 
 cct_node_t *
-ompt_cct_cursor_finalize(cct_bundle_t *cct, backtrace_info_t *bt, 
+ompt_cct_cursor_finalize(cct_bundle_t *cct, backtrace_info_t *bt,
                            cct_node_t *cct_cursor)
 {
   cct_node_t *omp_task_context = TD_GET(omp_task_context);
@@ -536,9 +730,9 @@ ompt_cct_cursor_finalize(cct_bundle_t *cct, backtrace_info_t *bt,
     root = region_root(omp_task_context);
 #else
     if((is_partial_resolve((cct_node_t *)omp_task_context) > 0)) {
-      root = hpcrun_get_thread_epoch()->csdata.unresolved_root; 
+      root = hpcrun_get_thread_epoch()->csdata.unresolved_root;
     } else {
-      root = hpcrun_get_thread_epoch()->csdata.tree_root; 
+      root = hpcrun_get_thread_epoch()->csdata.tree_root;
     }
 #endif
     return hpcrun_cct_insert_path_return_leaf(root, omp_task_context);
@@ -557,11 +751,11 @@ ompt_cct_cursor_finalize(cct_bundle_t *cct, backtrace_info_t *bt,
 	// full context is available now. use it.
 	cct_cursor = prefix;
       } else {
-	// full context is not available. if the there is a node for region_id in 
-	// the unresolved tree, use it as the cursor to anchor the sample for now. 
+	// full context is not available. if the there is a node for region_id in
+	// the unresolved tree, use it as the cursor to anchor the sample for now.
 	// it will be resolved later. otherwise, use the default cursor.
-	prefix = 
-	  hpcrun_cct_find_addr((hpcrun_get_thread_epoch()->csdata).unresolved_root, 
+	prefix =
+	  hpcrun_cct_find_addr((hpcrun_get_thread_epoch()->csdata).unresolved_root,
 			       &(ADDR2(UNRESOLVED, region_id)));
 	if (prefix) cct_cursor = prefix;
       }
@@ -572,7 +766,7 @@ ompt_cct_cursor_finalize(cct_bundle_t *cct, backtrace_info_t *bt,
 }
 
 
-void 
+void
 ompt_callstack_register_handlers(void)
 {
   if (hpcrun_trace_isactive()) ompt_eager_context = 1;
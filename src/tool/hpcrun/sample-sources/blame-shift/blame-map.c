@@ -47,12 +47,41 @@
 //
 // directed blame shifting for locks, critical sections, ...
 //
+// The map is an open-addressing hash table with linear probing, keyed
+// by the full 64-bit object address, with a 56-bit blame accumulator
+// per entry.  All operations are lock-free.
+//
+// When a table gets too full, a new table is linked in front of it and
+// the entries of the old table are migrated to the new one
+// incrementally: every add or get moves a chunk of old entries.  A
+// migrated entry's blame is marked MOVED, which sends any thread that
+// still uses the old table on to the new one.  Tables come from the
+// memstore and are never freed.
+//
+// A slot keeps its key once claimed, even after get_blame has taken
+// its blame, since emptying it would break the probe sequences that
+// pass through it.  Such dead entries are reclaimed by migration,
+// which only moves the entries that hold blame.  So a table counts
+// both its claimed slots ('used', which decides when it is too full)
+// and its live entries ('live', which decides the size of the next
+// table): a table full of dead entries is replaced by one of the same
+// size rather than by one twice as big.
+//
+// While an entry migrates, its blame is in transit: the migrating
+// thread counts it as pending in the entry of the new table before it
+// takes the blame from the old one, and adds it there afterwards.  A
+// get_blame that finds the old entry MOVED follows the tables to the
+// new entry and waits a bounded time for the pending blame.
+//
+
+
 
 /******************************************************************************
  * system includes
  *****************************************************************************/
 
-#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
 
 
 
@@ -70,29 +99,23 @@
  * macros
  *****************************************************************************/
 
-#define N (128*1024)
-#define INDEX_MASK ((N)-1)
-
-#define LOSSLESS_BLAME
-
-#ifdef BLAME_MAP_LOCKING
+#define INITIAL_LOG_SIZE  14        // 16K entries
+#define MAX_LOAD_NUM      3         // replace when more than 3/4 full
+#define MAX_LOAD_DEN      4
+#define MIGRATE_CHUNK     64
+#define MAX_FULL_RETRIES  1024      // while another thread grows the table
+#define MAX_PENDING_SPINS 1024      // while another thread migrates an entry
 
-#define do_lock() \
-{ \
-  for(;;) { \
-    if (fetch_and_store_i64(&thelock, 1) == 0) break; \
-    while (thelock == 1); \
-  } \
-}
-
-#define do_unlock() thelock = 0
+#define EMPTY_KEY   ((uint64_t) 0)
+#define MOVED_KEY   (~((uint64_t) 0))      // empty slot closed by migration
 
-#else
+// the blame word of an entry
+#define MOVED         (((uint64_t) 1) << 63)  // blame was migrated
+#define PENDING_ONE   (((uint64_t) 1) << 56)  // one migration in transit
+#define PENDING_MASK  (((uint64_t) 0x7f) << 56)
+#define BLAME_MASK    (PENDING_ONE - 1)
 
-#define do_lock() 
-#define do_unlock()
-
-#endif
+#define HASH_MULTIPLIER  0x9E3779B97F4A7C15ULL
 
 
 
@@ -101,51 +124,333 @@
  *****************************************************************************/
 
 typedef struct {
-  uint32_t obj_id;
-  uint32_t blame;
-} blame_parts_t;
-
-
-union blame_entry_t {
-  atomic_uint_least64_t  all;
-  blame_parts_t parts; 
+  atomic_uint_least64_t obj;
+  atomic_uint_least64_t blame;
+} blame_entry_t;
+
+
+typedef struct blame_table_t {
+  int log_size;
+  uint64_t size;
+  atomic_uint_least64_t used;        // slots with a key
+  atomic_uint_least64_t live;        // slots with a key and blame
+  atomic_uint_least64_t migrate_next;
+  atomic_uint_least64_t migrated;
+  _Atomic(struct blame_table_t *) next;     // newer table, if any
+  _Atomic(struct blame_table_t *) prev;     // older table being migrated
+  blame_entry_t entries[];
+} blame_table_t;
+
+
+struct blame_map_t {
+  _Atomic(blame_table_t *) current;
+  atomic_int resizing;
+
+  // statistics
+  atomic_uint_least64_t num_inserts;
+  atomic_uint_least64_t num_probes;    // slots examined past the home slot
+  atomic_uint_least64_t num_resizes;   // tables twice as big
+  atomic_uint_least64_t num_rebuilds;  // tables of the same size
+  atomic_uint_least64_t num_reclaimed; // dead entries not migrated
+  atomic_uint_least64_t num_dropped;
 };
 
 
 
 /***************************************************************************
- * private data  
+ * private operations
  ***************************************************************************/
 
-static uint64_t volatile thelock;
+static uint64_t
+blame_map_hash(blame_table_t *table, uint64_t obj)
+{
+  return (obj * HASH_MULTIPLIER) >> (64 - table->log_size);
+}
 
 
+static blame_table_t *
+blame_table_new(int log_size)
+{
+  uint64_t size = ((uint64_t) 1) << log_size;
+  blame_table_t *table =
+    hpcrun_malloc(sizeof(blame_table_t) + size * sizeof(blame_entry_t));
+
+  if (table == NULL) return NULL;
+
+  table->log_size = log_size;
+  table->size = size;
+  atomic_init(&table->used, 0);
+  atomic_init(&table->live, 0);
+  atomic_init(&table->migrate_next, 0);
+  atomic_init(&table->migrated, 0);
+  atomic_init(&table->next, NULL);
+  atomic_init(&table->prev, NULL);
+  for (uint64_t i = 0; i < size; i++) {
+    atomic_init(&table->entries[i].obj, EMPTY_KEY);
+    atomic_init(&table->entries[i].blame, 0);
+  }
+  return table;
+}
 
-/***************************************************************************
- * private operations
- ***************************************************************************/
 
-uint32_t 
-blame_map_obj_id(uint64_t obj)
+//
+// find the entry for obj in table, claiming an empty slot for it if
+// 'insert' is set.  returns NULL if obj is not in the table (or there
+// is no room for it).
+//
+static blame_entry_t *
+blame_table_find(blame_map_t *map, blame_table_t *table, uint64_t obj,
+		 bool insert)
+{
+  uint64_t mask = table->size - 1;
+  uint64_t index = blame_map_hash(table, obj);
+
+  for (uint64_t probes = 0; probes < table->size; probes++) {
+    blame_entry_t *entry = &table->entries[(index + probes) & mask];
+    uint64_t key = atomic_load_explicit(&entry->obj, memory_order_acquire);
+
+    if (key == EMPTY_KEY) {
+      if (! insert) return NULL;
+      if (atomic_compare_exchange_strong_explicit(&entry->obj, &key, obj,
+						  memory_order_acq_rel,
+						  memory_order_acquire)) {
+	atomic_fetch_add_explicit(&table->used, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&map->num_inserts, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&map->num_probes, probes, memory_order_relaxed);
+	return entry;
+      }
+      // lost the slot; key now holds the winner's object
+    }
+    if (key == obj) {
+      if (insert) {
+	atomic_fetch_add_explicit(&map->num_probes, probes, memory_order_relaxed);
+      }
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+
+//
+// add 'value' and 'pending' (a multiple of PENDING_ONE, possibly
+// negative) to an entry of table.  returns false if the entry was
+// migrated.
+//
+static bool
+blame_entry_add(blame_table_t *table, blame_entry_t *entry, uint64_t value,
+		uint64_t pending)
+{
+  uint64_t blame = atomic_load_explicit(&entry->blame, memory_order_relaxed);
+
+  while (! (blame & MOVED)) {
+    uint64_t sum = (((blame & BLAME_MASK) + value) & BLAME_MASK)
+      | (((blame & PENDING_MASK) + pending) & PENDING_MASK);
+    if (atomic_compare_exchange_weak_explicit(&entry->blame, &blame, sum,
+					      memory_order_release,
+					      memory_order_relaxed)) {
+      if ((blame & BLAME_MASK) == 0 && (sum & BLAME_MASK) != 0) {
+	atomic_fetch_add_explicit(&table->live, 1, memory_order_relaxed);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+
+static void blame_map_grow(blame_map_t *map, blame_table_t *table);
+static bool blame_map_help_migrate(blame_map_t *map, blame_table_t *current);
+
+
+static bool
+blame_table_overfull(blame_table_t *table)
+{
+  return atomic_load_explicit(&table->used, memory_order_relaxed)
+    > table->size / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
+
+
+//
+// add blame (and pending migrations) for obj, starting at 'table' and
+// following newer tables as needed.  returns the entry that took it,
+// or NULL if there was no room for obj.
+//
+// a full table is only possible while another thread is growing it
+// (or finishing the previous migration).  that thread may be the one
+// we interrupted, so we retry a bounded number of times, then give up.
+//
+static blame_entry_t *
+blame_map_add(blame_map_t *map, blame_table_t *table, uint64_t obj,
+	      uint64_t metric_value, uint64_t pending, blame_table_t **where)
+{
+  int retries = 0;
+
+  while (table != NULL) {
+    if (blame_table_overfull(table) && atomic_load(&table->next) == NULL) {
+      blame_map_grow(map, table);
+    }
+
+    blame_entry_t *entry = blame_table_find(map, table, obj, true);
+
+    if (entry != NULL && blame_entry_add(table, entry, metric_value, pending)) {
+      if (where) *where = table;
+      return entry;
+    }
+    // else full, or the entry was migrated while we used it: follow the table
+
+    blame_table_t *next = atomic_load(&table->next);
+    if (next == NULL) {
+      next = atomic_load(&map->current);
+    }
+    if (next == table) {
+      // full, and not yet replaced
+      if (++retries > MAX_FULL_RETRIES) break;
+      while (blame_map_help_migrate(map, table));
+      blame_map_grow(map, table);
+    }
+    table = next;
+  }
+  return NULL;
+}
+
+
+//
+// move the blame of one entry of an old table into the newest table.
+// an entry without blame is dead: it is dropped.
+//
+static void
+blame_entry_migrate(blame_map_t *map, blame_entry_t *entry)
 {
-  return ((uint32_t) ((uint64_t)obj) >> 2);
+  uint64_t key = EMPTY_KEY;
+
+  // close an empty slot so no stale inserter can use it
+  if (atomic_compare_exchange_strong(&entry->obj, &key, MOVED_KEY)) return;
+  if (key == MOVED_KEY) return;
+
+  uint64_t blame = atomic_load(&entry->blame);
+  if (blame & MOVED) return;
+
+  blame_entry_t *dst = NULL;
+  blame_table_t *dst_table = NULL;
+  if (blame & BLAME_MASK) {
+    // announce the blame in the new table before taking it from here
+    dst = blame_map_add(map, atomic_load(&map->current), key, 0, PENDING_ONE,
+			&dst_table);
+  }
+
+  blame = atomic_exchange(&entry->blame, MOVED) & BLAME_MASK;
+
+  if (dst == NULL) {
+    if (blame == 0) {
+      atomic_fetch_add(&map->num_reclaimed, 1);
+    }
+    else if (! blame_map_add(map, atomic_load(&map->current), key, blame, 0, NULL)) {
+      atomic_fetch_add(&map->num_dropped, 1);
+    }
+    return;
+  }
+
+  if (! blame_entry_add(dst_table, dst, blame, - PENDING_ONE)) {
+    // the new entry migrated meanwhile: its pending count went with it
+    if (blame != 0
+	&& ! blame_map_add(map, atomic_load(&map->current), key, blame, 0, NULL)) {
+      atomic_fetch_add(&map->num_dropped, 1);
+    }
+  }
 }
 
 
-uint32_t 
-blame_map_hash(uint64_t obj) 
+//
+// migrate a chunk of the table that the current table replaces, and
+// unlink it once it is empty.  returns false if there is nothing left
+// to claim.
+//
+static bool
+blame_map_help_migrate(blame_map_t *map, blame_table_t *current)
 {
-  return ((uint32_t)((blame_map_obj_id(obj)) & INDEX_MASK));
+  blame_table_t *old = atomic_load(&current->prev);
+  if (old == NULL) return false;
+
+  uint64_t start = atomic_fetch_add(&old->migrate_next, MIGRATE_CHUNK);
+  if (start >= old->size) return false;
+
+  uint64_t end = start + MIGRATE_CHUNK;
+  if (end > old->size) end = old->size;
+
+  for (uint64_t i = start; i < end; i++) {
+    blame_entry_migrate(map, &old->entries[i]);
+  }
+  if (atomic_fetch_add(&old->migrated, end - start) + (end - start) == old->size) {
+    atomic_store(&current->prev, NULL);
+    TMSG(LOCKWAIT, "blame map: migrated %ld entries", (long) old->size);
+  }
+  return true;
 }
 
 
-uint64_t 
-blame_map_entry(uint64_t obj, uint32_t metric_value)
+//
+// replace a full table: by one of the same size if at most half of it
+// is live, since migration drops the dead entries, else by one twice
+// its size.  only one resize at a time, and only when all of the
+// previous migration has been claimed (the last chunks may still be in
+// progress in other threads).
+//
+static void
+blame_map_grow(blame_map_t *map, blame_table_t *table)
 {
-  blame_entry_t be;
-  be.parts.obj_id = blame_map_obj_id(obj);
-  be.parts.blame = metric_value;
-  return atomic_load_explicit(&be.all, memory_order_relaxed);
+  blame_table_t *old = atomic_load(&table->prev);
+  int busy = 0;
+
+  if ((old != NULL && atomic_load(&old->migrate_next) < old->size)
+      || ! atomic_compare_exchange_strong(&map->resizing, &busy, 1)) {
+    return;
+  }
+  if (atomic_load(&map->current) == table) {
+    bool rebuild = atomic_load(&table->live) <= table->size / 2;
+    blame_table_t *bigger =
+      blame_table_new(rebuild ? table->log_size : table->log_size + 1);
+    if (bigger != NULL) {
+      atomic_store(&bigger->prev, table);
+      atomic_store(&table->next, bigger);
+      atomic_store(&map->current, bigger);
+      atomic_fetch_add(rebuild ? &map->num_rebuilds : &map->num_resizes, 1);
+      TMSG(LOCKWAIT, "blame map: %s to %ld entries (%ld live)",
+	   rebuild ? "rebuild" : "grow", (long) bigger->size,
+	   (long) atomic_load(&table->live));
+    }
+  }
+  atomic_store(&map->resizing, 0);
+}
+
+
+//
+// take the blame of an entry, waiting a bounded time for the blame of
+// a migration in transit.  returns false if the entry was migrated.
+//
+static bool
+blame_entry_take(blame_table_t *table, blame_entry_t *entry, uint64_t *val)
+{
+  uint64_t blame = atomic_load_explicit(&entry->blame, memory_order_acquire);
+
+  // the migrating thread may be the one we interrupted: don't wait forever
+  for (int spins = 0; (blame & PENDING_MASK) && ! (blame & MOVED)
+	 && spins < MAX_PENDING_SPINS; spins++) {
+    blame = atomic_load_explicit(&entry->blame, memory_order_acquire);
+  }
+
+  while (! (blame & MOVED)) {
+    if ((blame & BLAME_MASK) == 0) return true;
+    if (atomic_compare_exchange_weak_explicit(&entry->blame, &blame,
+					      blame & PENDING_MASK,
+					      memory_order_acquire,
+					      memory_order_acquire)) {
+      atomic_fetch_sub_explicit(&table->live, 1, memory_order_relaxed);
+      *val += blame & BLAME_MASK;
+      return true;
+    }
+  }
+  return false;
 }
 
 
@@ -154,109 +459,91 @@ blame_map_entry(uint64_t obj, uint32_t metric_value)
  * interface operations
  ***************************************************************************/
 
-blame_entry_t*
+blame_map_t*
 blame_map_new(void)
 {
-  blame_entry_t* rv = hpcrun_malloc(N * sizeof(blame_entry_t));
-  blame_map_init(rv);
+  blame_map_t* rv = hpcrun_malloc(sizeof(blame_map_t));
+  if (rv) blame_map_init(rv);
   return rv;
 }
 
-void 
-blame_map_init(blame_entry_t table[])
+
+void
+blame_map_init(blame_map_t* map)
 {
-  int i;
-  for(i = 0; i < N; i++) {
-    table[i].parts.obj_id = 0;
-    table[i].parts.blame = 0;
-  }
+  atomic_init(&map->current, blame_table_new(INITIAL_LOG_SIZE));
+  atomic_init(&map->resizing, 0);
+  atomic_init(&map->num_inserts, 0);
+  atomic_init(&map->num_probes, 0);
+  atomic_init(&map->num_resizes, 0);
+  atomic_init(&map->num_rebuilds, 0);
+  atomic_init(&map->num_reclaimed, 0);
+  atomic_init(&map->num_dropped, 0);
 }
 
 
 void
-blame_map_add_blame(blame_entry_t table[],
-		    uint64_t obj, uint32_t metric_value)
+blame_map_add_blame(blame_map_t* map, uint64_t obj, uint64_t metric_value)
 {
-  uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      blame_entry_t newval = oldval;
-      newval.parts.blame += metric_value;
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      uint64_t newall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newall,
-						  memory_order_relaxed, memory_order_relaxed) 
-	    == testoldall) break;
-#else
-      oldval.parts.blame += metric_value;
-      table[index].all = oldval.all;
-      break;
-#endif
-    } else {
-      if(oldval.parts.obj_id == 0) {
-	uint64_t newval = blame_map_entry(obj, metric_value);
-#ifdef LOSSLESS_BLAME
-	uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-	uint64_t testoldall = oldall;
-	if ((atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, newval,
-						     memory_order_relaxed, memory_order_relaxed)) 
-	    == testoldall) break;
-	// otherwise, try again
-#else
-	table[index].all = newval;
-	break;
-#endif
-      }
-      else {
-	EMSG("leaked blame %d\n", metric_value);
-	// entry in use for another object's blame
-	// in this case, since it isn't easy to shift 
-	// our blame efficiently, we simply drop it.
-	break;
-      }
-    }
+  blame_table_t *table = atomic_load(&map->current);
+
+  if (obj == EMPTY_KEY || obj == MOVED_KEY || table == NULL) return;
+
+  blame_map_help_migrate(map, table);
+
+  if (! blame_map_add(map, table, obj, metric_value & BLAME_MASK, 0, NULL)) {
+    atomic_fetch_add(&map->num_dropped, 1);
+    EMSG("blame map: dropped blame %ld for object %p", (long) metric_value,
+	 (void *) obj);
   }
-  do_unlock();
 }
 
 
-uint64_t 
-blame_map_get_blame(blame_entry_t table[], uint64_t obj)
+uint64_t
+blame_map_get_blame(blame_map_t* map, uint64_t obj)
 {
-  static uint64_t zero = 0;
+  blame_table_t *current = atomic_load(&map->current);
   uint64_t val = 0;
-  uint32_t obj_id = blame_map_obj_id(obj);
-  uint32_t index = blame_map_hash(obj);
-
-  assert(index >= 0 && index < N);
-
-  do_lock();
-  for(;;) {
-    blame_entry_t oldval = table[index];
-    if(oldval.parts.obj_id == obj_id) {
-#ifdef LOSSLESS_BLAME
-      uint64_t oldall = atomic_load_explicit(&oldval.all, memory_order_relaxed);
-      uint64_t testoldall = oldall;
-      if (atomic_compare_exchange_strong_explicit(&table[index].all, &oldall, zero,
-						  memory_order_relaxed, memory_order_relaxed)
-	  != testoldall) continue; // try again on failure
-#else
-      table[index].all = 0;
-#endif
-      val = (uint64_t)oldval.parts.blame;
-    }
-    break;
+
+  if (obj == EMPTY_KEY || obj == MOVED_KEY || current == NULL) return 0;
+
+  blame_map_help_migrate(map, current);
+
+  // oldest table first, then follow the tables that replaced it, so
+  // that blame migrating meanwhile is found in a newer one.  obj may
+  // have blame in several tables: adds go to the current one.
+  blame_table_t *table = current;
+  for (blame_table_t *prev; (prev = atomic_load(&table->prev)); ) {
+    table = prev;
   }
-  do_unlock();
 
+  for (; table != NULL; table = atomic_load(&table->next)) {
+    blame_entry_t *entry = blame_table_find(map, table, obj, false);
+    if (entry != NULL) {
+      blame_entry_take(table, entry, &val);
+    }
+  }
   return val;
 }
+
+
+void
+blame_map_summary(blame_map_t* map, const char *name)
+{
+  blame_table_t *current = atomic_load(&map->current);
+  uint64_t inserts = atomic_load(&map->num_inserts);
+  uint64_t probes = atomic_load(&map->num_probes);
+
+  if (current == NULL) return;
+
+  AMSG("BLAME MAP %s: objects: %ld, slots used: %ld, table size: %ld, "
+       "resizes: %ld, rebuilds: %ld, reclaimed: %ld, "
+       "inserts: %ld, collision probes: %ld (%.2f per insert), dropped: %ld",
+       name, (long) atomic_load(&current->live),
+       (long) atomic_load(&current->used), (long) current->size,
+       (long) atomic_load(&map->num_resizes),
+       (long) atomic_load(&map->num_rebuilds),
+       (long) atomic_load(&map->num_reclaimed), (long) inserts, (long) probes,
+       inserts ? (double) probes / inserts : 0.0,
+       (long) atomic_load(&map->num_dropped));
+}
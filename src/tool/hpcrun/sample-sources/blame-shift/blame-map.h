@@ -63,16 +63,19 @@
 //
 // (abstract) data type definition
 //
-typedef union blame_entry_t blame_entry_t;
+typedef struct blame_map_t blame_map_t;
 
 /***************************************************************************
  * interface operations
  ***************************************************************************/
 
-blame_entry_t* blame_map_new(void);
-void blame_map_init(blame_entry_t* table);
-void blame_map_add_blame(blame_entry_t* table,
-			 uint64_t obj, uint32_t metric_value);
-uint64_t blame_map_get_blame(blame_entry_t* table, uint64_t obj);
+blame_map_t* blame_map_new(void);
+void blame_map_init(blame_map_t* map);
+void blame_map_add_blame(blame_map_t* map,
+			 uint64_t obj, uint64_t metric_value);
+uint64_t blame_map_get_blame(blame_map_t* map, uint64_t obj);
+
+// report object count, size and collision statistics of the map
+void blame_map_summary(blame_map_t* map, const char *name);
 
 #endif // _hpctoolkit_blame_map_h_
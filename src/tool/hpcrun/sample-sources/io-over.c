@@ -51,21 +51,32 @@
 //
 // Purpose:
 // This file adds the IO sampling source: number of bytes read and
-// written.  This covers both stream IO (fread, fwrite, etc) and
-// unbuffered IO (read, write, etc).
+// written, time spent in IO calls and a log2 histogram of their
+// latency.  This covers both stream IO (fread, fwrite, etc) and
+// unbuffered IO (read, write, pread, readv, etc), plus fsync.
 //
 // Note: for the slow or blocking overrides, we record samples before
 // and after the function.  If a process blocks in kernel, then it
 // won't receive async interrupts and this may under report the time
 // in the trace.  Using two samples assures that we see the full span
-// of the function in the trace viewer.
+// of the function in the trace viewer.  Only the first sample
+// unwinds, the second one reuses its cct node (unless the thread's
+// epochs were flushed in between).
 //
-// TODO list:
+// Sampling: with HPCRUN_IO_PERIOD=N, only 1 in N calls per thread is
+// measured and its metrics are scaled by N.  With
+// HPCRUN_IO_THRESHOLD=usec, every (selected) call is timed but only
+// the calls that took at least that long are unwound, once, after
+// the call returns.  So the bytes at a call path are those of its
+// slow calls only.  The bytes of the faster calls are charged to the
+// IO_BELOW_THRESHOLD placeholder, below the root of the thread's cct,
+// so the byte totals stay complete; their time and latency are not
+// recorded.
+//
+// fsync moves no bytes: it is measured with the time metric and only
+// records its time and latency.
 //
-// 2. In the second sample (after the real function), want to record
-// the sample without doing a full unwind (which is the same path as
-// the first sample).  This may require a little refactoring in the
-// sample event code.
+// TODO list:
 //
 // 3. When taking the user context, replace the syscall with the
 // assembler macros.  This may require a little refactoring of the
@@ -84,8 +95,12 @@
  *****************************************************************************/
 
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 #include <ucontext.h>
 #include <unistd.h>
 
@@ -99,9 +114,13 @@
 #include <sample_event.h>
 #include <thread_data.h>
 
+#include <cct/cct.h>
 #include <messages/messages.h>
 #include <monitor-exts/monitor_ext.h>
 #include <sample-sources/io.h>
+#include <utilities/ip-normalized.h>
+
+#include <lib/prof-lean/placeholders.h>
 
 
 /******************************************************************************
@@ -110,10 +129,29 @@
 
 typedef ssize_t read_fn_t(int, void *, size_t);
 typedef ssize_t write_fn_t(int, const void *, size_t);
+typedef ssize_t pread_fn_t(int, void *, size_t, off_t);
+typedef ssize_t pwrite_fn_t(int, const void *, size_t, off_t);
+typedef ssize_t pread64_fn_t(int, void *, size_t, off64_t);
+typedef ssize_t pwrite64_fn_t(int, const void *, size_t, off64_t);
+typedef ssize_t readv_fn_t(int, const struct iovec *, int);
+typedef ssize_t writev_fn_t(int, const struct iovec *, int);
+typedef int     fsync_fn_t(int);
 
 typedef size_t  fread_fn_t(void *, size_t, size_t, FILE *);
 typedef size_t  fwrite_fn_t(const void *, size_t, size_t, FILE *);
 
+// state of one measured IO call
+typedef struct io_call_s {
+  int          metric_id;     // bytes read or written
+  int          unwind_before; // sample before the call (no threshold)
+  int          reentered;     // inside hpcrun again after the call
+  uint64_t     scale;         // weight of the call (sample period)
+  uint64_t     start;         // ns
+  uint64_t     elapsed;       // ns
+  sample_val_t sample;        // sample before the call
+  ucontext_t   uc;
+} io_call_t;
+
 
 /******************************************************************************
  * macros
@@ -125,6 +163,12 @@ typedef size_t  fwrite_fn_t(const void *, size_t, size_t, FILE *);
 // interfere with our code via locks or override functions.  We'll try
 // the _IO_ names until we hit a problem.  Statically, we always use
 // __wrap and __real.
+//
+// The other functions go through dlsym() (the first time they are
+// called): readv, writev and fsync have no such alias, and the only
+// alias of pread and pwrite, __pread64 and __pwrite64, takes an
+// off64_t, which is not an off_t everywhere.  pread64 and pwrite64
+// are overridden on their own.
 
 #ifdef HPCRUN_STATIC_LINK
 #define real_read    __real_read
@@ -143,42 +187,216 @@ extern write_fn_t   real_write;
 extern fread_fn_t   real_fread;
 extern fwrite_fn_t  real_fwrite;
 
+MONITOR_EXT_DECLARE_REAL_FN(pread_fn_t, real_pread);
+MONITOR_EXT_DECLARE_REAL_FN(pwrite_fn_t, real_pwrite);
+MONITOR_EXT_DECLARE_REAL_FN(pread64_fn_t, real_pread64);
+MONITOR_EXT_DECLARE_REAL_FN(pwrite64_fn_t, real_pwrite64);
+MONITOR_EXT_DECLARE_REAL_FN(readv_fn_t, real_readv);
+MONITOR_EXT_DECLARE_REAL_FN(writev_fn_t, real_writev);
+MONITOR_EXT_DECLARE_REAL_FN(fsync_fn_t, real_fsync);
+
+#define NSEC_PER_USEC  1000UL
+#define NSEC_PER_SEC   1000000000UL
+
+
+/******************************************************************************
+ * private data
+ *****************************************************************************/
+
+// calls left until the next measured one (1-in-N sampling)
+static __thread uint64_t io_calls_to_skip = 0;
+
+
+/******************************************************************************
+ * placeholder
+ *****************************************************************************/
+
+// collects the bytes of the IO calls below the latency threshold
+void
+IO_BELOW_THRESHOLD(void)
+{
+}
+
+
+/******************************************************************************
+ * private operations
+ *****************************************************************************/
+
+static inline uint64_t
+io_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+// log2 latency bucket for 'ns', see io.h
+static inline int
+io_latency_bucket(uint64_t ns)
+{
+  uint64_t us = ns / NSEC_PER_USEC;
+
+  if (us == 0) {
+    return 0;
+  }
+  int bucket = 64 - __builtin_clzl(us);
+  return (bucket < IO_LATENCY_BUCKETS) ? bucket : IO_LATENCY_BUCKETS - 1;
+}
+
+
+// Decide if this call is measured.  On true, we are inside hpcrun
+// (safe enter) and the caller must take the context if
+// call->unwind_before and then call io_call_before().
+static bool
+io_call_begin(io_call_t *call, int metric_id)
+{
+  if (metric_id < 0) {
+    return false;
+  }
+
+  uint64_t period = hpcrun_io_sample_period();
+  if (period > 1) {
+    if (io_calls_to_skip > 0) {
+      io_calls_to_skip--;
+      return false;
+    }
+    io_calls_to_skip = period - 1;
+  }
+
+  if (! hpcrun_safe_enter()) {
+    return false;
+  }
+
+  call->metric_id = metric_id;
+  call->unwind_before = (hpcrun_io_min_latency() == 0);
+  call->scale = period;
+  hpcrun_sample_val_init(&call->sample);
+
+  return true;
+}
+
+
+// Insert a sample before the slow function to make the traces look
+// better and start the clock.  Returns to the application.
+static void
+io_call_before(io_call_t *call)
+{
+  if (call->unwind_before) {
+    call->sample = hpcrun_sample_callpath(&call->uc, call->metric_id,
+					  (hpcrun_metricVal_t) {.i=0},
+					  0, 1, NULL);
+  }
+  hpcrun_safe_exit();
+  call->start = io_time_ns();
+}
+
+
+// Charge the scaled bytes of a call that was not unwound to the
+// IO_BELOW_THRESHOLD placeholder.
+static void
+io_below_threshold(int metric_id, uint64_t bytes)
+{
+  core_profile_trace_data_t *cptd = &(TD_GET(core_profile_trace_data));
+
+  ip_normalized_t ip =
+    hpcrun_normalize_ip(canonicalize_placeholder(IO_BELOW_THRESHOLD), NULL);
+  cct_addr_t addr = NON_LUSH_ADDR_INI(ip.lm_id, ip.lm_ip);
+
+  cct_node_t *node =
+    hpcrun_cct_insert_addr(cptd->epoch->csdata.partial_unw_root, &addr);
+  hpcrun_cct_terminate_path(node);
+  cct_metric_data_increment(metric_id, node, (cct_metric_data_t) {.i = bytes});
+}
+
+
+// Stop the clock and reenter hpcrun.  Returns true if the call needs
+// a fresh context for io_call_end(), that is, we did not sample
+// before the call, but the call was slow enough to be recorded.
+// Returns false if we can not reenter hpcrun, then io_call_end()
+// records nothing.
+static bool
+io_call_after(io_call_t *call)
+{
+  call->elapsed = io_time_ns() - call->start;
+  call->reentered = hpcrun_safe_enter();
+  if (! call->reentered) {
+    return false;
+  }
+
+  return (! call->unwind_before) && call->elapsed >= hpcrun_io_min_latency();
+}
+
+
+// Record the bytes, time and latency of the call at the call path of
+// the sample before the call, or unwind now if there was none (or it
+// has gone stale).  A call below the latency threshold only records
+// its bytes, at the IO_BELOW_THRESHOLD placeholder.  Returns to the
+// application.
+static void
+io_call_end(io_call_t *call, size_t bytes)
+{
+  if (! call->reentered) {
+    return;
+  }
+
+  // a call measured with the time metric (fsync) moves no bytes
+  bool moves_bytes = (call->metric_id != hpcrun_metric_id_io_time());
+
+  if (! call->unwind_before && call->elapsed < hpcrun_io_min_latency()) {
+    if (moves_bytes && bytes > 0) {
+      io_below_threshold(call->metric_id, bytes * call->scale);
+    }
+    hpcrun_safe_exit();
+    return;
+  }
+
+  hpcrun_metricVal_t incr = {.i = moves_bytes ? bytes * call->scale : 0};
+
+  if (! hpcrun_sample_callpath_again(&call->sample, call->metric_id, incr, 1)) {
+    call->sample = hpcrun_sample_callpath(&call->uc, call->metric_id, incr,
+					  0, 1, NULL);
+  }
+
+  int bucket = io_latency_bucket(call->elapsed);
+  hpcrun_sample_callpath_again(&call->sample, hpcrun_metric_id_io_time(),
+			       (hpcrun_metricVal_t) {.i = call->elapsed * call->scale}, 0);
+  hpcrun_sample_callpath_again(&call->sample, hpcrun_metric_id_io_latency(bucket),
+			       (hpcrun_metricVal_t) {.i = call->scale}, 0);
+  hpcrun_safe_exit();
+}
+
 
 /******************************************************************************
  * interface operations
  *****************************************************************************/
 
+// Every override has the same shape: io_call_begin() decides if the
+// call is measured, the context is taken in the override itself (the
+// leaf of the call path), the real function runs outside of hpcrun,
+// and io_call_end() records the call with at most one unwind.
+
 ssize_t
 MONITOR_EXT_WRAP_NAME(read)(int fd, void *buf, size_t count)
 {
-  ucontext_t uc;
+  io_call_t call;
   ssize_t ret;
-  int metric_id_read = hpcrun_metric_id_read();
   int save_errno;
 
-  if (metric_id_read < 0 || ! hpcrun_safe_enter()) {
+  if (! io_call_begin(&call, hpcrun_metric_id_read())) {
     return real_read(fd, buf, count);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
-  getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_read, 
-        (hpcrun_metricVal_t) {.i=0}, 
-        0, 1, NULL);
-
-  hpcrun_safe_exit();
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
   ret = real_read(fd, buf, count);
   save_errno = errno;
-  hpcrun_safe_enter();
-
-  // FIXME: the second sample should not do a full unwind.
-  TMSG(IO, "read: fd: %d, buf: %p, count: %ld, actual: %ld",
-       fd, buf, count, ret);
-  hpcrun_sample_callpath(&uc, metric_id_read, 
-        (hpcrun_metricVal_t) {.i=(ret > 0 ? ret : 0)}, 
-        0, 1, NULL);
-  hpcrun_safe_exit();
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "read: fd: %d, buf: %p, count: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
 
   errno = save_errno;
   return ret;
@@ -188,34 +406,220 @@ MONITOR_EXT_WRAP_NAME(read)(int fd, void *buf, size_t count)
 ssize_t
 MONITOR_EXT_WRAP_NAME(write)(int fd, const void *buf, size_t count)
 {
-  ucontext_t uc;
-  size_t ret;
-  int metric_id_write = hpcrun_metric_id_write();
+  io_call_t call;
+  ssize_t ret;
   int save_errno;
 
-  if (metric_id_write < 0 || ! hpcrun_safe_enter()) {
+  if (! io_call_begin(&call, hpcrun_metric_id_write())) {
     return real_write(fd, buf, count);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
-  getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_write, 
-            (hpcrun_metricVal_t) {.i=0}, 
-            0, 1, NULL);
-
-  hpcrun_safe_exit();
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
   ret = real_write(fd, buf, count);
   save_errno = errno;
-  hpcrun_safe_enter();
-
-  // FIXME: the second sample should not do a full unwind.
-  TMSG(IO, "write: fd: %d, buf: %p, count: %ld, actual: %ld",
-       fd, buf, count, ret);
-  hpcrun_sample_callpath(&uc, metric_id_write, 
-        (hpcrun_metricVal_t) {.i=(ret > 0 ? ret : 0)}, 
-        0, 1, NULL);
-  hpcrun_safe_exit();
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "write: fd: %d, buf: %p, count: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(pread)(int fd, void *buf, size_t count, off_t offset)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_pread, pread);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_read())) {
+    return real_pread(fd, buf, count, offset);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_pread(fd, buf, count, offset);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "pread: fd: %d, buf: %p, count: %ld, offset: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, (long) offset, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(pread64)(int fd, void *buf, size_t count, off64_t offset)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_pread64, pread64);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_read())) {
+    return real_pread64(fd, buf, count, offset);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_pread64(fd, buf, count, offset);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "pread64: fd: %d, buf: %p, count: %ld, offset: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, (long) offset, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(pwrite)(int fd, const void *buf, size_t count, off_t offset)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_pwrite, pwrite);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_write())) {
+    return real_pwrite(fd, buf, count, offset);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_pwrite(fd, buf, count, offset);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "pwrite: fd: %d, buf: %p, count: %ld, offset: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, (long) offset, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(pwrite64)(int fd, const void *buf, size_t count, off64_t offset)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_pwrite64, pwrite64);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_write())) {
+    return real_pwrite64(fd, buf, count, offset);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_pwrite64(fd, buf, count, offset);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "pwrite64: fd: %d, buf: %p, count: %ld, offset: %ld, actual: %ld, ns: %ld",
+       fd, buf, count, (long) offset, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(readv)(int fd, const struct iovec *iov, int iovcnt)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_readv, readv);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_read())) {
+    return real_readv(fd, iov, iovcnt);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_readv(fd, iov, iovcnt);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "readv: fd: %d, iovcnt: %d, actual: %ld, ns: %ld",
+       fd, iovcnt, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+ssize_t
+MONITOR_EXT_WRAP_NAME(writev)(int fd, const struct iovec *iov, int iovcnt)
+{
+  io_call_t call;
+  ssize_t ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_writev, writev);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_write())) {
+    return real_writev(fd, iov, iovcnt);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_writev(fd, iov, iovcnt);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "writev: fd: %d, iovcnt: %d, actual: %ld, ns: %ld",
+       fd, iovcnt, ret, call.elapsed);
+  io_call_end(&call, (ret > 0 ? ret : 0));
+
+  errno = save_errno;
+  return ret;
+}
+
+
+// fsync moves no bytes of its own, it is recorded under bytes
+// written with a zero increment (time and latency only).
+int
+MONITOR_EXT_WRAP_NAME(fsync)(int fd)
+{
+  io_call_t call;
+  int ret;
+  int save_errno;
+
+  MONITOR_EXT_GET_NAME_WRAP(real_fsync, fsync);
+
+  if (! io_call_begin(&call, hpcrun_metric_id_io_time())) {
+    return real_fsync(fd);
+  }
+
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
+  ret = real_fsync(fd);
+  save_errno = errno;
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "fsync: fd: %d, ret: %d, ns: %ld", fd, ret, call.elapsed);
+  io_call_end(&call, 0);
 
   errno = save_errno;
   return ret;
@@ -225,32 +629,21 @@ MONITOR_EXT_WRAP_NAME(write)(int fd, const void *buf, size_t count)
 size_t
 MONITOR_EXT_WRAP_NAME(fread)(void *ptr, size_t size, size_t count, FILE *stream)
 {
-  ucontext_t uc;
+  io_call_t call;
   size_t ret;
-  int metric_id_read = hpcrun_metric_id_read();
 
-  if (metric_id_read < 0 || ! hpcrun_safe_enter()) {
+  if (! io_call_begin(&call, hpcrun_metric_id_read())) {
     return real_fread(ptr, size, count, stream);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
-  getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_read, 
-            (hpcrun_metricVal_t) {.i=0}, 
-            0, 1, NULL);
-
-  hpcrun_safe_exit();
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
   ret = real_fread(ptr, size, count, stream);
-  hpcrun_safe_enter();
-
-  // FIXME: the second sample should not do a full unwind.
-  TMSG(IO, "fread: size: %ld, count: %ld, bytes: %ld, actual: %ld",
-       size, count, count*size, ret*size);
-  hpcrun_sample_callpath(&uc, metric_id_read, 
-            (hpcrun_metricVal_t) {.i=ret*size}, 
-            0, 1, NULL);
-  hpcrun_safe_exit();
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "fread: size: %ld, count: %ld, bytes: %ld, actual: %ld, ns: %ld",
+       size, count, count*size, ret*size, call.elapsed);
+  io_call_end(&call, ret*size);
 
   return ret;
 }
@@ -260,32 +653,21 @@ size_t
 MONITOR_EXT_WRAP_NAME(fwrite)(const void *ptr, size_t size, size_t count,
 			      FILE *stream)
 {
-  ucontext_t uc;
+  io_call_t call;
   size_t ret;
-  int metric_id_write = hpcrun_metric_id_write();
 
-  if (metric_id_write < 0 || ! hpcrun_safe_enter()) {
+  if (! io_call_begin(&call, hpcrun_metric_id_write())) {
     return real_fwrite(ptr, size, count, stream);
   }
 
-  // insert samples before and after the slow functions to make the
-  // traces look better.
-  getcontext(&uc);
-  hpcrun_sample_callpath(&uc, metric_id_write, 
-            (hpcrun_metricVal_t) {.i=0}, 
-            0, 1, NULL);
-
-  hpcrun_safe_exit();
+  if (call.unwind_before) getcontext(&call.uc);
+  io_call_before(&call);
   ret = real_fwrite(ptr, size, count, stream);
-  hpcrun_safe_enter();
-
-  // FIXME: the second sample should not do a full unwind.
-  TMSG(IO, "fwrite: size: %ld, count: %ld, bytes: %ld, actual: %ld",
-       size, count, count*size, ret*size);
-  hpcrun_sample_callpath(&uc, metric_id_write, 
-            (hpcrun_metricVal_t) {.i=ret*size}, 
-            0, 1, NULL);
-  hpcrun_safe_exit();
+  if (io_call_after(&call)) getcontext(&call.uc);
+
+  TMSG(IO, "fwrite: size: %ld, count: %ld, bytes: %ld, actual: %ld, ns: %ld",
+       size, count, count*size, ret*size, call.elapsed);
+  io_call_end(&call, ret*size);
 
   return ret;
 }
@@ -49,7 +49,9 @@
  *****************************************************************************/
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -68,12 +70,54 @@
 
 #include <utilities/tokenize.h>
 
+
+/******************************************************************************
+ * macros
+ *****************************************************************************/
+
+#define HPCRUN_IO_PERIOD     "HPCRUN_IO_PERIOD"
+#define HPCRUN_IO_THRESHOLD  "HPCRUN_IO_THRESHOLD"
+
+#define LATENCY_NAME_LEN  40
+
 /******************************************************************************
  * local variables
  *****************************************************************************/
 
 static int metric_id_read = -1;
 static int metric_id_write = -1;
+static int metric_id_time = -1;
+static int metric_id_latency[IO_LATENCY_BUCKETS];
+
+static char latency_name[IO_LATENCY_BUCKETS][LATENCY_NAME_LEN];
+
+static uint64_t io_sample_period = 1;
+static uint64_t io_min_latency = 0;
+
+
+/******************************************************************************
+ * private operations
+ *****************************************************************************/
+
+// Read a non-negative integer from environment variable 'name', or
+// return 'dflt' if it is unset or malformed.
+static uint64_t
+io_getenv_u64(const char *name, uint64_t dflt)
+{
+  char *str = getenv(name);
+  char *end;
+
+  if (str == NULL || *str == 0) {
+    return dflt;
+  }
+  unsigned long long val = strtoull(str, &end, 10);
+  if (*end != 0) {
+    EMSG("IO: bad value for %s: '%s', using %llu", name, str,
+	 (unsigned long long) dflt);
+    return dflt;
+  }
+  return val;
+}
 
 
 /******************************************************************************
@@ -87,6 +131,10 @@ METHOD_FN(init)
   self->state = INIT;
   metric_id_read = -1;
   metric_id_write = -1;
+  metric_id_time = -1;
+  for (int k = 0; k < IO_LATENCY_BUCKETS; k++) {
+    metric_id_latency[k] = -1;
+  }
 }
 
 
@@ -146,7 +194,8 @@ METHOD_FN(supports_event, const char *ev_str)
 }
 
 
-// IO metrics: bytes read and bytes written.
+// IO metrics: bytes read and bytes written, time spent in IO calls
+// and a log2 histogram of the latency of the calls.
 
 static void
 METHOD_FN(process_event_list, int lush_metrics)
@@ -154,9 +203,36 @@ METHOD_FN(process_event_list, int lush_metrics)
   TMSG(IO, "create metrics for IO bytes read and bytes written");
   metric_id_read = hpcrun_new_metric();
   metric_id_write = hpcrun_new_metric();
+  metric_id_time = hpcrun_new_metric();
   hpcrun_set_metric_info(metric_id_read,  "IO Bytes Read");
   hpcrun_set_metric_info(metric_id_write, "IO Bytes Written");
-  TMSG(IO, "metric id read: %d, write: %d", metric_id_read, metric_id_write);
+  hpcrun_set_metric_info(metric_id_time,  "IO Time (ns)");
+  TMSG(IO, "metric id read: %d, write: %d, time: %d",
+       metric_id_read, metric_id_write, metric_id_time);
+
+  for (int k = 0; k < IO_LATENCY_BUCKETS; k++) {
+    if (k == 0) {
+      snprintf(latency_name[k], LATENCY_NAME_LEN, "IO Calls <1us");
+    }
+    else if (k < IO_LATENCY_BUCKETS - 1) {
+      snprintf(latency_name[k], LATENCY_NAME_LEN, "IO Calls %luus-%luus",
+	       1UL << (k - 1), 1UL << k);
+    }
+    else {
+      snprintf(latency_name[k], LATENCY_NAME_LEN, "IO Calls >=%luus",
+	       1UL << (k - 1));
+    }
+    metric_id_latency[k] = hpcrun_new_metric();
+    hpcrun_set_metric_info(metric_id_latency[k], latency_name[k]);
+  }
+
+  io_sample_period = io_getenv_u64(HPCRUN_IO_PERIOD, 1);
+  if (io_sample_period == 0) {
+    io_sample_period = 1;
+  }
+  io_min_latency = 1000 * io_getenv_u64(HPCRUN_IO_THRESHOLD, 0);
+  TMSG(IO, "sampling 1 in %lu calls, min latency: %lu ns",
+       io_sample_period, io_min_latency);
 }
 
 
@@ -175,7 +251,11 @@ METHOD_FN(display_events)
   printf("===========================================================================\n");
   printf("Name\t\tDescription\n");
   printf("---------------------------------------------------------------------------\n");
-  printf("IO\t\tThe number of bytes read and written per dynamic context\n");
+  printf("IO\t\tThe number of bytes read and written, the time spent in\n"
+	 "\t\tIO calls and a log2 histogram of their latency per dynamic\n"
+	 "\t\tcontext.  Set HPCRUN_IO_PERIOD=N to sample 1 in N calls and\n"
+	 "\t\tHPCRUN_IO_THRESHOLD=usec to unwind only calls at least that\n"
+	 "\t\tslow (the bytes of faster calls go to IO_BELOW_THRESHOLD).\n");
   printf("\n");
 }
 
@@ -209,3 +289,27 @@ hpcrun_metric_id_write(void)
 {
   return metric_id_write;
 }
+
+int
+hpcrun_metric_id_io_time(void)
+{
+  return metric_id_time;
+}
+
+int
+hpcrun_metric_id_io_latency(int bucket)
+{
+  return metric_id_latency[bucket];
+}
+
+uint64_t
+hpcrun_io_sample_period(void)
+{
+  return io_sample_period;
+}
+
+uint64_t
+hpcrun_io_min_latency(void)
+{
+  return io_min_latency;
+}
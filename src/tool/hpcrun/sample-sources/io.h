@@ -47,7 +47,22 @@
 #ifndef _HPCRUN_IO_H_
 #define _HPCRUN_IO_H_
 
+#include <stdint.h>
+
+// Latency histogram: bucket 0 counts calls under 1 us, bucket k
+// (0 < k < last) calls in [2^(k-1), 2^k) us and the last bucket
+// calls of 2^(IO_LATENCY_BUCKETS-2) us or more.
+#define IO_LATENCY_BUCKETS  21
+
 int hpcrun_metric_id_read(void);
 int hpcrun_metric_id_write(void);
+int hpcrun_metric_id_io_time(void);
+int hpcrun_metric_id_io_latency(int bucket);
+
+// 1-in-N sampling of IO calls (1 = every call)
+uint64_t hpcrun_io_sample_period(void);
+
+// only calls that take at least this long (ns) are unwound
+uint64_t hpcrun_io_min_latency(void);
 
 #endif
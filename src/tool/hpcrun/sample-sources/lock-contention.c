@@ -0,0 +1,516 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL: $
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//
+// lock contention: wait and hold times of contended locks
+//
+
+/******************************************************************************
+ * system includes
+ *****************************************************************************/
+
+#include <dlfcn.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <ucontext.h>
+
+
+
+/******************************************************************************
+ * local includes
+ *****************************************************************************/
+
+#include "simple_oo.h"
+#include "sample_source_obj.h"
+#include "common.h"
+#include "lock-contention.h"
+#include "memleak.h"
+#include <sample-sources/blame-shift/blame-map.h>
+
+#include <hpcrun/loadmap.h>
+#include <hpcrun/metrics.h>
+
+#include <hpcrun/hpctoolkit.h>
+#include <hpcrun/safe-sampling.h>
+#include <hpcrun/sample_event.h>
+#include <hpcrun/thread_data.h>
+#include <hpcrun/cct/cct.h>
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+#include <utilities/tokenize.h>
+
+#include <lib/prof-lean/stdatomic.h>
+
+
+// *****************************************************************************
+// macros
+// *****************************************************************************
+
+// lock_contention_sample() and the interface function calling it
+#define SKIP_TWO_FRAMES 2
+
+// locks held at once by one thread that we keep times for
+#define LOCK_HELD_MAX  32
+
+// per-lock statistics (power of 2), and the most contended locks
+// reported at the end
+#define LOCK_TABLE_SIZE    4096
+#define LOCK_TABLE_PROBES  64
+#define LOCK_REPORT_MAX    10
+#define LOCK_REPORT_FRAMES 4
+
+#define NSEC_PER_SEC  1000000000UL
+
+
+
+// *****************************************************************************
+// type definitions
+// *****************************************************************************
+
+typedef struct {
+  void*    lock;
+  uint64_t start;   // ns, when acquired
+} held_lock_t;
+
+
+typedef struct {
+  atomic_uintptr_t lock;
+  atomic_uintptr_t alloc_site;  // cct_node_t* from memleak, if any
+  atomic_ulong     wait_ns;
+  atomic_ulong     hold_ns;
+  atomic_ulong     contended;
+} lock_stats_t;
+
+
+
+// *****************************************************************************
+// static local variables
+// *****************************************************************************
+
+static int wait_metric_id = -1;
+static int hold_metric_id = -1;
+static int contended_metric_id = -1;
+
+static bool lock_enabled = false;
+
+// lock -> number of threads that found it busy since its last
+// release.  the releasing thread takes (and clears) the count to
+// tell if anyone waited for it.
+static blame_map_t* lock_waiters = NULL;
+
+static lock_stats_t* lock_table = NULL;
+static atomic_ulong lock_table_dropped = ATOMIC_VAR_INIT(0);
+
+
+
+// *****************************************************************************
+// thread local variables
+// *****************************************************************************
+
+static __thread held_lock_t lock_held[LOCK_HELD_MAX];
+static __thread int lock_num_held = 0;
+
+
+
+/***************************************************************************
+ * private operations
+ ***************************************************************************/
+
+static inline uint64_t
+lock_time_ns(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+
+static inline void
+held_push(void* lock, uint64_t start)
+{
+  if (lock_num_held < LOCK_HELD_MAX) {
+    lock_held[lock_num_held++] = (held_lock_t) {.lock = lock, .start = start};
+  }
+}
+
+
+// remove 'lock' from the held locks (usually the top one, but locks
+// need not be released in order).  returns its acquire time, or 0 if
+// we don't know it.
+static inline uint64_t
+held_pop(void* lock)
+{
+  for (int i = lock_num_held - 1; i >= 0; i--) {
+    if (lock_held[i].lock == lock) {
+      uint64_t start = lock_held[i].start;
+      lock_held[i] = lock_held[--lock_num_held];
+      return start;
+    }
+  }
+  return 0;
+}
+
+
+// statistics entry for 'lock', inserted if new, NULL if the table
+// is full.  a new entry looks up the allocation site of the lock.
+static lock_stats_t*
+lock_stats_find(void* lock)
+{
+  uintptr_t key = (uintptr_t) lock;
+  uintptr_t h = (key >> 3) * 0x9E3779B97F4A7C15UL;
+
+  if (lock_table == NULL) return NULL;
+
+  for (int i = 0; i < LOCK_TABLE_PROBES; i++) {
+    lock_stats_t* entry = &lock_table[(h + i) & (LOCK_TABLE_SIZE - 1)];
+    uintptr_t cur = atomic_load_explicit(&entry->lock, memory_order_acquire);
+
+    if (cur == 0) {
+      if (atomic_compare_exchange_strong(&entry->lock, &cur, key)) {
+	cct_node_t* site = hpcrun_memleak_alloc_context(lock);
+	atomic_store(&entry->alloc_site, (uintptr_t) site);
+	return entry;
+      }
+    }
+    if (cur == key) return entry;
+  }
+  atomic_fetch_add(&lock_table_dropped, 1);
+  return NULL;
+}
+
+
+// sample the call path of the override that called the interface
+// function that called us.  (getcontext keeps this from inlining.)
+static sample_val_t
+lock_contention_sample(int metric_id, uint64_t value)
+{
+  ucontext_t uc;
+
+  getcontext(&uc);
+  return hpcrun_sample_callpath(&uc, metric_id,
+				(hpcrun_metricVal_t) {.i=value},
+				SKIP_TWO_FRAMES, 1, NULL);
+}
+
+
+static void
+lock_report_alloc_site(char* buf, size_t len, cct_node_t* node)
+{
+  size_t pos = snprintf(buf, len, "allocated at");
+
+  for (int i = 0; node != NULL && i < LOCK_REPORT_FRAMES && pos < len; i++) {
+    ip_normalized_t ip = hpcrun_cct_addr(node)->ip_norm;
+    load_module_t* lm = hpcrun_loadmap_findById(ip.lm_id);
+
+    pos += snprintf(buf + pos, len - pos, "%s %s+0x%lx", (i ? " <" : ""),
+		    (lm ? lm->name : "?"), (unsigned long) ip.lm_ip);
+    node = hpcrun_cct_parent(node);
+  }
+}
+
+
+// log the most contended locks with what we know about them: the
+// symbol for static locks, the allocation site for heap locks
+static void
+lock_report(void)
+{
+  bool reported[LOCK_TABLE_SIZE];
+  char ident[512];
+
+  if (lock_table == NULL) return;
+
+  memset(reported, 0, sizeof(reported));
+  AMSG("LOCK: most contended locks (dropped: %lu)",
+       atomic_load(&lock_table_dropped));
+
+  for (int n = 0; n < LOCK_REPORT_MAX; n++) {
+    int best = -1;
+    uint64_t best_wait = 0;
+
+    for (int i = 0; i < LOCK_TABLE_SIZE; i++) {
+      uint64_t wait = atomic_load(&lock_table[i].wait_ns);
+      if (! reported[i] && atomic_load(&lock_table[i].lock) != 0
+	  && wait > best_wait) {
+	best = i;
+	best_wait = wait;
+      }
+    }
+    if (best < 0) break;
+    reported[best] = true;
+
+    lock_stats_t* entry = &lock_table[best];
+    void* lock = (void*) atomic_load(&entry->lock);
+    cct_node_t* site = (cct_node_t*) atomic_load(&entry->alloc_site);
+    Dl_info info;
+
+    if (dladdr(lock, &info) && info.dli_sname != NULL) {
+      snprintf(ident, sizeof(ident), "%s+0x%lx in %s", info.dli_sname,
+	       (unsigned long) ((uintptr_t) lock - (uintptr_t) info.dli_saddr),
+	       info.dli_fname);
+    }
+    else if (site != NULL) {
+      lock_report_alloc_site(ident, sizeof(ident), site);
+    }
+    else {
+      snprintf(ident, sizeof(ident), "unknown (stack or untracked heap)");
+    }
+    AMSG("LOCK: %p: contended: %lu, wait: %lu ns, hold: %lu ns, %s",
+	 lock, atomic_load(&entry->contended), best_wait,
+	 atomic_load(&entry->hold_ns), ident);
+  }
+}
+
+
+
+// ******************************************************************************
+//  public interface to local variables
+// ******************************************************************************
+
+bool
+lock_contention_enabled(void)
+{
+  return lock_enabled;
+}
+
+//
+// public lock event functions
+//
+
+void
+lock_contention_acquired(void* lock)
+{
+  held_push(lock, lock_time_ns());
+}
+
+
+uint64_t
+lock_contention_wait_start(void* lock)
+{
+  // tell the holder that someone waits
+  if (lock_waiters) blame_map_add_blame(lock_waiters, (uint64_t)(uintptr_t) lock, 1);
+  return lock_time_ns();
+}
+
+
+void
+lock_contention_wait_end(void* lock, uint64_t start)
+{
+  uint64_t now = lock_time_ns();
+  uint64_t wait = now - start;
+
+  held_push(lock, now);
+
+  lock_stats_t* entry = lock_stats_find(lock);
+  if (entry) {
+    atomic_fetch_add(&entry->wait_ns, wait);
+    atomic_fetch_add(&entry->contended, 1);
+  }
+
+  TMSG(LOCKWAIT, "lock %p acquired after %ld ns", lock, wait);
+  if (hpcrun_safe_enter()) {
+    sample_val_t smpl = lock_contention_sample(wait_metric_id, wait);
+    hpcrun_sample_callpath_again(&smpl, contended_metric_id,
+				 (hpcrun_metricVal_t) {.i=1}, 0);
+    hpcrun_safe_exit();
+  }
+}
+
+
+uint64_t
+lock_contention_release(void* lock)
+{
+  uint64_t start = held_pop(lock);
+  uint64_t waiters = (lock_waiters == NULL) ? 0
+    : blame_map_get_blame(lock_waiters, (uint64_t)(uintptr_t) lock);
+
+  // only locks that someone waited for are worth an unwind
+  if (start == 0 || waiters == 0) {
+    return 0;
+  }
+
+  uint64_t hold = lock_time_ns() - start;
+
+  lock_stats_t* entry = lock_stats_find(lock);
+  if (entry) {
+    atomic_fetch_add(&entry->hold_ns, hold);
+  }
+
+  TMSG(LOCKWAIT, "lock %p released after %ld ns, %ld waiters",
+       lock, hold, waiters);
+  return hold;
+}
+
+
+void
+lock_contention_released(uint64_t hold)
+{
+  if (hold == 0) {
+    return;
+  }
+
+  if (hpcrun_safe_enter()) {
+    lock_contention_sample(hold_metric_id, hold);
+    hpcrun_safe_exit();
+  }
+}
+
+/*--------------------------------------------------------------------------
+ | sample source methods
+ --------------------------------------------------------------------------*/
+
+static void
+METHOD_FN(init)
+{
+  self->state = INIT;
+}
+
+
+static void
+METHOD_FN(thread_init)
+{
+}
+
+
+static void
+METHOD_FN(thread_init_action)
+{
+}
+
+
+static void
+METHOD_FN(start)
+{
+  lock_enabled = true;
+  TMSG(LOCKWAIT, "lock contention ss STARTED");
+}
+
+
+static void
+METHOD_FN(thread_fini_action)
+{
+}
+
+
+static void
+METHOD_FN(stop)
+{
+}
+
+static void
+METHOD_FN(shutdown)
+{
+  lock_enabled = false;
+  lock_report();
+  if (lock_waiters) blame_map_summary(lock_waiters, "lock");
+  self->state = UNINIT;
+}
+
+
+static bool
+METHOD_FN(supports_event,const char *ev_str)
+{
+  return hpcrun_ev_is(ev_str, LOCK_EVENT_NAME);
+}
+
+ 
+static void
+METHOD_FN(process_event_list, int lush_metrics)
+{
+  wait_metric_id = hpcrun_new_metric();
+  hpcrun_set_metric_info_and_period(wait_metric_id, LOCK_WAIT_METRIC,
+				    MetricFlags_ValFmt_Int, 1, metric_property_none);
+  hold_metric_id = hpcrun_new_metric();
+  hpcrun_set_metric_info_and_period(hold_metric_id, LOCK_HOLD_METRIC,
+				    MetricFlags_ValFmt_Int, 1, metric_property_none);
+  contended_metric_id = hpcrun_new_metric();
+  hpcrun_set_metric_info_and_period(contended_metric_id, LOCK_CONTENDED_METRIC,
+				    MetricFlags_ValFmt_Int, 1, metric_property_none);
+
+  // (once per process)
+  if (! lock_waiters) lock_waiters = blame_map_new();
+  if (! lock_table) {
+    lock_table = hpcrun_malloc(LOCK_TABLE_SIZE * sizeof(lock_stats_t));
+    memset(lock_table, 0, LOCK_TABLE_SIZE * sizeof(lock_stats_t));
+  }
+}
+
+
+static void
+METHOD_FN(gen_event_set,int lush_metrics)
+{
+}
+
+
+static void
+METHOD_FN(display_events)
+{
+  printf("===========================================================================\n");
+  printf("Available lock contention events\n");
+  printf("===========================================================================\n");
+  printf("Name\t\tDescription\n");
+  printf("---------------------------------------------------------------------------\n");
+  printf("%s\t\tTime spent waiting for contended pthread mutexes and spin\n"
+	 "\t\tlocks per acquiring context, and time they were held per\n"
+	 "\t\treleasing context.  Uncontended locks are not sampled.\n"
+	 "\t\tWith MEMLEAK, heap locks are reported by allocation site.\n",
+	 LOCK_EVENT_NAME);
+  printf("\n");
+}
+
+
+/*--------------------------------------------------------------------------
+ | sample source object
+ --------------------------------------------------------------------------*/
+
+#define ss_name lock_contention
+#define ss_cls SS_SOFTWARE
+#define ss_sort_order  95
+
+#include "ss_obj.h"
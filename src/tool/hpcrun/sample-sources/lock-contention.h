@@ -0,0 +1,94 @@
+// -*-Mode: C++;-*- // technically C99
+
+// * BeginRiceCopyright *****************************************************
+//
+// $HeadURL$
+// $Id$
+//
+// --------------------------------------------------------------------------
+// Part of HPCToolkit (hpctoolkit.org)
+//
+// Information about sources of support for research and development of
+// HPCToolkit is at 'hpctoolkit.org' and in 'README.Acknowledgments'.
+// --------------------------------------------------------------------------
+//
+// Copyright ((c)) 2002-2018, Rice University
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// * Redistributions of source code must retain the above copyright
+//   notice, this list of conditions and the following disclaimer.
+//
+// * Redistributions in binary form must reproduce the above copyright
+//   notice, this list of conditions and the following disclaimer in the
+//   documentation and/or other materials provided with the distribution.
+//
+// * Neither the name of Rice University (RICE) nor the names of its
+//   contributors may be used to endorse or promote products derived from
+//   this software without specific prior written permission.
+//
+// This software is provided by RICE and contributors "as is" and any
+// express or implied warranties, including, but not limited to, the
+// implied warranties of merchantability and fitness for a particular
+// purpose are disclaimed. In no event shall RICE or contributors be
+// liable for any direct, indirect, incidental, special, exemplary, or
+// consequential damages (including, but not limited to, procurement of
+// substitute goods or services; loss of use, data, or profits; or
+// business interruption) however caused and on any theory of liability,
+// whether in contract, strict liability, or tort (including negligence
+// or otherwise) arising in any way out of the use of this software, even
+// if advised of the possibility of such damage.
+//
+// ******************************************************* EndRiceCopyright *
+
+//
+// Lock contention sample source:
+//
+//  The lock overrides (pthread-blame-overrides.c) try the lock first
+//  and only sample when that fails.  Waiting time goes to the call
+//  path that acquires the lock, holding time (of contended locks
+//  only) to the call path that releases it, and the lock itself is
+//  identified by its symbol or, with MEMLEAK, its allocation site.
+//
+
+#ifndef LOCK_CONTENTION_H
+#define LOCK_CONTENTION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define LOCK_EVENT_NAME "LOCK"
+
+#define LOCK_WAIT_METRIC        "LOCK_WAIT (ns)"
+#define LOCK_HOLD_METRIC        "LOCK_HOLD (ns)"
+#define LOCK_CONTENDED_METRIC   "LOCK_CONTENDED"
+
+// lock contention profiling enabled
+extern bool lock_contention_enabled(void);
+
+//
+// lock events, called by the overrides
+//
+
+// 'lock' was acquired without waiting (fast path, no sample)
+extern void lock_contention_acquired(void* lock);
+
+// 'lock' is busy, returns the start time of the wait
+extern uint64_t lock_contention_wait_start(void* lock);
+
+// 'lock' was acquired after waiting since 'start'
+extern void lock_contention_wait_end(void* lock, uint64_t start);
+
+// 'lock' is about to be released (or given up by a condition wait).
+// returns the time it was held (ns) if someone waited for it, else 0.
+extern uint64_t lock_contention_release(void* lock);
+
+// the lock was released after being held for 'hold' ns, as returned
+// by lock_contention_release().  called after the real unlock, so
+// that the unwind does not run while the lock is held.
+extern void lock_contention_released(uint64_t hold);
+
+#endif // LOCK_CONTENTION_H
@@ -88,6 +88,8 @@
  * local include files
  *****************************************************************************/
 
+#include <memory/hpcrun-malloc.h>
+#include <sample-sources/lock-contention.h>
 #include <sample-sources/memleak.h>
 #include <messages/messages.h>
 #include <safe-sampling.h>
@@ -117,10 +119,17 @@ typedef struct leakinfo_s {
   cct_node_t *context;
   size_t bytes;
   void *memblock;
+  struct memtree_s *tree;   // header blocks: the tree it is in, if any
   struct leakinfo_s *left;
   struct leakinfo_s *right;
 } leakinfo_t;
 
+typedef struct memtree_s {
+  struct leakinfo_s *root;
+  spinlock_t lock;
+  struct memtree_s *next;   // per-thread header trees only
+} memtree_t;
+
 leakinfo_t leakinfo_NULL = { .magic = 0, .context = NULL, .bytes = 0 };
 
 typedef void *memalign_fcn(size_t, size_t);
@@ -174,8 +183,16 @@ static int leak_detection_init = 0;    // default is uninitialized
 static int use_memleak_prob = 0;
 static float memleak_prob = 0.0;
 
-static struct leakinfo_s *memleak_tree_root = NULL;
-static spinlock_t memtree_lock = SPINLOCK_UNLOCKED;
+// blocks with a footer, found by address at free time
+static memtree_t memtree = { .root = NULL, .lock = SPINLOCK_UNLOCKED };
+
+// with lock contention profiling, blocks with a header are indexed
+// too, so that a lock inside a block maps to its allocation site.
+// each thread inserts into its own tree, so malloc does not contend
+// on one lock; only frees from other threads and lookups do.
+static __thread memtree_t *header_tree = NULL;
+static memtree_t *header_trees = NULL;
+static spinlock_t header_trees_lock = SPINLOCK_UNLOCKED;
 
 static int leakinfo_size = sizeof(struct leakinfo_s);
 static long memleak_pagesize = MEMLEAK_DEFAULT_PAGESIZE;
@@ -206,71 +223,148 @@ splay(struct leakinfo_s *root, void *key)
 
 
 static void
-splay_insert(struct leakinfo_s *node)
+splay_insert(memtree_t *tree, struct leakinfo_s *node)
 {
   void *memblock = node->memblock;
 
   node->left = node->right = NULL;
 
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root != NULL) {
-    memleak_tree_root = splay(memleak_tree_root, memblock);
-
-    if (memblock < memleak_tree_root->memblock) {
-      node->left = memleak_tree_root->left;
-      node->right = memleak_tree_root;
-      memleak_tree_root->left = NULL;
-    } else if (memblock > memleak_tree_root->memblock) {
-      node->left = memleak_tree_root;
-      node->right = memleak_tree_root->right;
-      memleak_tree_root->right = NULL;
+  spinlock_lock(&tree->lock);  
+  if (tree->root != NULL) {
+    tree->root = splay(tree->root, memblock);
+
+    if (memblock < tree->root->memblock) {
+      node->left = tree->root->left;
+      node->right = tree->root;
+      tree->root->left = NULL;
+    } else if (memblock > tree->root->memblock) {
+      node->left = tree->root;
+      node->right = tree->root->right;
+      tree->root->right = NULL;
     } else {
       TMSG(MEMLEAK, "memleak splay tree: unable to insert %p (already present)", 
 	   node->memblock);
       assert(0);
     }
   }
-  memleak_tree_root = node;
-  spinlock_unlock(&memtree_lock);  
+  tree->root = node;
+  spinlock_unlock(&tree->lock);  
 }
 
 
 static struct leakinfo_s *
-splay_delete(void *memblock)
+splay_delete(memtree_t *tree, void *memblock)
 {
   struct leakinfo_s *result = NULL;
 
-  spinlock_lock(&memtree_lock);  
-  if (memleak_tree_root == NULL) {
-    spinlock_unlock(&memtree_lock);  
+  spinlock_lock(&tree->lock);  
+  if (tree->root == NULL) {
+    spinlock_unlock(&tree->lock);  
     TMSG(MEMLEAK, "memleak splay tree empty: unable to delete %p", memblock);
     return NULL;
   }
 
-  memleak_tree_root = splay(memleak_tree_root, memblock);
+  tree->root = splay(tree->root, memblock);
 
-  if (memblock != memleak_tree_root->memblock) {
-    spinlock_unlock(&memtree_lock);  
+  if (memblock != tree->root->memblock) {
+    spinlock_unlock(&tree->lock);  
     TMSG(MEMLEAK, "memleak splay tree: %p not in tree", memblock);
     return NULL;
   }
 
-  result = memleak_tree_root;
+  result = tree->root;
 
-  if (memleak_tree_root->left == NULL) {
-    memleak_tree_root = memleak_tree_root->right;
-    spinlock_unlock(&memtree_lock);  
+  if (tree->root->left == NULL) {
+    tree->root = tree->root->right;
+    spinlock_unlock(&tree->lock);  
     return result;
   }
 
-  memleak_tree_root->left = splay(memleak_tree_root->left, memblock);
-  memleak_tree_root->left->right = memleak_tree_root->right;
-  memleak_tree_root =  memleak_tree_root->left;
-  spinlock_unlock(&memtree_lock);  
+  tree->root->left = splay(tree->root->left, memblock);
+  tree->root->left->right = tree->root->right;
+  tree->root =  tree->root->left;
+  spinlock_unlock(&tree->lock);  
   return result;
 }
 
 
+// Returns: the allocation context of the block in 'tree' that
+// contains 'addr' (not just starts at it), or NULL.
+//
+static cct_node_t *
+splay_find_context(memtree_t *tree, void *addr)
+{
+  struct leakinfo_s *node;
+  cct_node_t *context = NULL;
+
+  spinlock_lock(&tree->lock);
+  if (tree->root != NULL) {
+    tree->root = splay(tree->root, addr);
+
+    // the root is the block at 'addr' or a neighbor, if it's the
+    // successor, the block we want is the max of the left subtree.
+    node = tree->root;
+    if ((char *) addr < (char *) node->memblock) {
+      node = node->left;
+      while (node != NULL && node->right != NULL) {
+	node = node->right;
+      }
+    }
+    if (node != NULL && (char *) addr >= (char *) node->memblock
+	&& (char *) addr < (char *) node->memblock + node->bytes) {
+      context = node->context;
+    }
+  }
+  spinlock_unlock(&tree->lock);
+
+  return context;
+}
+
+
+// Returns: the allocation context of the tracked block containing
+// 'addr', or NULL.  Only blocks in a splay tree are found, see
+// memleak_add_leakinfo().
+//
+static cct_node_t *
+memleak_find_context(void *addr)
+{
+  cct_node_t *context = splay_find_context(&memtree, addr);
+
+  spinlock_lock(&header_trees_lock);
+  for (memtree_t *tree = header_trees; tree && ! context; tree = tree->next) {
+    context = splay_find_context(tree, addr);
+  }
+  spinlock_unlock(&header_trees_lock);
+
+  return context;
+}
+
+
+// Returns: this thread's header tree, created on first use, or NULL
+// if out of memory.
+//
+static memtree_t *
+memleak_header_tree(void)
+{
+  if (header_tree == NULL) {
+    memtree_t *tree = hpcrun_malloc(sizeof(memtree_t));
+    if (tree == NULL) {
+      return NULL;
+    }
+    tree->root = NULL;
+    spinlock_init(&tree->lock);
+
+    spinlock_lock(&header_trees_lock);
+    tree->next = header_trees;
+    header_trees = tree;
+    spinlock_unlock(&header_trees_lock);
+
+    header_tree = tree;
+  }
+  return header_tree;
+}
+
+
 
 /******************************************************************************
  * private operations
@@ -335,6 +429,10 @@ memleak_initialize(void)
     srandom(seed);
   }
 
+  // let the lock contention source identify heap locks by their
+  // allocation site
+  hpcrun_memleak_register_lookup(memleak_find_context);
+
   // unconditionally enable leak detection for now
   leak_detection_enabled = 1;
   leak_detection_init = 1;
@@ -412,7 +510,7 @@ memleak_get_free_loc(void *appl_ptr, void **sys_ptr, leakinfo_t **info_ptr)
 
   // always try footer
   *sys_ptr = appl_ptr;
-  *info_ptr = splay_delete(appl_ptr);
+  *info_ptr = splay_delete(&memtree, appl_ptr);
   if (*info_ptr == NULL) {
     return MEMLEAK_LOC_NONE;
   }
@@ -468,8 +566,16 @@ memleak_add_leakinfo(const char *name, void *sys_ptr, void *appl_ptr,
     info_ptr->context = NULL;
     loc_str = "inactive";
   }
+  // footers must be found by address at free time.  with lock
+  // contention profiling, sampled headers go in this thread's tree.
+  info_ptr->tree = NULL;
   if (loc == MEMLEAK_LOC_FOOT) {
-    splay_insert(info_ptr);
+    splay_insert(&memtree, info_ptr);
+  } else if (info_ptr->context != NULL && lock_contention_enabled()) {
+    info_ptr->tree = memleak_header_tree();
+    if (info_ptr->tree != NULL) {
+      splay_insert(info_ptr->tree, info_ptr);
+    }
   }
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
@@ -568,6 +674,9 @@ memleak_free_helper(const char *name, void *sys_ptr, void *appl_ptr,
   } else {
     loc_str = "inactive";
   }
+  if (loc == MEMLEAK_LOC_HEAD && info_ptr->tree != NULL) {
+    splay_delete(info_ptr->tree, appl_ptr);
+  }
   info_ptr->magic = 0;
 
   TMSG(MEMLEAK, "%s: bytes: %ld sys: %p appl: %p info: %p cct: %p (%s)",
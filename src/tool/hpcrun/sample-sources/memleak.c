@@ -78,6 +78,7 @@
 #include <main.h>
 #include <hpcrun/sample_sources_registered.h>
 #include "simple_oo.h"
+#include "memleak.h"
 #include <hpcrun/thread_data.h>
 
 #include <messages/messages.h>
@@ -89,6 +90,8 @@ static int alloc_metric_id = -1;
 static int free_metric_id = -1;
 static int leak_metric_id = -1;
 
+static memleak_context_fn_t *memleak_lookup = NULL;
+
 
 /******************************************************************************
  * method definitions
@@ -276,3 +279,20 @@ hpcrun_free_inc(cct_node_t* node, int incr)
 			      (cct_metric_data_t){.i = incr});
   }
 }
+
+
+void
+hpcrun_memleak_register_lookup(memleak_context_fn_t *fn)
+{
+  memleak_lookup = fn;
+}
+
+
+cct_node_t*
+hpcrun_memleak_alloc_context(void *addr)
+{
+  if (memleak_lookup == NULL || ! hpcrun_memleak_active()) {
+    return NULL;
+  }
+  return memleak_lookup(addr);
+}
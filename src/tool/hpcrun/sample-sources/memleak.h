@@ -74,4 +74,11 @@ int hpcrun_memleak_active();
 void hpcrun_alloc_inc(cct_node_t* node, int incr);
 void hpcrun_free_inc(cct_node_t* node, int incr);
 
+// allocation context of the tracked heap block that contains 'addr',
+// or NULL (the lookup is registered by the memleak overrides)
+typedef cct_node_t* memleak_context_fn_t(void *addr);
+
+void hpcrun_memleak_register_lookup(memleak_context_fn_t *fn);
+cct_node_t* hpcrun_memleak_alloc_context(void *addr);
+
 #endif // sample_source_memleak_h
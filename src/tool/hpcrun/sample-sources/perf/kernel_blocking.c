@@ -42,18 +42,33 @@
 // ******************************************************* EndRiceCopyright *
 
 
+/******************************************************************************
+ * system includes
+ *****************************************************************************/
+
+#include <time.h>       // CLOCK_REALTIME
+
+
 /******************************************************************************
  * local includes
  *****************************************************************************/
 
 /**
- * WARNING : THIS IS AN EXPERIMENTAL FEATURE
+ * Off-CPU profiling with context switch records (Linux 4.3 or newer).
  *
- * Kernel blocking event is not validated yet, and only works for Kernel 4.3
- * (at least). This file will be updated once we find a way to make it work
- * properly.
+ * Every context switch of a monitored thread produces a sample record
+ * followed by a switch-out record and, once the thread runs again, a
+ * switch-in record. The signal for the sample is delivered when the
+ * thread returns to user mode, i.e., after the switch-in, with the user
+ * context still at the location where the thread was switched out. The
+ * time between switch-out and switch-in is charged to that call path
+ * (extended with the kernel call chain of the sample, if available).
+ *
+ * The perf clock is set to CLOCK_REALTIME so that the switch timestamps
+ * can be used directly in the trace: the interval is recorded as the
+ * BLOCKED_OFF_CPU placeholder at switch-out, followed by the call path
+ * at switch-in.
  */
-#include <assert.h>
 #include <include/linux_info.h>
 
 #include "kernel_blocking.h"
@@ -62,175 +77,157 @@
 #include "perf_mmap.h"
 #include "event_custom.h"
 
+#include <hpcrun/cct_insert_backtrace.h>
+#include <hpcrun/trace.h>
+#include <hpcrun/messages/messages.h>
+#include <hpcrun/utilities/ip-normalized.h>
+#include <lib/prof-lean/placeholders.h>
+
 /******************************************************************************
  * Macros
  *****************************************************************************/
 
-#define KERNEL_BLOCKING_DEBUG 0
-
 // -----------------------------------------------------
 // Predefined events
 // -----------------------------------------------------
 
 #define EVNAME_KERNEL_BLOCK     "BLOCKTIME"
+#define EVNAME_KERNEL_PREEMPT   "PREEMPTTIME"
 #define EVNAME_CONTEXT_SWITCHES "CS"
 
-
-//******************************************************************************
-// forward declaration
-//******************************************************************************
-
+#define NSEC_PER_USEC 1000
 
 
 //******************************************************************************
 // local variables
 //******************************************************************************
 
-// metric index for kernel blocking
-// usually each thread has the same metric index, so it's safe to make it global
-// for each thread (I hope).
+// metric indices for blocking time, preemption time and context switches.
+// each thread has the same metric indices, so it's safe to make them global.
 static int metric_blocking_index = -1;
+static int metric_preempt_index  = -1;
+static int metric_cs_index       = -1;
+
+static __thread u64  time_cs_out   = 0;  // time when leaving the cpu
+static __thread bool cs_preempted  = false;
+
+// the context switch sample that precedes the switch-out record:
+// its kernel call chain tells why the thread left the cpu
+static __thread perf_mmap_data_t cs_sample;
+static __thread bool             cs_sample_valid = false;
+
+
+/******************************************************************************
+ * placeholder
+ *****************************************************************************/
+
+// marks the intervals in the trace when a thread is blocked in the kernel
+void
+BLOCKED_OFF_CPU(void)
+{
+}
 
-static __thread u64          time_cs_out = 0;    // time when leaving the application process
-static __thread cct_node_t  *cct_kernel  = NULL; // cct of the last access to kernel
-static __thread u32          cpu = 0;           // cpu of the last sample
-static __thread u32          pid = 0, tid = 0;  // last pid/tid
 
 /******************************************************************************
  * private operations
  *****************************************************************************/
 
+static bool
+switch_out_is_preemption(perf_mmap_data_t *mmap_data)
+{
+#ifdef PERF_RECORD_MISC_SWITCH_OUT_PREEMPT
+  // only available since kernel 4.17
+  return (mmap_data->header_misc & PERF_RECORD_MISC_SWITCH_OUT_PREEMPT) != 0;
+#else
+  return false;
+#endif
+}
+
+
 static void
-blame_kernel_time(event_thread_t *current_event, cct_node_t *cct_kernel,
-    perf_mmap_data_t *mmap_data)
+trace_blocked(u64 time_ns)
+{
+  if (! hpcrun_trace_isactive()) return;
+
+  core_profile_trace_data_t *cptd = &(TD_GET(core_profile_trace_data));
+
+  ip_normalized_t ip =
+    hpcrun_normalize_ip(canonicalize_placeholder(BLOCKED_OFF_CPU), NULL);
+  cct_addr_t addr = NON_LUSH_ADDR_INI(ip.lm_id, ip.lm_ip);
+
+  cct_node_t *node =
+    hpcrun_cct_insert_addr(cptd->epoch->csdata.partial_unw_root, &addr);
+  hpcrun_cct_terminate_path(node);
+  hpcrun_cct_retain(node);
+
+  // samples taken while the switch-out record waited in the buffer
+  // are already in the trace: start the interval after them, so that
+  // the trace stays in time order
+  uint64_t time_us = time_ns / NSEC_PER_USEC;
+  if (time_us < cptd->trace_max_time_us) {
+    time_us = cptd->trace_max_time_us;
+  }
+
+  hpcrun_trace_append_with_time(cptd, hpcrun_cct_persistent_id(node),
+                                metric_blocking_index, time_us);
+}
+
+
+//----------------------------------------------------------------------
+// charge the off-cpu interval [time_cs_out, time_cs_in] to the call path
+// of 'context', where the thread was switched out.
+//----------------------------------------------------------------------
+static void
+blame_off_cpu_time(void *context, u64 time_cs_in)
 {
   // make sure the time is is zero or positive
-  if (mmap_data->time < time_cs_out) {
-    TMSG(LINUX_PERF, "old t: %l, c: %d, p: %d, td: %d -- vs -- t: %l, c: %d, p: %d, td: %d",
-        time_cs_out, cpu, pid, tid, mmap_data->time, mmap_data->cpu, mmap_data->pid, mmap_data->tid);
+  if (time_cs_in < time_cs_out) {
+    TMSG(LINUX_PERF, "switch in at %ld before switch out at %ld",
+         time_cs_in, time_cs_out);
     return;
   }
 
-  uint64_t delta = mmap_data->time - time_cs_out;
+  uint64_t delta = time_cs_in - time_cs_out;
+  int metric = cs_preempted ? metric_preempt_index : metric_blocking_index;
 
-  // ----------------------------------------------------------------
-  // blame the time spent in the kernel to the cct kernel
-  // ----------------------------------------------------------------
+  // the trace records must be appended in time order: the blocked
+  // interval starts before the call path is recorded at switch-in
+  if (! cs_preempted) {
+    trace_blocked(time_cs_out);
+  }
 
-  cct_metric_data_increment(metric_blocking_index, cct_kernel,
-      (cct_metric_data_t){.i = delta});
+  sampling_info_t info = {
+    .sample_clock = time_cs_in / NSEC_PER_USEC,
+    .sample_data  = cs_sample_valid ? &cs_sample : NULL
+  };
+
+  sample_val_t sv = hpcrun_sample_callpath(context, metric_cs_index,
+      (hpcrun_metricVal_t) {.r = 1}, 0/*skipInner*/, 0/*isSync*/, &info);
 
   // ----------------------------------------------------------------
   // it's important to always count the number of samples for debugging purpose
   // ----------------------------------------------------------------
 
   thread_data_t *td = hpcrun_get_thread_data();
-  td->core_profile_trace_data.perf_event_info[metric_blocking_index].num_samples++;
-}
-
-/***********************************************************************
- * this function is called when a cycle or time event occurs, OR a
- *  context switch event occurs.
- *
- * to compute kernel blocking time:
- *  time_outside_kernel - time_inside_kernel
- *
- * algorithm:
- *  if this is the first time entering kernel (time_cs_out == 0) then
- *    set time_cs_out
- *    store the cct to cct_kernel
- *  else
- *    if we are outside the kernel, then:
- *      compute the blocking time
- *      blame the time to the kernel cct
- *
- *    else if we are still inside the kernel with different cct_kernel:
- *      compute the time
- *      blame the time to the old cct_kernel
- *      set time_cs_out to the current time
- *      set cct_kernel with the new cct
- *    end if
- *  end if
- ***********************************************************************/
-void
-kernel_block_handler( event_thread_t *current_event, sample_val_t sv,
-    perf_mmap_data_t *mmap_data)
-{
-  if (metric_blocking_index < 0)
-    return; // not initialized or something wrong happens in the initialization
-
-  if (mmap_data == NULL) {
-
-    // somehow, at the end of the execution, a sample event is still triggered
-    // and in this case, the arguments are null. Is this our bug ? or gdb ?
+  td->core_profile_trace_data.perf_event_info[metric_cs_index].num_samples++;
 
-    return;
-  }
-
-  if (mmap_data->context_switch_time > 0) {
-    // ----------------------------------------------------------------
-    // when PERF_RECORD_SWITCH (context switch out) occurs:
-    //  if this is the first time, (time_cs_out is zero), then freeze the
-    //    cs time and the current cct
-    // ----------------------------------------------------------------
-
-    if (time_cs_out == 0) {
-      // ----------------------------------------------------------------
-      // this is the first time we enter the kernel (leaving the current process)
-      // needs to store the time to compute the blocking time in
-      //  the next step when leaving the kernel
-      // ----------------------------------------------------------------
-      time_cs_out = mmap_data->context_switch_time;
-      cpu = mmap_data->cpu;
-      pid = mmap_data->pid;
-      tid = mmap_data->tid;
-    }
-  } else {
-
-    // ----------------------------------------------------------------
-    // when PERF_SAMPLE_RECORD occurs:
-    // check whether we were previously in the kernel or not (time_cs_out > 0)
-    // if we were in the kernel, then we blame the different time to the
-    //   cct kernel
-    // ----------------------------------------------------------------
-
-    if (current_event->event->attr.config == PERF_COUNT_SW_CONTEXT_SWITCHES) {
-
-      if (cct_kernel != NULL && time_cs_out > 0) {
-        // corner case : context switch within a context switch !
-        blame_kernel_time(current_event, cct_kernel, mmap_data);
-        time_cs_out  = 0;
-      }
-      // context switch inside the kernel:  record the new cct
-      cct_kernel  = sv.sample_node;
-
-    } else if (cct_kernel != NULL) {
-      // other event than cs occurs (it can be cycles, clocks or others)
-
-      if ((mmap_data->time > 0) && (time_cs_out > 0) && (mmap_data->nr==0)) {
-#if KERNEL_BLOCKING_DEBUG
-        unsigned int cpumode = mmap_data->header_misc & PERF_RECORD_MISC_CPUMODE_MASK;
-        assert(cpumode == PERF_RECORD_MISC_USER);
-#endif
+  // the sample may have been dropped, or the epoch flushed after it
+  if (sv.sample_node == NULL || sv.epoch_gen != td->epoch_gen) return;
 
-        blame_kernel_time(current_event, cct_kernel, mmap_data);
-        // important: need to reset the value to inform that we are leaving the kernel
-        cct_kernel   = NULL;
-        time_cs_out  = 0;
-      }
-    }
-  }
+  cct_metric_data_increment(metric, sv.sample_node,
+      (cct_metric_data_t){.i = delta});
+  td->core_profile_trace_data.perf_event_info[metric].num_samples++;
 }
 
 
 /***************************************************************
- * Register events to compute blocking time in the kernel
- * We use perf's sofrware context switch event to compute the
- * time spent inside the kernel. For this, we need to sample everytime
- * a context switch occurs, and compute the time when entering the
- * kernel vs leaving the kernel. See perf_event_handler.
- * We need two metrics for this:
- * - blocking time metric to store the time spent in the kernel
+ * Register events to compute off-cpu time
+ * We use perf's software context switch event with switch records
+ * to get the time when a thread leaves and re-enters the cpu.
+ * We need three metrics for this:
+ * - blocking time metric to store the time a thread waits in the kernel
+ * - preemption time metric to store the time a runnable thread waits
+ *   for a cpu (kernel 4.17 or newer, otherwise counted as blocking)
  * - context switch metric to store the number of context switches
  ****************************************************************/
 static void
@@ -241,10 +238,19 @@ register_blocking(event_info_t *event_desc)
   // ------------------------------------------
   event_desc->metric_custom->metric_index = hpcrun_new_metric();
   event_desc->metric_custom->metric_desc  = hpcrun_set_metric_info_and_period(
-      event_desc->metric_custom->metric_index, EVNAME_KERNEL_BLOCK,
+      event_desc->metric_custom->metric_index, EVNAME_KERNEL_BLOCK " (ns)",
       MetricFlags_ValFmt_Int, 1 /* period */, metric_property_none);
 
   metric_blocking_index = event_desc->metric_custom->metric_index;
+
+  // ------------------------------------------
+  // create metric to compute preemption time
+  // ------------------------------------------
+  metric_preempt_index = hpcrun_new_metric();
+  hpcrun_set_metric_info_and_period(
+      metric_preempt_index, EVNAME_KERNEL_PREEMPT " (ns)",
+      MetricFlags_ValFmt_Int, 1 /* period */, metric_property_none);
+
   // ------------------------------------------
   // create metric to store context switches
   // ------------------------------------------
@@ -253,11 +259,12 @@ register_blocking(event_info_t *event_desc)
       event_desc->metric, EVNAME_CONTEXT_SWITCHES,
       MetricFlags_ValFmt_Real, 1 /* period*/, metric_property_none);
 
+  metric_cs_index = event_desc->metric;
+
   // ------------------------------------------
   // set context switch event description to be used when creating
   //  perf event of this type on each thread
   // ------------------------------------------
-  /* PERF_SAMPLE_STACK_USER may also be good to use */
   u64 sample_type = PERF_SAMPLE_IP   | PERF_SAMPLE_TID       |
       PERF_SAMPLE_TIME | PERF_SAMPLE_CALLCHAIN |
       PERF_SAMPLE_CPU  | PERF_SAMPLE_PERIOD;
@@ -274,6 +281,10 @@ register_blocking(event_info_t *event_desc)
 
   event_desc->attr.context_switch = 1;
   event_desc->attr.sample_id_all = 1;
+
+  // timestamps in the same clock as the trace (gettimeofday)
+  event_desc->attr.use_clockid = 1;
+  event_desc->attr.clockid     = CLOCK_REALTIME;
 }
 
 
@@ -287,14 +298,54 @@ void kernel_blocking_init()
 
   event_custom_t *event_kernel_blocking = hpcrun_malloc(sizeof(event_custom_t));
   event_kernel_blocking->name         = EVNAME_KERNEL_BLOCK;
-  event_kernel_blocking->desc         = "Approximation of a thread's blocking time."  
-					" This event requires another event (such as CYCLES) to profile with."  
-					" The unit time is hardware-dependent but mostly in microseconds."  
+  event_kernel_blocking->desc         = "Off-CPU time of a thread, attributed to the call path"
+					" where it was switched out, in nanoseconds."
+					" Time waiting for a cpu after preemption is reported"
+					" separately as " EVNAME_KERNEL_PREEMPT " (Linux 4.17 or newer)."
+					" Blocked intervals appear in the trace as BLOCKED_OFF_CPU."
 					" This event is only available on Linux kernel 4.3 or newer.";
   event_kernel_blocking->register_fn  = register_blocking;   // call backs
-  event_kernel_blocking->handler_fn   = NULL; 		// No call backs: we want all event to call us
+  event_kernel_blocking->handler_fn   = NULL; 		// records are routed by kernel_block_handler
   event_kernel_blocking->metric_index = 0;   		// these fields to be defined later
   event_kernel_blocking->metric_desc  = NULL; 	 	// these fields to be defined later
 
   event_custom_register(event_kernel_blocking);
 }
+
+
+//----------------------------------------------------------------------
+// called for every record read from the buffer of 'current_event'.
+// returns true if the record belongs to the off-cpu event (and has been
+// consumed), false if it should be handled as a regular sample.
+//----------------------------------------------------------------------
+bool
+kernel_block_handler(event_thread_t *current_event, void *context,
+    perf_mmap_data_t *mmap_data)
+{
+  if (metric_cs_index < 0 || current_event->event->metric != metric_cs_index)
+    return false;
+
+  switch (mmap_data->header_type) {
+
+  case PERF_RECORD_SAMPLE:
+    cs_sample = *mmap_data;
+    cs_sample_valid = true;
+    break;
+
+  case PERF_RECORD_SWITCH:
+    if (mmap_data->header_misc & PERF_RECORD_MISC_SWITCH_OUT) {
+      time_cs_out  = mmap_data->context_switch_time;
+      cs_preempted = switch_out_is_preemption(mmap_data);
+    } else if (time_cs_out > 0) {
+      blame_off_cpu_time(context, mmap_data->context_switch_time);
+      time_cs_out     = 0;
+      cs_sample_valid = false;
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  return true;
+}
@@ -42,13 +42,16 @@
 #ifndef __KERNEL_BLOCKING_H__
 #define __KERNEL_BLOCKING_H__
 
+#include <stdbool.h>
+
 #include "perf-util.h"    // u64, u32 and perf_mmap_data_t
 #include <sample_event.h> // sample_val_t
 
 void kernel_blocking_init();
 
-void
-kernel_block_handler( event_thread_t *current_event, sample_val_t sv,
+// returns true if the record has been consumed by the off-cpu event
+bool
+kernel_block_handler( event_thread_t *current_event, void *context,
     perf_mmap_data_t *mmap_data);
 
 #endif
@@ -45,9 +45,10 @@ void kernel_blocking_init()
 {
 }
 
-void
-kernel_block_handler( event_thread_t *current_event, sample_val_t sv,
+bool
+kernel_block_handler( event_thread_t *current_event, void *context,
     perf_mmap_data_t *mmap_data)
 {
+  return false;
 }
 
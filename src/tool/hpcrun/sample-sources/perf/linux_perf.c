@@ -1128,11 +1128,13 @@ perf_event_handler(
     sample_val_t sv;
     memset(&sv, 0, sizeof(sample_val_t));
 
+    // records of the off-cpu event are charged at switch-in
+    if (kernel_block_handler(current, context, &mmap_data))
+      continue;
+
     if (mmap_data.header_type == PERF_RECORD_SAMPLE)
       record_sample(current, &mmap_data, context, &sv);
 
-    kernel_block_handler(current, sv, &mmap_data);
-
   } while (more_data);
 
   perf_start_all(nevents, event_thread);
@@ -56,6 +56,7 @@
 #include <stdio.h>
 
 #include <sample-sources/blame-shift/blame-map.h>
+#include <sample-sources/lock-contention.h>
 #include <sample-sources/pthread-blame.h>
 #include <hpcrun/thread_data.h>
 
@@ -117,6 +118,7 @@ extern void monitor_real_abort(void);
 
 #define pthread_spin_lock_REAL        DL
 #define pthread_spin_unlock_REAL      DL
+#define pthread_spin_trylock_REAL     DL
 
 //
 // TBB investigation
@@ -143,8 +145,10 @@ REAL_TYPEDEF(int, pthread_mutex_lock)(pthread_mutex_t* mutex);
 REAL_TYPEDEF(int, pthread_mutex_unlock)(pthread_mutex_t* mutex);
 REAL_TYPEDEF(int, pthread_mutex_timedlock)(pthread_mutex_t* restrict mutex,
                                            const struct timespec* restrict abs_timeout);
+REAL_TYPEDEF(int, pthread_mutex_trylock)(pthread_mutex_t* mutex);
 REAL_TYPEDEF(int, pthread_spin_lock)(pthread_spinlock_t* lock);
 REAL_TYPEDEF(int, pthread_spin_unlock)(pthread_spinlock_t* lock);
+REAL_TYPEDEF(int, pthread_spin_trylock)(pthread_spinlock_t* lock);
 
 
 REAL_DCL(pthread_cond_timedwait);
@@ -154,8 +158,17 @@ REAL_DCL(pthread_cond_signal);
 REAL_DCL(pthread_mutex_lock);
 REAL_DCL(pthread_mutex_unlock);
 REAL_DCL(pthread_mutex_timedlock);
+REAL_DCL(pthread_mutex_trylock);
 REAL_DCL(pthread_spin_lock);
 REAL_DCL(pthread_spin_unlock);
+REAL_DCL(pthread_spin_trylock);
+
+//
+// Lock contention (see lock-contention.h): a lock is tried first,
+// only if that fails do we time the wait (and sample after it).
+// Condition waits give up the mutex while they wait, so the hold
+// ends before and restarts after the wait.
+//
 
 int 
 OVERRIDE_NM(pthread_cond_timedwait)(pthread_cond_t* restrict cond,
@@ -164,10 +177,17 @@ OVERRIDE_NM(pthread_cond_timedwait)(pthread_cond_t* restrict cond,
 {
   REAL_INIT(pthread_cond_timedwait);
 
+  // the mutex is held until the wait releases it, so the hold
+  // sample can not wait for the release
+  bool contention = lock_contention_enabled();
+  if (contention) lock_contention_released(lock_contention_release(mutex));
+
   pthread_directed_blame_shift_blocked_start(cond);
   int retval = REAL_FN(pthread_cond_timedwait)(cond, mutex, abstime);
   pthread_directed_blame_shift_end();
 
+  if (contention) lock_contention_acquired(mutex);
+
   return retval;
 }
 
@@ -177,10 +197,17 @@ OVERRIDE_NM(pthread_cond_wait)(pthread_cond_t* restrict cond,
 {
   REAL_INIT(pthread_cond_wait);
 
+  // the mutex is held until the wait releases it, so the hold
+  // sample can not wait for the release
+  bool contention = lock_contention_enabled();
+  if (contention) lock_contention_released(lock_contention_release(mutex));
+
   pthread_directed_blame_shift_blocked_start(cond);
   int retval = REAL_FN(pthread_cond_wait)(cond, mutex);
   pthread_directed_blame_shift_end();
 
+  if (contention) lock_contention_acquired(mutex);
+
   return retval;
 }
 
@@ -210,29 +237,62 @@ OVERRIDE_NM(pthread_mutex_lock)(pthread_mutex_t* mutex)
   REAL_INIT(pthread_mutex_lock);
 
   TMSG(LOCKWAIT, "mutex lock ENCOUNTERED");
+  bool contention = lock_contention_enabled();
+  uint64_t wait_start = 0;
+  if (contention) {
+    REAL_INIT(pthread_mutex_trylock);
+    if (REAL_FN(pthread_mutex_trylock)(mutex) == 0) {
+      lock_contention_acquired(mutex);
+      return 0;
+    }
+    wait_start = lock_contention_wait_start(mutex);
+  }
+
   if (! pthread_blame_lockwait_enabled() ) {
-    return REAL_FN(pthread_mutex_lock)(mutex);
+    int retval = REAL_FN(pthread_mutex_lock)(mutex);
+    if (contention && retval == 0) lock_contention_wait_end(mutex, wait_start);
+    return retval;
   }
 
   TMSG(LOCKWAIT, "pthread mutex LOCK override");
   pthread_directed_blame_shift_blocked_start(mutex);
   int retval = REAL_FN(pthread_mutex_lock)(mutex);
   pthread_directed_blame_shift_end();
+  if (contention && retval == 0) lock_contention_wait_end(mutex, wait_start);
 
   return retval;
 }
 
+int 
+OVERRIDE_NM(pthread_mutex_trylock)(pthread_mutex_t* mutex)
+{
+  REAL_INIT(pthread_mutex_trylock);
+
+  int retval = REAL_FN(pthread_mutex_trylock)(mutex);
+  if (retval == 0 && lock_contention_enabled()) {
+    lock_contention_acquired(mutex);
+  }
+  return retval;
+}
+
 int 
 OVERRIDE_NM(pthread_mutex_unlock)(pthread_mutex_t* mutex)
 {
   REAL_INIT(pthread_mutex_unlock);
 
   TMSG(LOCKWAIT, "mutex unlock ENCOUNTERED");
+  uint64_t hold = 0;
+  if (lock_contention_enabled()) {
+    hold = lock_contention_release(mutex);
+  }
   if (! pthread_blame_lockwait_enabled() ) {
-    return REAL_FN(pthread_mutex_unlock)(mutex);
+    int retval = REAL_FN(pthread_mutex_unlock)(mutex);
+    lock_contention_released(hold);
+    return retval;
   }
   TMSG(LOCKWAIT, "pthread mutex UNLOCK");
   int retval = REAL_FN(pthread_mutex_unlock)(mutex);
+  lock_contention_released(hold);
   pthread_directed_blame_accept(mutex);
   return retval;
 }
@@ -244,8 +304,21 @@ OVERRIDE_NM(pthread_mutex_timedlock)(pthread_mutex_t* restrict mutex,
   REAL_INIT(pthread_mutex_timedlock);
   
   TMSG(LOCKWAIT, "mutex timedlock ENCOUNTERED");
+  bool contention = lock_contention_enabled();
+  uint64_t wait_start = 0;
+  if (contention) {
+    REAL_INIT(pthread_mutex_trylock);
+    if (REAL_FN(pthread_mutex_trylock)(mutex) == 0) {
+      lock_contention_acquired(mutex);
+      return 0;
+    }
+    wait_start = lock_contention_wait_start(mutex);
+  }
+
   if (! pthread_blame_lockwait_enabled() ) {
-    return REAL_FN(pthread_mutex_timedlock)(mutex, abs_timeout);
+    int retval = REAL_FN(pthread_mutex_timedlock)(mutex, abs_timeout);
+    if (contention && retval == 0) lock_contention_wait_end(mutex, wait_start);
+    return retval;
   }
 
   TMSG(LOCKWAIT, "pthread mutex TIMEDLOCK");
@@ -253,6 +326,7 @@ OVERRIDE_NM(pthread_mutex_timedlock)(pthread_mutex_t* restrict mutex,
   pthread_directed_blame_shift_blocked_start(mutex);
   int retval = REAL_FN(pthread_mutex_timedlock)(mutex, abs_timeout);
   pthread_directed_blame_shift_end();
+  if (contention && retval == 0) lock_contention_wait_end(mutex, wait_start);
   return retval;
 }
 
@@ -262,15 +336,41 @@ OVERRIDE_NM(pthread_spin_lock)(pthread_spinlock_t* lock)
   REAL_INIT(pthread_spin_lock);
 
   TMSG(LOCKWAIT, "pthread_spin_lock ENCOUNTERED");
+  bool contention = lock_contention_enabled();
+  uint64_t wait_start = 0;
+  if (contention) {
+    REAL_INIT(pthread_spin_trylock);
+    if (REAL_FN(pthread_spin_trylock)(lock) == 0) {
+      lock_contention_acquired((void*) lock);
+      return 0;
+    }
+    wait_start = lock_contention_wait_start((void*) lock);
+  }
+
   if (! pthread_blame_lockwait_enabled() ) {
-    return REAL_FN(pthread_spin_lock)(lock);
+    int retval = REAL_FN(pthread_spin_lock)(lock);
+    if (contention && retval == 0) lock_contention_wait_end((void*) lock, wait_start);
+    return retval;
   }
 
   TMSG(LOCKWAIT, "pthread SPIN LOCK override");
   pthread_directed_blame_shift_spin_start((void*) lock);
   int retval = REAL_FN(pthread_spin_lock)((void*) lock);
   pthread_directed_blame_shift_end();
+  if (contention && retval == 0) lock_contention_wait_end((void*) lock, wait_start);
+
+  return retval;
+}
 
+int
+OVERRIDE_NM(pthread_spin_trylock)(pthread_spinlock_t* lock)
+{
+  REAL_INIT(pthread_spin_trylock);
+
+  int retval = REAL_FN(pthread_spin_trylock)(lock);
+  if (retval == 0 && lock_contention_enabled()) {
+    lock_contention_acquired((void*) lock);
+  }
   return retval;
 }
 
@@ -280,12 +380,19 @@ OVERRIDE_NM(pthread_spin_unlock)(pthread_spinlock_t* lock)
   REAL_INIT(pthread_spin_unlock);
 
   TMSG(LOCKWAIT, "pthread_spin_unlock ENCOUNTERED");
+  uint64_t hold = 0;
+  if (lock_contention_enabled()) {
+    hold = lock_contention_release((void*) lock);
+  }
   if (! pthread_blame_lockwait_enabled() ) {
-    return REAL_FN(pthread_spin_unlock)(lock);
+    int retval = REAL_FN(pthread_spin_unlock)(lock);
+    lock_contention_released(hold);
+    return retval;
   }
 
   TMSG(LOCKWAIT, "pthread SPIN UNLOCK");
   int retval = REAL_FN(pthread_spin_unlock)((void*) lock);
+  lock_contention_released(hold);
   pthread_directed_blame_accept((void*) lock);
   return retval;
 }
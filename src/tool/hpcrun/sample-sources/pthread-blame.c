@@ -120,7 +120,7 @@ static bs_fn_entry_t bs_entry;
 
 static bool lockwait_enabled = false;
 
-static blame_entry_t* pthread_blame_table = NULL;
+static blame_map_t* pthread_blame_table = NULL;
 
 static bool metric_id_set = false;
 
@@ -181,7 +181,7 @@ get_blame_metric_id(void)
 
 static inline
 void
-add_blame(uint64_t obj, uint32_t value)
+add_blame(uint64_t obj, uint64_t value)
 {
   if (! pthread_blame_table) {
     EMSG("Attempted to add pthread blame before initialization");
@@ -215,7 +215,7 @@ process_directed_blame_for_sample(void* arg, int metric_id, cct_node_t* node, in
     return;
 #endif // LOCKWAIT_FIX
   
-  uint32_t metric_value = (uint32_t) (metric_desc->period * metric_incr);
+  uint64_t metric_value = (uint64_t) (metric_desc->period * metric_incr);
 
   uint64_t obj_to_blame = get_blame_target();
   if(obj_to_blame) {
@@ -335,6 +335,7 @@ METHOD_FN(stop)
 static void
 METHOD_FN(shutdown)
 {
+  if (pthread_blame_table) blame_map_summary(pthread_blame_table, "pthread");
   self->state = UNINIT;
   lockwait_enabled = false;
 }
@@ -74,6 +74,7 @@
 #include "uw_recipe_map.h"
 #include "validate_return_addr.h"
 #include "write_data.h"
+#include "live_query.h"
 #include "cct_insert_backtrace.h"
 
 #include <monitor.h>
@@ -133,6 +134,7 @@ record_partial_unwind(
   bt.has_tramp = false;
   bt.n_trolls = 0;
   bt.bottom_frame_elided = false;
+  bt.prefix = NULL;
 
   TMSG(PARTIAL_UNW, "recording partial unwind from segv");
   hpcrun_stats_num_samples_partial_inc();
@@ -185,8 +187,10 @@ hpcrun_sample_callpath(void* context, int metricId,
   }
 
   // Synchronous unwinds (pthread_create) must wait until they acquire
-  // the read lock, but async samples give up if not avail.
-  // This only applies in the dynamic case.
+  // the read lock, but async samples give up if not avail.  The lock
+  // is only held exclusively by dlclose.  While a dlopen is in flight,
+  // async samples proceed unless their IP lies in the module being
+  // mapped.  This only applies in the dynamic case.
 #ifndef HPCRUN_STATIC_LINK
   if (isSync) {
     while (! hpcrun_dlopen_read_lock()) ;
@@ -197,6 +201,14 @@ hpcrun_sample_callpath(void* context, int metricId,
     monitor_unblock_shootdown();
     return ret;
   }
+  else if (context != NULL
+	   && hpcrun_dlopen_defer_sample(hpcrun_context_pc(context))) {
+    TMSG(SAMPLE_CALLPATH, "deferring sample in module being mapped");
+    hpcrun_dlopen_read_unlock();
+    hpcrun_stats_num_samples_blocked_dlopen_inc();
+    monitor_unblock_shootdown();
+    return ret;
+  }
 #endif
 
   TMSG(SAMPLE_CALLPATH, "attempting sample");
@@ -209,11 +221,14 @@ hpcrun_sample_callpath(void* context, int metricId,
 
   cct_node_t* node = NULL;
   epoch_t* epoch = td->core_profile_trace_data.epoch;
+  ret.epoch_gen = td->epoch_gen;
 
   // --------------------------------------
   // start of handling sample
   // --------------------------------------
   hpcrun_set_handling_sample(td);
+  // unwind recipes may be released by other threads (dlclose)
+  hpcrun_freeable_enter();
 
   td->btbuf_cur = NULL;
   td->deadlock_drop = false;
@@ -300,15 +315,25 @@ hpcrun_sample_callpath(void* context, int metricId,
     // so that the call path associated with the trace record can be recovered.
     hpcrun_cct_retain(func_proxy);
     TMSG(TRACE, "Changed persistent id to indicate mutation of func_proxy node");
-    hpcrun_trace_append(&td->core_profile_trace_data, hpcrun_cct_persistent_id(func_proxy), metricId);
+    if (data != NULL && data->sample_clock != 0) {
+      // the sample source knows when the sample really happened
+      hpcrun_trace_append_with_time(&td->core_profile_trace_data,
+				    hpcrun_cct_persistent_id(func_proxy), metricId,
+				    data->sample_clock);
+    } else {
+      hpcrun_trace_append(&td->core_profile_trace_data, hpcrun_cct_persistent_id(func_proxy), metricId);
+    }
     TMSG(TRACE, "Appended func_proxy node to trace");
   }
 
+  hpcrun_freeable_exit();
   hpcrun_clear_handling_sample(td);
   if (TD_GET(mem_low) || ENABLED(FLUSH_EVERY_SAMPLE)) {
     hpcrun_flush_epochs(&(TD_GET(core_profile_trace_data)));
     hpcrun_reclaim_freeable_mem();
   }
+  hpcrun_profile_window_check(&(TD_GET(core_profile_trace_data)));
+  hpcrun_live_query_check(&(TD_GET(core_profile_trace_data)));
 #ifndef HPCRUN_STATIC_LINK
   hpcrun_dlopen_read_unlock();
 #endif
@@ -319,6 +344,38 @@ hpcrun_sample_callpath(void* context, int metricId,
   return ret;
 }
 
+bool
+hpcrun_sample_callpath_again(sample_val_t *prev, int metricId,
+			     hpcrun_metricVal_t metricIncr, int doTrace)
+{
+  thread_data_t* td = hpcrun_get_thread_data();
+
+  if (prev->sample_node == NULL || prev->epoch_gen != td->epoch_gen) {
+    TMSG(SAMPLE_CALLPATH, "previous sample %p is stale", prev->sample_node);
+    return false;
+  }
+
+  if (! hpctoolkit_sampling_is_active() || hpcrun_is_sampling_disabled()) {
+    return true;
+  }
+
+  hpcrun_set_handling_sample(td);
+
+  metric_upd_proc_t* upd_proc = hpcrun_get_metric_proc(metricId);
+  if (upd_proc) {
+    upd_proc(metricId, hpcrun_reify_metric_set(prev->sample_node), metricIncr);
+  }
+
+  if (doTrace && prev->trace_node != NULL && hpcrun_trace_isactive()) {
+    hpcrun_trace_append(&td->core_profile_trace_data,
+			hpcrun_cct_persistent_id(prev->trace_node), metricId);
+  }
+
+  hpcrun_clear_handling_sample(td);
+
+  return true;
+}
+
 static int const PTHREAD_CTXT_SKIP_INNER = 1;
 
 cct_node_t*
@@ -352,6 +409,7 @@ hpcrun_gen_thread_ctxt(void* context)
   epoch_t* epoch    = td->core_profile_trace_data.epoch;
 
   hpcrun_set_handling_sample(td);
+  hpcrun_freeable_enter();
 
   td->btbuf_cur = NULL;
   int ljmp = sigsetjmp(it->jb, 1);
@@ -360,6 +418,7 @@ hpcrun_gen_thread_ctxt(void* context)
     if (epoch != NULL) {
       if (! hpcrun_generate_backtrace_no_trampoline(&bt, context,
           PTHREAD_CTXT_SKIP_INNER)) {
+        hpcrun_freeable_exit();
         hpcrun_clear_handling_sample(td); // restore state
         EMSG("Internal error: unable to obtain backtrace for pthread context");
         return NULL;
@@ -388,11 +447,14 @@ hpcrun_gen_thread_ctxt(void* context)
     hpcrun_cleanup_partial_unwind();
   }
 #endif
+  hpcrun_freeable_exit();
   hpcrun_clear_handling_sample(td);
   if (TD_GET(mem_low) || ENABLED(FLUSH_EVERY_SAMPLE)) {
     hpcrun_flush_epochs(&(TD_GET(core_profile_trace_data)));
     hpcrun_reclaim_freeable_mem();
   }
+  hpcrun_profile_window_check(&(TD_GET(core_profile_trace_data)));
+  hpcrun_live_query_check(&(TD_GET(core_profile_trace_data)));
 #ifndef HPCRUN_STATIC_LINK
   hpcrun_dlopen_read_unlock();
 #endif
@@ -93,6 +93,7 @@ extern void hpcrun_drop_sample(void);
 typedef struct sample_val_s {
   cct_node_t* sample_node; // CCT leaf representing innermost call path frame
   cct_node_t* trace_node;  // CCT leaf representing trace record
+  uint64_t    epoch_gen;   // thread's epoch generation when taken
 } sample_val_t;
 
 
@@ -102,6 +103,7 @@ hpcrun_sample_val_init(sample_val_t* x)
   //memset(x, 0, sizeof(*x));
   x->sample_node = 0;
   x->trace_node = 0;
+  x->epoch_gen = 0;
 }
 
 
@@ -109,6 +111,15 @@ extern sample_val_t hpcrun_sample_callpath(void *context, int metricId,
 		                   hpcrun_metricVal_t metricIncr,
 				   int skipInner, int isSync, sampling_info_t *data);
 
+// Record another sample at the call path of an earlier sample 'prev'
+// of the calling thread, without unwinding again.  Appends a trace
+// record if 'doTrace' and tracing is on.  Returns false (and records
+// nothing) if the thread's epochs were flushed since 'prev' was
+// taken, as its cct nodes are then gone.
+extern bool hpcrun_sample_callpath_again(sample_val_t *prev, int metricId,
+					 hpcrun_metricVal_t metricIncr,
+					 int doTrace);
+
 extern cct_node_t* hpcrun_gen_thread_ctxt(void *context);
 
 extern cct_node_t* hpcrun_sample_callpath_w_bt(void *context,
@@ -64,6 +64,7 @@
 #include "handling_sample.h"
 
 #include "thread_data.h"
+#include "write_data.h"
 
 #include <lush/lush-pthread.h>
 #include <messages/messages.h>
@@ -237,10 +238,13 @@ core_profile_trace_data_init(core_profile_trace_data_t * cptd, int id, cct_ctxt_
   cptd->trace_min_time_us = 0;
   cptd->trace_max_time_us = 0;
 
+  cptd->profile_window = hpcrun_profile_window_current();
+
   // ----------------------------------------
   // IO support
   // ----------------------------------------
   cptd->hpcrun_file  = NULL;
+  cptd->hpcrun_file_toc = NULL;
   cptd->trace_buffer = NULL;
 
   // ----------------------------------------
@@ -260,44 +264,20 @@ static inline void gpu_data_init(gpu_data_t * gpu_data)
 }
 #endif
 
-void
-hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sources)
+//
+// (re)set the per-thread state that does not depend on allocations:
+// used both for fresh thread data and for thread data that is reused
+// by a new thread (see hpcrun_thread_data_reuse_init).
+//
+static void
+thread_data_reset(thread_data_t* td, int id, size_t n_sources)
 {
-  hpcrun_meminfo_t memstore;
-  thread_data_t* td = hpcrun_get_thread_data();
-
-  // ----------------------------------------
-  // memstore for hpcrun_malloc()
-  // ----------------------------------------
-
-  // Wipe the thread data with a bogus bit pattern, but save the
-  // memstore so we can reuse it in the child after fork.  This must
-  // come first.
-  td->inside_hpcrun = 1;
-  memstore = td->memstore;
-  memset(td, 0xfe, sizeof(thread_data_t));
-  td->inside_hpcrun = 1;
-  td->memstore = memstore;
-  hpcrun_make_memstore(&td->memstore, is_child);
-  td->mem_low = 0;
-
-  // ----------------------------------------
-  // normalized thread id (monitor-generated)
-  // ----------------------------------------
-  core_profile_trace_data_init(&(td->core_profile_trace_data), id, thr_ctxt);
-
   td->idle = 0; // begin at work
 
   // ----------------------------------------
   // sample sources
   // ----------------------------------------
 
-
-  // allocate ss_state, ss_info
-
-  td->ss_state = hpcrun_malloc(n_sources * sizeof(source_state_t));
-  td->ss_info  = hpcrun_malloc(n_sources * sizeof(source_info_t));
-
   // initialize ss_state,info
 
   memset(td->ss_state, UNINIT, n_sources * sizeof(source_state_t));
@@ -311,25 +291,24 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
   // backtrace buffer
   // ----------------------------------------
   td->btbuf_cur = NULL;
-  td->btbuf_beg = hpcrun_malloc(sizeof(frame_t) * BACKTRACE_INIT_SZ);
-  td->btbuf_end = td->btbuf_beg + BACKTRACE_INIT_SZ;
   td->btbuf_sav = td->btbuf_end;  // FIXME: is this needed?
 
-  hpcrun_bt_init(&(td->bt), NEW_BACKTRACE_INIT_SZ);
-
   // ----------------------------------------
   // trampoline
   // ----------------------------------------
   td->tramp_present     = false;
   td->tramp_retn_addr   = NULL;
   td->tramp_loc         = NULL;
-  td->cached_bt         = hpcrun_malloc(sizeof(frame_t)
-					* CACHED_BACKTRACE_SIZE);
   td->cached_bt_end     = td->cached_bt;          
-  td->cached_bt_buf_end = td->cached_bt + CACHED_BACKTRACE_SIZE;
   td->tramp_frame       = NULL;
   td->tramp_cct_node    = NULL;
 
+  // ----------------------------------------
+  // prefix reuse
+  // ----------------------------------------
+  td->bt_prefix.len     = 0;
+  td->bt_prefix.epoch   = NULL;
+
   // ----------------------------------------
   // exception stuff
   // ----------------------------------------
@@ -363,6 +342,83 @@ hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sou
 }
 
 
+void
+hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sources)
+{
+  hpcrun_meminfo_t memstore;
+  thread_data_t* td = hpcrun_get_thread_data();
+
+  // ----------------------------------------
+  // memstore for hpcrun_malloc()
+  // ----------------------------------------
+
+  // Wipe the thread data with a bogus bit pattern, but save the
+  // memstore so we can reuse it in the child after fork.  This must
+  // come first.
+  td->inside_hpcrun = 1;
+  memstore = td->memstore;
+  memset(td, 0xfe, sizeof(thread_data_t));
+  td->inside_hpcrun = 1;
+  td->memstore = memstore;
+  hpcrun_make_memstore(&td->memstore, is_child);
+  td->mem_low = 0;
+  td->epoch_gen = 0;
+
+  // ----------------------------------------
+  // normalized thread id (monitor-generated)
+  // ----------------------------------------
+  core_profile_trace_data_init(&(td->core_profile_trace_data), id, thr_ctxt);
+
+  // ----------------------------------------
+  // sample sources
+  // ----------------------------------------
+
+  // allocate ss_state, ss_info
+
+  td->ss_state = hpcrun_malloc(n_sources * sizeof(source_state_t));
+  td->ss_info  = hpcrun_malloc(n_sources * sizeof(source_info_t));
+
+  // ----------------------------------------
+  // backtrace buffer
+  // ----------------------------------------
+  td->btbuf_beg = hpcrun_malloc(sizeof(frame_t) * BACKTRACE_INIT_SZ);
+  td->btbuf_end = td->btbuf_beg + BACKTRACE_INIT_SZ;
+
+  hpcrun_bt_init(&(td->bt), NEW_BACKTRACE_INIT_SZ);
+
+  // ----------------------------------------
+  // trampoline
+  // ----------------------------------------
+  td->cached_bt         = hpcrun_malloc(sizeof(frame_t)
+					* CACHED_BACKTRACE_SIZE);
+  td->cached_bt_buf_end = td->cached_bt + CACHED_BACKTRACE_SIZE;
+
+  // ----------------------------------------
+  // prefix reuse (allocated on first use)
+  // ----------------------------------------
+  memset(&(td->bt_prefix), 0, sizeof(td->bt_prefix));
+
+  thread_data_reset(td, id, n_sources);
+}
+
+
+//
+// prepare the thread data of a finished thread for use by a new
+// thread. the memstore, the buffers and the profile (epoch, cct,
+// metrics, output files) are kept, so the new thread accumulates
+// into the same cct as its predecessor(s).
+//
+void
+hpcrun_thread_data_reuse_init(int id, size_t n_sources)
+{
+  thread_data_t* td = hpcrun_get_thread_data();
+
+  td->inside_hpcrun = 1;
+  td->mem_low = 0;
+  thread_data_reset(td, id, n_sources);
+}
+
+
 //***************************************************************************
 // 
 //***************************************************************************
@@ -57,6 +57,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <time.h>
+#include <sys/types.h>
 
 #include "sample_sources_registered.h"
 #include "newmem.h"
@@ -143,6 +144,7 @@ typedef struct thread_data_t {
   // ----------------------------------------
   hpcrun_meminfo_t memstore;
   int              mem_low;
+  uint64_t         epoch_gen; // bumped when the epochs are flushed
 
   // ----------------------------------------
   // sample sources
@@ -206,6 +208,11 @@ typedef struct thread_data_t {
   frame_t* tramp_frame;       // (cached) frame assoc. w/ cur. trampoline loc.
   cct_node_t* tramp_cct_node; // cct node associated with the trampoline
 
+  // ----------------------------------------
+  // prefix reuse (see hpcrun_set_unwind_reuse_mode)
+  // ----------------------------------------
+  bt_prefix_t bt_prefix;      // call chain of the last backtrace
+
   // ----------------------------------------
   // exception stuff
   // ----------------------------------------
@@ -239,6 +246,12 @@ typedef struct thread_data_t {
   // sample or else deadlock on the dlopen lock.
   bool inside_dlfcn;
 
+  // ----------------------------------------
+  // thread data reuse (see threadmgr.c)
+  // ----------------------------------------
+  struct thread_data_t* retired_next; // next retired thread data in pool
+  pid_t retired_tid;                  // OS thread that last used this data
+
 #ifdef ENABLE_CUDA
   gpu_data_t gpu_data;
 #endif
@@ -269,6 +282,9 @@ extern thread_data_t* hpcrun_allocate_thread_data(int id);
 void
 hpcrun_thread_data_init(int id, cct_ctxt_t* thr_ctxt, int is_child, size_t n_sources);
 
+void
+hpcrun_thread_data_reuse_init(int id, size_t n_sources);
+
 
 void     hpcrun_cached_bt_adjust_size(size_t n);
 frame_t* hpcrun_expand_btbuf(void);
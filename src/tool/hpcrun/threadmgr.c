@@ -47,6 +47,22 @@
 //******************************************************************************
 // File: threadmgr.c: 
 // Purpose: maintain information about the number of live threads
+//
+// When HPCRUN_MERGE_THREADS is set, the profiles of finished threads are
+// not written when the thread exits. Instead, they are retained until
+// process exit, where the profiles of all threads that share the same
+// creation context are merged into one CCT (using hpcrun_cct_merge) and
+// written as a single profile. For thread pools with many identical
+// workers this reduces the number of profiles by orders of magnitude.
+//
+// When HPCRUN_REUSE_THREADS is set, the thread data of a finished thread
+// (memstore, buffers, epoch/cct and output files) is retired to a pool
+// instead of being written. A new thread with the same creation context
+// takes it over and keeps accumulating into the same cct, so programs
+// that create many short-lived threads pay neither for a new memstore
+// nor for a new profile and trace per thread. With
+// HPCRUN_REUSE_THREADS=mark, the end of each OS thread is marked in the
+// trace and the OS thread ids are recorded in the log.
 //******************************************************************************
 
 
@@ -55,6 +71,12 @@
 // system include files 
 //******************************************************************************
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
 
 
 
@@ -62,14 +84,84 @@
 // local include files 
 //******************************************************************************
 #include "threadmgr.h"
+#include "env.h"
+#include "trace.h"
+#include "write_data.h"
+
+#include "cct2metrics.h"
+
+#include <cct/cct.h>
+#include <cct/cct_bundle.h>
+#include <cct/cct_ctxt.h>
+#include <memory/hpcrun-malloc.h>
+#include <messages/messages.h>
+
+#include <utilities/ip-normalized.h>
+
+#include <lib/prof-lean/placeholders.h>
+#include <lib/prof-lean/spinlock.h>
 #include <lib/prof-lean/stdatomic.h>
 
 
+
+//******************************************************************************
+// type declarations
+//******************************************************************************
+
+// a finished thread whose profile awaits merging
+typedef struct deferred_profile_s {
+	struct deferred_profile_s *next;
+	core_profile_trace_data_t *cptd;
+} deferred_profile_t;
+
+// threads with the same creation context: the profiles of all
+// members are merged into the profile of the first member
+typedef struct profile_group_s {
+	struct profile_group_s *next;
+	core_profile_trace_data_t *cptd;
+	int num_threads;
+} profile_group_t;
+
+// the metric maps of the profiles being merged
+typedef struct {
+	cct2metrics_t **dst_map;
+	cct2metrics_t **src_map;
+} merge_maps_t;
+
+
+
 //******************************************************************************
 // private data
 //******************************************************************************
 static atomic_int_least32_t threadmgr_active_threads = ATOMIC_VAR_INIT(1); // one for the process main thread
 
+static bool merge_threads = false;
+
+// deferred_profiles and deferral_closed are protected by deferral_lock
+static spinlock_t deferral_lock = SPINLOCK_UNLOCKED;
+static deferred_profile_t *deferred_profiles = NULL;
+static bool deferral_closed = false;
+
+static bool reuse_threads = false;
+static bool mark_reuse = false;
+
+// retired_data and retirement_closed are protected by retirement_lock
+static spinlock_t retirement_lock = SPINLOCK_UNLOCKED;
+static thread_data_t *retired_data = NULL;
+static bool retirement_closed = false;
+
+
+
+//******************************************************************************
+// placeholders
+//******************************************************************************
+
+// marks the end of an OS thread in the trace of reused thread data
+void
+THREAD_RETIRED(void)
+{
+}
+
 
 
 //******************************************************************************
@@ -84,10 +176,165 @@ adjust_thread_count(int32_t val)
 
 
 
+//
+// two creation contexts are the same if they represent the same
+// sequence of call paths, even if they were recorded by different
+// threads (ie, are different cct nodes)
+//
+static bool
+same_creation_context(cct_ctxt_t *a, cct_ctxt_t *b)
+{
+	for (; a && b; a = a->parent, b = b->parent) {
+		cct_node_t *x = a->context;
+		cct_node_t *y = b->context;
+		if (x == y) continue;
+
+		for (; x && y; x = hpcrun_cct_parent(x), y = hpcrun_cct_parent(y)) {
+			if (! cct_addr_eq(hpcrun_cct_addr(x), hpcrun_cct_addr(y))) {
+				return false;
+			}
+		}
+		if (x || y) return false;
+	}
+	return a == b;
+}
+
+
+static cct_ctxt_t *
+creation_context(core_profile_trace_data_t *cptd)
+{
+	return cptd->epoch ? cptd->epoch->csdata_ctxt : NULL;
+}
+
+
+// merge operation for common nodes: combine the metrics
+static void
+merge_node_metrics(cct_node_t *a, cct_node_t *b, merge_op_arg_t arg)
+{
+	merge_maps_t *maps = (merge_maps_t *) arg;
+	hpcrun_cct2metrics_accumulate(maps->dst_map, a, maps->src_map, b);
+}
+
+
+// nodes of a subtree moved over from the source cct still have their
+// metrics in the source map: make the destination map refer to them.
+// the moved nodes are new to the destination map, so only the source
+// map needs a lookup.
+static void
+adopt_node_metrics(cct_node_t *node, cct_op_arg_t arg, size_t level)
+{
+	merge_maps_t *maps = (merge_maps_t *) arg;
+	metric_set_t *set = hpcrun_get_metric_set_specific(maps->src_map, node);
+	if (set) {
+		cct2metrics_assoc_specific(maps->dst_map, node, set);
+	}
+}
+
+
+// join operation for the root of each subtree moved by the merge
+static void
+adopt_subtree_metrics(cct_node_t *node, cct_op_arg_t arg, size_t level)
+{
+	hpcrun_cct_walk_node_1st(node, adopt_node_metrics, arg);
+}
+
+
+//
+// merge all epochs of profile 'src' into the current epoch of 'dst'.
+// the loadmap is shared by all threads, so the ccts of different
+// epochs use the same load module ids.
+//
+static void
+merge_profile(core_profile_trace_data_t *dst, core_profile_trace_data_t *src)
+{
+	cct_bundle_t *dst_cct = &(dst->epoch->csdata);
+	merge_maps_t maps = {
+		.dst_map = &(dst->cct2metrics_map),
+		.src_map = &(src->cct2metrics_map),
+	};
+
+	for (epoch_t *e = src->epoch; e; e = e->next) {
+		hpcrun_cct_bundle_merge(dst_cct, &(e->csdata), merge_node_metrics,
+					adopt_subtree_metrics, &maps);
+	}
+}
+
+
+
+static pid_t
+os_thread_id(void)
+{
+	return (pid_t) syscall(SYS_gettid);
+}
+
+
+// true if OS thread 'tid' of this process has terminated
+static bool
+os_thread_is_gone(pid_t tid)
+{
+	return syscall(SYS_tgkill, getpid(), tid, 0) != 0;
+}
+
+
+//
+// append the THREAD_RETIRED placeholder to the trace of 'td', so that the
+// time between the end of this OS thread and the start of the next one
+// is not attributed to the last sample.
+//
+static void
+mark_retirement(thread_data_t *td)
+{
+	core_profile_trace_data_t *cptd = &(td->core_profile_trace_data);
+
+	AMSG("THREAD: OS thread %d retires the data of thread %d",
+	     (int) os_thread_id(), cptd->id);
+
+	if (! hpcrun_trace_isactive()) return;
+
+	ip_normalized_t ip =
+		hpcrun_normalize_ip(canonicalize_placeholder(THREAD_RETIRED), NULL);
+	cct_addr_t addr = NON_LUSH_ADDR_INI(ip.lm_id, ip.lm_ip);
+
+	cct_node_t *node =
+		hpcrun_cct_insert_addr(cptd->epoch->csdata.partial_unw_root, &addr);
+	hpcrun_cct_terminate_path(node);
+	hpcrun_cct_retain(node);
+	hpcrun_trace_append(cptd, hpcrun_cct_persistent_id(node),
+			    HPCRUN_FMT_MetricId_NULL);
+}
+
+
+
 //******************************************************************************
 // interface operations
 //******************************************************************************
 
+void
+hpcrun_threadmgr_init(void)
+{
+	merge_threads = (getenv(HPCRUN_MERGE_THREADS) != NULL);
+
+	char *reuse = getenv(HPCRUN_REUSE_THREADS);
+	reuse_threads = (reuse != NULL);
+	mark_reuse = reuse_threads && (strcmp(reuse, "mark") == 0);
+
+	spinlock_init(&retirement_lock);
+	retired_data = NULL;
+	retirement_closed = false;
+
+	// a trace refers to the cct node ids of its own thread, which do not
+	// survive merging.
+	if (merge_threads && hpcrun_trace_isactive()) {
+		EMSG("Thread profiles are not merged when tracing is enabled");
+		merge_threads = false;
+	}
+
+	spinlock_init(&deferral_lock);
+	deferred_profiles = NULL;
+	deferral_closed = false;
+}
+
+
 void
 hpcrun_threadmgr_thread_new()
 {
@@ -107,3 +354,149 @@ hpcrun_threadmgr_thread_count()
 {
 	return atomic_load_explicit(&threadmgr_active_threads, memory_order_relaxed);
 }
+
+
+bool
+hpcrun_threadmgr_profile_defer(core_profile_trace_data_t *cptd)
+{
+	if (! merge_threads || ! creation_context(cptd)) return false;
+
+	deferred_profile_t *dp = hpcrun_malloc(sizeof(deferred_profile_t));
+	dp->cptd = cptd;
+
+	bool deferred = false;
+	spinlock_lock(&deferral_lock);
+	if (! deferral_closed) {
+		dp->next = deferred_profiles;
+		deferred_profiles = dp;
+		deferred = true;
+	}
+	spinlock_unlock(&deferral_lock);
+
+	TMSG(THREAD, "thread %d profile %s", cptd->id,
+	     deferred ? "deferred for merging" : "written: process is exiting");
+	return deferred;
+}
+
+
+thread_data_t *
+hpcrun_threadmgr_data_get(cct_ctxt_t *thr_ctxt)
+{
+	if (! reuse_threads || ! thr_ctxt) return NULL;
+
+	thread_data_t *td = NULL;
+
+	spinlock_lock(&retirement_lock);
+	for (thread_data_t **p = &retired_data; *p; p = &((*p)->retired_next)) {
+		thread_data_t *x = *p;
+
+		// the retiring thread may still run (outside of hpcrun) for a
+		// while after it has handed over its data
+		if (same_creation_context(creation_context(&(x->core_profile_trace_data)),
+					  thr_ctxt)
+		    && os_thread_is_gone(x->retired_tid)) {
+			*p = x->retired_next;
+			td = x;
+			break;
+		}
+	}
+	spinlock_unlock(&retirement_lock);
+
+	if (td) {
+		TMSG(THREAD, "reusing the data of thread %d",
+		     td->core_profile_trace_data.id);
+	}
+	return td;
+}
+
+
+bool
+hpcrun_threadmgr_data_put(thread_data_t *td)
+{
+	if (! reuse_threads || ! creation_context(&(td->core_profile_trace_data))) {
+		return false;
+	}
+
+	if (mark_reuse) mark_retirement(td);
+
+	td->retired_tid = os_thread_id();
+
+	bool retired = false;
+	spinlock_lock(&retirement_lock);
+	if (! retirement_closed) {
+		td->retired_next = retired_data;
+		retired_data = td;
+		retired = true;
+	}
+	spinlock_unlock(&retirement_lock);
+
+	return retired;
+}
+
+
+void
+hpcrun_threadmgr_profile_fini(void)
+{
+	// the retired thread data still hold unwritten profiles. threads
+	// that finish from now on write their own profile.
+	spinlock_lock(&retirement_lock);
+	retirement_closed = true;
+	thread_data_t *retired = retired_data;
+	retired_data = NULL;
+	spinlock_unlock(&retirement_lock);
+
+	for (thread_data_t *td = retired; td; td = td->retired_next) {
+		core_profile_trace_data_t *cptd = &(td->core_profile_trace_data);
+		if (! hpcrun_threadmgr_profile_defer(cptd)) {
+			hpcrun_write_profile_data(cptd);
+			hpcrun_trace_close(cptd);
+		}
+	}
+
+	if (! merge_threads) return;
+
+	// threads that finish from now on write their own profile
+	spinlock_lock(&deferral_lock);
+	deferral_closed = true;
+	deferred_profile_t *list = deferred_profiles;
+	deferred_profiles = NULL;
+	spinlock_unlock(&deferral_lock);
+
+	profile_group_t *groups = NULL;
+
+	for (deferred_profile_t *dp = list; dp; dp = dp->next) {
+		core_profile_trace_data_t *cptd = dp->cptd;
+
+		profile_group_t *g;
+		for (g = groups; g; g = g->next) {
+			if (same_creation_context(creation_context(g->cptd),
+						  creation_context(cptd))) break;
+		}
+
+		if (g) {
+			// name the merged profile after the lowest thread id
+			if (cptd->id < g->cptd->id) {
+				core_profile_trace_data_t *tmp = g->cptd;
+				g->cptd = cptd;
+				cptd = tmp;
+			}
+			TMSG(THREAD, "merging profile of thread %d into thread %d",
+			     cptd->id, g->cptd->id);
+			merge_profile(g->cptd, cptd);
+			g->num_threads++;
+		}
+		else {
+			g = hpcrun_malloc(sizeof(profile_group_t));
+			g->cptd = cptd;
+			g->num_threads = 1;
+			g->next = groups;
+			groups = g;
+		}
+	}
+
+	for (profile_group_t *g = groups; g; g = g->next) {
+		TMSG(THREAD, "writing merged profile of %d threads as thread %d",
+		     g->num_threads, g->cptd->id);
+		hpcrun_write_merged_profile_data(g->cptd, g->num_threads);
+	}
+}
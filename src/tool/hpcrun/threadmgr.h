@@ -49,20 +49,57 @@
 //
 // Purpose: 
 //   interface definitions for threadmgr, which maintains information 
-//   about the number of live threads
+//   about the number of live threads, and (optionally) merges the
+//   profiles of threads that share a creation context
 //******************************************************************************
 
 #ifndef _threadmgr_h_
 #define _threadmgr_h_
 
+//******************************************************************************
+// local include files 
+//******************************************************************************
+
+#include <stdbool.h>
+
+#include "core_profile_trace_data.h"
+#include "thread_data.h"
+
+#include <cct/cct_ctxt.h>
+
+
+
 //******************************************************************************
 // interface operations
 //******************************************************************************
 
+void hpcrun_threadmgr_init(void);
+
 void hpcrun_threadmgr_thread_new();
 
 void hpcrun_threadmgr_thread_delete();
 
 int hpcrun_threadmgr_thread_count();
 
+// hand over the profile of a finishing thread. returns true if the
+// profile has been retained to be merged with the profiles of other
+// threads that have the same creation context; the caller must then
+// not write it.
+bool hpcrun_threadmgr_profile_defer(core_profile_trace_data_t* cptd);
+
+// take over the thread data of a finished thread with the same creation
+// context, if thread data reuse is enabled and such data is available.
+// returns NULL otherwise.
+thread_data_t *hpcrun_threadmgr_data_get(cct_ctxt_t *thr_ctxt);
+
+// retire the thread data of a finishing thread for reuse by a later
+// thread. returns true if the data was retired; the caller must then
+// neither write its profile nor use it any more.
+bool hpcrun_threadmgr_data_put(thread_data_t *td);
+
+// write the profiles of retired thread data, merge the retained thread
+// profiles and write one profile for each group of threads with the
+// same creation context.
+void hpcrun_threadmgr_profile_fini(void);
+
 #endif
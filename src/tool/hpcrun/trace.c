@@ -77,6 +77,7 @@
 #include <lib/prof-lean/hpcrun-fmt.h>
 #include <lib/prof-lean/hpcio.h>
 #include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/hpcio-z.h>
 
 
 //*********************************************************************
@@ -129,6 +130,13 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
   }
 
   TMSG(TRACE, "Trace open called");
+
+  // thread data reused by a new thread keeps its open trace
+  if (cptd->trace_buffer) {
+    TMSG(TRACE, "Trace already open");
+    return;
+  }
+
   // With fractional sampling, if this process is inactive, then don't
   // open an output file, not even /dev/null.
   if (tracing && hpcrun_sample_prob_active()) {
@@ -146,6 +154,16 @@ hpcrun_trace_open(core_profile_trace_data_t * cptd)
 			      HPCRUN_TraceBufferSz, HPCIO_OUTBUF_UNLOCKED);
     hpcrun_trace_file_validate(ret == HPCFMT_OK, "open");
 
+    // chunks are compressed independently, so hpcserver can still
+    // seek within a compressed trace
+    int level = hpcrun_files_compress_level();
+    if (level >= 0) {
+      size_t worksz = hpcio_z_enc_worksz(level);
+      void* work = hpcrun_malloc(worksz);
+      ret = hpcio_outbuf_compress(&cptd->trace_outbuf, work, worksz, level);
+      hpcrun_trace_file_validate(ret == HPCFMT_OK, "compress");
+    }
+
     hpctrace_hdr_flags_t flags = hpctrace_hdr_flags_NULL;
 #ifdef DATACENTRIC_TRACE
     flags.fields.isDataCentric = true;
@@ -70,11 +70,15 @@
 
 #include <trampoline/common/trampoline.h>
 #include <dbg_backtrace.h>
+#include <cct_backtrace_finalize.h>
+#include <memory/hpcrun-malloc.h>
 
 //***************************************************************************
 // local constants & macros
 //***************************************************************************
 
+#define BT_PREFIX_INIT_SZ 64
+
 //***************************************************************************
 // forward declarations 
 //***************************************************************************
@@ -82,6 +86,16 @@
 static void lush_assoc_info2str(char* buf, size_t len, lush_assoc_info_t info);
 static void lush_lip2str(char* buf, size_t len, lush_lip_t* lip);
 
+static bt_prefix_t* bt_prefix_get(thread_data_t* td, int skipInner);
+static bool bt_prefix_match(bt_prefix_t* prefix, hpcrun_unw_cursor_t* cursor,
+			    size_t* k, size_t* k_min);
+
+//***************************************************************************
+// local variables
+//***************************************************************************
+
+static bool unwind_reuse = false;
+
 //***************************************************************************
 // interface functions
 //***************************************************************************
@@ -185,6 +199,7 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   bt->fence = FENCE_BAD;
   bt->bottom_frame_elided = false;
   bt->partial_unwind = true;
+  bt->prefix = NULL;
 
   step_state ret = STEP_ERROR; // default return value from stepper
 
@@ -199,6 +214,9 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
   td->btbuf_cur   = td->btbuf_beg; // innermost
   td->btbuf_sav   = td->btbuf_end;
 
+  bt_prefix_t* prefix = bt_prefix_get(td, skipInner);
+  size_t prefix_k = 0, prefix_k_min = 0;
+
   hpcrun_unw_cursor_t cursor;
   hpcrun_unw_init_cursor(&cursor, context);
 
@@ -246,6 +264,15 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
 
     frame_t* prev = td->btbuf_cur++;
 
+    if (prefix && bt_prefix_match(prefix, &cursor, &prefix_k, &prefix_k_min)) {
+      // the outer frames are those of the previous backtrace
+      prefix->match = prefix_k;
+      bt->prefix = prefix->frames[prefix_k].parent;
+      bt->fence = prefix->fence;
+      ret = STEP_STOP;
+      break;
+    }
+
     ret = hpcrun_unw_step(&cursor);
     switch (ret) {
     case STEP_TROLL:
@@ -264,7 +291,12 @@ hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
     }
   } while (ret != STEP_ERROR && ret != STEP_STOP);
 
-  TMSG(FENCE, "backtrace generation detects fence = %s", fence_enum_name(bt->fence));
+  if (bt->prefix == NULL) {
+    TMSG(FENCE, "backtrace generation detects fence = %s", fence_enum_name(bt->fence));
+  }
+  else {
+    TMSG(BT, "backtrace joins the previous one at frame %d", (int) prefix->match);
+  }
 
   frame_t* bt_beg  = td->btbuf_beg;      // innermost, inclusive
   frame_t* bt_last = td->btbuf_cur - 1; // outermost, inclusive
@@ -375,10 +407,172 @@ hpcrun_generate_backtrace(backtrace_info_t* bt,
 }
 
 
+//
+// Prefix reuse: instead of unwinding to the outermost frame, stop at a
+// frame of the previous backtrace of the thread whose callers are
+// unchanged, and insert the new frames below the cct node of its caller.
+// No return address is modified (unlike the trampoline).
+//
+void
+hpcrun_set_unwind_reuse_mode(bool mode)
+{
+  TMSG(BT, "unwind reuse set to %s", mode ? "true" : "false");
+  unwind_reuse = mode;
+}
+
+
+//
+// Space for the parents of the frames of 'bt', filled in by the insertion
+// into the cct. NULL if the frames are not going to be remembered.
+//
+struct cct_node_t**
+hpcrun_bt_prefix_parents(backtrace_info_t* bt)
+{
+  if (! unwind_reuse || bt->partial_unwind || bt->has_tramp) return NULL;
+
+  bt_prefix_t* prefix = &(TD_GET(bt_prefix));
+  size_t n = bt->last - bt->begin + 1;
+
+  if (prefix->parents_size < n) {
+    size_t size = (n > 2 * prefix->parents_size) ? n : 2 * prefix->parents_size;
+    struct cct_node_t** parents = hpcrun_malloc(size * sizeof(*parents));
+    if (parents == NULL) return NULL;
+    prefix->parents = parents;
+    prefix->parents_size = size;
+  }
+  return prefix->parents;
+}
+
+
+//
+// Remember the frames of 'bt' after its insertion into the cct: the new
+// frames, then (if the unwind joined the previous backtrace) the outer
+// frames of the previous backtrace.
+//
+void
+hpcrun_bt_prefix_update(backtrace_info_t* bt)
+{
+  thread_data_t* td = hpcrun_get_thread_data();
+  bt_prefix_t* prefix = &(td->bt_prefix);
+
+  size_t n_new = bt->last - bt->begin + 1;
+  size_t n_old = 0;
+  void* last_ra_loc = bt->last->ra_loc;
+
+  if (bt->prefix != NULL) {
+    // bt->last is the frame prefix->match of the previous backtrace
+    last_ra_loc = prefix->frames[prefix->match].ra_loc;
+    n_old = prefix->len - prefix->match - 1;
+  }
+  else if (bt->fence != FENCE_MAIN && bt->fence != FENCE_THREAD) {
+    prefix->len = 0;
+    return;
+  }
+
+  size_t len = n_new + n_old;
+  if (prefix->size < len) {
+    size_t size = (len > 2 * prefix->size) ? len : 2 * prefix->size;
+    if (size < BT_PREFIX_INIT_SZ) size = BT_PREFIX_INIT_SZ;
+    bt_prefix_frame_t* frames = hpcrun_malloc(size * sizeof(bt_prefix_frame_t));
+    if (frames == NULL) {
+      prefix->len = 0;
+      return;
+    }
+    if (n_old > 0) {
+      memcpy(frames + n_new, prefix->frames + prefix->match + 1,
+	     n_old * sizeof(bt_prefix_frame_t));
+    }
+    prefix->frames = frames;
+    prefix->size = size;
+  }
+  else if (n_old > 0) {
+    memmove(prefix->frames + n_new, prefix->frames + prefix->match + 1,
+	    n_old * sizeof(bt_prefix_frame_t));
+  }
+
+  for (size_t i = 0; i < n_new; i++) {
+    frame_t* f = bt->begin + i;
+    prefix->frames[i] = (bt_prefix_frame_t) {
+      .sp = (void*) f->cursor.sp,
+      .pc = f->cursor.pc_unnorm,
+      .ra_loc = f->ra_loc,
+      .the_function = f->the_function,
+      .parent = prefix->parents[i]
+    };
+  }
+  prefix->frames[n_new - 1].ra_loc = last_ra_loc;
+
+  prefix->len = len;
+  prefix->fence = bt->fence;
+  prefix->epoch = td->core_profile_trace_data.epoch;
+}
+
+
 //***************************************************************************
 // private operations 
 //***************************************************************************
 
+static bt_prefix_t*
+bt_prefix_get(thread_data_t* td, int skipInner)
+{
+  // skipped inner frames, return counting, and backtrace finalizers (OMPT)
+  // all need the complete backtrace
+  if (! unwind_reuse || skipInner || ENABLED(USE_TRAMP)
+      || cct_backtrace_finalize_registered()) {
+    return NULL;
+  }
+
+  bt_prefix_t* prefix = &(td->bt_prefix);
+
+  // the parents belong to the cct of the current epoch only
+  if (prefix->len == 0 || prefix->epoch != td->core_profile_trace_data.epoch) {
+    return NULL;
+  }
+  return prefix;
+}
+
+
+//
+// Is the frame at 'cursor' the frame *k of the previous backtrace, with
+// the same callers? The frames of the unwind come in increasing sp order,
+// so the search resumes at *k. The callers are the same if the return
+// addresses on the stack are: if one was overwritten at frame m, no frame
+// at or inside m can match, hence *k_min.
+//
+static bool
+bt_prefix_match(bt_prefix_t* prefix, hpcrun_unw_cursor_t* cursor,
+		size_t* k, size_t* k_min)
+{
+  bt_prefix_frame_t* frames = prefix->frames;
+  size_t n = prefix->len;
+  void* sp = (void*) cursor->sp;
+
+  while (*k < n && frames[*k].sp < sp) (*k)++;
+
+  size_t i = *k;
+  if (i == n || i < *k_min
+      || frames[i].sp != sp || frames[i].pc != cursor->pc_unnorm) {
+    return false;
+  }
+
+  // a frame folded into its caller by recursion compression
+  // has no parent of its own
+  if (i + 1 < n
+      && ip_normalized_eq(&(frames[i].the_function), &(frames[i + 1].the_function))) {
+    return false;
+  }
+
+  for (size_t m = n - 1; m-- > i; ) {
+    void** ra_loc = (void**) frames[m].ra_loc;
+    if (ra_loc == NULL || *ra_loc != frames[m + 1].pc) {
+      *k_min = m + 1;
+      return false;
+    }
+  }
+  return true;
+}
+
+
 static void
 lush_assoc_info2str(char* buf, size_t len, lush_assoc_info_t info)
 {
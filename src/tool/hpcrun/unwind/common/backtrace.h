@@ -92,6 +92,32 @@ typedef struct bt_iter_t {
   backtrace_t* bt;
 } bt_iter_t;
 
+//
+// prefix reuse: the call chain of the previous backtrace of a thread,
+// and the cct nodes its frames were inserted below. an unwind that
+// reaches a frame of this chain (same sp and pc, same return addresses
+// further out) stops there.
+//
+
+typedef struct bt_prefix_frame_t {
+  void* sp;
+  void* pc;                         // unnormalized
+  void* ra_loc;                     // location of the return address into the caller
+  ip_normalized_t the_function;
+  struct cct_node_t* parent;        // node the frame was inserted below
+} bt_prefix_frame_t;
+
+typedef struct bt_prefix_t {
+  bt_prefix_frame_t* frames;        // innermost first
+  size_t len;
+  size_t size;
+  size_t match;                     // frame where the current unwind stopped
+  fence_enum_t fence;
+  void* epoch;                      // epoch of the cct the parents belong to
+  struct cct_node_t** parents;      // parents of the frames of a new backtrace
+  size_t parents_size;
+} bt_prefix_t;
+
 //***************************************************************************
 // interface functions
 //***************************************************************************
@@ -117,4 +143,10 @@ bool hpcrun_generate_backtrace(backtrace_info_t* bt,
 bool hpcrun_generate_backtrace_no_trampoline(backtrace_info_t* bt,
 					     ucontext_t* context, int skipInner);
 
+void hpcrun_set_unwind_reuse_mode(bool mode);
+
+struct cct_node_t** hpcrun_bt_prefix_parents(backtrace_info_t* bt);
+
+void hpcrun_bt_prefix_update(backtrace_info_t* bt);
+
 #endif // hpcrun_backtrace_h
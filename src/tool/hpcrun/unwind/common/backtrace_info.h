@@ -24,6 +24,8 @@ typedef struct {
   bool     bottom_frame_elided:1; // true if bottom frame has been elided 
   bool     partial_unwind:1; // true if not a full unwind
   void    *trace_pc;  // in/out value: modified to adjust trace when modifying backtrace
+  struct cct_node_t *prefix; // if not NULL, the unwind stopped at a frame of the
+                             // previous backtrace: insert below this node
 } backtrace_info_t;
 
 #endif // BACKTRACE_INFO_H
@@ -84,6 +84,20 @@ void bitree_uwi_free(unwinder_t uw, bitree_uwi_t *tree)
   mcs_unlock(&GF[uw].lock, &me);
 }
 
+/*
+ * release every node of tree with m_free, without modifying the tree,
+ * so that concurrent lookups in it stay valid until m_free reuses the
+ * nodes.
+ */
+void
+bitree_uwi_retire(bitree_uwi_t *tree, mem_free m_free)
+{
+  if (!tree) return;
+  bitree_uwi_retire(bitree_uwi_leftsubtree(tree), m_free);
+  bitree_uwi_retire(bitree_uwi_rightsubtree(tree), m_free);
+  m_free(tree);
+}
+
 // return the value at the root
 // pre-condition: tree != NULL
 uwi_t*
@@ -92,6 +92,12 @@ bitree_uwi_malloc(unwinder_t uw, size_t recipe_size);
  */
 void bitree_uwi_free(unwinder_t uw, bitree_uwi_t *tree);
 
+/*
+ * Release all nodes of tree with m_free (eg, a deferred free), leaving
+ * the tree intact for lookups that may still be in progress.
+ */
+void bitree_uwi_retire(bitree_uwi_t *tree, mem_free m_free);
+
 
 // return the value at the root
 // pre-condition: tree != NULL
@@ -54,6 +54,12 @@
  * 
  * Valid return address is determined by using the enclosing_function_bounds
  * routine.
+ *
+ * Most stack words are not even in the text of a load module (data, stack
+ * addresses, small integers). To avoid an expensive validation for each
+ * of them, the words are first checked in batches against a compact table
+ * of the address ranges of the load modules, which the compiler turns into
+ * vector compares; only the candidates are validated.
  * 
  * NOTE: This is a secondary heuristic: when the normal binary analysis interval
  * builder does not yield a useful interval, the unwinder can use this stack trolling
@@ -61,7 +67,9 @@
  */
 
 #include <stdlib.h>
+#include <stdbool.h>
 #include <inttypes.h>
+#include <string.h>
 
 #include <include/uint.h>
 
@@ -69,57 +77,231 @@
 #include "fnbounds_interface.h"
 #include "validate_return_addr.h"
 
+#include <hpcrun/loadmap.h>
+#include <memory/hpcrun-malloc.h>
 #include <messages/messages.h>
+#include <lib/prof-lean/stdatomic.h>
+
+// with the text range pre-filter, trolling further is cheap
+static const int TROLL_LIMIT = 64;
+
+#define TROLL_BATCH 8
+
+// up to this many ranges, a batch is compared against all of them
+// (branch free); beyond, each word is looked up by binary search
+#define TEXT_RANGES_SCAN_MAX 64
+
+
+//***************************************************************************
+// text ranges of the load modules
+//***************************************************************************
+
+// immutable once published
+typedef struct text_ranges_t {
+  size_t n;
+  uintptr_t *start;    // sorted
+  uintptr_t *len;
+  uintptr_t data[];
+} text_ranges_t;
+
+// readers are inside a sample (hpcrun_freeable_enter/exit); writers are
+// serialized by the loadmap updates that notify them
+static atomic_uintptr_t text_ranges = ATOMIC_VAR_INIT(0);
+
+
+static text_ranges_t *
+text_ranges_new(size_t n)
+{
+  text_ranges_t *t =
+    hpcrun_malloc_freeable(sizeof(text_ranges_t) + 2 * n * sizeof(uintptr_t));
+  if (t == NULL) return NULL;
+
+  t->n = n;
+  t->start = t->data;
+  t->len = t->data + n;
+  return t;
+}
+
+
+static void
+text_ranges_publish(text_ranges_t *t)
+{
+  uintptr_t old = atomic_exchange_explicit(&text_ranges, (uintptr_t) t,
+					   memory_order_acq_rel);
+  if (old) hpcrun_free_deferred((void *) old);
+}
+
+
+static void
+text_ranges_map(void *start, void *end)
+{
+  text_ranges_t *old = (text_ranges_t *) atomic_load(&text_ranges);
+  size_t n = old ? old->n : 0;
+
+  text_ranges_t *t = text_ranges_new(n + 1);
+  if (t == NULL) return;
+
+  size_t i = 0, j = 0;
+  for (; i < n && old->start[i] < (uintptr_t) start; i++, j++) {
+    t->start[j] = old->start[i];
+    t->len[j] = old->len[i];
+  }
+  t->start[j] = (uintptr_t) start;
+  t->len[j] = (uintptr_t) end - (uintptr_t) start;
+  for (j++; i < n; i++, j++) {
+    t->start[j] = old->start[i];
+    t->len[j] = old->len[i];
+  }
+
+  text_ranges_publish(t);
+}
+
+
+static void
+text_ranges_unmap(void *start, void *end)
+{
+  text_ranges_t *old = (text_ranges_t *) atomic_load(&text_ranges);
+  if (old == NULL) return;
+
+  text_ranges_t *t = text_ranges_new(old->n);
+  if (t == NULL) return;
+
+  size_t j = 0;
+  for (size_t i = 0; i < old->n; i++) {
+    if (old->start[i] == (uintptr_t) start) continue;
+    t->start[j] = old->start[i];
+    t->len[j] = old->len[i];
+    j++;
+  }
+  t->n = j;
+
+  text_ranges_publish(t);
+}
+
+
+static bool
+text_ranges_lookup(text_ranges_t *t, uintptr_t addr)
+{
+  size_t lo = 0, hi = t->n;
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (t->start[mid] <= addr) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo > 0 && addr - t->start[lo - 1] < t->len[lo - 1];
+}
+
+
+//
+// bit i of the result is set if words[i] is in the text of a load module
+//
+static unsigned int
+text_ranges_filter(text_ranges_t *t, void **words)
+{
+  unsigned int mask = 0;
+
+  if (t == NULL || t->n == 0) {
+    // no load modules known (yet): every word is a candidate
+    return (1u << TROLL_BATCH) - 1;
+  }
+
+  if (t->n <= TEXT_RANGES_SCAN_MAX) {
+    uintptr_t w[TROLL_BATCH];
+    uintptr_t in[TROLL_BATCH];
+    for (int i = 0; i < TROLL_BATCH; i++) {
+      w[i] = (uintptr_t) words[i];
+      in[i] = 0;
+    }
+    for (size_t j = 0; j < t->n; j++) {
+      uintptr_t start = t->start[j], len = t->len[j];
+      for (int i = 0; i < TROLL_BATCH; i++) {
+	in[i] |= (w[i] - start < len);
+      }
+    }
+    for (int i = 0; i < TROLL_BATCH; i++) {
+      mask |= (unsigned int) in[i] << i;
+    }
+  }
+  else {
+    for (int i = 0; i < TROLL_BATCH; i++) {
+      if (text_ranges_lookup(t, (uintptr_t) words[i])) mask |= 1u << i;
+    }
+  }
+
+  return mask;
+}
+
+
+//***************************************************************************
+// interface operations
+//***************************************************************************
+
+void
+stack_troll_init(void)
+{
+  static loadmap_notify_t stack_troll_notifiers;
+
+  stack_troll_notifiers.map = text_ranges_map;
+  stack_troll_notifiers.unmap = text_ranges_unmap;
+  hpcrun_loadmap_notify_register(&stack_troll_notifiers);
+}
 
-static const int TROLL_LIMIT = 16;
 
 troll_status
 stack_troll(void **start_sp, uint *ra_pos, validate_addr_fn_t validate_addr, void *generic_arg)
 {
-  void **sp = start_sp;
-
-  for (int i = 0; i < TROLL_LIMIT; i++) {
-    switch (validate_addr(*sp, generic_arg)){
-      case UNW_ADDR_CONFIRMED:
-        TMSG(TROLL,"found a confirmed valid return address %p at sp = %p", \
-	     *sp, sp);
-        *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
-        return TROLL_VALID; // success
-
-      case UNW_ADDR_PROBABLE_INDIRECT:
-        TMSG(TROLL,"found a likely (from indirect call) valid return address %p at sp = %p", \
-	     *sp, sp);
-        *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
-        return TROLL_LIKELY; // success
-
-      case UNW_ADDR_PROBABLE_TAIL:
-        TMSG(TROLL,"found a likely (from tail call) valid return address %p at sp = %p", \
-	     *sp, sp);
-        *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
-        return TROLL_LIKELY; // success
-
-      case UNW_ADDR_PROBABLE:
-        TMSG(TROLL,"found a likely valid return address %p at sp = %p", \
-	     *sp, sp);
-        *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
-        return TROLL_LIKELY; // success
-
-      case UNW_ADDR_CYCLE:
-        TMSG(TROLL_CHK,"infinite loop detected with return address %p at sp = %p", \
-	     *sp, sp);
-        break;
-
-      case UNW_ADDR_WRONG:
-        TMSG(TROLL_CHK,"provably invalid return address %p at sp = %p", \
-	     *sp, sp);
-        break;
-
-      default:
-        EMSG("UNKNOWN return code from validate_addr in Trolling code %p at sp = %p",
-             *sp, sp);
-        break;
+  text_ranges_t *ranges = 
+    (text_ranges_t *) atomic_load_explicit(&text_ranges, memory_order_acquire);
+
+  for (int b = 0; b < TROLL_LIMIT; b += TROLL_BATCH) {
+    void **batch = start_sp + b;
+    unsigned int candidates = text_ranges_filter(ranges, batch);
+
+    for (int i = 0; candidates != 0; i++, candidates >>= 1) {
+      if ((candidates & 1) == 0) continue;
+
+      void **sp = batch + i;
+      switch (validate_addr(*sp, generic_arg)){
+        case UNW_ADDR_CONFIRMED:
+          TMSG(TROLL,"found a confirmed valid return address %p at sp = %p", \
+	       *sp, sp);
+          *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
+          return TROLL_VALID; // success
+
+        case UNW_ADDR_PROBABLE_INDIRECT:
+          TMSG(TROLL,"found a likely (from indirect call) valid return address %p at sp = %p", \
+	       *sp, sp);
+          *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
+          return TROLL_LIKELY; // success
+
+        case UNW_ADDR_PROBABLE_TAIL:
+          TMSG(TROLL,"found a likely (from tail call) valid return address %p at sp = %p", \
+	       *sp, sp);
+          *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
+          return TROLL_LIKELY; // success
+
+        case UNW_ADDR_PROBABLE:
+          TMSG(TROLL,"found a likely valid return address %p at sp = %p", \
+	       *sp, sp);
+          *ra_pos = (uintptr_t)sp - (uintptr_t)start_sp;
+          return TROLL_LIKELY; // success
+
+        case UNW_ADDR_CYCLE:
+          TMSG(TROLL_CHK,"infinite loop detected with return address %p at sp = %p", \
+	       *sp, sp);
+          break;
+
+        case UNW_ADDR_WRONG:
+          TMSG(TROLL_CHK,"provably invalid return address %p at sp = %p", \
+	       *sp, sp);
+          break;
+
+        default:
+          EMSG("UNKNOWN return code from validate_addr in Trolling code %p at sp = %p",
+               *sp, sp);
+          break;
+      }
     }
-    sp++;
   }
   
   TMSG(TROLL,"(sp=%p): failed using limit %d", start_sp, TROLL_LIMIT);
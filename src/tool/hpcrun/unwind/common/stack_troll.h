@@ -60,6 +60,7 @@ typedef enum {
 } troll_status;
 
 #include "validate_return_addr.h"
+  void stack_troll_init(void);
   troll_status stack_troll(void **start_sp, uint *ra_pos, validate_addr_fn_t validate_addr, void *generic_arg);
 
 #ifdef __cplusplus
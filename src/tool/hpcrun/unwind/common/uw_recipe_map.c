@@ -264,6 +264,19 @@ ilmstat_btuwi_pair_free(ilmstat_btuwi_pair_t* pair, unwinder_t uw)
   mcs_unlock(&GFL_lock, &me);
 }
 
+/*
+ * Release a pair that was removed from the map, along with its tree.
+ * Other threads may still be unwinding through them, so they are
+ * reused only after those threads' samples are done.
+ */
+static void
+ilmstat_btuwi_pair_retire(ilmstat_btuwi_pair_t* pair)
+{
+  if (!pair) return;
+  bitree_uwi_retire(pair->btuwi, hpcrun_free_deferred);
+  hpcrun_free_deferred(pair);
+}
+
 //---------------------------------------------------------------------
 // local data
 //---------------------------------------------------------------------
@@ -275,6 +288,10 @@ static cskiplist_t *addr2recipe_map[NUM_UNWINDERS];
 // and inserting entries into addr2recipe_map:
 static mem_alloc my_alloc = hpcrun_malloc;
 
+// memory allocator for the pairs and trees in addr2recipe_map, which
+// are released when their load module is unmapped:
+static mem_alloc freeable_alloc = hpcrun_malloc_freeable;
+
 //******************************************************************************
 // String output
 //******************************************************************************
@@ -446,7 +463,7 @@ uw_recipe_map_poison(uintptr_t start, uintptr_t end, unwinder_t uw)
   uw_recipe_map_report("uw_recipe_map_poison", (void *) start, (void *) end);
 
   ilmstat_btuwi_pair_t* itpair =
-	  ilmstat_btuwi_pair_build(start, end, NULL, NEVER, my_alloc);
+	  ilmstat_btuwi_pair_build(start, end, NULL, NEVER, freeable_alloc);
   csklnode_t *node = cskl_insert(addr2recipe_map[uw], itpair, my_alloc);
   if (itpair != (ilmstat_btuwi_pair_t*)node->val)
     ilmstat_btuwi_pair_free(itpair, uw);
@@ -472,7 +489,7 @@ cskl_ilmstat_btuwi_free_uw(void *anode, unwinder_t uw)
 
   csklnode_t *node = (csklnode_t*) anode;
   ilmstat_btuwi_pair_t *ilmstat_btuwi = (ilmstat_btuwi_pair_t*)node->val;
-  ilmstat_btuwi_pair_free(ilmstat_btuwi, uw);
+  ilmstat_btuwi_pair_retire(ilmstat_btuwi);
   node->val = NULL;
   cskl_free(node);
 }
@@ -611,7 +628,7 @@ uw_recipe_map_init(void)
   fprintf(stderr, "%s: mcs_init(&GFL_lock), call bitree_uwi_init() \n", __func__);
 #endif
   mcs_init(&GFL_lock);
-  bitree_uwi_init(my_alloc);
+  bitree_uwi_init(freeable_alloc);
 
   TMSG(UW_RECIPE_MAP, "init address-to-recipe map");
   ilmstat_btuwi_pair_t* lsentinel =
@@ -674,7 +691,7 @@ uw_recipe_map_lookup(void *addr, unwinder_t uw, unwindr_info_t *unwr_info)
 	// (bitree_uwi_t*)NULL and try to insert into map:
 	ilm_btui =
 		ilmstat_btuwi_pair_malloc((uintptr_t)fcn_start, (uintptr_t)fcn_end, lm,
-			DEFERRED, my_alloc);
+			DEFERRED, freeable_alloc);
 
 	
 	csklnode_t *node = cskl_insert(addr2recipe_map[uw], ilm_btui, my_alloc);
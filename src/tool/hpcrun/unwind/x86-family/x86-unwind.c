@@ -81,6 +81,7 @@
 #include <hpcrun/main.h>
 #include "stack_troll.h"
 #include "thread_use.h"
+#include "x86-validate-retn-addr.h"
 
 #include <unwind/common/unwind.h>
 #include <unwind/common/backtrace.h>
@@ -181,6 +182,8 @@ hpcrun_unw_init(void)
 {
   x86_family_decoder_init();
   uw_recipe_map_init();
+  stack_troll_init();
+  x86_validate_init();
 }
 
 typedef unw_frame_regnum_t unw_reg_code_t;
@@ -55,6 +55,7 @@
 //***************************************************************************
 
 #include <stdbool.h>
+#include <stdint.h>
 
 
 
@@ -71,7 +72,10 @@
 #include "x86-unwind-interval.h"
 
 #include <unwind/common/unw-datatypes.h>
+#include <hpcrun/hpcrun_stats.h>
+#include <hpcrun/loadmap.h>
 #include <messages/messages.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #include <lib/isa-lean/x86/instruction-set.h>
 
@@ -86,6 +90,31 @@ typedef struct xed_decode_t {
 } xed_decode_t;
 
 
+//
+// process-wide cache of validation results, keyed by (return address,
+// callee, generation). an entry holds (key ^ status, status): a reader
+// accepts it only if both words agree with its key, so a torn read or a
+// concurrent update is just a miss. mapping or unmapping a load module
+// bumps the generation, which invalidates all entries.
+//
+typedef struct validation_cache_entry_t {
+  atomic_uint_least64_t check;
+  atomic_uint_least64_t status;
+} validation_cache_entry_t;
+
+
+
+//****************************************************************************
+// local data 
+//****************************************************************************
+
+#define VALIDATION_CACHE_SIZE 4096   // power of 2
+
+static validation_cache_entry_t validation_cache[VALIDATION_CACHE_SIZE];
+
+static atomic_uint_least64_t validation_cache_gen = ATOMIC_VAR_INIT(1);
+
+
 
 //****************************************************************************
 // local operations 
@@ -351,28 +380,62 @@ return_addr_valid(void *addr, unwindr_info_t *unwr_info)
 	  unwr_info->treestat != NEVER);
 }
 
-//****************************************************************************
-// interface operations 
-//****************************************************************************
-validation_status
-deep_validate_return_addr(void* addr, void* generic)
+
+static uint64_t
+validation_cache_key(void *addr, void *callee)
 {
-  hpcrun_unw_cursor_t* cursor = (hpcrun_unw_cursor_t*) generic;
+  uint64_t gen = atomic_load_explicit(&validation_cache_gen, memory_order_acquire);
+  uint64_t h = (uint64_t) (uintptr_t) addr * 0x9E3779B97F4A7C15ull;
+  h ^= ((uint64_t) (uintptr_t) callee + gen) * 0xC2B2AE3D27D4EB4Full;
+  h ^= h >> 29;
+  return h | 1; // never matches an empty entry
+}
 
-  TMSG(VALIDATE_UNW,"validating unwind step from %p ==> %p",cursor->pc_unnorm,
-       addr);
 
-  unwindr_info_t unwr_info;
-  if (!return_addr_valid(addr, &unwr_info) ) {
-    TMSG(VALIDATE_UNW,"unwind addr %p does NOT have function bounds, so it is invalid", addr);
-    return status_is_wrong();
+static validation_cache_entry_t *
+validation_cache_entry(uint64_t key)
+{
+  return &validation_cache[(key >> 32) & (VALIDATION_CACHE_SIZE - 1)];
+}
+
+
+static bool
+validation_cache_get(uint64_t key, validation_status *status)
+{
+  validation_cache_entry_t *e = validation_cache_entry(key);
+  uint64_t check = atomic_load_explicit(&e->check, memory_order_relaxed);
+  uint64_t value = atomic_load_explicit(&e->status, memory_order_relaxed);
+
+  if ((check ^ value) != key) {
+    hpcrun_stats_validation_cache_miss_inc();
+    return false;
   }
+  hpcrun_stats_validation_cache_hit_inc();
+  *status = (validation_status) value;
+  return true;
+}
 
-  if (!return_addr_valid(cursor->pc_unnorm, &unwr_info))
-    return status_is_wrong();
 
-  void* callee = (void*)unwr_info.interval.start;
-  TMSG(VALIDATE_UNW, "beginning of my routine = %p", callee);
+static validation_status
+validation_cache_put(uint64_t key, validation_status status)
+{
+  validation_cache_entry_t *e = validation_cache_entry(key);
+  atomic_store_explicit(&e->check, key ^ (uint64_t) status, memory_order_relaxed);
+  atomic_store_explicit(&e->status, (uint64_t) status, memory_order_relaxed);
+  return status;
+}
+
+
+static void
+validation_cache_invalidate(void *start, void *end)
+{
+  atomic_fetch_add_explicit(&validation_cache_gen, 1, memory_order_release);
+}
+
+
+static validation_status
+validate_call_to(void *addr, void *callee)
+{
   if (confirm_call(addr, callee)) {
     TMSG(VALIDATE_UNW, "Instruction preceeding %p is a call to this routine. Unwind confirmed", addr);
     return UNW_ADDR_CONFIRMED;
@@ -399,6 +462,52 @@ deep_validate_return_addr(void* addr, void* generic)
   return status_is_wrong();
 }
 
+//****************************************************************************
+// interface operations 
+//****************************************************************************
+
+void
+x86_validate_init(void)
+{
+  static loadmap_notify_t validation_cache_notifiers;
+
+  validation_cache_notifiers.map = validation_cache_invalidate;
+  validation_cache_notifiers.unmap = validation_cache_invalidate;
+  hpcrun_loadmap_notify_register(&validation_cache_notifiers);
+}
+
+
+validation_status
+deep_validate_return_addr(void* addr, void* generic)
+{
+  hpcrun_unw_cursor_t* cursor = (hpcrun_unw_cursor_t*) generic;
+
+  TMSG(VALIDATE_UNW,"validating unwind step from %p ==> %p",cursor->pc_unnorm,
+       addr);
+
+  unwindr_info_t unwr_info;
+  if (!return_addr_valid(addr, &unwr_info) ) {
+    TMSG(VALIDATE_UNW,"unwind addr %p does NOT have function bounds, so it is invalid", addr);
+    return status_is_wrong();
+  }
+
+  if (!return_addr_valid(cursor->pc_unnorm, &unwr_info))
+    return status_is_wrong();
+
+  void* callee = (void*)unwr_info.interval.start;
+  TMSG(VALIDATE_UNW, "beginning of my routine = %p", callee);
+
+  // the same return addresses show up sample after sample
+  uint64_t key = validation_cache_key(addr, callee);
+  validation_status status;
+  if (validation_cache_get(key, &status)) {
+    TMSG(VALIDATE_UNW, "cached validation of %p: %s", addr, vstat2s(status));
+    return status;
+  }
+
+  return validation_cache_put(key, validate_call_to(addr, callee));
+}
+
 
 validation_status
 dbg_val(void *addr, void *pc)
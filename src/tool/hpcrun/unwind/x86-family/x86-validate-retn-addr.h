@@ -52,4 +52,6 @@
 extern validation_status validate_return_addr(void *addr, void *generic);
 extern validation_status deep_validate_return_addr(void *addr, void *generic);
 
+extern void x86_validate_init(void);
+
 #endif // X86_VALIDATE_RETN_ADDR_H
@@ -48,14 +48,30 @@
 // system includes
 //*****************************************************************************
 
+#ifndef _GNU_SOURCE
+#  define _GNU_SOURCE  // fopencookie()
+#endif
+
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include <setjmp.h>
+#include <sys/mman.h>
+#include <sys/time.h>
 
 //*****************************************************************************
 // local includes
 //*****************************************************************************
 
+#include "env.h"
 #include "fname_max.h"
 #include "backtrace.h"
 #include "files.h"
@@ -67,14 +83,24 @@
 #include "write_data.h"
 #include "loadmap.h"
 #include "sample_prob.h"
+#include "cct2metrics.h"
+#include "metrics.h"
+#include "hpcrun_dlfns.h"
 
+#include <memory/hpcrun-malloc.h>
+#include <memory/mmap.h>
 #include <messages/messages.h>
+#include <monitor.h>
 
 #include <lush/lush-backtrace.h>
 
 #include <lib/prof-lean/hpcio.h>
+#include <lib/prof-lean/hpcio-buffer.h>
+#include <lib/prof-lean/hpcio-z.h>
 #include <lib/prof-lean/hpcfmt.h>
 #include <lib/prof-lean/hpcrun-fmt.h>
+#include <lib/prof-lean/spinlock.h>
+#include <lib/prof-lean/stdatomic.h>
 
 #include <lib/support-lean/OSUtil.h>
 
@@ -89,12 +115,304 @@ static epoch_flags_t epoch_flags = {
 
 static const uint64_t default_measurement_granularity = 1;
 
+// continuous profiling: length of a profile window (0 = no rotation)
+// and the time at which window 0 began
+static uint64_t profile_window_us = 0;
+static uint64_t profile_window_origin_us = 0;
+
 
 
 //*****************************************************************************
 // local utilities
 //*****************************************************************************
 
+//*****************************************************************************
+// table of contents
+//
+// Each epoch written to a profile gets a toc entry (see hpcrun-fmt.h).
+// Epochs may be flushed early, so the entries are kept with the file
+// until write_toc() at its close.
+//*****************************************************************************
+
+typedef struct profile_toc_s {
+  hpcrun_fmt_tocEntry_t entry;
+  struct profile_toc_s* next;
+} profile_toc_t;
+
+
+static hpcrun_fmt_tocEntry_t*
+toc_append(profile_toc_t** toc)
+{
+  profile_toc_t* x = hpcrun_malloc(sizeof(profile_toc_t));
+  if (x == NULL) {
+    return NULL;
+  }
+  memset(x, 0, sizeof(*x));
+
+  while (*toc) {
+    toc = &(*toc)->next;
+  }
+  *toc = x;
+  return &x->entry;
+}
+
+
+static bool
+toc_entry_valid(const hpcrun_fmt_tocEntry_t* x)
+{
+  // ftello() returns -1 on a stream that cannot tell its position
+  const uint64_t bad = (uint64_t) -1;
+  return (x->epochOff != bad && x->metricTblOff != bad
+	  && x->loadmapOff != bad && x->cctOff != bad && x->cctIdxOff != bad);
+}
+
+
+static void
+write_toc(FILE* fs, profile_toc_t* toc)
+{
+  uint32_t num_epochs = 0;
+  for (profile_toc_t* x = toc; x; x = x->next) {
+    if (! toc_entry_valid(&x->entry)) {
+      TMSG(DATA_WRITE, "profile has no toc: missing file offsets");
+      return;
+    }
+    num_epochs++;
+  }
+
+  off_t toc_off = ftello(fs);
+  if (toc_off < 0) {
+    TMSG(DATA_WRITE, "profile has no toc: missing file offsets");
+    return;
+  }
+
+  TMSG(DATA_WRITE, "writing toc (%d epochs)", num_epochs);
+  hpcrun_fmt_tocHdr_fwrite(num_epochs, fs);
+  for (profile_toc_t* x = toc; x; x = x->next) {
+    hpcrun_fmt_tocEntry_fwrite(&x->entry, fs);
+  }
+  hpcrun_fmt_tocFtr_fwrite(toc_off, fs);
+}
+
+
+//*****************************************************************************
+// dictionary
+//
+// The metric descriptors, load module names and program nv-pairs are
+// written once, to the process's dictionary (see hpcrun-fmt.h), and
+// the profiles refer to them by id.  The dictionary is per process
+// rather than per directory since the processes of a run (eg, MPI
+// ranks) write to the same directory concurrently.  It only grows:
+// before an epoch is written, dict_sync() appends what is new.
+//*****************************************************************************
+
+// These variables are protected by the dictionary lock.
+
+static spinlock_t dict_lock = SPINLOCK_UNLOCKED;
+static pid_t dict_pid = 0;
+static FILE* dict_fs = NULL;
+static char dict_name[NAME_MAX + 1];
+static uint32_t dict_num_metrics = 0;
+static uint8_t dict_lm_done[(UINT16_MAX + 1) / 8]; // bit per load module id
+
+
+static void
+dict_init(void)
+{
+  const uint bufSZ = 32;
+
+  const char* jobIdStr = OSUtil_jobid();
+  if (!jobIdStr) {
+    jobIdStr = "";
+  }
+
+  char hostidStr[bufSZ];
+  snprintf(hostidStr, bufSZ, "%lx", OSUtil_hostid());
+
+  char pidStr[bufSZ];
+  snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
+
+  int fd = hpcrun_open_dictionary_file(dict_name, sizeof(dict_name));
+  if (fd >= 0 && dict_name[0] != '\0') {
+    dict_fs = fdopen(fd, "w");
+  }
+  if (dict_fs == NULL) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    dict_name[0] = '\0';
+    return;
+  }
+
+  TMSG(DATA_WRITE, "writing dictionary %s", dict_name);
+  hpcrun_fmt_dictHdr_fwrite(dict_fs,
+			    HPCRUN_FMT_NV_prog, hpcrun_files_executable_name(),
+			    HPCRUN_FMT_NV_progPath, hpcrun_files_executable_pathname(),
+			    HPCRUN_FMT_NV_envPath, getenv("PATH"),
+			    HPCRUN_FMT_NV_jobId, jobIdStr,
+			    HPCRUN_FMT_NV_hostid, hostidStr,
+			    HPCRUN_FMT_NV_pid, pidStr,
+			    NULL);
+  if (fflush(dict_fs) != 0) {
+    EMSG("HPCToolkit: unable to write dictionary %s", dict_name);
+    fclose(dict_fs);
+    dict_fs = NULL;
+    dict_name[0] = '\0';
+  }
+}
+
+
+// Returns: the file name of the process's dictionary, opened on first
+// use, else NULL if the profiles must be self-contained.
+static const char*
+dict_open(void)
+{
+  spinlock_lock(&dict_lock);
+  pid_t pid = getpid();
+  if (dict_pid != pid) {
+    // first use, or after fork: the parent's dictionary is not ours
+    if (dict_fs) {
+      fclose(dict_fs);
+      dict_fs = NULL;
+    }
+    dict_pid = pid;
+    dict_name[0] = '\0';
+    dict_num_metrics = 0;
+    memset(dict_lm_done, 0, sizeof(dict_lm_done));
+    dict_init();
+  }
+  const char* name = (dict_fs) ? dict_name : NULL;
+  spinlock_unlock(&dict_lock);
+
+  return name;
+}
+
+
+// Appends the metrics of 'metric_tbl' and the load modules of
+// 'loadmap' that the dictionary does not have yet.
+static void
+dict_sync(metric_desc_p_tbl_t* metric_tbl, hpcrun_loadmap_t* loadmap)
+{
+  int ret = HPCFMT_OK;
+
+  spinlock_lock(&dict_lock);
+
+  for (uint32_t i = dict_num_metrics;
+       ret == HPCFMT_OK && i < metric_tbl->len; i++) {
+    ret = hpcrun_fmt_dictMetric_fwrite(i, metric_tbl->lst[i], dict_fs);
+    dict_num_metrics = i + 1;
+  }
+
+  for (load_module_t* lm = loadmap->lm_end;
+       ret == HPCFMT_OK && lm; lm = lm->prev) {
+    uint8_t bit = 1u << (lm->id % 8);
+    if (dict_lm_done[lm->id / 8] & bit) {
+      continue;
+    }
+    loadmap_entry_t lm_entry;
+    lm_entry.id = lm->id;
+    lm_entry.name = lm->name;
+    lm_entry.flags = 0;
+    ret = hpcrun_fmt_dictLM_fwrite(&lm_entry, dict_fs);
+    dict_lm_done[lm->id / 8] |= bit;
+  }
+
+  if (ret != HPCFMT_OK || fflush(dict_fs) != 0) {
+    EMSG("HPCToolkit: unable to write dictionary %s", dict_name);
+  }
+
+  spinlock_unlock(&dict_lock);
+}
+
+
+//*****************************************************************************
+// compressed profiles
+//
+// With HPCRUN_COMPRESS, a profile is written through a stdio stream
+// whose writes go to a compressing hpcio_outbuf (see hpcio-z.h), so
+// the hpcrun-fmt writers are unchanged.  The outbuf holds one chunk.
+//*****************************************************************************
+
+typedef struct zfile_s {
+  hpcio_outbuf_t outbuf;
+  off64_t pos; // in the uncompressed stream
+  // followed by the outbuf's buffer and the compressor's work area
+} zfile_t;
+
+
+static ssize_t
+zfile_write(void* cookie, const char* buf, size_t size)
+{
+  zfile_t* z = (zfile_t*) cookie;
+  ssize_t ret = hpcio_outbuf_write(&z->outbuf, buf, size);
+  if (ret > 0) {
+    z->pos += ret;
+  }
+  return ret;
+}
+
+
+// Supports only ftello(), which the profile's toc needs.
+static int
+zfile_seek(void* cookie, off64_t* offset, int whence)
+{
+  zfile_t* z = (zfile_t*) cookie;
+  if (whence != SEEK_CUR || *offset != 0) {
+    errno = ESPIPE;
+    return -1;
+  }
+  *offset = z->pos;
+  return 0;
+}
+
+
+static int
+zfile_close(void* cookie)
+{
+  zfile_t* z = (zfile_t*) cookie;
+  int ret = hpcio_outbuf_close(&z->outbuf);
+  free(z);
+  return (ret == HPCFMT_OK) ? 0 : EOF;
+}
+
+
+// Returns a stream for writing a profile to 'fd', or NULL on error.
+static FILE*
+profile_fdopen(int fd)
+{
+  int level = hpcrun_files_compress_level();
+  if (level < 0) {
+    return fdopen(fd, "w");
+  }
+
+  size_t worksz = hpcio_z_enc_worksz(level);
+  zfile_t* z = (zfile_t*) malloc(sizeof(zfile_t) + HPCIO_Z_ChunkSz + worksz);
+  if (z == NULL) {
+    return NULL;
+  }
+  z->pos = 0;
+  char* buf = (char*) (z + 1);
+  char* work = buf + HPCIO_Z_ChunkSz;
+
+  if (hpcio_outbuf_attach(&z->outbuf, fd, buf, HPCIO_Z_ChunkSz,
+			  HPCIO_OUTBUF_UNLOCKED) != HPCFMT_OK
+      || hpcio_outbuf_compress(&z->outbuf, work, worksz, level) != HPCFMT_OK) {
+    free(z);
+    return NULL;
+  }
+
+  cookie_io_functions_t fns;
+  fns.read  = NULL;
+  fns.write = zfile_write;
+  fns.seek  = zfile_seek;
+  fns.close = zfile_close;
+
+  FILE* fs = fopencookie(z, "w", fns);
+  if (fs == NULL) {
+    free(z);
+  }
+  return fs;
+}
+
 
 //***************************************************************************
 //
@@ -132,30 +450,17 @@ static const uint64_t default_measurement_granularity = 1;
 //
 //***************************************************************************
 
-static FILE *
-lazy_open_data_file(core_profile_trace_data_t * cptd)
+//
+// write the file header of thread 'tid'.  a profile of a time window
+// ('window' != NULL, holding its begin and end times) carries the window
+// bounds and no trace bounds: its trace is the one of the thread's final
+// profile.
+//
+static void
+write_file_hdr(FILE* fs, int tid, uint64_t trace_min_time_us,
+	       uint64_t trace_max_time_us, int rank, int num_threads,
+	       uint64_t* window)
 {
-
-  FILE* fs = cptd->hpcrun_file;
-  if (fs) {
-    return fs;
-  }
-
-  int rank = hpcrun_get_rank();
-  if (rank < 0) {
-    rank = 0;
-  }
-  int fd = hpcrun_open_profile_file(rank, cptd->id);
-  fs = fdopen(fd, "w");
-  if (fs == NULL) {
-    EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
-    return NULL;
-  }
-  cptd->hpcrun_file = fs;
-
-  if (! hpcrun_sample_prob_active())
-    return fs;
-
   const uint bufSZ = 32; // sufficient to hold a 64-bit integer in base 10
 
   const char* jobIdStr = OSUtil_jobid();
@@ -168,7 +473,7 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   snprintf(mpiRankStr, bufSZ, "%d", rank);
 
   char tidStr[bufSZ];
-  snprintf(tidStr, bufSZ, "%d", cptd->id);
+  snprintf(tidStr, bufSZ, "%d", tid);
 
   char hostidStr[bufSZ];
   snprintf(hostidStr, bufSZ, "%lx", OSUtil_hostid());
@@ -177,16 +482,45 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
   snprintf(pidStr, bufSZ, "%u", OSUtil_pid());
 
   char traceMinTimeStr[bufSZ];
-  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, cptd->trace_min_time_us);
+  snprintf(traceMinTimeStr, bufSZ, "%"PRIu64, trace_min_time_us);
 
   char traceMaxTimeStr[bufSZ];
-  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, cptd->trace_max_time_us);
+  snprintf(traceMaxTimeStr, bufSZ, "%"PRIu64, trace_max_time_us);
+
+  char numThreadsStr[bufSZ];
+  snprintf(numThreadsStr, bufSZ, "%d", num_threads);
+
+  char windowBeginStr[bufSZ];
+  char windowEndStr[bufSZ];
+  windowBeginStr[0] = windowEndStr[0] = '\0';
+  if (window) {
+    snprintf(windowBeginStr, bufSZ, "%"PRIu64, window[0]);
+    snprintf(windowEndStr, bufSZ, "%"PRIu64, window[1]);
+  }
 
   //
   // ==== file hdr =====
   //
 
   TMSG(DATA_WRITE,"writing file header");
+
+  // the program nv-pairs are in the dictionary, if any
+  const char* dict = dict_open();
+  if (dict) {
+    hpcrun_fmt_hdr_fwrite(fs,
+			  HPCRUN_FMT_NV_dict, dict,
+			  HPCRUN_FMT_NV_mpiRank, mpiRankStr,
+			  HPCRUN_FMT_NV_tid, tidStr,
+			  HPCRUN_FMT_NV_traceMinTime, traceMinTimeStr,
+			  HPCRUN_FMT_NV_traceMaxTime, traceMaxTimeStr,
+			  HPCRUN_FMT_NV_numThreads, numThreadsStr,
+			  // N.B.: ends the list here unless writing a window
+			  (window ? HPCRUN_FMT_NV_windowBegin : NULL), windowBeginStr,
+			  HPCRUN_FMT_NV_windowEnd, windowEndStr,
+			  NULL);
+    return;
+  }
+
   hpcrun_fmt_hdr_fwrite(fs,
                         HPCRUN_FMT_NV_prog, hpcrun_files_executable_name(),
                         HPCRUN_FMT_NV_progPath, hpcrun_files_executable_pathname(),
@@ -198,13 +532,116 @@ lazy_open_data_file(core_profile_trace_data_t * cptd)
                         HPCRUN_FMT_NV_pid, pidStr,
 			HPCRUN_FMT_NV_traceMinTime, traceMinTimeStr,
 			HPCRUN_FMT_NV_traceMaxTime, traceMaxTimeStr,
+			HPCRUN_FMT_NV_numThreads, numThreadsStr,
+			// N.B.: ends the list here unless writing a window
+			(window ? HPCRUN_FMT_NV_windowBegin : NULL), windowBeginStr,
+			HPCRUN_FMT_NV_windowEnd, windowEndStr,
                         NULL);
+}
+
+
+static FILE *
+lazy_open_data_file(core_profile_trace_data_t * cptd, int num_threads)
+{
+
+  FILE* fs = cptd->hpcrun_file;
+  if (fs) {
+    return fs;
+  }
+
+  int rank = hpcrun_get_rank();
+  if (rank < 0) {
+    rank = 0;
+  }
+  int fd = hpcrun_open_profile_file(rank, cptd->id);
+  fs = profile_fdopen(fd);
+  if (fs == NULL) {
+    EEMSG("HPCToolkit: %s: unable to open profile file", __func__);
+    return NULL;
+  }
+  cptd->hpcrun_file = fs;
+
+  if (! hpcrun_sample_prob_active())
+    return fs;
+
+  write_file_hdr(fs, cptd->id, cptd->trace_min_time_us,
+		 cptd->trace_max_time_us, rank, num_threads, NULL);
   return fs;
 }
 
 
+//
+// write the epoch header, metric table and loadmap of an epoch, filling
+// in their offsets in 'toc_entry'.
+//
+static void
+write_epoch_prologue(FILE* fs, epoch_flags_t flags, hpcrun_loadmap_t* loadmap,
+		     metric_aux_info_t* perf_event_info, bool use_dict,
+		     hpcrun_fmt_tocEntry_t* toc_entry)
+{
+  //
+  //  == epoch header ==
+  //
+
+  TMSG(DATA_WRITE," epoch header");
+  toc_entry->epochOff = ftello(fs);
+
+  TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", flags.bits);
+  hpcrun_fmt_epochHdr_fwrite(fs, flags,
+			     default_measurement_granularity,
+			     "TODO:epoch-name","TODO:epoch-value",
+			     NULL);
+
+  //
+  // == metrics ==
+  //
+
+  metric_desc_p_tbl_t *metric_tbl = hpcrun_get_metric_tbl();
+  uint32_t num_metrics = metric_tbl->len;
+
+  TMSG(DATA_WRITE, "metric tbl len = %d", num_metrics);
+  toc_entry->metricTblOff = ftello(fs);
+  if (use_dict) {
+    dict_sync(metric_tbl, loadmap);
+    hpcrun_fmt_metricTblRef_fwrite(num_metrics, perf_event_info, fs);
+  }
+  else {
+    hpcrun_fmt_metricTbl_fwrite(metric_tbl, perf_event_info, fs);
+  }
+
+  TMSG(DATA_WRITE, "Done writing metric data");
+
+  //
+  // == load map ==
+  //
+
+  TMSG(DATA_WRITE, "Preparing to write loadmap");
+
+  toc_entry->loadmapOff = ftello(fs);
+  hpcfmt_int4_fwrite(loadmap->size, fs);
+
+  // N.B.: Write in reverse order to obtain nicely ascending LM ids.
+  for (load_module_t* lm_src = loadmap->lm_end;
+       (lm_src); lm_src = lm_src->prev) {
+    if (use_dict) {
+      hpcfmt_int2_fwrite(lm_src->id, fs);
+      continue;
+    }
+    loadmap_entry_t lm_entry;
+    lm_entry.id = lm_src->id;
+    lm_entry.name = lm_src->name;
+    lm_entry.flags = 0;
+
+    hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+  }
+
+  TMSG(DATA_WRITE, "Done writing loadmap");
+}
+
+
 static int
-write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
+write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch,
+	     profile_toc_t** toc)
 {
   uint32_t num_epochs = 0;
 
@@ -224,6 +661,9 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 
   TMSG(DATA_WRITE, "writing # epochs = %d", num_epochs);
 
+  // as the file hdr: refer to the dictionary, if any
+  bool use_dict = (dict_open() != NULL);
+
   //
   // for each epoch ...
   //
@@ -238,11 +678,6 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
       }
     }
 #endif
-    //
-    //  == epoch header ==
-    //
-
-    TMSG(DATA_WRITE," epoch header");
     //
     // set epoch flags before writing
     //
@@ -250,52 +685,21 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
     epoch_flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
     TMSG(LUSH,"epoch lush flag set to %s", epoch_flags.fields.isLogicalUnwind ? "true" : "false");
     
-    TMSG(DATA_WRITE,"epoch flags = %"PRIx64"", epoch_flags.bits);
-    hpcrun_fmt_epochHdr_fwrite(fs, epoch_flags,
-			       default_measurement_granularity,
-			       "TODO:epoch-name","TODO:epoch-value",
-			       NULL);
-
-    //
-    // == metrics ==
-    //
-
-    metric_desc_p_tbl_t *metric_tbl = hpcrun_get_metric_tbl();
-
-    TMSG(DATA_WRITE, "metric tbl len = %d", metric_tbl->len);
-    hpcrun_fmt_metricTbl_fwrite(metric_tbl, cptd->perf_event_info, fs);
-
-    TMSG(DATA_WRITE, "Done writing metric data");
-
-    //
-    // == load map ==
-    //
-
-    TMSG(DATA_WRITE, "Preparing to write loadmap");
-
-    hpcrun_loadmap_t* current_loadmap = s->loadmap;
-    
-    hpcfmt_int4_fwrite(current_loadmap->size, fs);
-
-    // N.B.: Write in reverse order to obtain nicely ascending LM ids.
-    for (load_module_t* lm_src = current_loadmap->lm_end;
-	 (lm_src); lm_src = lm_src->prev) {
-      loadmap_entry_t lm_entry;
-      lm_entry.id = lm_src->id;
-      lm_entry.name = lm_src->name;
-      lm_entry.flags = 0;
-      
-      hpcrun_fmt_loadmapEntry_fwrite(&lm_entry, fs);
+    hpcrun_fmt_tocEntry_t* toc_entry = toc_append(toc);
+    hpcrun_fmt_tocEntry_t toc_dummy;
+    if (toc_entry == NULL) {
+      toc_entry = &toc_dummy;
     }
-
-    TMSG(DATA_WRITE, "Done writing loadmap");
+    write_epoch_prologue(fs, epoch_flags, s->loadmap, cptd->perf_event_info,
+			 use_dict, toc_entry);
 
     //
     // == cct ==
     //
 
     cct_bundle_t* cct      = &(s->csdata);
-    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct);
+    int ret = hpcrun_cct_bundle_fwrite(fs, epoch_flags, cct,
+				       &(cptd->cct2metrics_map), toc_entry);
     if(ret != HPCRUN_OK) {
       TMSG(DATA_WRITE, "Error writing tree %#lx", cct);
       TMSG(DATA_WRITE, "Number of tree nodes lost: %ld", cct->num_nodes);
@@ -306,7 +710,6 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
     else {
       TMSG(DATA_WRITE, "saved profile data to hpcrun file ");
     }
-    current_loadmap++;
 
   } // epoch loop
 
@@ -317,23 +720,37 @@ write_epochs(FILE* fs, core_profile_trace_data_t * cptd, epoch_t* epoch)
 void
 hpcrun_flush_epochs(core_profile_trace_data_t * cptd)
 {
-  FILE *fs = lazy_open_data_file(cptd);
+  FILE *fs = lazy_open_data_file(cptd, 1);
   if (fs == NULL)
     return;
 
-  write_epochs(fs, cptd, cptd->epoch);
+  write_epochs(fs, cptd, cptd->epoch, &cptd->hpcrun_file_toc);
   hpcrun_epoch_reset();
 }
 
 int
 hpcrun_write_profile_data(core_profile_trace_data_t * cptd)
 {
-  TMSG(DATA_WRITE,"Writing hpcrun profile data");
-  FILE* fs = lazy_open_data_file(cptd);
+  return hpcrun_write_merged_profile_data(cptd, 1);
+}
+
+//
+// write the profile of 'cptd', into which the profiles of
+// 'num_threads' threads (including its own) have been merged.
+//
+int
+hpcrun_write_merged_profile_data(core_profile_trace_data_t * cptd, int num_threads)
+{
+  TMSG(DATA_WRITE,"Writing hpcrun profile data (%d threads)", num_threads);
+  FILE* fs = lazy_open_data_file(cptd, num_threads);
   if (fs == NULL)
     return HPCRUN_ERR;
 
-  write_epochs(fs, cptd, cptd->epoch);
+  write_epochs(fs, cptd, cptd->epoch, &cptd->hpcrun_file_toc);
+  if (hpcrun_sample_prob_active()) {
+    write_toc(fs, cptd->hpcrun_file_toc);
+  }
+  cptd->hpcrun_file_toc = NULL;
 
   TMSG(DATA_WRITE,"closing file");
   hpcio_fclose(fs);
@@ -342,6 +759,484 @@ hpcrun_write_profile_data(core_profile_trace_data_t * cptd)
   return HPCRUN_OK;
 }
 
+//*****************************************************************************
+// continuous profiling
+//
+// With HPCRUN_PROFILE_WINDOW=<seconds>, time is cut into windows of that
+// length, starting when hpcrun initializes.  The first time a thread
+// finishes a sample in a new window, it copies the metrics accumulated
+// since its previous rotation into a profile of its own for the old
+// window, then zeroes them.  CCT nodes are kept, so cct ids in the
+// trace stay valid; the profile written at thread exit holds only the
+// last window.  Merging all profiles of a thread yields the usual
+// profile; merging a subset of window files yields those windows.
+//
+// The rotation runs in the sample handler, so it only copies the cct
+// nodes and their metrics into a part, mapped with mmap, and pushes it
+// onto a lock-free list.  The parts are written by a helper thread,
+// which has all signals blocked and is hidden from libmonitor, as
+// writing uses malloc and stdio.  hpcrun_profile_window_fini() writes
+// the parts still pending at process exit.
+//
+// N.B.: a window is closed by the thread's first sample after it ends,
+// so that sample is charged to the old window.  A thread that takes no
+// samples in a window writes no profile for it.
+//*****************************************************************************
+
+// the cct of one epoch of a part
+typedef struct window_epoch_s {
+  hpcrun_loadmap_t* loadmap;
+  uint64_t num_nodes;
+  hpcrun_fmt_cct_node_t* nodes;     // with their metrics, as lwrite() does
+} window_epoch_t;
+
+
+// the copy of the profile of one thread for one window
+typedef struct window_part_s {
+  struct window_part_s* next;
+  size_t size;                      // bytes mapped, including this header
+  int rank;
+  int tid;
+  uint64_t window;
+  uint64_t bounds[2];               // begin and end times of the window
+  epoch_flags_t flags;
+  uint32_t num_metrics;
+  metric_aux_info_t* perf_event_info;
+  uint32_t num_epochs;
+  window_epoch_t* epochs;
+  // followed by the epochs, the nodes, their metrics and perf_event_info
+} window_part_t;
+
+
+typedef struct window_copy_arg_s {
+  window_part_t* part;
+  window_epoch_t* epoch;
+  hpcrun_metricVal_t* metrics;      // of the next node
+  cct2metrics_t** map;
+  cct_node_t* partial_root;         // partial unwinds not attached yet,
+  cct_node_t* partial_parent;       // and where they will be
+} window_copy_arg_t;
+
+
+static _Atomic(window_part_t*) window_parts = ATOMIC_VAR_INIT(NULL);
+static spinlock_t window_write_lock = SPINLOCK_UNLOCKED;
+static sem_t window_sem;
+static bool window_helper = false;
+
+
+static uint64_t
+profile_window_time_us(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return ((uint64_t) tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+
+static void
+window_count_node(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  (*(size_t*) arg)++;
+}
+
+
+// copies 'node' as lwrite() in cct.c writes it, except that the
+// partial unwinds are copied in place, below the root of the tree
+// they will be attached to when the epoch is written.
+static void
+window_copy_node(cct_node_t* node, cct_op_arg_t arg, size_t level)
+{
+  window_copy_arg_t* a = (window_copy_arg_t*) arg;
+  hpcrun_fmt_cct_node_t* x = &(a->epoch->nodes[a->epoch->num_nodes++]);
+  cct_node_t* parent = hpcrun_cct_parent(node);
+  cct_addr_t* addr = hpcrun_cct_addr(node);
+
+  if (node == a->partial_root) {
+    parent = a->partial_parent;
+  }
+
+  hpcrun_fmt_cct_node_init(x);
+  x->id = hpcrun_cct_persistent_id(node);
+  x->id_parent = parent ? hpcrun_cct_persistent_id(parent) : 0;
+  if (hpcrun_cct_no_children(node) && node != a->partial_parent) {
+    x->id = - x->id;
+  }
+  if (a->part->flags.fields.isLogicalUnwind) {
+    x->as_info = addr->as_info;
+    lush_lip_init(&x->lip);
+    if (addr->lip) {
+      x->lip = *(addr->lip);
+    }
+  }
+  x->lm_id = (addr->ip_norm).lm_id;
+  x->lm_ip = (hpcfmt_vma_t) (uintptr_t) (addr->ip_norm).lm_ip;
+
+  x->num_metrics = a->part->num_metrics;
+  x->metrics = a->metrics;
+  hpcrun_metric_set_dense_copy(x->metrics,
+			       hpcrun_get_metric_set_specific(a->map, node),
+			       x->num_metrics);
+  a->metrics += x->num_metrics;
+}
+
+
+// Returns: a copy of the profile of 'cptd' for its current window,
+// else NULL.  Only uses mmap, so it may run in the sample handler.
+static window_part_t*
+window_copy(core_profile_trace_data_t * cptd, int rank, uint64_t* bounds)
+{
+  uint32_t num_epochs = 0;
+  size_t num_nodes = 0;
+  for (epoch_t* e = cptd->epoch; e; e = e->next) {
+    cct_bundle_t* cct = &(e->csdata);
+    hpcrun_cct_walk_node_1st(cct->top, window_count_node, &num_nodes);
+    if (! hpcrun_cct_parent(cct->partial_unw_root)) {
+      hpcrun_cct_walk_node_1st(cct->partial_unw_root, window_count_node, &num_nodes);
+    }
+    num_epochs++;
+  }
+
+  size_t num_metrics = hpcrun_get_num_metrics();
+  size_t size = sizeof(window_part_t)
+    + num_epochs * sizeof(window_epoch_t)
+    + num_nodes * sizeof(hpcrun_fmt_cct_node_t)
+    + num_nodes * num_metrics * sizeof(hpcrun_metricVal_t)
+    + num_metrics * sizeof(metric_aux_info_t);
+
+  window_part_t* part = hpcrun_mmap_anon(size);
+  if (part == NULL) {
+    return NULL;
+  }
+  part->next = NULL;
+  part->size = size;
+  part->rank = rank;
+  part->tid = cptd->id;
+  part->window = cptd->profile_window;
+  part->bounds[0] = bounds[0];
+  part->bounds[1] = bounds[1];
+  part->flags = epoch_flags;
+  part->flags.fields.isLogicalUnwind = hpcrun_isLogicalUnwind();
+  part->num_metrics = num_metrics;
+  part->num_epochs = num_epochs;
+  part->epochs = (window_epoch_t*) (part + 1);
+
+  hpcrun_fmt_cct_node_t* nodes = (hpcrun_fmt_cct_node_t*) (part->epochs + num_epochs);
+  window_copy_arg_t arg = {
+    .part = part,
+    .metrics = (hpcrun_metricVal_t*) (nodes + num_nodes),
+    .map = &(cptd->cct2metrics_map),
+  };
+
+  window_epoch_t* we = part->epochs;
+  for (epoch_t* e = cptd->epoch; e; e = e->next, we++) {
+    cct_bundle_t* cct = &(e->csdata);
+    we->loadmap = e->loadmap;
+    we->num_nodes = 0;
+    we->nodes = nodes;
+
+    arg.epoch = we;
+    arg.partial_root = NULL;
+    arg.partial_parent = NULL;
+    if (! hpcrun_cct_parent(cct->partial_unw_root)) {
+      // see hpcrun_cct_bundle_fwrite()
+      arg.partial_root = cct->partial_unw_root;
+      arg.partial_parent = cct->tree_root;
+    }
+    hpcrun_cct_walk_node_1st(cct->top, window_copy_node, &arg);
+    if (arg.partial_root) {
+      hpcrun_cct_walk_node_1st(arg.partial_root, window_copy_node, &arg);
+    }
+    nodes += we->num_nodes;
+  }
+
+  part->perf_event_info = NULL;
+  if (cptd->perf_event_info) {
+    part->perf_event_info = (metric_aux_info_t*) arg.metrics;
+    memcpy(part->perf_event_info, cptd->perf_event_info,
+	   num_metrics * sizeof(metric_aux_info_t));
+  }
+
+  return part;
+}
+
+
+static void
+window_push(window_part_t* part)
+{
+  window_part_t* head = atomic_load_explicit(&window_parts, memory_order_relaxed);
+  do {
+    part->next = head;
+  } while (! atomic_compare_exchange_weak_explicit(&window_parts, &head, part,
+						   memory_order_release,
+						   memory_order_relaxed));
+  if (window_helper) {
+    sem_post(&window_sem); // async-signal-safe
+  }
+}
+
+
+static int
+window_cmp_idx(const void* a, const void* b)
+{
+  uint64_t x = *(const uint64_t*) a;
+  uint64_t y = *(const uint64_t*) b;
+  return (x > y) - (x < y);
+}
+
+
+// writes the cct of an epoch of a part, as hpcrun_cct_fwrite() does
+static void
+window_cct_fwrite(FILE* fs, window_part_t* part, window_epoch_t* we,
+		  hpcrun_fmt_tocEntry_t* toc_entry)
+{
+  toc_entry->cctOff = ftello(fs);
+  toc_entry->numNodes = we->num_nodes;
+  toc_entry->numMetrics = part->num_metrics;
+  toc_entry->nodeSz = hpcrun_fmt_cct_node_size(part->flags, part->num_metrics);
+
+  hpcfmt_int8_fwrite(we->num_nodes, fs);
+
+  uint64_t* idx = NULL;
+  if (we->num_nodes > 0) {
+    idx = malloc(we->num_nodes * sizeof(uint64_t));
+  }
+  for (uint64_t i = 0; i < we->num_nodes; i++) {
+    hpcrun_fmt_cct_node_t* x = &(we->nodes[i]);
+    hpcrun_fmt_cct_node_fwrite(x, part->flags, fs);
+    if (idx) {
+      // the ids of leaves were negated
+      int32_t id = (int32_t) x->id;
+      uint64_t key = (uint32_t) ((id < 0) ? - id : id);
+      idx[i] = (key << 32) | i;
+    }
+  }
+
+  toc_entry->cctIdxOff = ftello(fs);
+  if (idx) {
+    qsort(idx, we->num_nodes, sizeof(uint64_t), window_cmp_idx);
+    hpcrun_fmt_cctIdx_fwrite(idx, we->num_nodes, fs);
+    free(idx);
+  }
+  else {
+    hpcrun_fmt_cctIdx_fwrite(NULL, 0, fs);
+  }
+}
+
+
+// writes a part to its window file.  not for the sample handler.
+static void
+window_fwrite(window_part_t* part)
+{
+  TMSG(DATA_WRITE, "thread %d: writing profile window %"PRIu64,
+       part->tid, part->window);
+
+  int fd = hpcrun_open_profile_window_file(part->rank, part->tid, part->window);
+  FILE* fs = profile_fdopen(fd);
+  if (fs == NULL) {
+    EMSG("HPCToolkit: %s: unable to open profile window file", __func__);
+    close(fd);
+    return;
+  }
+
+  // the toc entries, linked as toc_append() does
+  profile_toc_t* toc = NULL;
+  if (part->num_epochs > 0) {
+    toc = calloc(part->num_epochs, sizeof(profile_toc_t));
+  }
+  for (uint32_t i = 0; toc && i + 1 < part->num_epochs; i++) {
+    toc[i].next = &toc[i + 1];
+  }
+
+  write_file_hdr(fs, part->tid, 0, 0, part->rank, 1, part->bounds);
+  bool use_dict = (dict_open() != NULL);
+
+  for (uint32_t i = 0; i < part->num_epochs; i++) {
+    hpcrun_fmt_tocEntry_t toc_dummy;
+    hpcrun_fmt_tocEntry_t* toc_entry = (toc) ? &(toc[i].entry) : &toc_dummy;
+
+    // the loadmap only changes under the dlopen lock
+    while (! hpcrun_dlopen_read_lock()) {
+      struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000000 };
+      nanosleep(&ts, NULL);
+    }
+    write_epoch_prologue(fs, part->flags, part->epochs[i].loadmap,
+			 part->perf_event_info, use_dict, toc_entry);
+    hpcrun_dlopen_read_unlock();
+
+    window_cct_fwrite(fs, part, &(part->epochs[i]), toc_entry);
+  }
+
+  if (toc || part->num_epochs == 0) {
+    write_toc(fs, toc);
+  }
+  free(toc);
+  hpcio_fclose(fs);
+}
+
+
+// writes the pending parts, oldest first.  the lock keeps the helper
+// and hpcrun_profile_window_fini() from writing at the same time, so
+// that the latter returns when all parts are written.
+static void
+window_write_pending(void)
+{
+  spinlock_lock(&window_write_lock);
+
+  window_part_t* part = atomic_exchange_explicit(&window_parts, NULL,
+						 memory_order_acquire);
+  window_part_t* oldest = NULL;
+  while (part) {
+    window_part_t* next = part->next;
+    part->next = oldest;
+    oldest = part;
+    part = next;
+  }
+
+  while (oldest) {
+    window_part_t* next = oldest->next;
+    window_fwrite(oldest);
+    munmap(oldest, oldest->size);
+    oldest = next;
+  }
+
+  spinlock_unlock(&window_write_lock);
+}
+
+
+static void *
+window_writer(void* arg)
+{
+  for (;;) {
+    if (sem_wait(&window_sem) != 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    window_write_pending();
+  }
+  return NULL;
+}
+
+
+void
+hpcrun_profile_window_init(void)
+{
+  // after fork, the helper and the parts belong to the parent
+  atomic_store_explicit(&window_parts, NULL, memory_order_relaxed);
+  spinlock_init(&window_write_lock);
+  if (window_helper) {
+    sem_destroy(&window_sem);
+    window_helper = false;
+  }
+
+  char* str = getenv(HPCRUN_PROFILE_WINDOW);
+  if (str == NULL) {
+    return;
+  }
+
+  long secs = strtol(str, NULL, 10);
+  if (secs <= 0) {
+    EMSG("HPCToolkit: ignoring invalid profile window: '%s'", str);
+    return;
+  }
+
+  profile_window_us = ((uint64_t) secs) * 1000000;
+  profile_window_origin_us = profile_window_time_us();
+  TMSG(DATA_WRITE, "rotating profiles every %ld seconds", secs);
+
+  if (sem_init(&window_sem, 0, 0) != 0) {
+    EMSG("HPCToolkit: profile windows written at exit: sem_init failed: %s",
+	 strerror(errno));
+    return;
+  }
+
+  // the helper inherits a mask with all signals blocked, so that it
+  // never runs a sample handler, and is hidden from libmonitor
+  sigset_t all, old;
+  sigfillset(&all);
+  monitor_real_pthread_sigmask(SIG_SETMASK, &all, &old);
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  monitor_disable_new_threads();
+  int ret = pthread_create(&thread, &attr, window_writer, NULL);
+  monitor_enable_new_threads();
+  pthread_attr_destroy(&attr);
+
+  monitor_real_pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+  if (ret != 0) {
+    EMSG("HPCToolkit: profile windows written at exit: unable to create thread: %s",
+	 strerror(ret));
+    sem_destroy(&window_sem);
+    return;
+  }
+  window_helper = true;
+}
+
+
+void
+hpcrun_profile_window_fini(void)
+{
+  if (profile_window_us == 0) {
+    return;
+  }
+  window_write_pending();
+}
+
+
+uint64_t
+hpcrun_profile_window_current(void)
+{
+  if (profile_window_us == 0) {
+    return 0;
+  }
+  return (profile_window_time_us() - profile_window_origin_us) / profile_window_us;
+}
+
+
+void
+hpcrun_profile_window_check(core_profile_trace_data_t * cptd)
+{
+  if (profile_window_us == 0) {
+    return;
+  }
+
+  uint64_t window = hpcrun_profile_window_current();
+  if (window == cptd->profile_window) {
+    return;
+  }
+
+  if (hpcrun_sample_prob_active()) {
+    uint64_t bounds[2];
+    bounds[0] = profile_window_origin_us + cptd->profile_window * profile_window_us;
+    bounds[1] = bounds[0] + profile_window_us;
+
+    int rank = hpcrun_get_rank();
+    if (rank < 0) {
+      rank = 0;
+    }
+    window_part_t* part = window_copy(cptd, rank, bounds);
+    if (part == NULL) {
+      // the metrics stay, and are charged to the next window
+      EMSG("HPCToolkit: thread %d: no memory to copy profile window %"PRIu64,
+	   cptd->id, cptd->profile_window);
+      cptd->profile_window = window;
+      return;
+    }
+    TMSG(DATA_WRITE, "thread %d: copied profile window %"PRIu64,
+	 cptd->id, cptd->profile_window);
+    window_push(part);
+  }
+
+  // the copy above splayed the map through cptd, so the reset starts
+  // from its root and zeroes every metric set
+  hpcrun_cct2metrics_reset(&(cptd->cct2metrics_map));
+  cptd->profile_window = window;
+}
+
+
 //
 // DEBUG: fetch and print current loadmap
 //
@@ -51,6 +51,14 @@
 #include "core_profile_trace_data.h"
 
 extern int hpcrun_write_profile_data(core_profile_trace_data_t * cptd);
+extern int hpcrun_write_merged_profile_data(core_profile_trace_data_t * cptd, int num_threads);
 extern void hpcrun_flush_epochs(core_profile_trace_data_t * cptd);
 
+// continuous profiling: rotate the profile of 'cptd' at the end of
+// each profile window (see write_data.c)
+extern void hpcrun_profile_window_init(void);
+extern void hpcrun_profile_window_fini(void);
+extern uint64_t hpcrun_profile_window_current(void);
+extern void hpcrun_profile_window_check(core_profile_trace_data_t * cptd);
+
 #endif // WRITE_DATA_H
@@ -61,6 +61,8 @@
 #include "Constants.hpp"
 #include "DebugUtils.hpp"
 
+#include <lib/prof-lean/hpcrun-fmt.h>
+
 using namespace std;
 
 namespace TraceviewerServer
@@ -114,6 +116,7 @@ namespace TraceviewerServer
 
 		processIDs = new int[numFiles];
 		threadIDs = new short[numFiles];
+		endians = new char[numFiles];
 		offsets = new OffsetPair[numFiles];
 
 
@@ -128,6 +131,9 @@ namespace TraceviewerServer
 			currentPos += SIZEOF_INT;
 
 			offsets[i].start = masterBuff->getLong(currentPos);
+			// each merged file starts with its own hpctrace header
+			endians[i] = masterBuff->getByte(offsets[i].start
+					+ HPCTRACE_FMT_MagicLen + HPCTRACE_FMT_VersionLen);
 			//offset.end is the position of the last trace record that is a part of that line
 			if (i > 0)
 				offsets[i-1].end = offsets[i].start - SIZE_OF_TRACE_RECORD;
@@ -183,6 +189,7 @@ namespace TraceviewerServer
 		delete(masterBuff);
 		delete[] processIDs;
 		delete[] threadIDs;
+		delete[] endians;
 		delete[] offsets;
 	}
 
@@ -89,6 +89,7 @@ public:
 
 	int* processIDs;
 	short* threadIDs;
+	char* endians; // byte order of each file's trace records
 private:
 	int type; // Default is Constants::MULTI_PROCESSES | Constants::MULTI_THREADING;
 	LargeByteBuffer* masterBuff;
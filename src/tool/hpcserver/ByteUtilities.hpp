@@ -63,6 +63,7 @@
 #define BYTEUTILITIES_H_
 
 #include <stdint.h>
+#include <string.h>
 
 namespace TraceviewerServer
 {
@@ -91,6 +92,46 @@ namespace TraceviewerServer
 			return combined;
 		}
 
+		// Trace records are in the byte order named by the endian byte
+		// of their hpctrace header: 'b' (big) or 'l' (little).  Data in
+		// host order is loaded directly.
+		static int readInt(char* buffer, char endian)
+		{
+			if (endian == hostEndian()) {
+				int32_t val;
+				memcpy(&val, buffer, sizeof(val));
+				return val;
+			}
+			return (endian == 'l') ? readIntLittle(buffer) : readInt(buffer);
+		}
+		static int64_t readLong(char* buffer, char endian)
+		{
+			if (endian == hostEndian()) {
+				int64_t val;
+				memcpy(&val, buffer, sizeof(val));
+				return val;
+			}
+			return (endian == 'l') ? readLongLittle(buffer) : readLong(buffer);
+		}
+		static int readIntLittle(char* buffer)
+		{
+			unsigned char* uBuffer = (unsigned char*) buffer;
+			return ((uBuffer[3] << 24) | (uBuffer[2] << 16) | (uBuffer[1] << 8)
+					| (uBuffer[0]));
+		}
+		static int64_t readLongLittle(char* buffer)
+		{
+			unsigned int lowWord = readIntLittle(buffer);
+			unsigned int highWord = readIntLittle(buffer + 4);
+			uint64_t combined = (((uint64_t) highWord) << 32) | lowWord;
+			return combined;
+		}
+		static char hostEndian()
+		{
+			const uint16_t one = 1;
+			return (*(const unsigned char*) &one == 1) ? 'l' : 'b';
+		}
+
 		static void writeShort(char* buffer, short ToWrite)
 		{
 			unsigned short utoWrite = ToWrite;
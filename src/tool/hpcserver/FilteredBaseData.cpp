@@ -112,13 +112,19 @@ FileOffset FilteredBaseData::getMaxLoc(int pseudoRank){
 	return baseOffsets[rankMapping[pseudoRank]].end;
 }
 
-int64_t FilteredBaseData::getLong(FileOffset position)
+char FilteredBaseData::getEndian(int pseudoRank)
 {
-	return baseDataFile->getMasterBuffer()->getLong(position);
+	assert((unsigned int)pseudoRank < rankMapping.size());
+	return baseDataFile->endians[rankMapping[pseudoRank]];
+}
+
+int64_t FilteredBaseData::getLong(FileOffset position, char endian)
+{
+	return baseDataFile->getMasterBuffer()->getLong(position, endian);
 }
-int FilteredBaseData::getInt(FileOffset position)
+int FilteredBaseData::getInt(FileOffset position, char endian)
 {
-	return baseDataFile->getMasterBuffer()->getInt(position);
+	return baseDataFile->getMasterBuffer()->getInt(position, endian);
 }
 
 int FilteredBaseData::getNumberOfRanks()
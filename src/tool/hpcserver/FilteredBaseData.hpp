@@ -80,8 +80,9 @@ namespace TraceviewerServer
 
 		FileOffset getMinLoc(int pseudoRank);
 		FileOffset getMaxLoc(int pseudoRank);
-		int64_t getLong(FileOffset position);
-		int getInt(FileOffset position);
+		char getEndian(int pseudoRank);
+		int64_t getLong(FileOffset position, char endian);
+		int getInt(FileOffset position, char endian);
 		int getNumberOfRanks();
 		int* getProcessIDs();
 		short* getThreadIDs();
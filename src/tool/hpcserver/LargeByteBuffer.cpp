@@ -146,6 +146,26 @@ namespace TraceviewerServer
 		return val;
 
 	}
+	int LargeByteBuffer::getInt(FileOffset pos, char endian)
+	{
+		int Page = pos / mmPageSize;
+		int loc = pos % mmPageSize;
+		char* p2D = masterBuffer[Page].get() + loc;
+		return ByteUtilities::readInt(p2D, endian);
+	}
+	Long LargeByteBuffer::getLong(FileOffset pos, char endian)
+	{
+		int Page = pos / mmPageSize;
+		int loc = pos % mmPageSize;
+		char* p2D = masterBuffer[Page].get() + loc;
+		return ByteUtilities::readLong(p2D, endian);
+	}
+	char LargeByteBuffer::getByte(FileOffset pos)
+	{
+		int Page = pos / mmPageSize;
+		int loc = pos % mmPageSize;
+		return *(masterBuffer[Page].get() + loc);
+	}
 	//Could very well be a template, but we only use it for uint64_t
 	uint64_t LargeByteBuffer::lcm(uint64_t _a, uint64_t _b)
 	{
@@ -80,6 +80,9 @@ namespace TraceviewerServer
 		FileOffset size();
 		Long getLong(FileOffset);
 		int getInt(FileOffset);
+		Long getLong(FileOffset, char endian);
+		int getInt(FileOffset, char endian);
+		char getByte(FileOffset);
 	private:
 		static uint64_t lcm(uint64_t, uint64_t);
 		static uint64_t getRamSize();
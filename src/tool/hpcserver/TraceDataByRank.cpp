@@ -74,6 +74,7 @@ namespace TraceviewerServer
 		//OffsetPair* offsets = data->getOffsets();
 		minloc = data->getMinLoc(rank);
 		maxloc = data->getMaxLoc(rank);
+		endian = data->getEndian(rank);
 		numPixelsH = _numPixelH;
 
 		
@@ -190,8 +191,8 @@ namespace TraceviewerServer
 		FileOffset l_index = getRelativeLocation(l_boundOffset);
 		FileOffset r_index = getRelativeLocation(r_boundOffset);
 
-		Time l_time = data->getLong(l_boundOffset);
-		Time r_time = data->getLong(r_boundOffset);
+		Time l_time = data->getLong(l_boundOffset, endian);
+		Time r_time = data->getLong(r_boundOffset, endian);
 	
 		// apply "Newton's method" to find target time
 		while (r_index - l_index > 1)
@@ -220,7 +221,7 @@ namespace TraceviewerServer
 			if (predicted_index >= r_index)
 				predicted_index = r_index - 1;
 
-			Time temp = data->getLong(getAbsoluteLocation(predicted_index));
+			Time temp = data->getLong(getAbsoluteLocation(predicted_index), endian);
 			if (time >= temp)
 			{
 				l_index = predicted_index;
@@ -235,8 +236,8 @@ namespace TraceviewerServer
 		FileOffset l_offset = getAbsoluteLocation(l_index);
 		FileOffset r_offset = getAbsoluteLocation(r_index);
 
-		l_time = data->getLong(l_offset);
-		r_time = data->getLong(r_offset);
+		l_time = data->getLong(l_offset, endian);
+		r_time = data->getLong(r_offset, endian);
 
 		int leftDiff = time - l_time;
 		int rightDiff = r_time - time;
@@ -274,8 +275,8 @@ namespace TraceviewerServer
 	TimeCPID TraceDataByRank::getData(FileOffset location)
 	{
 
-		 Time time = data->getLong(location);
-		 int CPID = data->getInt(location + SIZEOF_LONG);
+		 Time time = data->getLong(location, endian);
+		 int CPID = data->getInt(location + SIZEOF_LONG, endian);
 		TimeCPID ToReturn(time, CPID);
 		return ToReturn;
 	}
@@ -89,6 +89,7 @@ namespace TraceviewerServer
 
 		FileOffset minloc;
 		FileOffset maxloc;
+		char endian;
 		int numPixelsH;
 
 		FileOffset getAbsoluteLocation(FileOffset);
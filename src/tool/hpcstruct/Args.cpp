@@ -172,6 +172,8 @@ Options: Output:\n\
                        Write hpcstruct file to <file>.\n\
                        Use '--output=-' to write output to stdout.\n\
   --compact            Generate compact output, eliminating extra white space\n\
+  --binary             Write the structure in binary form instead of XML.\n\
+                       hpcprof loads it without parsing.\n\
 ";
 
 // Possible extensions:
@@ -219,6 +221,8 @@ CmdLineParser::OptArgDesc Args::optArgs[] = {
      NULL },
   {  0 , "compact",         CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
      NULL },
+  {  0 , "binary",          CLP::ARG_NONE, CLP::DUPOPT_CLOB, NULL,
+     NULL },
 
   // General
   { 'v', "verbose",     CLP::ARG_OPT,  CLP::DUPOPT_CLOB, NULL,
@@ -270,6 +274,7 @@ Args::Ctor()
   isIrreducibleIntervalLoop = true;
   isForwardSubstitution = true;
   prettyPrintOutput = true;
+  binaryOutput = false;
   useBinutils = false;
   show_gaps = false;
 }
@@ -441,6 +446,9 @@ Args::parse(int argc, const char* const argv[])
     if (parser.isOpt("compact")) {
       prettyPrintOutput = false;
     }
+    if (parser.isOpt("binary")) {
+      binaryOutput = true;
+    }
 
     // Check for required arguments
     if (parser.getNumArgs() != 1) {
@@ -125,6 +125,7 @@ public:
 
   std::string out_filenm;
   bool prettyPrintOutput;         // default: true
+  bool binaryOutput;              // default: false
   bool useBinutils;		  // default: false
   bool show_gaps;                 // default: false
 
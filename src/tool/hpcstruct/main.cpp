@@ -189,6 +189,7 @@ realmain(int argc, char* argv[])
 #endif
 
   opts.show_time = args.show_time;
+  opts.binary = args.binaryOutput;
 
   // ------------------------------------------------------------
   // Set the demangler before reading the executable 